@@ -23,95 +23,150 @@
 #include <vw/Core/Cache.h>
 #include <vw/Core/Debugging.h>
 
+vw::Cache::Cache( size_t max_size, uint32 num_shards ) :
+  m_num_shards( num_shards ? num_shards : 1 ), m_shards( new Shard[m_num_shards] ),
+  m_size(0), m_max_size(max_size) {}
+
+// Lines are assigned to shards by hashing their address.  The low bits
+// of a heap address carry little information, so drop them and mix
+// the rest with a multiplicative hash.
+vw::uint32 vw::Cache::shard_index( CacheLineBase const* line ) const {
+  if ( m_num_shards == 1 ) return 0;
+  uint64 key = reinterpret_cast<size_t>(line) >> 4;
+  key *= 0x9E3779B97F4A7C15ULL;
+  return uint32( (key >> 32) % m_num_shards );
+}
+
+// Put the cache line at the front of its shard's valid list (so the
+// most recently validated).  Must be called with the shard lock held.
+void vw::Cache::link_front( Shard& shard, CacheLineBase *line ) {
+  if ( line->m_listed ) {
+    if ( line == shard.first_valid ) return;
+    unlink( shard, line );
+  }
+  line->m_next = shard.first_valid;
+  line->m_prev = 0;
+  if ( shard.first_valid ) shard.first_valid->m_prev = line;
+  shard.first_valid = line;
+  if ( !shard.last_valid ) shard.last_valid = line;
+  line->m_listed = true;
+  shard.num_valid++;
+}
+
+// Take the cache line off its shard's valid list, if it is on it.
+// Must be called with the shard lock held.
+void vw::Cache::unlink( Shard& shard, CacheLineBase *line ) {
+  if ( !line->m_listed ) return;
+  if ( line == shard.first_valid ) shard.first_valid = line->m_next;
+  if ( line == shard.last_valid ) shard.last_valid = line->m_prev;
+  if ( line->m_next ) line->m_next->m_prev = line->m_prev;
+  if ( line->m_prev ) line->m_prev->m_next = line->m_next;
+  line->m_next = line->m_prev = 0;
+  line->m_listed = false;
+  shard.num_valid--;
+}
+
+// Invalidate lines from the back of the shard's valid list until the
+// cache fits in its budget again.  A line that has been hit since the
+// last pass, or that is busy in another thread, gets a second chance
+// and is moved back to the front.  Must be called with the shard lock
+// held.  Returns the number of lines evicted.
+vw::uint64 vw::Cache::evict( Shard& shard, CacheLineBase *line ) {
+  uint64 evicted = 0;
+
+  // Each line can be passed over at most twice (once to clear its
+  // reference flag, once more if it is busy), so this bounds the scan
+  // even when nothing can be freed.
+  size_t budget = 2 * shard.num_valid + 1;
+
+  while ( m_size > m_max_size && shard.last_valid && budget-- > 0 ) {
+    CacheLineBase* victim = shard.last_valid;
+
+    // Never evict the line we are making room for.
+    if ( victim == line || victim->m_referenced.exchange(false) ) {
+      link_front( shard, victim );
+      continue;
+    }
+
+    if ( victim->try_invalidate() )
+      evicted++;
+    else
+      link_front( shard, victim );
+  }
+  return evicted;
+}
+
 void vw::Cache::allocate( size_t size, CacheLineBase* line ) {
 
-  // Put the current cache line at the top of the list (so the most
-  // recently used). If the cache size is beyond the storage limit,
-  // de-allocate the least recently used elements.
+  // Put the current cache line at the front of its shard's list. If
+  // the cache size is beyond the storage limit, de-allocate lines
+  // that have not been used recently.
 
   // Note: Doing allocation implies the need to call validate.
 
-  // WARNING! YOU CAN NOT HOLD THE CACHE MUTEX AND THEN CALL
-  // INVALIDATE. That's a line -> cache -> line mutex hold. A
-  // deadlock!
+  // WARNING! YOU CAN NOT HOLD A SHARD MUTEX AND THEN CALL
+  // INVALIDATE. That's a line -> shard -> line mutex hold. A
+  // deadlock! (evict() only ever try-locks other lines.)
 
   // The lock below is recursive, so if a resource is locked by a
   // thread, it can still be accessed by this thread, but not by
   // others.
-  RecursiveMutex::Lock cache_lock( m_line_mgmt_mutex );
-
+  Shard& home = shard( line );
   uint64 local_evictions = 0;
+  {
+    RecursiveMutex::Lock shard_lock( home.line_mgmt_mutex );
+    link_front( home, line );
+    m_size += size;   // Update the size after adding the new line
+    VW_CACHE_DEBUG( VW_OUT(DebugMessage, "cache") << "Cache allocated " << size
+                    << " bytes (" << m_size << " / " << m_max_size << " used)" << "\n"; );
 
-  validate( line ); // Call here to insure that last_valid is not us!
-  m_size += size;   // Update the size after adding the new line
-  VW_CACHE_DEBUG( VW_OUT(DebugMessage, "cache") << "Cache allocated " << size
-                  << " bytes (" << m_size << " / " << m_max_size << " used)" << "\n"; );
-
-  CacheLineBase* local_last_valid = m_last_valid;
-
-  while ( m_size > m_max_size ) {
-
-    if ( local_last_valid == line || !local_last_valid ) {
-      // De-allocated all lines except the current one which are not
-      // held up currently by other threads.
-      break;
-    }
-
-    bool invalidated = local_last_valid->try_invalidate();
-    if (invalidated) {
-      local_evictions++;
-      local_last_valid = m_last_valid;
-    } else {
-      // If we can't deallocate current line,
-      // switch to the one used a bit more recently.
-      local_last_valid = local_last_valid->m_prev;
-    }
+    local_evictions += evict( home, line );
   }
 
-  {
-    Mutex::WriteLock cache_lock( m_stats_mutex );
-    m_evictions += local_evictions;
+  // If our own shard could not free enough, take from the others.
+  // Only one shard lock is held at a time.
+  for ( uint32 i = 1; i < m_num_shards && m_size > m_max_size; ++i ) {
+    Shard& other = m_shards[ (line->m_shard + i) % m_num_shards ];
+    RecursiveMutex::Lock shard_lock( other.line_mgmt_mutex );
+    local_evictions += evict( other, line );
   }
 
+  home.evictions += local_evictions;
+
   if ( m_size > m_max_size ) {
     VW_OUT(WarningMessage, "cache")   << "Cached object (" << size << ") larger than requested maximum cache size (" << m_max_size << "). Current size = " << m_size << "\n";
   }
 }
 
 void vw::Cache::resize( size_t size ) {
-  // WARNING! YOU CAN NOT HOLD THE CACHE MUTEX AND THEN CALL
-  // INVALIDATE. That's a line -> cache -> line mutex hold. A
+  // WARNING! YOU CAN NOT HOLD A SHARD MUTEX AND THEN CALL
+  // INVALIDATE. That's a line -> shard -> line mutex hold. A
   // deadlock!
-  size_t local_size, local_max_size;
-  CacheLineBase* local_last_valid;
-  { // Locally buffer variables that require Cache Mutex
-    RecursiveMutex::Lock cache_lock(m_line_mgmt_mutex);
-    m_max_size = size;
-    local_size = m_size;
-    local_max_size = m_max_size;
-    local_last_valid = m_last_valid;
-  }
-  while ( local_size > local_max_size ) {
-    VW_ASSERT( local_last_valid, LogicErr() << "Cache is empty but has nonzero size!" );
-    m_last_valid->invalidate(); // Problem ( probably grabs a line's mutex too )
-    { // Update local buffer by grabbing cache buffer
-      RecursiveMutex::Lock cache_lock( m_line_mgmt_mutex );
-      local_size = m_size;
-      local_last_valid = m_last_valid;
+  m_max_size = size;
+  for ( uint32 i = 0; i < m_num_shards && m_size > m_max_size; ++i ) {
+    Shard& s = m_shards[i];
+    while ( m_size > m_max_size ) {
+      CacheLineBase* local_last_valid;
+      { // Locally buffer the victim, which requires the shard mutex
+        RecursiveMutex::Lock shard_lock( s.line_mgmt_mutex );
+        local_last_valid = s.last_valid;
+      }
+      if ( !local_last_valid ) break;
+      local_last_valid->invalidate(); // Grabs the line's mutex, then the shard's
     }
   }
 }
 
 size_t vw::Cache::max_size() {
-  RecursiveMutex::Lock cache_lock(m_line_mgmt_mutex);
   return m_max_size;
 }
 
 void vw::Cache::deallocate( size_t size, CacheLineBase *line ) {
-  RecursiveMutex::Lock cache_lock(m_line_mgmt_mutex);
+  Shard& s = shard( line );
+  RecursiveMutex::Lock shard_lock( s.line_mgmt_mutex );
 
   // This call implies the need to call invalidate
-  invalidate( line );
+  unlink( s, line );
 
   m_size -= size;
   VW_CACHE_DEBUG( VW_OUT(DebugMessage, "cache") << "Cache deallocated " << size << " bytes (" << m_size << " / " << m_max_size << " used)" << "\n"; )
@@ -119,73 +174,69 @@ void vw::Cache::deallocate( size_t size, CacheLineBase *line ) {
 
 // Move the cache line to the top of the valid list.
 void vw::Cache::validate( CacheLineBase *line ) {
-  RecursiveMutex::Lock cache_lock(m_line_mgmt_mutex);
-  if( line == m_first_valid ) return;
-  if( line == m_last_valid ) m_last_valid = line->m_prev;
-  if( line == m_first_invalid ) m_first_invalid = line->m_next;
-  if( line->m_next ) line->m_next->m_prev = line->m_prev;
-  if( line->m_prev ) line->m_prev->m_next = line->m_next;
-  line->m_next = m_first_valid;
-  line->m_prev = 0;
-  if( m_first_valid ) m_first_valid->m_prev = line;
-  m_first_valid = line;
-  if( ! m_last_valid ) m_last_valid = line;
+  Shard& s = shard( line );
+  RecursiveMutex::Lock shard_lock( s.line_mgmt_mutex );
+  link_front( s, line );
 }
 
-// Move the cache line to the top of the invalid list.
+// Invalid lines are simply not on any list.
 void vw::Cache::invalidate( CacheLineBase *line ) {
-  RecursiveMutex::Lock cache_lock(m_line_mgmt_mutex);
-  if( line == m_first_valid ) m_first_valid = line->m_next;
-  if( line == m_last_valid ) m_last_valid = line->m_prev;
-  if( line->m_next ) line->m_next->m_prev = line->m_prev;
-  if( line->m_prev ) line->m_prev->m_next = line->m_next;
-  line->m_next = m_first_invalid;
-  line->m_prev = 0;
-  if( m_first_invalid ) m_first_invalid->m_prev = line;
-  m_first_invalid = line;
+  Shard& s = shard( line );
+  RecursiveMutex::Lock shard_lock( s.line_mgmt_mutex );
+  unlink( s, line );
 }
 
 // Remove the cache line from the cache lists.
 void vw::Cache::remove( CacheLineBase *line ) {
-  RecursiveMutex::Lock cache_lock(m_line_mgmt_mutex);
-  if( line == m_first_valid ) m_first_valid = line->m_next;
-  if( line == m_last_valid ) m_last_valid = line->m_prev;
-  if( line == m_first_invalid ) m_first_invalid = line->m_next;
-  if( line->m_next ) line->m_next->m_prev = line->m_prev;
-  if( line->m_prev ) line->m_prev->m_next = line->m_next;
-  line->m_next = line->m_prev = 0;
+  Shard& s = shard( line );
+  RecursiveMutex::Lock shard_lock( s.line_mgmt_mutex );
+  unlink( s, line );
 }
 
-// Move the cache line to the bottom of the valid list.
+// Move the cache line to the bottom of the valid list, and forget
+// that it was used, so that it is the next one to go.
 void vw::Cache::deprioritize( CacheLineBase *line ) {
-  RecursiveMutex::Lock cache_lock(m_line_mgmt_mutex);
-  if( line == m_last_valid ) return;
-  if( line == m_first_valid ) m_first_valid = line->m_next;
-  if( line->m_next ) line->m_next->m_prev = line->m_prev;
-  if( line->m_prev ) line->m_prev->m_next = line->m_next;
-  line->m_prev = m_last_valid;
+  Shard& s = shard( line );
+  RecursiveMutex::Lock shard_lock( s.line_mgmt_mutex );
+  line->m_referenced = false;
+  if ( !line->m_listed || line == s.last_valid ) return;
+  unlink( s, line );
+  line->m_prev = s.last_valid;
   line->m_next = 0;
-  m_last_valid->m_next = line;
-  m_last_valid = line;
+  if ( s.last_valid ) s.last_valid->m_next = line;
+  s.last_valid = line;
+  if ( !s.first_valid ) s.first_valid = line;
+  line->m_listed = true;
+  s.num_valid++;
 }
 
-// Statistics request methods
+// Statistics request methods.  These add up the per-shard counters,
+// so they are only a snapshot while other threads use the cache.
 vw::uint64 vw::Cache::hits() {
-  Mutex::ReadLock cache_lock( m_stats_mutex );
-  return m_hits;
+  uint64 total = 0;
+  for ( uint32 i = 0; i < m_num_shards; ++i )
+    total += m_shards[i].hits;
+  return total;
 }
 
 vw::uint64 vw::Cache::misses() {
-  Mutex::ReadLock cache_lock( m_stats_mutex );
-  return m_misses;
+  uint64 total = 0;
+  for ( uint32 i = 0; i < m_num_shards; ++i )
+    total += m_shards[i].misses;
+  return total;
 }
 
 vw::uint64 vw::Cache::evictions() {
-  Mutex::ReadLock cache_lock( m_stats_mutex );
-  return m_evictions;
+  uint64 total = 0;
+  for ( uint32 i = 0; i < m_num_shards; ++i )
+    total += m_shards[i].evictions;
+  return total;
 }
 
 void vw::Cache::clear_stats() {
-  Mutex::WriteLock cache_lock( m_stats_mutex );
-  m_hits = m_misses = m_evictions = 0;
+  for ( uint32 i = 0; i < m_num_shards; ++i ) {
+    m_shards[i].hits = 0;
+    m_shards[i].misses = 0;
+    m_shards[i].evictions = 0;
+  }
 }
@@ -19,8 +19,9 @@
 /// \file Core/Cache.h
 ///
 /// The Vision Workbench provides a thread-safe system for caching
-/// regeneratable data.  When the cache is full, the least recently
-/// used object is "invalidated" to make room for new objects.
+/// regeneratable data.  When the cache is full, an object that has
+/// not been used recently is "invalidated" to make room for new
+/// objects.
 /// Invalidated objects have had the resource associated with them
 /// (e.g. memory or other resources) deallocated or freed, however,
 /// the object can be "regenerated" (that is, the resource is
@@ -43,13 +44,22 @@
 ///  The entire Handle<GeneratorT> class
 ///
 /// No other functions are guaranteed to be thread-safe.  There are
-/// two levels of synchronization: one lock per cache to protect the
-/// cache data structure itself, and one lock per cache line to
-/// protect the m_value pointer and synchronize the (potentially very
-/// expensive) generation operation.  However, the lock on the cache
-/// line ends just before the generate() method is called on the
-/// m_value object itself, so that object is responsible for its own
-/// thread safety.
+/// two levels of synchronization: one lock per cache shard to protect
+/// that shard's list of valid cache lines, and one lock per cache
+/// line to protect the m_value pointer and synchronize the
+/// (potentially very expensive) generation operation.  However, the
+/// lock on the cache line ends just before the generate() method is
+/// called on the m_value object itself, so that object is responsible
+/// for its own thread safety.
+///
+/// Cache lines are spread over a number of independent shards (one by
+/// default) by hashing the line's address.  Each shard keeps its own
+/// list of valid lines and its own statistics, so threads working on
+/// different lines rarely contend for the same lock.  The size limit
+/// applies to the cache as a whole.  Eviction uses the CLOCK (second
+/// chance) policy: a cache hit only sets a flag on the line itself,
+/// and lines that have been hit since the last pass are skipped once
+/// before they are evicted.
 ///
 /// Note also that the valid() function is only useful as a heuristic:
 /// there is no guarantee that the cache line won't be invalidated
@@ -71,6 +81,8 @@
 #include <vw/Core/System.h>
 
 #include <boost/shared_ptr.hpp>
+#include <boost/scoped_array.hpp>
+#include <boost/atomic.hpp>
 #include <typeinfo>
 #include <sstream>
 
@@ -101,7 +113,7 @@ namespace vw {
   // virtual and contains {generator,object,valid} Handle contains a
   // shared pointer to CacheLine
 
-  // An LRU-based regeneratable-data cache
+  // A sharded, CLOCK-based regeneratable-data cache
   class Cache {
 
     // The abstract base class for all cache line objects.
@@ -109,6 +121,9 @@ namespace vw {
       Cache& m_cache;
       CacheLineBase *m_prev, *m_next;
       const size_t m_size;
+      const uint32 m_shard;
+      bool m_listed;                 // On its shard's valid list?
+      boost::atomic<bool> m_referenced; // Hit since the last eviction pass?
       friend class Cache;
     protected:
       Cache& cache() const { return m_cache; }
@@ -117,8 +132,12 @@ namespace vw {
       inline void validate() { m_cache.validate(this); }
       inline void remove() { m_cache.remove(this); }
       inline void deprioritize() { m_cache.deprioritize(this); }
+      inline void hit() { m_referenced = true; m_cache.m_shards[m_shard].hits++; }
+      inline void miss() { m_cache.m_shards[m_shard].misses++; }
     public:
-      CacheLineBase( Cache& cache, size_t size ) : m_cache(cache), m_prev(0), m_next(0), m_size(size) {}
+      CacheLineBase( Cache& cache, size_t size )
+        : m_cache(cache), m_prev(0), m_next(0), m_size(size),
+          m_shard(cache.shard_index(this)), m_listed(false), m_referenced(false) {}
       virtual ~CacheLineBase() {}
       virtual inline void invalidate() { m_cache.invalidate(this); }
       virtual inline bool try_invalidate() { m_cache.invalidate(this); return true; }
@@ -130,7 +149,7 @@ namespace vw {
     //
     // Always follow the order of mutexs is:
     // ACQUIRE LINE FIRST
-    // ACQUIRE CACHE's LINE MGMT SECOND
+    // ACQUIRE SHARD's LINE MGMT SECOND
     template <class GeneratorT>
     class CacheLine : public CacheLineBase {
       GeneratorT m_generator;
@@ -192,17 +211,10 @@ namespace vw {
       // that another thread could delete.
       value_type const& value() {
         m_mutex.lock_shared();
-        bool hit = (bool)m_value;
-        {
-          { // This should be abstracted into a call
-            Mutex::WriteLock cache_lock( cache().m_stats_mutex );
-            if (hit)
-              cache().m_hits++;
-            else
-              cache().m_misses++;
-          }
-        }
-        if( !hit ) {
+        if( m_value ) {
+          CacheLineBase::hit();
+        } else {
+          CacheLineBase::miss();
           VW_CACHE_DEBUG( VW_OUT(DebugMessage, "cache") << "Cache generating CacheLine " << info() << "\n"; );
           m_mutex.unlock_shared(); // Loose shared
           m_mutex.lock_upgrade();  // Get upgrade status
@@ -221,9 +233,11 @@ namespace vw {
         m_mutex.unlock_shared();
       }
 
+      // Only reads m_value, so a shared lock will do; this is called on
+      // every block access by the prefetcher.
       bool valid() {
-        Mutex::WriteLock line_lock(m_mutex);
-        return m_value;
+        Mutex::ReadLock line_lock(m_mutex);
+        return (bool)m_value;
       }
 
       void deprioritize() {
@@ -235,11 +249,26 @@ namespace vw {
       }
     };
 
-    CacheLineBase *m_first_valid, *m_last_valid, *m_first_invalid;
-    size_t m_size, m_max_size;
-    RecursiveMutex m_line_mgmt_mutex;
-    Mutex m_stats_mutex;
-    volatile vw::uint64 m_hits, m_misses, m_evictions;
+    // Each shard owns a list of its valid cache lines, most recently
+    // validated first, and its own statistics.
+    struct Shard {
+      RecursiveMutex line_mgmt_mutex;
+      CacheLineBase *first_valid, *last_valid;
+      size_t num_valid;
+      boost::atomic<vw::uint64> hits, misses, evictions;
+      Shard() : first_valid(0), last_valid(0), num_valid(0),
+                hits(0), misses(0), evictions(0) {}
+    };
+
+    const uint32 m_num_shards;
+    boost::scoped_array<Shard> m_shards;
+    boost::atomic<size_t> m_size, m_max_size;
+
+    uint32 shard_index( CacheLineBase const* line ) const;
+    Shard& shard( CacheLineBase const* line ) { return m_shards[line->m_shard]; }
+    void link_front( Shard& shard, CacheLineBase *line );
+    void unlink( Shard& shard, CacheLineBase *line );
+    uint64 evict( Shard& shard, CacheLineBase *line );
 
     void allocate( size_t size, CacheLineBase *line );
     void deallocate( size_t size, CacheLineBase *line );
@@ -301,10 +330,9 @@ namespace vw {
       }
     };
 
-    Cache( size_t max_size ) :
-      m_first_valid(0), m_last_valid(0), m_first_invalid(0),
-      m_size(0), m_max_size(max_size),
-      m_hits(0), m_misses(0), m_evictions(0) {}
+    /// Create a cache holding at most max_size bytes, with its lines
+    /// spread over num_shards independently locked shards.
+    Cache( size_t max_size, uint32 num_shards = 1 );
 
     template <class GeneratorT>
     Handle<GeneratorT> insert( GeneratorT const& generator ) {
@@ -315,6 +343,7 @@ namespace vw {
 
     void resize( size_t size );
     size_t max_size();
+    uint32 num_shards() const { return m_num_shards; }
 
     // Statistics functions
     uint64 hits();
@@ -100,6 +100,8 @@ void vw::parse_config(std::basic_istream<char>& stream,
     try {
       if (o.string_key == "general.default_num_threads")
         settings.set_default_num_threads(boost::lexical_cast<uint32>(o.value[0]));
+      else if (o.string_key == "general.thread_affinity")
+        settings.set_thread_affinity(boost::lexical_cast<bool>(o.value[0]));
       else if (o.string_key == "general.system_cache_size")
         settings.set_system_cache_size(boost::lexical_cast<size_t>(o.value[0]));
       else if (o.string_key == "general.default_tile_size")
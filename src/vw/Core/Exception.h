@@ -163,6 +163,11 @@ namespace vw {
 
     VW_IF_EXCEPTIONS( virtual void default_throw() const { throw *this; } )
 
+    /// Returns a heap-allocated copy of this exception with the same
+    /// dynamic type, so that an error caught on one thread can be kept
+    /// and rethrown (with default_throw()) on another.
+    virtual Exception* clone() const { return new Exception(*this); }
+
   protected:
       virtual std::ostringstream& stream() {return m_desc;}
 
@@ -218,6 +223,7 @@ namespace vw {
   #define VW_EXCEPTION_API(exception_type)                                     \
     virtual std::string name() const { return #exception_type; }               \
     VW_IF_EXCEPTIONS( virtual void default_throw() const { throw *this; } )    \
+    virtual exception_type* clone() const { return new exception_type(*this); } \
     template <class T>                                                         \
     exception_type& operator<<( T const& t ) { stream() << t; return *this; }
 
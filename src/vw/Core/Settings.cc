@@ -183,6 +183,7 @@ namespace {
 
 Settings::Settings()
   : _VW_SET1(default_num_threads, VW_NUM_THREADS),
+    _VW_SET1(thread_affinity, false),
     _VW_SET1(system_cache_size, size_t(VW_CACHE_SIZE) * 1024 * 1024),
     _VW_SET1(write_pool_size, 21), // 21 threads is about 252MB of back data for RGB f32 1024x1024 blocks
     _VW_SET1(default_tile_size, 256),
@@ -207,6 +208,7 @@ Settings::Settings()
   }
 
 GETSET(default_num_threads, uint32, ;);
+GETSET(thread_affinity, bool, ;);
 GETSET(system_cache_size, size_t, vw_system_cache().resize(x););
 GETSET(write_pool_size, uint32, ;);
 GETSET(default_tile_size, uint32, ;);
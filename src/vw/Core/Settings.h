@@ -60,6 +60,11 @@ namespace vw {
     // The default number of threads used in block processing operations.
     VW_DECLARE_SETTING(default_num_threads, uint32);
 
+    // If true, the shared thread pool pins each of its worker threads
+    // to one CPU, filling a NUMA node before moving to the next.  Only
+    // read when the pool is first created.
+    VW_DECLARE_SETTING(thread_affinity, bool);
+
     // The current system cache size (in bytes). The system cache is shared by
     // all BlockRasterizeView<>'s, including DiskImageView<>'s.
     VW_DECLARE_SETTING(system_cache_size, size_t);
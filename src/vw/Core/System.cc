@@ -21,6 +21,7 @@
 #include <vw/Core/Log.h>
 #include <vw/Core/Settings.h>
 #include <vw/Core/Stopwatch.h>
+#include <vw/Core/ThreadPool.h>
 
 namespace {
   vw::RunOnce settings_once      = VW_RUNONCE_INIT;
@@ -28,11 +29,13 @@ namespace {
   vw::RunOnce stopwatch_set_once = VW_RUNONCE_INIT;
   vw::RunOnce system_cache_once  = VW_RUNONCE_INIT;
   vw::RunOnce log_once           = VW_RUNONCE_INIT;
+  vw::RunOnce thread_pool_once   = VW_RUNONCE_INIT;
 
   vw::Settings     *settings_ptr      = 0;
   vw::StopwatchSet *stopwatch_set_ptr = 0;
   vw::Cache        *system_cache_ptr  = 0;
   vw::Log          *log_ptr           = 0;
+  vw::ThreadPool   *thread_pool_ptr   = 0;
 
   void init_settings() {
     settings_ptr = new vw::Settings();
@@ -43,8 +46,13 @@ namespace {
       system_cache_ptr->resize(settings_ptr->system_cache_size());
   }
 
+  // The system cache is shared by every DiskImageView and
+  // BlockRasterizeView, so spread it over enough shards that many
+  // rasterizing threads rarely meet on the same lock.
+  const vw::uint32 system_cache_shards = 16;
+
   void init_system_cache() {
-    system_cache_ptr = new vw::Cache(0);
+    system_cache_ptr = new vw::Cache(0, system_cache_shards);
   }
 
   void init_stopwatch_set() {
@@ -54,6 +62,13 @@ namespace {
   void init_log() {
     log_ptr = new vw::Log();
   }
+
+  // The pool is never destroyed: its workers may still be parked on
+  // it while other static objects are being torn down.
+  void init_thread_pool() {
+    thread_pool_ptr = new vw::ThreadPool( vw::vw_settings().default_num_threads(),
+                                        vw::vw_settings().thread_affinity() );
+  }
 }
 
 vw::Settings &vw::vw_settings() {
@@ -79,3 +94,8 @@ vw::Log &vw::vw_log() {
   log_once.run( init_log );
   return *log_ptr;
 }
+
+vw::ThreadPool &vw::vw_thread_pool() {
+  thread_pool_once.run( init_thread_pool );
+  return *thread_pool_ptr;
+}
@@ -28,6 +28,7 @@ namespace vw {
   class Log;
   class Settings;
   class StopwatchSet;
+  class ThreadPool;
 
   // This cache is used by default for all new BlockImageView<>'s such as
   // DiskImageView<>.
@@ -43,6 +44,10 @@ namespace vw {
 
   // Global instance of StopwatchSet
   StopwatchSet& vw_stopwatch_set();
+
+  // Process-wide pool of worker threads, shared by all WorkQueues and
+  // block processors.
+  ThreadPool& vw_thread_pool();
 }
 
 #endif
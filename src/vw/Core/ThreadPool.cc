@@ -0,0 +1,323 @@
+// __BEGIN_LICENSE__
+//  Copyright (c) 2006-2013, United States Government as represented by the
+//  Administrator of the National Aeronautics and Space Administration. All
+//  rights reserved.
+//
+//  The NASA Vision Workbench is licensed under the Apache License,
+//  Version 2.0 (the "License"); you may not use this file except in
+//  compliance with the License. You may obtain a copy of the License at
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+// __END_LICENSE__
+
+
+#include <vw/Core/ThreadPool.h>
+
+#include <fstream>
+#include <sstream>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace vw {
+namespace thread {
+
+  // add_blocking_task() grows the pool to at most this many times the
+  // number of core workers.
+  static const int MAX_THREADS_PER_CORE_THREAD = 4;
+
+  // How long a thread added by add_blocking_task() waits for more work
+  // before it exits.
+  static const unsigned long EXTRA_THREAD_IDLE_MS = 1000;
+
+  // Identifies the pool (and the slot within it) that the current
+  // thread works for, so that nested submissions can go to the
+  // submitting worker's own deque.
+  struct PoolWorkerId {
+    ThreadPool const* pool;
+    int id;
+    PoolWorkerId( ThreadPool const* pool, int id ) : pool(pool), id(id) {}
+  };
+
+  typedef boost::thread_specific_ptr<PoolWorkerId> pool_worker_ptr_t;
+
+  // Construct-on-first-use, for the same reasons as the thread id
+  // storage in Thread.cc.
+  static pool_worker_ptr_t& pool_worker_ptr() {
+    static pool_worker_ptr_t* ptr = new pool_worker_ptr_t();
+    return *ptr;
+  }
+
+  // Returns the calling thread's worker id in the given pool, or -1 if
+  // it is not one of that pool's workers.
+  static int current_worker_id( ThreadPool const* pool ) {
+    PoolWorkerId* worker = pool_worker_ptr().get();
+    if ( worker && worker->pool == pool )
+      return worker->id;
+    return -1;
+  }
+
+  // Parse a kernel CPU list such as "0-3,8,10-11".
+  static void parse_cpu_list( std::string const& list, std::vector<int>& cpus ) {
+    std::istringstream in( list );
+    std::string range;
+    while ( std::getline( in, range, ',' ) ) {
+      int first = 0, last = 0;
+      char dash = 0;
+      std::istringstream r( range );
+      if ( !(r >> first) ) continue;
+      if ( r >> dash >> last ) {
+        if ( dash != '-' ) continue;
+      } else {
+        last = first;
+      }
+      for ( int cpu = first; cpu <= last; ++cpu )
+        cpus.push_back( cpu );
+    }
+  }
+
+  // The CPUs this process may run on, grouped by NUMA node.  CPUs the
+  // kernel does not list under any node are appended at the end.
+  static std::vector<int> cpus_by_node() {
+    std::vector<int> cpus;
+#ifdef __linux__
+    cpu_set_t allowed;
+    CPU_ZERO( &allowed );
+    if ( sched_getaffinity( 0, sizeof(allowed), &allowed ) != 0 )
+      return cpus;
+
+    std::vector<bool> seen( CPU_SETSIZE, false );
+    for ( int node = 0; ; ++node ) {
+      std::ostringstream path;
+      path << "/sys/devices/system/node/node" << node << "/cpulist";
+      std::ifstream file( path.str().c_str() );
+      if ( !file ) break;
+      std::string list;
+      std::getline( file, list );
+      std::vector<int> node_cpus;
+      parse_cpu_list( list, node_cpus );
+      for ( size_t i = 0; i < node_cpus.size(); ++i ) {
+        int cpu = node_cpus[i];
+        if ( cpu >= 0 && cpu < CPU_SETSIZE && CPU_ISSET( cpu, &allowed ) && !seen[cpu] ) {
+          cpus.push_back( cpu );
+          seen[cpu] = true;
+        }
+      }
+    }
+    for ( int cpu = 0; cpu < CPU_SETSIZE; ++cpu )
+      if ( CPU_ISSET( cpu, &allowed ) && !seen[cpu] )
+        cpus.push_back( cpu );
+#endif
+    return cpus;
+  }
+
+  static void pin_current_thread( int cpu ) {
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO( &set );
+    CPU_SET( cpu, &set );
+    if ( pthread_setaffinity_np( pthread_self(), sizeof(set), &set ) != 0 )
+      VW_OUT(DebugMessage, "thread") << "ThreadPool: could not pin thread to CPU " << cpu << ".\n";
+#endif
+  }
+
+}} // namespace vw::thread
+
+// The function object run by each pool thread.
+class vw::ThreadPool::WorkerLoop {
+  ThreadPool& m_pool;
+  int m_id;
+public:
+  WorkerLoop( ThreadPool& pool, int id ) : m_pool(pool), m_id(id) {}
+  void operator()() {
+    thread::pool_worker_ptr().reset( new thread::PoolWorkerId( &m_pool, m_id ) );
+    // Threads added for blocking tasks are left free to float.
+    if ( m_id < m_pool.m_core_threads && !m_pool.m_cpus.empty() )
+      thread::pin_current_thread( m_pool.m_cpus[ m_id % m_pool.m_cpus.size() ] );
+    m_pool.worker_loop( m_id );
+  }
+};
+
+vw::ThreadPool::ThreadPool( int num_threads, bool pin_threads )
+  : m_core_threads( num_threads > 0 ? num_threads : 1 ),
+    m_max_threads( m_core_threads * thread::MAX_THREADS_PER_CORE_THREAD ),
+    m_next_extra_id( m_core_threads ),
+    m_pending(0), m_idle(0), m_next_worker(0), m_shutdown(false) {
+  if ( pin_threads )
+    m_cpus = thread::cpus_by_node();
+  for ( int i = 0; i < m_core_threads; ++i )
+    m_workers.push_back( boost::shared_ptr<Worker>( new Worker() ) );
+
+  Mutex::Lock lock(m_mutex);
+  for ( int i = 0; i < m_core_threads; ++i )
+    spawn_worker();
+}
+
+vw::ThreadPool::~ThreadPool() {
+  {
+    Mutex::Lock lock(m_mutex);
+    m_shutdown = true;
+  }
+  m_work_available.notify_all();
+  // Once m_shutdown is set no thread retires itself, so the lists below
+  // no longer change.
+  for ( size_t i = 0; i < m_threads.size(); ++i )
+    m_threads[i]->join();
+  typedef std::map<int, boost::shared_ptr<Thread> >::iterator extra_iter;
+  for ( extra_iter it = m_extra_threads.begin(); it != m_extra_threads.end(); ++it )
+    it->second->join();
+  for ( size_t i = 0; i < m_retired_threads.size(); ++i )
+    m_retired_threads[i]->join();
+}
+
+// Must be called with m_mutex held.
+void vw::ThreadPool::spawn_worker() {
+  int id = int(m_threads.size());
+  m_threads.push_back( boost::shared_ptr<Thread>( new Thread( WorkerLoop( *this, id ) ) ) );
+  VW_OUT(DebugMessage, "thread") << "ThreadPool: created pool thread " << id << ".  [ "
+                                 << m_threads.size() << " threads, "
+                                 << m_core_threads << " core ]\n";
+}
+
+// Must be called with m_mutex held.  Also joins any extra threads that
+// have retired since the last call; they have already left
+// worker_loop(), so this doesn't wait on the lock we hold.
+void vw::ThreadPool::spawn_extra_worker() {
+  for ( size_t i = 0; i < m_retired_threads.size(); ++i )
+    m_retired_threads[i]->join();
+  m_retired_threads.clear();
+
+  int id = m_next_extra_id++;
+  m_extra_threads[id] = boost::shared_ptr<Thread>( new Thread( WorkerLoop( *this, id ) ) );
+  VW_OUT(DebugMessage, "thread") << "ThreadPool: created extra pool thread " << id << ".  [ "
+                                 << m_threads.size() + m_extra_threads.size() << " threads, "
+                                 << m_core_threads << " core ]\n";
+}
+
+void vw::ThreadPool::worker_loop( int worker_id ) {
+  while ( true ) {
+    boost::shared_ptr<Task> task = take_task( worker_id );
+    if ( task ) {
+      (*task)();
+      task->signal_finished();
+      continue;
+    }
+
+    Mutex::Lock lock(m_mutex);
+    if ( m_shutdown )
+      return;
+    // A task may have been queued between take_task() and here.
+    if ( m_pending > 0 )
+      continue;
+    m_idle++;
+    if ( worker_id < m_core_threads ) {
+      m_work_available.wait(lock);
+      m_idle--;
+      continue;
+    }
+
+    // Extra threads go away once they have been idle for a while.
+    bool woken = m_work_available.timed_wait(lock, thread::EXTRA_THREAD_IDLE_MS);
+    m_idle--;
+    if ( !woken && m_pending == 0 && !m_shutdown ) {
+      m_retired_threads.push_back( m_extra_threads[worker_id] );
+      m_extra_threads.erase( worker_id );
+      VW_OUT(DebugMessage, "thread") << "ThreadPool: retired idle pool thread " << worker_id << ".\n";
+      return;
+    }
+  }
+}
+
+// Tasks from one of our own core workers go on the back of that
+// worker's deque.  Everyone else deals tasks out round-robin.
+void vw::ThreadPool::push_task( boost::shared_ptr<Task> const& task ) {
+  int id = thread::current_worker_id( this );
+  if ( id < 0 || id >= m_core_threads ) {
+    Mutex::Lock lock(m_mutex);
+    id = m_next_worker;
+    m_next_worker = ( m_next_worker + 1 ) % m_core_threads;
+  }
+  Worker& worker = *m_workers[id];
+  Mutex::Lock lock(worker.mutex);
+  worker.tasks.push_back( task );
+}
+
+// Pop from the back of our own deque (most recently submitted, so
+// likely still warm in cache), then steal from the front of the
+// others.
+boost::shared_ptr<vw::Task> vw::ThreadPool::take_task( int worker_id ) {
+  boost::shared_ptr<Task> task;
+  if ( worker_id >= 0 && worker_id < m_core_threads ) {
+    Worker& worker = *m_workers[worker_id];
+    Mutex::Lock lock(worker.mutex);
+    if ( !worker.tasks.empty() ) {
+      task = worker.tasks.back();
+      worker.tasks.pop_back();
+    }
+  }
+
+  int start = worker_id >= 0 ? worker_id + 1 : 0;
+  for ( int i = 0; !task && i < m_core_threads; ++i ) {
+    Worker& victim = *m_workers[ ( start + i ) % m_core_threads ];
+    Mutex::Lock lock(victim.mutex);
+    if ( !victim.tasks.empty() ) {
+      task = victim.tasks.front();
+      victim.tasks.pop_front();
+    }
+  }
+
+  if ( task ) {
+    Mutex::Lock lock(m_mutex);
+    m_pending--;
+  }
+  return task;
+}
+
+void vw::ThreadPool::add_task( boost::shared_ptr<Task> task ) {
+  push_task( task );
+  Mutex::Lock lock(m_mutex);
+  m_pending++;
+  if ( m_idle > 0 )
+    m_work_available.notify_one();
+}
+
+void vw::ThreadPool::add_blocking_task( boost::shared_ptr<Task> task ) {
+  push_task( task );
+  Mutex::Lock lock(m_mutex);
+  m_pending++;
+  if ( m_pending > m_idle &&
+       int(m_threads.size() + m_extra_threads.size()) < m_max_threads )
+    spawn_extra_worker();
+  else
+    m_work_available.notify_one();
+}
+
+bool vw::ThreadPool::run_pending_task() {
+  boost::shared_ptr<Task> task = take_task( thread::current_worker_id( this ) );
+  if ( !task )
+    return false;
+  (*task)();
+  task->signal_finished();
+  return true;
+}
+
+bool vw::ThreadPool::in_worker_thread() const {
+  return thread::current_worker_id( this ) >= 0;
+}
+
+int vw::ThreadPool::num_threads() {
+  Mutex::Lock lock(m_mutex);
+  return int(m_threads.size() + m_extra_threads.size());
+}
+
+int vw::ThreadPool::idle_threads() {
+  Mutex::Lock lock(m_mutex);
+  return m_idle;
+}
@@ -21,11 +21,16 @@
 /// Note: All tasks need to be of the same type, but you can have a
 /// common abstract base class if you want.
 ///
+/// All work queues share a single process-wide ThreadPool (see
+/// vw_thread_pool()), so worker threads are created once and reused
+/// rather than spawned per task.
+///
 #ifndef __VW_CORE_THREADPOOL_H__
 #define __VW_CORE_THREADPOOL_H__
 
 #include <vector>
 #include <list>
+#include <deque>
 
 #include <vw/Core/Settings.h>
 #include <vw/Core/Thread.h>
@@ -69,6 +74,103 @@ namespace vw {
     }
   };
 
+  // ----------------------  --------------  ---------------------------
+  // ----------------------   Thread Pool    ---------------------------
+  // ----------------------  --------------  ---------------------------
+
+  /// A pool of persistent worker threads.  Each worker owns a deque of
+  /// tasks: it pops new work from the back of its own deque and, when
+  /// that runs dry, steals from the front of the other workers'
+  /// deques.  Tasks submitted from inside a worker go onto that
+  /// worker's own deque, so nested submissions (e.g. a rasterize call
+  /// made from within a pool task) are picked up by idle workers
+  /// instead of spinning up more threads than there are cores.
+  ///
+  /// Most code should use the process-wide instance returned by
+  /// vw_thread_pool(), which is sized from
+  /// vw_settings().default_num_threads() the first time it is used.
+  class ThreadPool : private boost::noncopyable {
+
+    class WorkerLoop;
+    friend class WorkerLoop;
+
+    struct Worker {
+      Mutex mutex;
+      std::deque<boost::shared_ptr<Task> > tasks;
+    };
+
+    int m_core_threads, m_max_threads;
+    std::vector<int> m_cpus;
+    std::vector<boost::shared_ptr<Worker> > m_workers;
+    std::vector<boost::shared_ptr<Thread> > m_threads;
+
+    // Threads added by add_blocking_task(), by worker id.  They exit
+    // once they have sat idle for a while, and are joined later from
+    // m_retired_threads.
+    std::map<int, boost::shared_ptr<Thread> > m_extra_threads;
+    std::vector<boost::shared_ptr<Thread> > m_retired_threads;
+    int m_next_extra_id;
+
+    // Protects the bookkeeping below, and is the mutex that idle
+    // workers sleep on.
+    Mutex m_mutex;
+    Condition m_work_available;
+    int m_pending, m_idle, m_next_worker;
+    bool m_shutdown;
+
+    void spawn_worker();
+    void spawn_extra_worker();
+    void worker_loop( int worker_id );
+    void push_task( boost::shared_ptr<Task> const& task );
+    boost::shared_ptr<Task> take_task( int worker_id );
+
+  public:
+    /// Start a pool with num_threads persistent worker threads.  If
+    /// pin_threads is set, core worker i is pinned to the i'th CPU the
+    /// process may run on, taking CPUs one NUMA node at a time so that
+    /// neighbouring workers share a node.  Pinning is only supported
+    /// on Linux and is silently skipped elsewhere.
+    ThreadPool( int num_threads = vw_settings().default_num_threads(), bool pin_threads = false );
+
+    /// Stop and join all workers.  Tasks that are already queued are
+    /// run before the workers exit.
+    ~ThreadPool();
+
+    /// Queue a short-lived, compute-bound task.  The task is run by
+    /// the next available worker; if all workers are busy it waits.
+    void add_task( boost::shared_ptr<Task> task );
+
+    /// Queue a task that may block for long periods (for example the
+    /// drain loop of a WorkQueue).  If no worker is idle to pick it up
+    /// right away, the pool grows by one thread so that the task can
+    /// start promptly.  The pool never grows past max_threads(); past
+    /// that, the task waits for a thread like any other.  Threads added
+    /// this way are reused while there is work, and exit after sitting
+    /// idle for a second.
+    void add_blocking_task( boost::shared_ptr<Task> task );
+
+    /// Take one queued task and run it on the calling thread.  Returns
+    /// false if there was nothing to do.  Threads waiting on work they
+    /// submitted themselves can use this to help rather than block.
+    bool run_pending_task();
+
+    /// Returns true if the calling thread is one of this pool's workers.
+    bool in_worker_thread() const;
+
+    /// The number of workers the pool was created with.
+    int core_threads() const { return m_core_threads; }
+
+    /// The most workers add_blocking_task() will grow the pool to.
+    int max_threads() const { return m_max_threads; }
+
+    /// The number of workers currently alive, including any added by
+    /// add_blocking_task().
+    int num_threads();
+
+    /// The number of workers currently waiting for work.
+    int idle_threads();
+  };
+
   // ----------------------  --------------  ---------------------------
   // ----------------------  Task Generator  ---------------------------
   // ----------------------  --------------  ---------------------------
@@ -76,11 +178,11 @@ namespace vw {
   // Work Queue Base Class
   class WorkQueue {
 
-    // The worker thread class is the Task object that is spun out to
-    // do the actual work of the WorkQueue.  When a worker thread
-    // finishes its task it notifies the threadpool, which farms out
-    // the next task to the worker thread.
-    class WorkerThread {
+    // The worker thread class is the Task object that is handed to
+    // the thread pool to do the actual work of the WorkQueue.  When a
+    // worker thread finishes its task it notifies the work queue,
+    // which farms out the next task to the worker thread.
+    class WorkerThread : public Task {
       WorkQueue &m_queue;
       boost::shared_ptr<Task> m_task;
       int m_thread_id;
@@ -113,7 +215,6 @@ namespace vw {
 
     int m_active_workers, m_max_workers;
     Mutex m_queue_mutex;
-    std::vector<boost::shared_ptr<Thread> > m_running_threads;
     std::list<int> m_available_thread_ids;
     Condition m_joined_event;
     bool m_should_die;
@@ -127,18 +228,16 @@ namespace vw {
     // from within child thread so that we can clean up the list of
     // available threads.  As such, one must be very careful about
     // what is done in this method, because for the duration of this
-    // method, the child thread has access to it's own shared pointer.
-    // This method has been carefully written so as not to
-    // accidentally allow the thread to delete it's own shared
-    // pointer, which could cause the thread to call its own join()
-    // method.
+    // method, the worker must not touch the WorkQueue again once it
+    // has returned, because join_all() may already have let the
+    // WorkQueue be destroyed.
     // *************************************************************
     void worker_thread_complete(int worker_id) {
       m_active_workers--;
       VW_OUT(DebugMessage, "thread") << "ThreadPool: terminating worker thread " << worker_id << ".  [ " << m_active_workers << " / " << m_max_workers << " now active ]\n";
 
-      // Erase the worker thread from the list of active threads
-      VW_ASSERT(worker_id >= 0 && worker_id < int(m_running_threads.size()),
+      // Return the worker id to the list of available ids
+      VW_ASSERT(worker_id >= 0 && worker_id < m_max_workers,
                 LogicErr() << "WorkQueue: request to terminate thread " << worker_id << ", which does not exist.");
       m_available_thread_ids.push_back(worker_id);
 
@@ -149,7 +248,6 @@ namespace vw {
   public:
     WorkQueue(int num_threads = vw_settings().default_num_threads() )
       : m_active_workers(0), m_max_workers(num_threads), m_should_die(false) {
-      m_running_threads.resize(num_threads);
       for (int i = 0; i < num_threads; ++i)
         m_available_thread_ids.push_back(i);
     }
@@ -162,8 +260,8 @@ namespace vw {
     // Notify can be called by a child class that inherits from
     // WorkQueue.  A call to notify will cause the WorkQueue to
     // re-examine the list of tasks it has available for execution.
-    // If there are any idle slots for worker threads, it will spin
-    // off WorkerThreads to execute these tasks.
+    // If there are any idle slots for worker threads, it will hand
+    // WorkerThreads to the thread pool to execute these tasks.
     void notify() {
       Mutex::Lock lock(m_queue_mutex);
 
@@ -178,10 +276,12 @@ namespace vw {
         boost::shared_ptr<WorkerThread> next_worker( new WorkerThread(*this, task,
                                                                       next_available_thread_id,
                                                                       m_should_die) );
-        boost::shared_ptr<Thread> thread(new Thread(next_worker));
-        m_running_threads[next_available_thread_id] = thread;
         m_active_workers++;
-        VW_OUT(DebugMessage, "thread") << "ThreadPool: creating worker thread " << next_available_thread_id << ".  [ " << m_active_workers << " / " << m_max_workers << " now active ]\n";
+        // Tasks in a work queue are allowed to block (waiting on each
+        // other, on I/O, ...), so each worker slot must get a thread
+        // of its own rather than wait for a busy pool thread.
+        vw_thread_pool().add_blocking_task( next_worker );
+        VW_OUT(DebugMessage, "thread") << "ThreadPool: starting worker thread " << next_available_thread_id << ".  [ " << m_active_workers << " / " << m_max_workers << " now active ]\n";
       }
     }
 
@@ -252,6 +252,52 @@ TEST(Cache, Stats) {
   EXPECT_EQ(0u, cache.evictions());
 }
 
+TEST(Cache, Sharded) {
+  typedef Cache::Handle<BlockGenerator> handle_t;
+
+  // Four shards sharing a budget of four items
+  vw::Cache cache(4*sizeof(handle_t::value_type), 4);
+  EXPECT_EQ(4u, cache.num_shards());
+
+  std::vector<handle_t> h;
+  for (uint8 i = 0; i < 16; ++i)
+    h.push_back( cache.insert(BlockGenerator(1, i)) );
+
+  for (uint8 i = 0; i < 16; ++i) {
+    EXPECT_EQ(i, *h[i]);
+    EXPECT_NO_THROW( h[i].release() );
+  }
+
+  // The size limit applies to the whole cache, not to each shard.
+  int valid = 0;
+  for (size_t i = 0; i < h.size(); ++i)
+    if (h[i].valid())
+      valid++;
+  EXPECT_EQ(4, valid);
+  EXPECT_TRUE(h[15].valid());
+
+  // Statistics are gathered from all the shards.
+  EXPECT_EQ(0u,  cache.hits());
+  EXPECT_EQ(16u, cache.misses());
+  EXPECT_EQ(12u, cache.evictions());
+
+  EXPECT_EQ(15, *h[15]);
+  EXPECT_NO_THROW( h[15].release() );
+  EXPECT_EQ(1u, cache.hits());
+
+  cache.resize(2*sizeof(handle_t::value_type));
+  valid = 0;
+  for (size_t i = 0; i < h.size(); ++i)
+    if (h[i].valid())
+      valid++;
+  EXPECT_EQ(2, valid);
+
+  cache.clear_stats();
+  EXPECT_EQ(0u, cache.hits());
+  EXPECT_EQ(0u, cache.misses());
+  EXPECT_EQ(0u, cache.evictions());
+}
+
 // Here's a more aggressive test that uses many threads plus a good
 // chunk of memory (24k).
 class ArrayDataGenerator {
@@ -315,3 +361,22 @@ TEST(Cache, StressTest) {
   // its time?
   EXPECT_NO_THROW( queue.join_all(); );
 }
+
+TEST(Cache, ShardedStressTest) {
+  typedef Cache::Handle<ArrayDataGenerator> handle_t;
+  vw::Cache cache( 6*1024, 4 );
+
+  std::vector<handle_t> handles;
+  for ( size_t i = 0; i < 24; i++ ) {
+    handles.push_back( cache.insert( ArrayDataGenerator() ) );
+  }
+
+  FifoWorkQueue queue(12);
+  for ( size_t i = 0; i < 1000; i++ ) {
+    boost::shared_ptr<Task> task( new TestTask(handles) );
+    queue.add_task( task );
+  }
+
+  EXPECT_NO_THROW( queue.join_all(); );
+  EXPECT_EQ( 2000u, cache.hits() + cache.misses() );
+}
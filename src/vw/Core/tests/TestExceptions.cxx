@@ -19,6 +19,8 @@
 #include <vw/Core/Exception.h>
 #include <test/Helpers.h>
 
+#include <boost/scoped_ptr.hpp>
+
 using namespace vw;
 
 VW_DEFINE_EXCEPTION(Level1Err, Exception);
@@ -73,3 +75,17 @@ TEST(Exceptions, HAS_EXCEPTIONS(Ext)) {
     EXPECT_EQ("Code2", c.name());
   }
 }
+
+TEST(Exceptions, HAS_EXCEPTIONS(Clone)) {
+  Level2Err l2;
+  l2 << "cloned";
+  Exception const& base = l2;
+  boost::scoped_ptr<Exception> copy(base.clone());
+  EXPECT_EQ("Level2Err", copy->name());
+  EXPECT_EQ("cloned", copy->desc());
+  EXPECT_THROW(copy->default_throw(), Level2Err);
+
+  boost::scoped_ptr<Exception> ext(static_cast<Exception const&>(Code2() << "ext").clone());
+  EXPECT_EQ("Code2", ext->name());
+  EXPECT_THROW(ext->default_throw(), Code2);
+}
@@ -223,3 +223,153 @@ TEST(ThreadPool, OrderedWorkQueue) {
 
   queue.join_all();
 }
+
+class CountTask : public Task {
+  Mutex& m_mutex;
+  int& m_count;
+public:
+  CountTask(Mutex& mutex, int& count) : m_mutex(mutex), m_count(count) {}
+  void operator()() {
+    Mutex::Lock lock(m_mutex);
+    m_count++;
+  }
+};
+
+// Submits its children to the pool it is running in, and helps run
+// them while it waits for them to finish.
+class ParentTask : public Task {
+  ThreadPool& m_pool;
+  Mutex& m_mutex;
+  int& m_count;
+public:
+  ParentTask(ThreadPool& pool, Mutex& mutex, int& count) : m_pool(pool), m_mutex(mutex), m_count(count) {}
+  void operator()() {
+    EXPECT_TRUE( m_pool.in_worker_thread() );
+    std::vector<boost::shared_ptr<Task> > children;
+    for (int i = 0; i < 10; ++i) {
+      children.push_back( boost::shared_ptr<Task>( new CountTask(m_mutex, m_count) ) );
+      m_pool.add_task( children.back() );
+    }
+    for (size_t i = 0; i < children.size(); ++i)
+      while ( !children[i]->is_finished() )
+        if ( !m_pool.run_pending_task() )
+          Thread::yield();
+  }
+};
+
+TEST(ThreadPool, PersistentPool) {
+  ThreadPool pool(2);
+  EXPECT_FALSE( pool.in_worker_thread() );
+
+  Mutex mutex;
+  int count = 0;
+  std::vector<boost::shared_ptr<Task> > tasks;
+  for (int i = 0; i < 100; ++i) {
+    tasks.push_back( boost::shared_ptr<Task>( new CountTask(mutex, count) ) );
+    pool.add_task( tasks.back() );
+  }
+  for (size_t i = 0; i < tasks.size(); ++i)
+    tasks[i]->join();
+
+  EXPECT_EQ( 100, count );
+  // No threads are created beyond the ones the pool started with.
+  EXPECT_EQ( 2, pool.num_threads() );
+}
+
+TEST(ThreadPool, PinnedPool) {
+  // Pinning is best-effort, so this only checks that a pinned pool
+  // (with more workers than most machines have CPUs) still runs work.
+  ThreadPool pool(3, true);
+  Mutex mutex;
+  int count = 0;
+  std::vector<boost::shared_ptr<Task> > tasks;
+  for (int i = 0; i < 30; ++i) {
+    tasks.push_back( boost::shared_ptr<Task>( new CountTask(mutex, count) ) );
+    pool.add_task( tasks.back() );
+  }
+  for (size_t i = 0; i < tasks.size(); ++i)
+    tasks[i]->join();
+  EXPECT_EQ( 30, count );
+}
+
+TEST(ThreadPool, NestedSubmission) {
+  ThreadPool pool(2);
+  Mutex mutex;
+  int count = 0;
+  std::vector<boost::shared_ptr<Task> > parents;
+  for (int i = 0; i < 4; ++i) {
+    parents.push_back( boost::shared_ptr<Task>( new ParentTask(pool, mutex, count) ) );
+    pool.add_task( parents.back() );
+  }
+  for (size_t i = 0; i < parents.size(); ++i)
+    parents[i]->join();
+
+  EXPECT_EQ( 40, count );
+  EXPECT_EQ( 2, pool.num_threads() );
+}
+
+TEST(ThreadPool, BlockingTasksGetThreads) {
+  ThreadPool pool(1);
+  boost::shared_ptr<TestTask> task1 (new TestTask);
+  boost::shared_ptr<TestTask> task2 (new TestTask);
+  boost::shared_ptr<TestTask> task3 (new TestTask);
+  pool.add_blocking_task(task1);
+  pool.add_blocking_task(task2);
+  pool.add_blocking_task(task3);
+
+  Thread::sleep_ms(200);
+  EXPECT_EQ( 1, task1->value() );
+  EXPECT_EQ( 1, task2->value() );
+  EXPECT_EQ( 1, task3->value() );
+  EXPECT_GE( pool.num_threads(), 3 );
+
+  task1->kill();
+  task2->kill();
+  task3->kill();
+  task1->join();
+  task2->join();
+  task3->join();
+  EXPECT_EQ( 3, task3->value() );
+}
+
+TEST(ThreadPool, BlockingThreadsAreCappedAndRetired) {
+  ThreadPool pool(1);
+  ASSERT_EQ( 4, pool.max_threads() );
+
+  std::vector<boost::shared_ptr<TestTask> > tasks;
+  for (int i = 0; i < 6; ++i) {
+    tasks.push_back( boost::shared_ptr<TestTask>( new TestTask ) );
+    pool.add_blocking_task( tasks.back() );
+  }
+
+  // Only max_threads() of them get a thread; the rest wait.
+  Thread::sleep_ms(200);
+  EXPECT_EQ( 4, pool.num_threads() );
+  int started = 0;
+  for (size_t i = 0; i < tasks.size(); ++i)
+    started += tasks[i]->value();
+  EXPECT_EQ( 4, started );
+
+  for (size_t i = 0; i < tasks.size(); ++i)
+    tasks[i]->kill();
+  for (size_t i = 0; i < tasks.size(); ++i)
+    tasks[i]->join();
+
+  // The extra threads exit once they have nothing to do.
+  for (int i = 0; i < 50 && pool.num_threads() > 1; ++i)
+    Thread::sleep_ms(100);
+  EXPECT_EQ( 1, pool.num_threads() );
+
+  // ... and the pool can still grow again afterwards.
+  boost::shared_ptr<TestTask> task1 (new TestTask);
+  boost::shared_ptr<TestTask> task2 (new TestTask);
+  pool.add_blocking_task(task1);
+  pool.add_blocking_task(task2);
+  Thread::sleep_ms(200);
+  EXPECT_EQ( 1, task1->value() );
+  EXPECT_EQ( 1, task2->value() );
+  task1->kill();
+  task2->kill();
+  task1->join();
+  task2->join();
+}
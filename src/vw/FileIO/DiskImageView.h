@@ -89,6 +89,22 @@ namespace vw {
 
     std::string filename() const { return m_rsrc->filename(); }
 
+    /// Set the order in which blocks are read when this view is
+    /// rasterized.  See BlockRasterizeView::set_traversal().
+    void set_traversal( BlockTraversal order ) { m_impl.set_traversal( order ); }
+
+    /// Read ahead up to depth blocks in the background while this
+    /// view is being rasterized, so that disk reads overlap with
+    /// computation.  See BlockRasterizeView::set_prefetch().
+    void set_prefetch( int depth, int io_threads = 2 ) { m_impl.set_prefetch( depth, io_threads ); }
+
+    /// Hint that the given region will be read soon.
+    void prefetch( BBox2i const& bbox ) const { m_impl.prefetch( bbox ); }
+    void join_prefetch() const { m_impl.join_prefetch(); }
+
+    uint64 prefetch_hits() const { return m_impl.prefetch_hits(); }
+    uint64 prefetch_misses() const { return m_impl.prefetch_misses(); }
+    uint64 prefetch_requests() const { return m_impl.prefetch_requests(); }
   };
 
 
@@ -47,6 +47,7 @@
 #include <vw/Image/EdgeExtension.h>
 #include <vw/Image/Interpolation.h>
 #include <vw/Image/Convolution.h>
+#include <vw/Image/RecursiveFilter.h>
 #include <vw/Image/Filter.h>
 #include <vw/Image/Transform.h>
 #include <vw/Image/BlockProcessor.h>
@@ -0,0 +1,98 @@
+// __BEGIN_LICENSE__
+//  Copyright (c) 2006-2013, United States Government as represented by the
+//  Administrator of the National Aeronautics and Space Administration. All
+//  rights reserved.
+//
+//  The NASA Vision Workbench is licensed under the Apache License,
+//  Version 2.0 (the "License"); you may not use this file except in
+//  compliance with the License. You may obtain a copy of the License at
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+// __END_LICENSE__
+
+
+/// \file BlockProcessor.cc
+///
+/// Block traversal orders for the BlockProcessor.
+///
+#include <vw/Image/BlockProcessor.h>
+
+#include <algorithm>
+#include <utility>
+
+namespace {
+
+  // Interleave the bits of x and y, x in the even bits.
+  vw::uint64 morton_key( vw::uint32 x, vw::uint32 y ) {
+    vw::uint64 key = 0;
+    for( int b=0; b<32; ++b ) {
+      key |= vw::uint64( (x >> b) & 1 ) << (2*b);
+      key |= vw::uint64( (y >> b) & 1 ) << (2*b+1);
+    }
+    return key;
+  }
+
+  // Distance of (x,y) along the Hilbert curve that fills an n x n
+  // grid, where n is a power of two.
+  vw::uint64 hilbert_key( vw::uint32 n, vw::uint32 x, vw::uint32 y ) {
+    vw::uint64 key = 0;
+    for( vw::uint32 s=n/2; s>0; s/=2 ) {
+      vw::uint32 rx = (x & s) ? 1 : 0;
+      vw::uint32 ry = (y & s) ? 1 : 0;
+      key += vw::uint64(s) * s * ((3*rx) ^ ry);
+      if( ry == 0 ) {
+        if( rx == 1 ) {
+          x = n-1 - x;
+          y = n-1 - y;
+        }
+        std::swap( x, y );
+      }
+    }
+    return key;
+  }
+
+  typedef std::pair<vw::uint64, vw::Vector2i> keyed_block;
+
+  bool key_less( keyed_block const& a, keyed_block const& b ) {
+    return a.first < b.first;
+  }
+
+}
+
+std::vector<vw::Vector2i> vw::block_traversal( int32 cols, int32 rows, BlockTraversal order ) {
+  std::vector<Vector2i> blocks;
+  if( cols <= 0 || rows <= 0 )
+    return blocks;
+  blocks.reserve( size_t(cols) * rows );
+
+  if( order == RowMajorTraversal || order == StripedTraversal ) {
+    for( int32 y=0; y<rows; ++y )
+      for( int32 x=0; x<cols; ++x )
+        blocks.push_back( Vector2i(x,y) );
+    return blocks;
+  }
+
+  // Sort the grid by curve distance rather than walking the curve, so
+  // that long thin grids do not pay for the whole enclosing square.
+  uint32 n = 1;
+  while( n < uint32(std::max(cols,rows)) )
+    n *= 2;
+
+  std::vector<keyed_block> keyed;
+  keyed.reserve( size_t(cols) * rows );
+  for( int32 y=0; y<rows; ++y )
+    for( int32 x=0; x<cols; ++x ) {
+      uint64 key = ( order == HilbertTraversal ) ? hilbert_key( n, x, y ) : morton_key( x, y );
+      keyed.push_back( keyed_block( key, Vector2i(x,y) ) );
+    }
+  std::sort( keyed.begin(), keyed.end(), key_less );
+
+  for( size_t i=0; i<keyed.size(); ++i )
+    blocks.push_back( keyed[i].second );
+  return blocks;
+}
@@ -24,7 +24,17 @@
 /// processing threads.  You can then call the block processor,
 /// passing it an arbitrarily large bounding box.  It will chop that
 /// bounding box up into blocks and call the callback function on
-/// each block, spawning as many child threads as you request.
+/// each block, using as many threads from the shared thread pool
+/// (see vw_thread_pool()) as you request.
+///
+/// The order in which blocks are handed out is selectable.  Row-major
+/// order is the simplest, but when the processing function pulls on
+/// a deep view pipeline, threads working far apart in a row fetch
+/// unrelated source blocks and compete for the cache.  The Z-order
+/// and Hilbert traversals keep blocks that are processed close
+/// together in time close together in the image, and the striped
+/// traversal gives each thread its own horizontal band of the image.
+/// Blocks are claimed with atomic counters rather than under a lock.
 ///
 /// Strictly speaking, this doesn't need to be in the Image module.
 /// However, it was designed for large image processing, it depends
@@ -34,39 +44,115 @@
 #ifndef __VW_IMAGE_BLOCKPROCESSOR_H__
 #define __VW_IMAGE_BLOCKPROCESSOR_H__
 
+#include <vector>
+
+#include <boost/atomic.hpp>
+#include <boost/scoped_array.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <vw/Core/Exception.h>
 #include <vw/Core/Settings.h>
 #include <vw/Core/Thread.h>
+#include <vw/Core/ThreadPool.h>
 #include <vw/Math/BBox.h>
 
 namespace vw {
 
+  /// The order in which a BlockProcessor visits the blocks of a region.
+  enum BlockTraversal {
+    RowMajorTraversal,  ///< Left to right, then top to bottom.
+    ZOrderTraversal,    ///< Morton (Z-order) curve over the block grid.
+    HilbertTraversal,   ///< Hilbert curve over the block grid.
+    StripedTraversal    ///< One band of block rows per thread, row-major
+                        ///< within the band; idle threads steal from
+                        ///< the other bands.
+  };
+
+  /// Return the (column,row) block indices of a cols x rows block grid
+  /// in the order given.  For StripedTraversal this is row-major
+  /// order; the bands are carved out of it by the BlockProcessor.
+  std::vector<Vector2i> block_traversal( int32 cols, int32 rows, BlockTraversal order );
+
   template <class FuncT>
   class BlockProcessor {
     FuncT m_func;
     Vector2i m_block_size;
     uint32 m_num_threads;
+    BlockTraversal m_order;
   public:
-    BlockProcessor( FuncT const& func, Vector2i const& block_size, uint32 threads = 0 )
+    BlockProcessor( FuncT const& func, Vector2i const& block_size, uint32 threads = 0,
+                    BlockTraversal order = RowMajorTraversal )
       : m_func(func), m_block_size(block_size),
-        m_num_threads(threads?threads:(vw_settings().default_num_threads())) {}
+        m_num_threads(threads?threads:(vw_settings().default_num_threads())),
+        m_order(order) {}
 
-    // We will construct and call one BlockThread per thread.
-    class BlockThread {
+    // The calling thread and up to (threads - 1) helper tasks in the
+    // shared thread pool each run one BlockThread.
+    class BlockThread : public Task {
     public:
-      // All the BlockThread objects share a reference to a shared Info object,
-      // which stores information about what block should be processed next.
+      // All the BlockThread objects share a reference to a shared Info
+      // object, which holds the list of blocks in traversal order and
+      // the counters used to hand them out.
       class Info {
+        // A contiguous run of the block list.  next is advanced with an
+        // atomic fetch_add, so it may run past end once the run is
+        // exhausted.
+        struct Range {
+          size_t end;
+          boost::atomic<size_t> next;
+          Range() : end(0), next(0) {}
+        };
+
       public:
-        Info( FuncT const& func, BBox2i const& total_bbox, Vector2i const& block_size )
-          : m_func(func), m_total_bbox(total_bbox),
-            m_block_bbox(round_down(total_bbox.min().x(),block_size.x()),round_down(total_bbox.min().y(),block_size.y()),block_size.x(),block_size.y()),
-            m_block_size(block_size) {}
-
-        // Return the next block bbox to process.
-        BBox2i bbox() const {
-          BBox2i block_bbox = m_block_bbox;
-          block_bbox.crop( m_total_bbox );
-          return block_bbox;
+        Info( FuncT const& func, BBox2i const& total_bbox, Vector2i const& block_size,
+              BlockTraversal order, uint32 num_threads )
+          : m_func(func), m_num_ranges(1), m_active(0), m_failed(false) {
+          int32 x0 = round_down(total_bbox.min().x(),block_size.x());
+          int32 y0 = round_down(total_bbox.min().y(),block_size.y());
+          int32 cols = 0, rows = 0;
+          if( !total_bbox.empty() ) {
+            cols = (total_bbox.max().x() - x0 - 1) / block_size.x() + 1;
+            rows = (total_bbox.max().y() - y0 - 1) / block_size.y() + 1;
+          }
+
+          std::vector<Vector2i> grid = block_traversal( cols, rows, order );
+          m_blocks.reserve( grid.size() );
+          for( size_t i=0; i<grid.size(); ++i ) {
+            BBox2i block_bbox( x0 + grid[i].x()*block_size.x(), y0 + grid[i].y()*block_size.y(),
+                               block_size.x(), block_size.y() );
+            block_bbox.crop( total_bbox );
+            m_blocks.push_back( block_bbox );
+          }
+
+          // Striped traversal splits the row-major list into one band
+          // of whole block rows per thread.
+          if( order == StripedTraversal && num_threads > 1 && rows > 1 )
+            m_num_ranges = std::min( num_threads, uint32(rows) );
+          m_ranges.reset( new Range[m_num_ranges] );
+          for( uint32 i=0; i<m_num_ranges; ++i ) {
+            m_ranges[i].next = size_t( rows * i / m_num_ranges ) * cols;
+            m_ranges[i].end = size_t( rows * (i+1) / m_num_ranges ) * cols;
+          }
+        }
+
+        // Claim the next block for the given participant.  Each
+        // participant starts in its own range and moves on to the
+        // others once that is exhausted.  Returns false when there are
+        // no blocks left anywhere, or once any block has failed.
+        bool claim( uint32 participant, BBox2i& bbox ) {
+          if( m_failed.load() )
+            return false;
+          for( uint32 i=0; i<m_num_ranges; ++i ) {
+            Range& range = m_ranges[ (participant + i) % m_num_ranges ];
+            if( range.next.load() >= range.end )
+              continue;
+            size_t index = range.next.fetch_add( 1 );
+            if( index < range.end ) {
+              bbox = m_blocks[index];
+              return true;
+            }
+          }
+          return false;
         }
 
         // Return the processing function.
@@ -74,25 +160,40 @@ namespace vw {
           return m_func;
         }
 
-        // Are we finished?
-        bool complete() const {
-          return ( m_block_bbox.min().y() >= m_total_bbox.max().y() );
+        // Count the participants that are currently claiming or
+        // processing blocks.
+        void enter() { m_active++; }
+        void leave() {
+          if( --m_active == 0 ) {
+            Mutex::Lock lock(m_mutex);
+            m_done.notify_all();
+          }
         }
 
-        // Returns the info mutex, for locking.
-        Mutex& mutex() {
-          return m_mutex;
+        // Keep the first error raised by the processing function.
+        // No more blocks are handed out after this.
+        void fail( Exception const& e ) {
+          {
+            Mutex::Lock lock(m_mutex);
+            if( !m_error )
+              m_error.reset( e.clone() );
+          }
+          m_failed = true;
         }
 
-        // Advance the block_bbox to point to the next block to process.
-        void advance() {
-          m_block_bbox.min().x() += m_block_size.x();
-          if( m_block_bbox.min().x() >= m_total_bbox.max().x() ) {
-            m_block_bbox.min().x() = round_down(m_total_bbox.min().x(),m_block_size.x());
-            m_block_bbox.min().y() += m_block_size.y();
-            m_block_bbox.max().y() = m_block_bbox.min().y() + m_block_size.y();
-          }
-          m_block_bbox.max().x() = m_block_bbox.min().x() + m_block_size.x();
+        // Throw the stored error, if any.  Only call this after wait().
+        void rethrow() const {
+          if( m_error )
+            vw_throw( *m_error );
+        }
+
+        // Wait until every participant that may still be working on a
+        // block has left.  A participant that enters after the blocks
+        // have run out claims nothing, so only the caller needs to wait.
+        void wait() {
+          Mutex::Lock lock(m_mutex);
+          while( m_active.load() != 0 )
+            m_done.wait(lock);
         }
 
       private:
@@ -105,55 +206,72 @@ namespace vw {
         }
 
         FuncT const& m_func;
-        BBox2i m_total_bbox, m_block_bbox;
-        Vector2i m_block_size;
+        std::vector<BBox2i> m_blocks;
+        uint32 m_num_ranges;
+        boost::scoped_array<Range> m_ranges;
+        boost::atomic<int> m_active;
+        boost::atomic<bool> m_failed;
+        boost::shared_ptr<Exception> m_error;
         Mutex m_mutex;
+        Condition m_done;
       };
 
-      BlockThread( Info &info ) : info(info) {}
+      BlockThread( boost::shared_ptr<Info> info, uint32 participant )
+        : info(info), m_participant(participant) {}
 
+      // Errors are kept in the Info rather than thrown, so that the
+      // caller always waits for the helpers and pool workers never see
+      // an exception.
       void operator()() {
-        while( true ) {
+        info->enter();
+        try {
           BBox2i bbox;
-          {
-            // Grab the next bbox to process, and update it with the
-            // subsequent bbox for the next thread to grab.
-            Mutex::Lock lock(info.mutex());
-            if( info.complete() ) return;
-            bbox = info.bbox();
-            info.advance();
-          }
-          info.func()( bbox );
+          while( info->claim( m_participant, bbox ) )
+            info->func()( bbox );
+        } catch( const Exception& e ) {
+          info->fail( e );
+        } catch( const std::exception& e ) {
+          Exception err;
+          err.set( e.what() );
+          info->fail( err );
+        } catch( ... ) {
+          info->fail( LogicErr() << "Unknown exception in BlockProcessor" );
         }
+        info->leave();
       }
 
     private:
-      Info &info;
+      // Helpers that only get picked up by the pool after all the
+      // blocks are gone still look at the Info, so it is shared.
+      boost::shared_ptr<Info> info;
+      uint32 m_participant;
     };
 
     inline void operator()( BBox2i bbox ) const {
-      typename BlockThread::Info info( m_func, bbox, m_block_size );
+      boost::shared_ptr<typename BlockThread::Info> info( new typename BlockThread::Info( m_func, bbox, m_block_size, m_order, m_num_threads ) );
 
-      // Avoid threads altogether in the single-threaded case.
-      // Annoyingly, this still creates an unnecessary Mutex.
+      // Avoid the thread pool altogether in the single-threaded case.
       if( m_num_threads == 1 ) {
-        BlockThread bt( info );
-        return bt();
+        BlockThread bt( info, 0 );
+        bt();
+        info->rethrow();
+        return;
       }
 
-      std::vector<boost::shared_ptr<BlockThread> > generators;
-      std::vector<boost::shared_ptr<Thread> > threads;
+      // Helpers are queued in the shared thread pool rather than
+      // given threads of their own, so only idle pool workers pick
+      // them up.  This keeps nested block processing (e.g. from
+      // inside another pool task) from oversubscribing the cores.
+      // The calling thread works through the blocks as well, so it
+      // never waits on a helper that has not started.
+      ThreadPool& pool = vw_thread_pool();
+      for( uint32 i=1; i<m_num_threads; ++i )
+        pool.add_task( boost::shared_ptr<Task>( new BlockThread( info, i ) ) );
 
-      for( uint32 i=0; i<m_num_threads; ++i ) {
-        boost::shared_ptr<BlockThread> generator( new BlockThread( info ) );
-        generators.push_back( generator );
-        boost::shared_ptr<Thread> thread( new Thread( generator ) );
-        threads.push_back( thread );
-      }
-
-      for( uint32 i=0; i<m_num_threads; ++i ) {
-        threads[i]->join();
-      }
+      BlockThread bt( info, 0 );
+      bt();
+      info->wait();
+      info->rethrow();
     }
 
   };
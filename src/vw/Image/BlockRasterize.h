@@ -25,10 +25,17 @@
 /// block at a time can dramatically improve performance by reducing
 /// memory utilization.
 ///
+/// When a cache is in use, the view can optionally prefetch blocks:
+/// while one block is being consumed, the next few blocks in raster
+/// order (or the blocks named by an explicit prefetch() hint) are
+/// generated into the cache by background threads, so that I/O and
+/// computation overlap.  See set_prefetch().
+///
 #ifndef __VW_IMAGE_BLOCKRASTERIZE_H__
 #define __VW_IMAGE_BLOCKRASTERIZE_H__
 
 #include <vw/Core/Cache.h>
+#include <vw/Core/ThreadPool.h>
 #include <vw/Image/ImageViewBase.h>
 #include <vw/Image/PixelAccessors.h>
 #include <vw/Image/Manipulation.h>
@@ -49,6 +56,7 @@ namespace vw {
       : m_child( new ImageT(image) ),
         m_block_size( block_size ),
         m_num_threads( num_threads ),
+        m_traversal( RowMajorTraversal ),
         m_cache_ptr( cache ),
         m_block_table_size( 0 )
     {
@@ -92,10 +100,60 @@ namespace vw {
     }
     template <class DestT> inline void rasterize( DestT const& dest, BBox2i const& bbox ) const {
       RasterizeFunctor<DestT> rasterizer( *this, dest, bbox.min() );
-      BlockProcessor<RasterizeFunctor<DestT> > process( rasterizer, m_block_size, m_num_threads );
+      BlockProcessor<RasterizeFunctor<DestT> > process( rasterizer, m_block_size, m_num_threads, m_traversal );
       process(bbox);
     }
 
+    /// Set the order in which rasterize() visits blocks (see
+    /// BlockTraversal).  The default is row-major.  Prefetching reads
+    /// ahead in the same order.
+    void set_traversal( BlockTraversal order ) {
+      m_traversal = order;
+      if ( m_prefetch ) m_prefetch->set_traversal( m_table_width, m_table_height, order );
+    }
+
+    /// Turn on asynchronous prefetching.  Whenever rasterize() starts
+    /// on a block, the depth blocks that follow it in traversal order are
+    /// generated into the cache (unless they are already there) by up
+    /// to io_threads background threads.  The depth is further capped
+    /// so that prefetched blocks never take more than half of the
+    /// cache.  A depth of zero turns prefetching off.  Only has an
+    /// effect when the view has a cache.  Copies of this view made
+    /// after this call share the prefetcher and its statistics.
+    void set_prefetch( int depth, int io_threads = 2 ) {
+      if ( depth <= 0 || !m_cache_ptr ) {
+        m_prefetch.reset();
+        return;
+      }
+      m_prefetch.reset( new Prefetcher( depth, io_threads, m_block_table_size ) );
+      m_prefetch->set_traversal( m_table_width, m_table_height, m_traversal );
+    }
+
+    /// Hint that the given region will be needed soon.  If prefetching
+    /// is on, every block it touches is queued for generation.
+    void prefetch( BBox2i const& bbox ) const {
+      if ( !m_prefetch ) return;
+      BBox2i region = bbox;
+      region.crop( BBox2i(0,0,cols(),rows()) );
+      if ( region.empty() ) return;
+      for ( int32 iy = region.min().y()/m_block_size.y(); iy <= (region.max().y()-1)/m_block_size.y(); ++iy )
+        for ( int32 ix = region.min().x()/m_block_size.x(); ix <= (region.max().x()-1)/m_block_size.x(); ++ix )
+          m_prefetch->request( *this, ix, iy );
+    }
+
+    /// Wait for all queued prefetches to finish.
+    void join_prefetch() const {
+      if ( m_prefetch ) m_prefetch->join();
+    }
+
+    /// Prefetch statistics.  A hit is a block access that found the
+    /// block already cached by a prefetch; a miss is a block access
+    /// that had to generate the block itself.  All zero when
+    /// prefetching is off.
+    uint64 prefetch_hits() const { return m_prefetch ? m_prefetch->hits() : 0; }
+    uint64 prefetch_misses() const { return m_prefetch ? m_prefetch->misses() : 0; }
+    uint64 prefetch_requests() const { return m_prefetch ? m_prefetch->requests() : 0; }
+
   private:
     // These function objects are spawned to rasterize the child image.
     // One functor is created per child thread, and they are called
@@ -122,6 +180,8 @@ namespace vw {
           }
 #endif
           const Cache::Handle<BlockGenerator>& handle = m_view.block(ix,iy);
+          if ( m_view.m_prefetch )
+            m_view.m_prefetch->touch( m_view, ix, iy );
           handle->rasterize( crop( m_dest, bbox-m_offset ), bbox-Vector2i(ix*m_view.m_block_size.x(),iy*m_view.m_block_size.y()) );
           handle.release();
         }
@@ -154,6 +214,131 @@ namespace vw {
       }
     };
 
+    class Prefetcher;
+
+    // Generates a single block into the cache in the background.  It
+    // holds its own copy of the cache handle, so it stays valid even
+    // if the view that queued it goes away first.
+    class PrefetchTask : public Task {
+      Cache::Handle<BlockGenerator> m_handle;
+      size_t m_index;
+      Prefetcher& m_prefetcher;
+    public:
+      PrefetchTask( Cache::Handle<BlockGenerator> const& handle, size_t index, Prefetcher& prefetcher )
+        : m_handle(handle), m_index(index), m_prefetcher(prefetcher) {}
+      virtual ~PrefetchTask() {}
+      virtual void operator()() {
+        if ( !m_handle.valid() ) {
+          *m_handle;
+          m_handle.release();
+        }
+        m_prefetcher.finished( m_index );
+      }
+    };
+
+    // The shared prefetch state.  Remembers which blocks have been
+    // queued or generated by a prefetch, so that accesses can be
+    // counted as prefetch hits or misses.
+    class Prefetcher : private boost::noncopyable {
+      int m_depth;
+      FifoWorkQueue m_queue;
+      Mutex m_mutex;
+      std::vector<uint8> m_state; // one of the BlockState values below
+      std::vector<size_t> m_order, m_position; // traversal order, and its inverse
+      boost::atomic<uint64> m_hits, m_misses, m_requests;
+
+      enum BlockState { IDLE = 0, QUEUED = 1, PREFETCHED = 2 };
+
+    public:
+      Prefetcher( int depth, int io_threads, size_t table_size )
+        : m_depth(depth), m_queue(io_threads > 0 ? io_threads : 1), m_state(table_size, IDLE),
+          m_hits(0), m_misses(0), m_requests(0) {}
+
+      ~Prefetcher() { m_queue.join_all(); }
+
+      uint64 hits() const { return m_hits; }
+      uint64 misses() const { return m_misses; }
+      uint64 requests() const { return m_requests; }
+      void join() { m_queue.join_all(); }
+
+      // Read ahead in the order a full rasterize() with this traversal
+      // visits the block table.
+      void set_traversal( int32 table_width, int32 table_height, BlockTraversal order ) {
+        std::vector<Vector2i> grid = block_traversal( table_width, table_height, order );
+        Mutex::Lock lock(m_mutex);
+        m_order.resize( grid.size() );
+        m_position.resize( grid.size() );
+        for ( size_t i = 0; i < grid.size(); ++i ) {
+          m_order[i] = grid[i].x() + grid[i].y()*table_width;
+          m_position[m_order[i]] = i;
+        }
+      }
+
+      void finished( size_t index ) {
+        Mutex::Lock lock(m_mutex);
+        if ( m_state[index] == QUEUED )
+          m_state[index] = PREFETCHED;
+      }
+
+      // Queue block (ix,iy) unless it is already cached or queued.
+      // valid() may wait on a block that is being generated, so it is
+      // never called with m_mutex held.
+      void request( BlockRasterizeView const& view, int32 ix, int32 iy ) {
+        size_t index = ix + iy*view.m_table_width;
+        Cache::Handle<BlockGenerator> const& handle = view.block(ix,iy);
+        {
+          Mutex::Lock lock(m_mutex);
+          if ( m_state[index] == QUEUED ) return;
+        }
+        if ( handle.valid() ) return;
+        {
+          Mutex::Lock lock(m_mutex);
+          if ( m_state[index] == QUEUED ) return;
+          m_state[index] = QUEUED;
+        }
+        m_requests++;
+        m_queue.add_task( boost::shared_ptr<Task>( new PrefetchTask( handle, index, *this ) ) );
+      }
+
+      // Called whenever block (ix,iy) is about to be used.  Records a
+      // hit or a miss, then queues the blocks that follow it in
+      // traversal order.  A block that is still being prefetched counts
+      // as a hit, since the caller only waits for it rather than
+      // generating it again.
+      void touch( BlockRasterizeView const& view, int32 ix, int32 iy ) {
+        size_t index = ix + iy*view.m_table_width;
+        bool resident = view.block(ix,iy).valid();
+
+        // Never let prefetched blocks fill more than half the cache.
+        int depth = m_depth;
+        size_t block_bytes = view.block(ix,iy).size();
+        if ( block_bytes > 0 ) {
+          size_t budget = view.m_cache_ptr->max_size() / (2*block_bytes);
+          if ( size_t(depth) > budget ) depth = int(budget);
+        }
+
+        std::vector<size_t> ahead;
+        {
+          Mutex::Lock lock(m_mutex);
+          uint8& state = m_state[index];
+          if ( state == QUEUED || ( state == PREFETCHED && resident ) )
+            m_hits++;
+          else if ( !resident )
+            m_misses++;
+          state = IDLE;
+
+          size_t pos = m_position[index];
+          for ( int i = 1; i <= depth && pos + i < m_order.size(); ++i )
+            ahead.push_back( m_order[pos + i] );
+        }
+
+        for ( size_t i = 0; i < ahead.size(); ++i )
+          request( view, int32(ahead[i] % view.m_table_width), int32(ahead[i] / view.m_table_width) );
+      }
+    };
+
+    friend class Prefetcher;
+
     void initialize() {
       if( m_block_size.x() <= 0 || m_block_size.y() <= 0 ) {
         const int32 default_blocksize = 2*1024*1024; // 2 megabytes
@@ -201,10 +386,12 @@ namespace vw {
     boost::shared_ptr<ImageT> m_child;
     Vector2i m_block_size;
     int32 m_num_threads;
+    BlockTraversal m_traversal;
     Cache *m_cache_ptr;
     int m_table_width, m_table_height;
     size_t m_block_table_size;
     boost::shared_array<Cache::Handle<BlockGenerator> > m_block_table;
+    boost::shared_ptr<Prefetcher> m_prefetch;
   };
 
   template <class ImageT>
@@ -27,12 +27,17 @@
 
 #include <vector>
 #include <iterator>
+#include <algorithm>
 
 #include <vw/Image/ImageView.h>
 #include <vw/Image/Manipulation.h>
 #include <vw/Image/EdgeExtension.h>
 #include <vw/Image/PixelMask.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 namespace vw {
 
   // *******************************************************************
@@ -85,6 +90,71 @@ namespace vw {
     return result;
   }
 
+  // Row primitives for the separable convolution fast path.  Each
+  // computes acc[i] += k * src[i], i.e. one kernel tap applied to a
+  // run of channel values, in the same float arithmetic as
+  // correlate_1d_at_point.  The generic loops are written so that the
+  // compiler can vectorize them; the SSE2 versions do so explicitly.
+  namespace convolution {
+
+    template <class SrcT>
+    inline void multiply_accumulate( float* acc, const SrcT* src, float k, size_t n ) {
+      for( size_t i=0; i<n; ++i ) acc[i] += k * src[i];
+    }
+
+#if defined(__SSE2__)
+    inline void multiply_accumulate( float* acc, const float* src, float k, size_t n ) {
+      const __m128 vk = _mm_set1_ps( k );
+      size_t i = 0;
+      for( ; i+4<=n; i+=4 )
+        _mm_storeu_ps( acc+i, _mm_add_ps( _mm_loadu_ps( acc+i ), _mm_mul_ps( vk, _mm_loadu_ps( src+i ) ) ) );
+      for( ; i<n; ++i ) acc[i] += k * src[i];
+    }
+
+    inline void multiply_accumulate( float* acc, const uint8* src, float k, size_t n ) {
+      const __m128 vk = _mm_set1_ps( k );
+      const __m128i zero = _mm_setzero_si128();
+      size_t i = 0;
+      for( ; i+16<=n; i+=16 ) {
+        __m128i v = _mm_loadu_si128( (const __m128i*)(src+i) );
+        __m128i lo = _mm_unpacklo_epi8( v, zero ), hi = _mm_unpackhi_epi8( v, zero );
+        __m128i w[4] = { _mm_unpacklo_epi16( lo, zero ), _mm_unpackhi_epi16( lo, zero ),
+                         _mm_unpacklo_epi16( hi, zero ), _mm_unpackhi_epi16( hi, zero ) };
+        for( int j=0; j<4; ++j )
+          _mm_storeu_ps( acc+i+4*j, _mm_add_ps( _mm_loadu_ps( acc+i+4*j ), _mm_mul_ps( vk, _mm_cvtepi32_ps( w[j] ) ) ) );
+      }
+      for( ; i<n; ++i ) acc[i] += k * src[i];
+    }
+
+    inline void multiply_accumulate( float* acc, const uint16* src, float k, size_t n ) {
+      const __m128 vk = _mm_set1_ps( k );
+      const __m128i zero = _mm_setzero_si128();
+      size_t i = 0;
+      for( ; i+8<=n; i+=8 ) {
+        __m128i v = _mm_loadu_si128( (const __m128i*)(src+i) );
+        _mm_storeu_ps( acc+i,   _mm_add_ps( _mm_loadu_ps( acc+i ),   _mm_mul_ps( vk, _mm_cvtepi32_ps( _mm_unpacklo_epi16( v, zero ) ) ) ) );
+        _mm_storeu_ps( acc+i+4, _mm_add_ps( _mm_loadu_ps( acc+i+4 ), _mm_mul_ps( vk, _mm_cvtepi32_ps( _mm_unpackhi_epi16( v, zero ) ) ) ) );
+      }
+      for( ; i<n; ++i ) acc[i] += k * src[i];
+    }
+#endif
+
+    /// Whether SeparableConvolutionView can use its row-oriented fast
+    /// path: unmasked pixels whose channels are all float32, uint8 or
+    /// uint16, convolved with a float kernel.
+    template <class PixelT, class KernelT>
+    struct HasFastPath {
+      typedef typename CompoundChannelType<PixelT>::type channel_type;
+      static const bool value =
+        boost::is_same<KernelT, float>::value && !IsMasked<PixelT>::value &&
+        sizeof(PixelT) == sizeof(channel_type) * CompoundNumChannels<PixelT>::value &&
+        ( boost::is_same<channel_type, float>::value || boost::is_same<channel_type, uint8>::value ||
+          boost::is_same<channel_type, uint16>::value );
+      typedef boost::integral_constant<bool, value> type;
+    };
+
+  } // namespace convolution
+
   /// \endcond
 
 
@@ -274,9 +344,41 @@ namespace vw {
       BBox2i child_bbox = bbox;
       child_bbox.min() -= Vector2i( int32(ni?(ni-m_ci-1):0), int32(nj?(nj-m_cj-1):0) );
       child_bbox.max() += Vector2i( int32(ni?m_ci:0), int32(nj?m_cj:0) );
-      ImageView<typename ImageT::pixel_type> src_buf = edge_extend(m_image,child_bbox,m_edge);
+      ImageView<typename ImageT::pixel_type> src_buf( child_bbox.width(), child_bbox.height(), m_image.planes() );
+      rasterize_extended( src_buf, child_bbox );
+      rasterize_passes( src_buf, dest, bbox, typename convolution::HasFastPath<pixel_type,KernelT>::type() );
+    }
+
+    // Rasterizes the source region, which may run off the edges of the
+    // image, into buf.  Only the strips outside the image go through
+    // the edge extension; the rest is rasterized directly.
+    void rasterize_extended( ImageView<typename ImageT::pixel_type> const& buf, BBox2i const& bbox ) const {
+      BBox2i inner = bbox;
+      inner.crop( BBox2i(0,0,m_image.cols(),m_image.rows()) );
+      if( inner.empty() ) {
+        edge_extend(m_image,m_edge).rasterize( buf, bbox );
+        return;
+      }
+      Vector2i offset = bbox.min();
+      m_image.rasterize( crop( buf, inner - offset ), inner );
+      BBox2i strips[4] = {
+        BBox2i( Vector2i(bbox.min().x(), bbox.min().y()), Vector2i(bbox.max().x(), inner.min().y()) ),
+        BBox2i( Vector2i(bbox.min().x(), inner.max().y()), Vector2i(bbox.max().x(), bbox.max().y()) ),
+        BBox2i( Vector2i(bbox.min().x(), inner.min().y()), Vector2i(inner.min().x(), inner.max().y()) ),
+        BBox2i( Vector2i(inner.max().x(), inner.min().y()), Vector2i(bbox.max().x(), inner.max().y()) )
+      };
+      for( int i=0; i<4; ++i )
+        if( !strips[i].empty() )
+          edge_extend(m_image,m_edge).rasterize( crop( buf, strips[i] - offset ), strips[i] );
+    }
+
+    // The generic passes, through pixel accessors.
+    template <class DestT>
+    void rasterize_passes( ImageView<typename ImageT::pixel_type>& src_buf, DestT const& dest,
+                           BBox2i const& bbox, boost::false_type ) const {
+      size_t ni = m_i_kernel.size(), nj = m_j_kernel.size();
       if( ni>0 && nj>0 ) {
-        ImageView<pixel_type> work( bbox.width(), child_bbox.height(), planes() );
+        ImageView<pixel_type> work( bbox.width(), src_buf.rows(), planes() );
         convolve_1d( src_buf, work, m_i_kernel );
         src_buf.reset(); // Free up some memory
         convolve_1d( transpose(work), transpose(dest), m_j_kernel );
@@ -289,6 +391,100 @@ namespace vw {
       }
     }
 
+    // The fast path, for pixels made of float, uint8 or uint16
+    // channels.  Both passes run along rows of contiguous channel
+    // values, one kernel tap at a time, in column chunks that keep the
+    // float accumulators in cache.  Every output value sees the same
+    // taps in the same order as in convolve_1d, so the results are
+    // identical (unless the compiler is allowed to fuse the multiply
+    // and add into one instruction, which changes float rounding).
+    // The last pass stores straight into dest, cast to its channel type
+    // the way convolve_1d would.
+    template <class DestT>
+    void rasterize_passes( ImageView<typename ImageT::pixel_type>& src_buf, DestT const& dest,
+                           BBox2i const& bbox, boost::true_type ) const {
+      size_t ni = m_i_kernel.size(), nj = m_j_kernel.size();
+      if( ni>0 && nj>0 ) {
+        ImageView<pixel_type> work( bbox.width(), src_buf.rows(), planes() );
+        row_pass( src_buf, work, m_i_kernel );
+        src_buf.reset(); // Free up some memory
+        column_pass( work, dest, m_j_kernel );
+      }
+      else if( ni>0 ) {
+        row_pass( src_buf, dest, m_i_kernel );
+      }
+      else /* nj>0 */ {
+        column_pass( src_buf, dest, m_j_kernel );
+      }
+    }
+
+    // Convolves each row of src with the kernel, producing dest.cols()
+    // pixels per row.
+    template <class DestT>
+    void row_pass( ImageView<pixel_type> const& src, DestT const& dest,
+                   std::vector<KernelT> const& kernel ) const {
+      typedef typename CompoundChannelType<pixel_type>::type channel_type;
+      const size_t nch = CompoundNumChannels<pixel_type>::value;
+      const size_t chunk = 1024 / nch;
+      std::vector<float> acc( chunk * nch );
+      for( int32 p=0; p<dest.planes(); ++p )
+        for( int32 y=0; y<dest.rows(); ++y )
+          for( int32 x0=0; x0<dest.cols(); x0+=chunk ) {
+            size_t n = std::min( size_t(dest.cols()-x0), chunk ) * nch;
+            std::fill( acc.begin(), acc.begin()+n, 0.0f );
+            const channel_type* s = reinterpret_cast<const channel_type*>( &src(x0,y,p) );
+            for( size_t t=0; t<kernel.size(); ++t )
+              convolution::multiply_accumulate( &acc[0], s + t*nch, kernel[kernel.size()-1-t], n );
+            store_pixels( &acc[0], dest, x0, y, p, n / nch );
+          }
+    }
+
+    // Convolves each column of src with the kernel, producing
+    // dest.rows() rows, but working a row at a time.
+    template <class DestT>
+    void column_pass( ImageView<pixel_type> const& src, DestT const& dest,
+                      std::vector<KernelT> const& kernel ) const {
+      typedef typename CompoundChannelType<pixel_type>::type channel_type;
+      const size_t nch = CompoundNumChannels<pixel_type>::value;
+      const size_t chunk = 1024 / nch;
+      std::vector<float> acc( chunk * nch );
+      for( int32 p=0; p<dest.planes(); ++p )
+        for( int32 x0=0; x0<dest.cols(); x0+=chunk ) {
+          size_t n = std::min( size_t(dest.cols()-x0), chunk ) * nch;
+          for( int32 y=0; y<dest.rows(); ++y ) {
+            std::fill( acc.begin(), acc.begin()+n, 0.0f );
+            for( size_t t=0; t<kernel.size(); ++t )
+              convolution::multiply_accumulate( &acc[0], reinterpret_cast<const channel_type*>( &src(x0,y+int32(t),p) ),
+                                                kernel[kernel.size()-1-t], n );
+            store_pixels( &acc[0], dest, x0, y, p, n / nch );
+          }
+        }
+    }
+
+    // Stores a run of accumulated pixels into dest starting at
+    // (x0,y,p), cast to dest's channel type and clamped if it is an
+    // integer type, as convolve_1d does.
+    template <class DestT>
+    static void store_pixels( const float* acc, DestT const& dest, int32 x0, int32 y, int32 p, size_t npixels ) {
+      typedef typename CompoundChannelCast<pixel_type, float>::type acc_pixel_type;
+      typedef typename CompoundChannelType<typename DestT::pixel_type>::type dest_channel_type;
+      const acc_pixel_type* a = reinterpret_cast<const acc_pixel_type*>( acc );
+      typename DestT::pixel_accessor d = dest.origin().advance( x0, y, p );
+      for( size_t i=0; i<npixels; ++i ) {
+        *d = channel_cast_clamp_if_int<dest_channel_type>( a[i] );
+        d.next_col();
+      }
+    }
+
+    // Our own buffers hold contiguous channels, so store those directly.
+    static void store_pixels( const float* acc, ImageView<pixel_type> const& dest, int32 x0, int32 y, int32 p, size_t npixels ) {
+      typedef typename CompoundChannelType<pixel_type>::type channel_type;
+      const size_t nch = CompoundNumChannels<pixel_type>::value;
+      channel_type* d = reinterpret_cast<channel_type*>( &dest(x0,y,p) );
+      for( size_t i=0; i<npixels*nch; ++i )
+        d[i] = channel_cast_clamp_if_int<channel_type>( acc[i] );
+    }
+
     template <class SrcT, class DestT>
     void convolve_1d( SrcT const& src, DestT const& dest, std::vector<KernelT> const& kernel ) const {
       typedef typename SrcT::pixel_accessor SrcAccessT;
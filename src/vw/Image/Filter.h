@@ -34,6 +34,7 @@
 
 #include <vw/Image/ImageView.h>
 #include <vw/Image/Convolution.h>
+#include <vw/Image/RecursiveFilter.h>
 
 namespace vw {
 
@@ -241,6 +242,70 @@ namespace vw {
     return gaussian_filter( src, sigma, sigma, 0, 0, ConstantEdgeExtension() );
   }
 
+  /// This function applies a Gaussian smoothing filter to an image,
+  /// computed by the given method.  The recursive and box methods
+  /// cost the same per pixel whatever the sigma, at the price of a
+  /// small approximation error; AutoGaussian uses an explicit kernel
+  /// for small sigmas, where that is both exact and cheaper, and the
+  /// recursive filter above LineFilter::auto_gaussian_threshold.
+  /// Masked pixels are handled by normalized convolution; see
+  /// RecursiveFilterView.  See also vw::GaussianMethod.
+  template <class SrcT, class EdgeT>
+  RecursiveFilterView<SrcT, EdgeT>
+  inline gaussian_filter( ImageViewBase<SrcT> const& src, double x_sigma, double y_sigma, GaussianMethod method, EdgeT edge ) {
+    return RecursiveFilterView<SrcT, EdgeT>( src.impl(), LineFilter::gaussian( x_sigma, method ), LineFilter::gaussian( y_sigma, method ), edge );
+  }
+
+  /// This is an overloaded function provided for convenience; see
+  /// vw::gaussian_filter. It uses the default
+  /// vw::ConstantEdgeExtension mode.
+  template <class SrcT>
+  RecursiveFilterView<SrcT, ConstantEdgeExtension>
+  inline gaussian_filter( ImageViewBase<SrcT> const& src, double x_sigma, double y_sigma, GaussianMethod method ) {
+    return gaussian_filter( src, x_sigma, y_sigma, method, ConstantEdgeExtension() );
+  }
+
+  /// This is an overloaded function provided for convenience; see
+  /// vw::gaussian_filter. It uses the same standard deviation in both
+  /// directions.
+  template <class SrcT, class EdgeT>
+  RecursiveFilterView<SrcT, EdgeT>
+  inline gaussian_filter( ImageViewBase<SrcT> const& src, double sigma, GaussianMethod method, EdgeT edge ) {
+    return gaussian_filter( src, sigma, sigma, method, edge );
+  }
+
+  /// This is an overloaded function provided for convenience; see
+  /// vw::gaussian_filter. It uses the same standard deviation in both
+  /// directions and the default vw::ConstantEdgeExtension mode.
+  template <class SrcT>
+  RecursiveFilterView<SrcT, ConstantEdgeExtension>
+  inline gaussian_filter( ImageViewBase<SrcT> const& src, double sigma, GaussianMethod method ) {
+    return gaussian_filter( src, sigma, sigma, method, ConstantEdgeExtension() );
+  }
+
+
+  // Box filter functions
+
+  /// This function averages each pixel over an x_width by y_width
+  /// box, repeated the given number of times, using running sums so
+  /// that the cost per pixel does not depend on the size of the box.
+  /// The widths must be odd.  The source image is edge-extended using
+  /// the given edge extension mode as needed.
+  template <class SrcT, class EdgeT>
+  RecursiveFilterView<SrcT, EdgeT>
+  inline box_filter( ImageViewBase<SrcT> const& src, int32 x_width, int32 y_width, int32 passes, EdgeT edge ) {
+    return RecursiveFilterView<SrcT, EdgeT>( src.impl(), LineFilter::box( x_width, passes ), LineFilter::box( y_width, passes ), edge );
+  }
+
+  /// This is an overloaded function provided for convenience; see
+  /// vw::box_filter. It makes a single pass and uses the default
+  /// vw::ConstantEdgeExtension mode.
+  template <class SrcT>
+  RecursiveFilterView<SrcT, ConstantEdgeExtension>
+  inline box_filter( ImageViewBase<SrcT> const& src, int32 x_width, int32 y_width ) {
+    return box_filter( src, x_width, y_width, 1, ConstantEdgeExtension() );
+  }
+
 
   // Image differentiation functions
 
@@ -36,6 +36,12 @@
 #include <vw/Image/ImageResource.h>
 
 #include <cmath>
+#include <cstring>
+
+#if defined(__GNUC__) && defined(__SSE2__) && ( defined(__x86_64__) || defined(__i386__) )
+#define VW_CONVERT_X86 1
+#include <immintrin.h>
+#endif
 
 using namespace vw;
 
@@ -62,7 +68,7 @@ void channel_convert_int_to_float( SrcT* src, DestT* dest ) {
 template <class SrcT, class DestT>
 void channel_convert_float_to_int( SrcT* src, DestT* dest ) {
   if( *src > SrcT(1.0) ) *dest = boost::integer_traits<DestT>::const_max;
-  else if( *src < SrcT(0.0) ) *dest = DestT(0);
+  else if( !(*src >= SrcT(0.0)) ) *dest = DestT(0); // negative or NaN
   else *dest = DestT( *src * boost::integer_traits<DestT>::const_max );
 }
 
@@ -352,6 +358,415 @@ ChannelUnpremultiplyMapEntry _unpremultiply_u64( &channel_unpremultiply_int<uint
 ChannelUnpremultiplyMapEntry _unpremultiply_f32( &channel_unpremultiply_float<float> );
 ChannelUnpremultiplyMapEntry _unpremultiply_f64( &channel_unpremultiply_float<double> );
 
+// -------------------------------------------------------------------
+// Vectorized row kernels
+// -------------------------------------------------------------------
+//
+// The function tables above convert one channel value per call.  For
+// the most common conversions, where the channels of each row are
+// packed contiguously, convert() instead hands whole rows to one of
+// the kernels below.  Each kernel produces exactly the same values as
+// the table functions it replaces.  On x86 the SSE2 kernels are always
+// available, and AVX2/SSSE3 versions are chosen at run time when the
+// CPU supports them; on other CPUs only the plain C++ kernels are used.
+// set_convert_simd(false) turns all of them off.
+
+typedef void (*row_convert_func)(const uint8* src, uint8* dst, size_t count);
+
+namespace {
+
+  bool convert_simd_enabled = true;
+
+  // Scalar tails, shared by all of the kernels.
+  template <class SrcT>
+  inline void int_to_float_tail( const SrcT* src, float* dst, size_t i, size_t count, float scale ) {
+    for( ; i<count; ++i ) dst[i] = float(src[i]) * scale;
+  }
+
+  template <class DestT>
+  inline void float_to_int_tail( const float* src, DestT* dst, size_t i, size_t count ) {
+    for( ; i<count; ++i ) channel_convert_float_to_int( const_cast<float*>(src+i), dst+i );
+  }
+
+  // Averages three channels the way channel_average<float> does.
+  void rgb_to_gray_f32( const uint8* src_p, uint8* dst_p, size_t count ) {
+    const float* src = (const float*)src_p;
+    float* dst = (float*)dst_p;
+    for( size_t i=0; i<count; ++i, src+=3 ) {
+      double accum = 0;
+      accum += src[0]; accum += src[1]; accum += src[2];
+      dst[i] = float( accum / 3 );
+    }
+  }
+
+#ifdef VW_CONVERT_X86
+
+  // ---------------------------------------------------------------
+  // SSE2
+  // ---------------------------------------------------------------
+
+  template <bool RescaleV>
+  void u8_to_f32_sse2( const uint8* src, uint8* dst_p, size_t count ) {
+    float* dst = (float*)dst_p;
+    const float scale = RescaleV ? float(1.0)/255 : 1.0f;
+    const __m128 vscale = _mm_set1_ps( scale );
+    const __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+    for( ; i+16<=count; i+=16 ) {
+      __m128i v = _mm_loadu_si128( (const __m128i*)(src+i) );
+      __m128i lo = _mm_unpacklo_epi8( v, zero ), hi = _mm_unpackhi_epi8( v, zero );
+      _mm_storeu_ps( dst+i,    _mm_mul_ps( _mm_cvtepi32_ps( _mm_unpacklo_epi16( lo, zero ) ), vscale ) );
+      _mm_storeu_ps( dst+i+4,  _mm_mul_ps( _mm_cvtepi32_ps( _mm_unpackhi_epi16( lo, zero ) ), vscale ) );
+      _mm_storeu_ps( dst+i+8,  _mm_mul_ps( _mm_cvtepi32_ps( _mm_unpacklo_epi16( hi, zero ) ), vscale ) );
+      _mm_storeu_ps( dst+i+12, _mm_mul_ps( _mm_cvtepi32_ps( _mm_unpackhi_epi16( hi, zero ) ), vscale ) );
+    }
+    int_to_float_tail( src, dst, i, count, scale );
+  }
+
+  template <bool RescaleV>
+  void u16_to_f32_sse2( const uint8* src_p, uint8* dst_p, size_t count ) {
+    const uint16* src = (const uint16*)src_p;
+    float* dst = (float*)dst_p;
+    const float scale = RescaleV ? float(1.0)/65535 : 1.0f;
+    const __m128 vscale = _mm_set1_ps( scale );
+    const __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+    for( ; i+8<=count; i+=8 ) {
+      __m128i v = _mm_loadu_si128( (const __m128i*)(src+i) );
+      _mm_storeu_ps( dst+i,   _mm_mul_ps( _mm_cvtepi32_ps( _mm_unpacklo_epi16( v, zero ) ), vscale ) );
+      _mm_storeu_ps( dst+i+4, _mm_mul_ps( _mm_cvtepi32_ps( _mm_unpackhi_epi16( v, zero ) ), vscale ) );
+    }
+    int_to_float_tail( src, dst, i, count, scale );
+  }
+
+  // Clamp to [0,1], scale, and truncate, as channel_convert_float_to_int does.
+  // maxps returns its second operand when either is NaN, so taking the max
+  // with zero first sends NaN to 0.
+  inline __m128i f32_to_i32_rescale( const float* src, __m128 vmax ) {
+    __m128 v = _mm_loadu_ps( src );
+    v = _mm_min_ps( _mm_max_ps( v, _mm_setzero_ps() ), _mm_set1_ps(1.0f) );
+    return _mm_cvttps_epi32( _mm_mul_ps( v, vmax ) );
+  }
+
+  void f32_to_u8_rescale_sse2( const uint8* src_p, uint8* dst, size_t count ) {
+    const float* src = (const float*)src_p;
+    const __m128 vmax = _mm_set1_ps( 255.0f );
+    size_t i = 0;
+    for( ; i+16<=count; i+=16 ) {
+      __m128i a = _mm_packs_epi32( f32_to_i32_rescale( src+i,   vmax ), f32_to_i32_rescale( src+i+4,  vmax ) );
+      __m128i b = _mm_packs_epi32( f32_to_i32_rescale( src+i+8, vmax ), f32_to_i32_rescale( src+i+12, vmax ) );
+      _mm_storeu_si128( (__m128i*)(dst+i), _mm_packus_epi16( a, b ) );
+    }
+    float_to_int_tail( src, dst, i, count );
+  }
+
+  void f32_to_u16_rescale_sse2( const uint8* src_p, uint8* dst_p, size_t count ) {
+    const float* src = (const float*)src_p;
+    uint16* dst = (uint16*)dst_p;
+    const __m128 vmax = _mm_set1_ps( 65535.0f );
+    // SSE2 only packs to signed 16 bits, so shift the range down first.
+    const __m128i bias32 = _mm_set1_epi32( 32768 ), bias16 = _mm_set1_epi16( -32768 );
+    size_t i = 0;
+    for( ; i+8<=count; i+=8 ) {
+      __m128i a = _mm_sub_epi32( f32_to_i32_rescale( src+i,   vmax ), bias32 );
+      __m128i b = _mm_sub_epi32( f32_to_i32_rescale( src+i+4, vmax ), bias32 );
+      _mm_storeu_si128( (__m128i*)(dst+i), _mm_xor_si128( _mm_packs_epi32( a, b ), bias16 ) );
+    }
+    float_to_int_tail( src, dst, i, count );
+  }
+
+  void u8_to_u16_rescale_sse2( const uint8* src, uint8* dst_p, size_t count ) {
+    uint16* dst = (uint16*)dst_p;
+    const __m128i zero = _mm_setzero_si128(), factor = _mm_set1_epi16( 65535/255 );
+    size_t i = 0;
+    for( ; i+16<=count; i+=16 ) {
+      __m128i v = _mm_loadu_si128( (const __m128i*)(src+i) );
+      _mm_storeu_si128( (__m128i*)(dst+i),   _mm_mullo_epi16( _mm_unpacklo_epi8( v, zero ), factor ) );
+      _mm_storeu_si128( (__m128i*)(dst+i+8), _mm_mullo_epi16( _mm_unpackhi_epi8( v, zero ), factor ) );
+    }
+    for( ; i<count; ++i ) channel_convert_uint8_to_uint16( const_cast<uint8*>(src+i), dst+i );
+  }
+
+  // x/257 == (x - (x>>8)) >> 8 for every 16-bit x.
+  inline __m128i div257_epu16( __m128i v ) {
+    return _mm_srli_epi16( _mm_sub_epi16( v, _mm_srli_epi16( v, 8 ) ), 8 );
+  }
+
+  void u16_to_u8_rescale_sse2( const uint8* src_p, uint8* dst, size_t count ) {
+    const uint16* src = (const uint16*)src_p;
+    size_t i = 0;
+    for( ; i+16<=count; i+=16 ) {
+      __m128i a = div257_epu16( _mm_loadu_si128( (const __m128i*)(src+i) ) );
+      __m128i b = div257_epu16( _mm_loadu_si128( (const __m128i*)(src+i+8) ) );
+      _mm_storeu_si128( (__m128i*)(dst+i), _mm_packus_epi16( a, b ) );
+    }
+    for( ; i<count; ++i ) channel_convert_uint16_to_uint8( const_cast<uint16*>(src+i), dst+i );
+  }
+
+  void rgb_to_rgba_f32_sse2( const uint8* src_p, uint8* dst_p, size_t count ) {
+    const float* src = (const float*)src_p;
+    float* dst = (float*)dst_p;
+    const __m128 keep = _mm_castsi128_ps( _mm_setr_epi32( -1, -1, -1, 0 ) );
+    const __m128 alpha = _mm_setr_ps( 0.0f, 0.0f, 0.0f, 1.0f );
+    size_t i = 0;
+    // Each load reads one float past the pixel, so stop one early.
+    for( ; i+1<count; ++i )
+      _mm_storeu_ps( dst+4*i, _mm_or_ps( _mm_and_ps( _mm_loadu_ps( src+3*i ), keep ), alpha ) );
+    for( ; i<count; ++i ) {
+      dst[4*i] = src[3*i]; dst[4*i+1] = src[3*i+1]; dst[4*i+2] = src[3*i+2]; dst[4*i+3] = 1.0f;
+    }
+  }
+
+  // round(c*a/255) for 16-bit lanes holding c*a+128, exact for c,a < 256.
+  inline __m128i div255_round_epu16( __m128i t ) {
+    return _mm_srli_epi16( _mm_add_epi16( t, _mm_srli_epi16( t, 8 ) ), 8 );
+  }
+
+  void premultiply_rgba_u8_sse2( const uint8* src, uint8* dst, size_t count ) {
+    const __m128i zero = _mm_setzero_si128(), half = _mm_set1_epi16( 128 );
+    // The alpha lanes are multiplied by 255 so that they come out unchanged.
+    const __m128i color = _mm_setr_epi16( -1, -1, -1, 0, -1, -1, -1, 0 );
+    const __m128i opaque = _mm_setr_epi16( 0, 0, 0, 255, 0, 0, 0, 255 );
+    size_t i = 0;
+    for( ; i+4<=count; i+=4 ) {
+      __m128i v = _mm_loadu_si128( (const __m128i*)(src+4*i) );
+      __m128i px[2] = { _mm_unpacklo_epi8( v, zero ), _mm_unpackhi_epi8( v, zero ) };
+      for( int k=0; k<2; ++k ) {
+        __m128i a = _mm_shufflehi_epi16( _mm_shufflelo_epi16( px[k], _MM_SHUFFLE(3,3,3,3) ), _MM_SHUFFLE(3,3,3,3) );
+        a = _mm_or_si128( _mm_and_si128( a, color ), opaque );
+        px[k] = div255_round_epu16( _mm_add_epi16( _mm_mullo_epi16( px[k], a ), half ) );
+      }
+      _mm_storeu_si128( (__m128i*)(dst+4*i), _mm_packus_epi16( px[0], px[1] ) );
+    }
+    for( ; i<count; ++i )
+      channel_premultiply_int<uint8>( const_cast<uint8*>(src+4*i), dst+4*i, 4 );
+  }
+
+  void premultiply_rgba_f32_sse2( const uint8* src_p, uint8* dst_p, size_t count ) {
+    const float* src = (const float*)src_p;
+    float* dst = (float*)dst_p;
+    const __m128 color = _mm_castsi128_ps( _mm_setr_epi32( -1, -1, -1, 0 ) );
+    const __m128 one = _mm_setr_ps( 0.0f, 0.0f, 0.0f, 1.0f );
+    for( size_t i=0; i<count; ++i ) {
+      __m128 v = _mm_loadu_ps( src+4*i );
+      __m128 a = _mm_shuffle_ps( v, v, _MM_SHUFFLE(3,3,3,3) );
+      _mm_storeu_ps( dst+4*i, _mm_mul_ps( v, _mm_or_ps( _mm_and_ps( a, color ), one ) ) );
+    }
+  }
+
+  // ---------------------------------------------------------------
+  // SSSE3
+  // ---------------------------------------------------------------
+
+  __attribute__((target("ssse3")))
+  void rgb_to_rgba_u8_ssse3( const uint8* src, uint8* dst, size_t count ) {
+    const __m128i shuffle = _mm_setr_epi8( 0, 1, 2, -128, 3, 4, 5, -128, 6, 7, 8, -128, 9, 10, 11, -128 );
+    const __m128i alpha = _mm_set1_epi32( 0xff000000 );
+    size_t i = 0;
+    // Each load covers 16 bytes but only uses 12, so stop two pixels early.
+    for( ; i+6<=count; i+=4 ) {
+      __m128i v = _mm_loadu_si128( (const __m128i*)(src+3*i) );
+      _mm_storeu_si128( (__m128i*)(dst+4*i), _mm_or_si128( _mm_shuffle_epi8( v, shuffle ), alpha ) );
+    }
+    for( ; i<count; ++i ) {
+      dst[4*i] = src[3*i]; dst[4*i+1] = src[3*i+1]; dst[4*i+2] = src[3*i+2]; dst[4*i+3] = 255;
+    }
+  }
+
+  // Shuffle mask that gathers channel ch of 16 RGB pixels from the
+  // given 16-byte third of their 48 bytes.
+  inline __m128i rgb_gather_mask( int ch, int part ) {
+    int8 mask[16];
+    for( int k=0; k<16; ++k ) {
+      int index = 3*k + ch - 16*part;
+      mask[k] = ( index >= 0 && index < 16 ) ? int8(index) : int8(-128);
+    }
+    return _mm_loadu_si128( (const __m128i*)mask );
+  }
+
+  __attribute__((target("ssse3")))
+  void rgb_to_gray_u8_ssse3( const uint8* src, uint8* dst, size_t count ) {
+    __m128i masks[3][3];
+    for( int ch=0; ch<3; ++ch )
+      for( int part=0; part<3; ++part )
+        masks[ch][part] = rgb_gather_mask( ch, part );
+    const __m128i zero = _mm_setzero_si128();
+    // x/3 == (x*0xAAAB) >> 17 for x <= 3*255.
+    const __m128i third = _mm_set1_epi16( (short)0xAAAB );
+    size_t i = 0;
+    for( ; i+16<=count; i+=16 ) {
+      __m128i v[3];
+      for( int part=0; part<3; ++part )
+        v[part] = _mm_loadu_si128( (const __m128i*)(src+3*i+16*part) );
+      __m128i lo = zero, hi = zero;
+      for( int ch=0; ch<3; ++ch ) {
+        __m128i c = _mm_or_si128( _mm_or_si128( _mm_shuffle_epi8( v[0], masks[ch][0] ),
+                                                _mm_shuffle_epi8( v[1], masks[ch][1] ) ),
+                                  _mm_shuffle_epi8( v[2], masks[ch][2] ) );
+        lo = _mm_add_epi16( lo, _mm_unpacklo_epi8( c, zero ) );
+        hi = _mm_add_epi16( hi, _mm_unpackhi_epi8( c, zero ) );
+      }
+      lo = _mm_srli_epi16( _mm_mulhi_epu16( lo, third ), 1 );
+      hi = _mm_srli_epi16( _mm_mulhi_epu16( hi, third ), 1 );
+      _mm_storeu_si128( (__m128i*)(dst+i), _mm_packus_epi16( lo, hi ) );
+    }
+    for( ; i<count; ++i )
+      channel_average<uint8>( const_cast<uint8*>(src+3*i), dst+i, 3 );
+  }
+
+  // ---------------------------------------------------------------
+  // AVX2
+  // ---------------------------------------------------------------
+
+  template <bool RescaleV>
+  __attribute__((target("avx2")))
+  void u8_to_f32_avx2( const uint8* src, uint8* dst_p, size_t count ) {
+    float* dst = (float*)dst_p;
+    const float scale = RescaleV ? float(1.0)/255 : 1.0f;
+    const __m256 vscale = _mm256_set1_ps( scale );
+    size_t i = 0;
+    for( ; i+8<=count; i+=8 ) {
+      __m256i v = _mm256_cvtepu8_epi32( _mm_loadl_epi64( (const __m128i*)(src+i) ) );
+      _mm256_storeu_ps( dst+i, _mm256_mul_ps( _mm256_cvtepi32_ps( v ), vscale ) );
+    }
+    int_to_float_tail( src, dst, i, count, scale );
+  }
+
+  template <bool RescaleV>
+  __attribute__((target("avx2")))
+  void u16_to_f32_avx2( const uint8* src_p, uint8* dst_p, size_t count ) {
+    const uint16* src = (const uint16*)src_p;
+    float* dst = (float*)dst_p;
+    const float scale = RescaleV ? float(1.0)/65535 : 1.0f;
+    const __m256 vscale = _mm256_set1_ps( scale );
+    size_t i = 0;
+    for( ; i+8<=count; i+=8 ) {
+      __m256i v = _mm256_cvtepu16_epi32( _mm_loadu_si128( (const __m128i*)(src+i) ) );
+      _mm256_storeu_ps( dst+i, _mm256_mul_ps( _mm256_cvtepi32_ps( v ), vscale ) );
+    }
+    int_to_float_tail( src, dst, i, count, scale );
+  }
+
+#endif // x86
+
+  // The kernels chosen for this CPU.  A null entry means convert()
+  // uses the function tables for that case.
+  struct RowConvertKernels {
+    row_convert_func u8_f32, u8_f32_rescale, u16_f32, u16_f32_rescale;
+    row_convert_func f32_u8_rescale, f32_u16_rescale, u8_u16_rescale, u16_u8_rescale;
+    row_convert_func rgb_rgba_u8, rgb_rgba_f32, rgb_gray_u8, rgb_gray_f32;
+    row_convert_func premultiply_rgba_u8, premultiply_rgba_f32;
+
+    RowConvertKernels() {
+      memset( this, 0, sizeof(*this) );
+      rgb_gray_f32 = &rgb_to_gray_f32;
+#ifdef VW_CONVERT_X86
+      u8_f32 = &u8_to_f32_sse2<false>;
+      u8_f32_rescale = &u8_to_f32_sse2<true>;
+      u16_f32 = &u16_to_f32_sse2<false>;
+      u16_f32_rescale = &u16_to_f32_sse2<true>;
+      f32_u8_rescale = &f32_to_u8_rescale_sse2;
+      f32_u16_rescale = &f32_to_u16_rescale_sse2;
+      u8_u16_rescale = &u8_to_u16_rescale_sse2;
+      u16_u8_rescale = &u16_to_u8_rescale_sse2;
+      rgb_rgba_f32 = &rgb_to_rgba_f32_sse2;
+      premultiply_rgba_u8 = &premultiply_rgba_u8_sse2;
+      premultiply_rgba_f32 = &premultiply_rgba_f32_sse2;
+      __builtin_cpu_init();
+      if( __builtin_cpu_supports("ssse3") ) {
+        rgb_rgba_u8 = &rgb_to_rgba_u8_ssse3;
+        rgb_gray_u8 = &rgb_to_gray_u8_ssse3;
+      }
+      if( __builtin_cpu_supports("avx2") ) {
+        u8_f32 = &u8_to_f32_avx2<false>;
+        u8_f32_rescale = &u8_to_f32_avx2<true>;
+        u16_f32 = &u16_to_f32_avx2<false>;
+        u16_f32_rescale = &u16_to_f32_avx2<true>;
+      }
+#endif
+    }
+  };
+
+  RowConvertKernels const& row_convert_kernels() {
+    static RowConvertKernels kernels;
+    return kernels;
+  }
+
+  // Picks the row kernel for a conversion between packed channel
+  // types, or returns null.
+  row_convert_func channel_row_kernel( ChannelTypeEnum src, ChannelTypeEnum dst, bool rescale ) {
+    RowConvertKernels const& k = row_convert_kernels();
+    if( src == VW_CHANNEL_UINT8 && dst == VW_CHANNEL_FLOAT32 )   return rescale ? k.u8_f32_rescale : k.u8_f32;
+    if( src == VW_CHANNEL_UINT16 && dst == VW_CHANNEL_FLOAT32 )  return rescale ? k.u16_f32_rescale : k.u16_f32;
+    if( !rescale ) return 0;
+    if( src == VW_CHANNEL_FLOAT32 && dst == VW_CHANNEL_UINT8 )   return k.f32_u8_rescale;
+    if( src == VW_CHANNEL_FLOAT32 && dst == VW_CHANNEL_UINT16 )  return k.f32_u16_rescale;
+    if( src == VW_CHANNEL_UINT8 && dst == VW_CHANNEL_UINT16 )    return k.u8_u16_rescale;
+    if( src == VW_CHANNEL_UINT16 && dst == VW_CHANNEL_UINT8 )    return k.u16_u8_rescale;
+    return 0;
+  }
+
+  // Runs the conversion a row at a time if one of the row kernels
+  // applies.  Returns false, having done nothing, if none does.
+  bool convert_rows( ImageBuffer const& dst, ImageBuffer const& src, bool rescale,
+                     bool premultiply_dst, bool other_premultiply ) {
+    if( !convert_simd_enabled || other_premultiply )
+      return false;
+
+    const ImageFormat &srcf = src.format, &dstf = dst.format;
+    size_t src_channels = num_channels( srcf.pixel_format );
+    size_t dst_channels = num_channels( dstf.pixel_format );
+    if( src.cstride != ssize_t( src_channels * channel_size( srcf.channel_type ) ) ||
+        dst.cstride != ssize_t( dst_channels * channel_size( dstf.channel_type ) ) )
+      return false;
+
+    RowConvertKernels const& k = row_convert_kernels();
+    row_convert_func func = 0;
+    size_t count = srcf.cols;
+    bool same_type = srcf.channel_type == dstf.channel_type;
+
+    if( premultiply_dst ) {
+      if( same_type && srcf.pixel_format == VW_PIXEL_RGBA && dstf.pixel_format == VW_PIXEL_RGBA )
+        func = ( srcf.channel_type == VW_CHANNEL_UINT8 )   ? k.premultiply_rgba_u8
+             : ( srcf.channel_type == VW_CHANNEL_FLOAT32 ) ? k.premultiply_rgba_f32 : 0;
+    }
+    else if( src_channels == dst_channels && srcf.pixel_format == dstf.pixel_format ) {
+      func = channel_row_kernel( srcf.channel_type, dstf.channel_type, rescale );
+      count *= src_channels;
+    }
+    else if( same_type && srcf.pixel_format == VW_PIXEL_RGB && dstf.pixel_format == VW_PIXEL_RGBA ) {
+      func = ( srcf.channel_type == VW_CHANNEL_UINT8 )   ? k.rgb_rgba_u8
+           : ( srcf.channel_type == VW_CHANNEL_FLOAT32 ) ? k.rgb_rgba_f32 : 0;
+    }
+    else if( same_type && srcf.pixel_format == VW_PIXEL_RGB && dstf.pixel_format == VW_PIXEL_GRAY ) {
+      func = ( srcf.channel_type == VW_CHANNEL_UINT8 )   ? k.rgb_gray_u8
+           : ( srcf.channel_type == VW_CHANNEL_FLOAT32 ) ? k.rgb_gray_f32 : 0;
+    }
+    if( !func )
+      return false;
+
+    const uint8 *src_ptr_p = (const uint8*)src.data;
+    uint8 *dst_ptr_p = (uint8*)dst.data;
+    for( uint32 p=0; p<srcf.planes; ++p ) {
+      const uint8 *src_ptr_r = src_ptr_p;
+      uint8 *dst_ptr_r = dst_ptr_p;
+      for( uint32 r=0; r<srcf.rows; ++r ) {
+        func( src_ptr_r, dst_ptr_r, count );
+        src_ptr_r += src.rstride;
+        dst_ptr_r += dst.rstride;
+      }
+      src_ptr_p += src.pstride;
+      dst_ptr_p += dst.pstride;
+    }
+    return true;
+  }
+
+} // namespace
+
+void vw::set_convert_simd( bool enable ) {
+  convert_simd_enabled = enable;
+}
+
 void vw::convert( ImageBuffer const& dst, ImageBuffer const& src, bool rescale ) {
   VW_ASSERT( dst.format.cols==src.format.cols && dst.format.rows==src.format.rows,
              ArgumentErr() << "Destination buffer has wrong size." );
@@ -443,6 +858,10 @@ void vw::convert( ImageBuffer const& dst, ImageBuffer const& src, bool rescale )
   if( !conv_func || !max_func || !avg_func || !unpremultiply_src_func || !premultiply_dst_func || !premultiply_src_func )
     vw_throw( NoImplErr() << "Unsupported channel type combination in convert (" << src.format.channel_type << ", " << dst.format.channel_type << ")!" );
 
+  // Hand whole rows to a vectorized kernel where we have one.
+  if( convert_rows( dst, src, rescale, premultiply_dst, unpremultiply_src || premultiply_src ) )
+    return;
+
   int32 max_channels = std::max( src_channels, dst_channels );
 
   boost::scoped_array<uint8> src_buf(new uint8[max_channels*src_chstride]);
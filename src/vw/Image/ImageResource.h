@@ -38,6 +38,13 @@ namespace vw {
   /// buffer, converting the pixel format and channel type as required.
   void convert( ImageBuffer const& dst, ImageBuffer const& src, bool rescale=false );
 
+  /// Enables or disables the row kernels (SSE2, SSSE3 and AVX2 where
+  /// the CPU has them) that convert() uses for the most common
+  /// conversions.  They are on by default and give the same results as
+  /// the generic code; turning them off is mainly useful for testing
+  /// and benchmarking.
+  void set_convert_simd( bool enable );
+
 
   /// Describes the format of an image, i.e. its dimensions, pixel
   /// structure, and channel type.
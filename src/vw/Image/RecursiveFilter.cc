@@ -0,0 +1,98 @@
+// __BEGIN_LICENSE__
+//  Copyright (c) 2006-2013, United States Government as represented by the
+//  Administrator of the National Aeronautics and Space Administration. All
+//  rights reserved.
+//
+//  The NASA Vision Workbench is licensed under the Apache License,
+//  Version 2.0 (the "License"); you may not use this file except in
+//  compliance with the License. You may obtain a copy of the License at
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+// __END_LICENSE__
+
+
+/// \file RecursiveFilter.cc
+///
+/// Coefficients for the constant-cost smoothing filters.
+///
+#include <vw/Image/RecursiveFilter.h>
+#include <vw/Image/Filter.h>
+
+#include <cmath>
+
+const double vw::LineFilter::auto_gaussian_threshold = 5.0;
+
+/// The recursive filter follows I. T. Young and L. J. van Vliet,
+/// "Recursive implementation of the Gaussian filter", Signal
+/// Processing 44 (1995), which is accurate for sigma >= 0.5.  The box
+/// widths follow W. M. Wells, "Efficient synthesis of Gaussian
+/// filters by cascaded uniform filters" (1986): passes of two
+/// adjacent odd widths whose combined variance is closest to sigma^2.
+vw::LineFilter vw::LineFilter::gaussian( double sigma, GaussianMethod method ) {
+  LineFilter result;
+  if( sigma <= 0 ) return result;
+  if( method == AutoGaussian )
+    method = ( sigma < auto_gaussian_threshold ) ? KernelGaussian : RecursiveGaussian;
+  if( method == RecursiveGaussian && sigma < 0.5 )
+    method = KernelGaussian;
+
+  switch( method ) {
+  case RecursiveGaussian: {
+    double q = ( sigma >= 2.5 ) ? 0.98711*sigma - 0.96330 : 3.97156 - 4.14554*std::sqrt(1 - 0.26891*sigma);
+    double q2 = q*q, q3 = q2*q;
+    double b0 = 1.57825 + 2.44413*q + 1.4281*q2 + 0.422205*q3;
+    double b1 = 2.44413*q + 2.85619*q2 + 1.26661*q3;
+    double b2 = -( 1.4281*q2 + 1.26661*q3 );
+    double b3 = 0.422205*q3;
+    result.m_type = Recursive;
+    result.m_a[1] = b1 / b0;
+    result.m_a[2] = b2 / b0;
+    result.m_a[3] = b3 / b0;
+    result.m_a[0] = 1 - ( result.m_a[1] + result.m_a[2] + result.m_a[3] );
+    // The impulse response falls below 1e-4 of its peak by about 5
+    // sigma; the start-up transient of each pass decays as fast.
+    result.m_halo = int32( std::ceil( 5*sigma ) ) + 3;
+    break;
+  }
+  case BoxGaussian: {
+    const int32 passes = 3;
+    double ideal = std::sqrt( 12*sigma*sigma/passes + 1 );
+    int32 wl = int32( std::floor( ideal ) );
+    if( wl % 2 == 0 ) --wl;
+    if( wl < 1 ) wl = 1;
+    int32 m = int32( std::floor( ( 12*sigma*sigma - passes*wl*wl - 4*passes*wl - 3*passes ) / ( -4.0*wl - 4 ) + 0.5 ) );
+    m = std::min( std::max( m, 0 ), passes );
+    result.m_type = Box;
+    result.m_halo = 0;
+    for( int32 i=0; i<passes; ++i ) {
+      int32 w = ( i < m ) ? wl : wl+2;
+      if( w > 1 ) result.m_widths.push_back( w );
+      result.m_halo += w/2;
+    }
+    if( result.m_widths.empty() ) result.m_type = Identity;
+    break;
+  }
+  default: {
+    generate_gaussian_kernel( result.m_kernel, sigma );
+    result.m_type = Kernel;
+    result.m_halo = int32( result.m_kernel.size()/2 );
+    break;
+  }
+  }
+  return result;
+}
+
+vw::LineFilter vw::LineFilter::box( int32 width, int32 passes ) {
+  VW_ASSERT( width > 0 && width % 2 == 1, ArgumentErr() << "LineFilter::box: width must be odd and positive." );
+  LineFilter result;
+  if( width == 1 || passes <= 0 ) return result;
+  result.m_type = Box;
+  result.m_widths.assign( passes, width );
+  result.m_halo = passes * (width/2);
+  return result;
+}
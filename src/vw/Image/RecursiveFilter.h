@@ -0,0 +1,294 @@
+// __BEGIN_LICENSE__
+//  Copyright (c) 2006-2013, United States Government as represented by the
+//  Administrator of the National Aeronautics and Space Administration. All
+//  rights reserved.
+//
+//  The NASA Vision Workbench is licensed under the Apache License,
+//  Version 2.0 (the "License"); you may not use this file except in
+//  compliance with the License. You may obtain a copy of the License at
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+// __END_LICENSE__
+
+
+/// \file RecursiveFilter.h
+///
+/// Separable smoothing filters whose cost per pixel does not depend
+/// on the size of the filter: a recursive (IIR) approximation to the
+/// Gaussian after Young and van Vliet, and repeated running-sum box
+/// filters.  The user-facing functions are gaussian_filter() with a
+/// GaussianMethod argument and box_filter(), in Filter.h.
+///
+#ifndef __VW_IMAGE_RECURSIVEFILTER_H__
+#define __VW_IMAGE_RECURSIVEFILTER_H__
+
+#include <vector>
+#include <algorithm>
+
+#include <boost/type_traits.hpp>
+#include <boost/mpl/if.hpp>
+
+#include <vw/Image/ImageView.h>
+#include <vw/Image/Manipulation.h>
+#include <vw/Image/EdgeExtension.h>
+#include <vw/Image/PixelMask.h>
+
+namespace vw {
+
+  /// How gaussian_filter() should compute the blur.
+  enum GaussianMethod {
+    /// Convolve with an explicit kernel.  Exact, but the cost grows
+    /// linearly with sigma.
+    KernelGaussian,
+    /// The third-order recursive filter of Young and van Vliet.
+    /// Constant cost per pixel; the frequency response differs from
+    /// a true Gaussian's by a few percent.  Requires sigma >= 0.5;
+    /// smaller sigmas fall back to the kernel.
+    RecursiveGaussian,
+    /// Three passes of a running-sum box filter with widths chosen to
+    /// match sigma.  Constant cost per pixel; the effective sigma is
+    /// only approximate for small sigmas.
+    BoxGaussian,
+    /// KernelGaussian below a sigma threshold, RecursiveGaussian
+    /// above it.
+    AutoGaussian
+  };
+
+  /// A one-dimensional smoothing filter applied along the columns of
+  /// a buffer of real numbers, used by RecursiveFilterView.  Each
+  /// column is treated as if its end values extended forever, so the
+  /// first and last halo() values are only approximate.
+  class LineFilter {
+  public:
+    enum Type { Identity, Kernel, Recursive, Box };
+
+    /// The sigma above which AutoGaussian switches to the recursive
+    /// filter.
+    static const double auto_gaussian_threshold;
+
+    /// A Gaussian of the given sigma, computed by the given method.
+    static LineFilter gaussian( double sigma, GaussianMethod method = AutoGaussian );
+
+    /// The given number of passes of a box of the given (odd) width.
+    static LineFilter box( int32 width, int32 passes = 1 );
+
+    LineFilter() : m_type(Identity), m_halo(0) {}
+
+    Type type() const { return m_type; }
+
+    /// How far beyond a region the input must extend for the output
+    /// over that region to be accurate.
+    int32 halo() const { return m_halo; }
+
+    /// Filters the columns of a block of rows, in place: each of the
+    /// len columns is one line, and rows are row_stride apart.
+    template <class RealT>
+    void filter_rows( RealT* data, ptrdiff_t row_stride, int32 rows, int32 len, std::vector<RealT>& tmp ) const;
+
+  private:
+    Type m_type;
+    int32 m_halo;
+    std::vector<double> m_kernel;  // Kernel: taps, centered on m_kernel.size()/2
+    double m_a[4];                 // Recursive: B and b1..b3 over b0
+    std::vector<int32> m_widths;   // Box: the width of each pass
+
+    template <class RealT> void box_rows( RealT* data, ptrdiff_t row_stride, int32 rows, int32 len, int32 width, std::vector<RealT>& tmp ) const;
+  };
+
+
+  /// A view that applies one LineFilter along rows and another along
+  /// columns.  Like SeparableConvolutionView, it rasterizes a region
+  /// by edge-extending the source over the region plus the filters'
+  /// halos, so it can be rasterized in tiles.  The work is done in
+  /// float (or double, for double pixels) and the result is cast
+  /// back to the pixel's channel type, clamping integer types.
+  ///
+  /// Masked pixels are filtered by normalized convolution: invalid
+  /// pixels get no weight, each result is divided by the total weight
+  /// of the valid pixels that contributed to it, and a pixel is valid
+  /// in the result if it is valid in the source.  (This differs from
+  /// SeparableConvolutionView, whose results are invalid anywhere the
+  /// kernel touches an invalid pixel.)
+  template <class ImageT, class EdgeT>
+  class RecursiveFilterView : public ImageViewBase<RecursiveFilterView<ImageT,EdgeT> > {
+  public:
+    typedef typename ImageT::pixel_type pixel_type;
+    typedef pixel_type result_type;
+    typedef ProceduralPixelAccessor<RecursiveFilterView> pixel_accessor;
+
+  private:
+    typedef typename UnmaskedPixelType<pixel_type>::type value_type;
+    typedef typename CompoundChannelType<value_type>::type channel_type;
+    typedef typename boost::mpl::if_< boost::is_same<channel_type, double>, double, float >::type real_type;
+
+    ImageT m_image;
+    LineFilter m_x_filter, m_y_filter;
+    EdgeT m_edge;
+
+  public:
+    RecursiveFilterView( ImageT const& image, LineFilter const& x_filter, LineFilter const& y_filter, EdgeT const& edge = EdgeT() )
+      : m_image(image), m_x_filter(x_filter), m_y_filter(y_filter), m_edge(edge) {}
+
+    inline int32 cols() const { return m_image.cols(); }
+    inline int32 rows() const { return m_image.rows(); }
+    inline int32 planes() const { return m_image.planes(); }
+
+    inline pixel_accessor origin() const { return pixel_accessor( *this ); }
+
+    /// Returns the pixel at the given position.  This filters a whole
+    /// neighborhood, so it is very slow; rasterize the view instead.
+    inline result_type operator()( int32 x, int32 y, int32 p=0 ) const {
+      ImageView<pixel_type> buf( 1, 1, planes() );
+      rasterize( buf, BBox2i(x,y,1,1) );
+      return buf(0,0,p);
+    }
+
+    LineFilter const& x_filter() const { return m_x_filter; }
+    LineFilter const& y_filter() const { return m_y_filter; }
+
+    /// \cond INTERNAL
+    typedef CropView<ImageView<pixel_type> > prerasterize_type;
+    inline prerasterize_type prerasterize( BBox2i const& bbox ) const {
+      ImageView<pixel_type> dest( bbox.width(), bbox.height(), planes() );
+      rasterize( dest, bbox );
+      return CropView<ImageView<pixel_type> >( dest, BBox2i(-bbox.min().x(),-bbox.min().y(),cols(),rows()) );
+    }
+
+    template <class DestT>
+    void rasterize( DestT const& dest, BBox2i const& bbox ) const {
+      // Masked pixels carry their weight as an extra channel.
+      const bool masked = IsMasked<pixel_type>::value;
+      const int32 nch = CompoundNumChannels<value_type>::value, nbuf = nch + (masked ? 1 : 0);
+      const int32 hx = m_x_filter.halo(), hy = m_y_filter.halo();
+      BBox2i child_bbox = bbox;
+      child_bbox.min() -= Vector2i( hx, hy );
+      child_bbox.max() += Vector2i( hx, hy );
+      ImageView<pixel_type> src = edge_extend( m_image, child_bbox, m_edge );
+
+      // The row pass runs on a transposed copy of the source, so that
+      // both passes filter many independent lines at once instead of
+      // waiting on the recursion along a single line.
+      const int32 w = child_bbox.width(), h = child_bbox.height(), bw = bbox.width();
+      const ptrdiff_t line = ptrdiff_t(h) * nbuf;
+      std::vector<real_type> tbuf( size_t(w) * line ), buf( size_t(bw) * line ), tmp;
+      for( int32 p=0; p<planes(); ++p ) {
+        for( int32 y=0; y<h; ++y )
+          for( int32 x=0; x<w; ++x ) {
+            pixel_type const& px = src(x,y,p);
+            real_type* out = &tbuf[x*line + y*nbuf];
+            const bool valid = is_valid( px );
+            for( int32 c=0; c<nch; ++c )
+              out[c] = valid ? real_type( compound_select_channel<channel_type const&>( remove_mask(px), c ) ) : real_type(0);
+            if( masked ) out[nch] = valid ? real_type(1) : real_type(0);
+          }
+        m_x_filter.filter_rows( &tbuf[0], line, w, int32(line), tmp );
+
+        for( int32 y=0; y<h; ++y )
+          for( int32 x=0; x<bw; ++x )
+            std::copy( &tbuf[(x+hx)*line + y*nbuf], &tbuf[(x+hx)*line + (y+1)*nbuf], &buf[(size_t(y)*bw + x)*nbuf] );
+        m_y_filter.filter_rows( &buf[0], ptrdiff_t(bw)*nbuf, h, bw*nbuf, tmp );
+
+        for( int32 y=0; y<bbox.height(); ++y )
+          for( int32 x=0; x<bw; ++x ) {
+            const real_type* in = &buf[(size_t(y+hy)*bw + x)*nbuf];
+            bool valid = true;
+            real_type scale = 1;
+            if( masked ) {
+              valid = is_valid( src(x+hx,y+hy,p) ) && in[nch] > 0;
+              scale = valid ? 1 / in[nch] : 0;
+            }
+            pixel_type px;
+            for( int32 c=0; c<nch; ++c )
+              compound_select_channel<channel_type&>( remove_mask(px), c ) = channel_cast_clamp_if_int<channel_type>( in[c] * scale );
+            if( valid ) validate( px );
+            dest(x,y,p) = px;
+          }
+      }
+    }
+    /// \endcond
+  };
+
+
+  // *******************************************************************
+  // LineFilter template definitions
+  // *******************************************************************
+
+  template <class RealT>
+  void LineFilter::filter_rows( RealT* data, ptrdiff_t row_stride, int32 rows, int32 len, std::vector<RealT>& tmp ) const {
+    if( rows <= 0 || len <= 0 ) return;
+    switch( m_type ) {
+    case Identity:
+      break;
+    case Kernel: {
+      tmp.resize( size_t(rows) * len );
+      for( int32 r=0; r<rows; ++r )
+        std::copy( data + r*row_stride, data + r*row_stride + len, &tmp[size_t(r)*len] );
+      const int32 c = int32(m_kernel.size()/2);
+      for( int32 r=0; r<rows; ++r ) {
+        RealT* out = data + r*row_stride;
+        std::fill( out, out+len, RealT(0) );
+        for( int32 k=0; k<int32(m_kernel.size()); ++k ) {
+          const RealT* in = &tmp[size_t(std::min( std::max( r+c-k, 0 ), rows-1 ))*len];
+          const RealT t = RealT(m_kernel[k]);
+          for( int32 i=0; i<len; ++i ) out[i] += t * in[i];
+        }
+      }
+      break;
+    }
+    case Recursive: {
+      const RealT B = RealT(m_a[0]), a1 = RealT(m_a[1]), a2 = RealT(m_a[2]), a3 = RealT(m_a[3]);
+      for( int32 r=1; r<rows; ++r ) {
+        RealT* out = data + r*row_stride;
+        const RealT *w1 = data + (r-1)*row_stride, *w2 = data + std::max(r-2,0)*row_stride, *w3 = data + std::max(r-3,0)*row_stride;
+        for( int32 i=0; i<len; ++i ) out[i] = B*out[i] + a1*w1[i] + a2*w2[i] + a3*w3[i];
+      }
+      for( int32 r=rows-2; r>=0; --r ) {
+        RealT* out = data + r*row_stride;
+        const RealT *w1 = data + (r+1)*row_stride, *w2 = data + std::min(r+2,rows-1)*row_stride, *w3 = data + std::min(r+3,rows-1)*row_stride;
+        for( int32 i=0; i<len; ++i ) out[i] = B*out[i] + a1*w1[i] + a2*w2[i] + a3*w3[i];
+      }
+      break;
+    }
+    case Box:
+      for( size_t i=0; i<m_widths.size(); ++i )
+        box_rows( data, row_stride, rows, len, m_widths[i], tmp );
+      break;
+    }
+  }
+
+  // A running sum over a window of the given width, divided by the
+  // width, kept for every column at once.
+  template <class RealT>
+  void LineFilter::box_rows( RealT* data, ptrdiff_t row_stride, int32 rows, int32 len, int32 width, std::vector<RealT>& tmp ) const {
+    const int32 r = width/2;
+    // The first len values of tmp hold the running sums, the rest a
+    // copy of the input rows.
+    tmp.resize( size_t(rows+1) * len );
+    RealT* sum = &tmp[0];
+    for( int32 y=0; y<rows; ++y )
+      std::copy( data + y*row_stride, data + y*row_stride + len, &tmp[size_t(y+1)*len] );
+    std::fill( sum, sum+len, RealT(0) );
+    for( int32 j=-r; j<=r; ++j ) {
+      const RealT* in = &tmp[size_t(std::min( std::max( j, 0 ), rows-1 )+1)*len];
+      for( int32 i=0; i<len; ++i ) sum[i] += in[i];
+    }
+    const RealT scale = RealT(1.0 / width);
+    for( int32 y=0; y<rows; ++y ) {
+      RealT* out = data + y*row_stride;
+      const RealT* add = &tmp[size_t(std::min( y+r+1, rows-1 )+1)*len];
+      const RealT* sub = &tmp[size_t(std::max( y-r, 0 )+1)*len];
+      for( int32 i=0; i<len; ++i ) {
+        out[i] = sum[i] * scale;
+        sum[i] += add[i] - sub[i];
+      }
+    }
+  }
+
+} // namespace vw
+
+#endif // __VW_IMAGE_RECURSIVEFILTER_H__
@@ -0,0 +1,107 @@
+// __BEGIN_LICENSE__
+//  Copyright (c) 2006-2013, United States Government as represented by the
+//  Administrator of the National Aeronautics and Space Administration. All
+//  rights reserved.
+//
+//  The NASA Vision Workbench is licensed under the Apache License,
+//  Version 2.0 (the "License"); you may not use this file except in
+//  compliance with the License. You may obtain a copy of the License at
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+// __END_LICENSE__
+
+// Micro-benchmark for the convert() row kernels.  This is not part of
+// the test suite; build it with "make BenchImageResource" and run it
+// directly.  Each case converts an 8 megapixel buffer with the row
+// kernels off and on and prints the throughput of both.
+
+#include <gtest/gtest_VW.h>
+
+#include <vw/Core/Stopwatch.h>
+#include <vw/Image/ImageResource.h>
+#include <vw/Image/PixelTypeInfo.h>
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+
+using namespace vw;
+
+namespace {
+
+  // Returns the time per conversion, in seconds.
+  double time_convert( ImageBuffer const& dst, ImageBuffer const& src, bool rescale ) {
+    const int iterations = 10;
+    convert( dst, src, rescale );
+    uint64 t0 = Stopwatch::microtime();
+    for (int i = 0; i < iterations; ++i)
+      convert( dst, src, rescale );
+    uint64 t1 = Stopwatch::microtime();
+    return (t1 - t0) / 1e6 / iterations;
+  }
+
+  void bench( PixelFormatEnum src_pf, ChannelTypeEnum src_ct,
+              PixelFormatEnum dst_pf, ChannelTypeEnum dst_ct,
+              bool rescale, bool src_premultiplied = true ) {
+    ImageFormat sfmt, dfmt;
+    sfmt.cols = dfmt.cols = 4096;
+    sfmt.rows = dfmt.rows = 2048;
+    sfmt.planes = dfmt.planes = 1;
+    sfmt.pixel_format = src_pf;
+    sfmt.channel_type = src_ct;
+    sfmt.premultiplied = src_premultiplied;
+    dfmt.pixel_format = dst_pf;
+    dfmt.channel_type = dst_ct;
+
+    size_t src_bytes = size_t(sfmt.cols) * sfmt.rows * num_channels(src_pf) * channel_size(src_ct);
+    size_t dst_bytes = size_t(dfmt.cols) * dfmt.rows * num_channels(dst_pf) * channel_size(dst_ct);
+    std::vector<uint8> src( src_bytes ), dst( dst_bytes );
+    if (src_ct == VW_CHANNEL_FLOAT32) {
+      float* f = reinterpret_cast<float*>(&src[0]);
+      for (size_t i = 0; i < src_bytes / sizeof(float); ++i)
+        f[i] = float(i % 1000) / 999.0f;
+    } else {
+      for (size_t i = 0; i < src_bytes; ++i)
+        src[i] = uint8(i * 7);
+    }
+
+    ImageBuffer sbuf( sfmt, &src[0] ), dbuf( dfmt, &dst[0] );
+    set_convert_simd(false);
+    double scalar = time_convert( dbuf, sbuf, rescale );
+    set_convert_simd(true);
+    double simd = time_convert( dbuf, sbuf, rescale );
+
+    double mpix = double(sfmt.cols) * sfmt.rows / 1e6;
+    std::cout << std::setw(7) << pixel_format_name(src_pf) << "/" << std::setw(7) << channel_type_name(src_ct)
+              << " -> " << std::setw(7) << pixel_format_name(dst_pf) << "/" << std::setw(7) << channel_type_name(dst_ct)
+              << (rescale ? " rescale" : "        ")
+              << std::fixed << std::setprecision(1)
+              << std::setw(9) << mpix / scalar << " Mpix/s scalar"
+              << std::setw(9) << mpix / simd << " Mpix/s simd"
+              << std::setw(7) << std::setprecision(2) << scalar / simd << "x\n";
+  }
+}
+
+TEST( BenchImageResource, ChannelConvert ) {
+  bench( VW_PIXEL_RGB,  VW_CHANNEL_UINT8,   VW_PIXEL_RGB,  VW_CHANNEL_FLOAT32, true  );
+  bench( VW_PIXEL_RGB,  VW_CHANNEL_UINT8,   VW_PIXEL_RGB,  VW_CHANNEL_FLOAT32, false );
+  bench( VW_PIXEL_GRAY, VW_CHANNEL_UINT16,  VW_PIXEL_GRAY, VW_CHANNEL_FLOAT32, true  );
+  bench( VW_PIXEL_RGB,  VW_CHANNEL_FLOAT32, VW_PIXEL_RGB,  VW_CHANNEL_UINT8,   true  );
+  bench( VW_PIXEL_GRAY, VW_CHANNEL_FLOAT32, VW_PIXEL_GRAY, VW_CHANNEL_UINT16,  true  );
+  bench( VW_PIXEL_RGB,  VW_CHANNEL_UINT8,   VW_PIXEL_RGB,  VW_CHANNEL_UINT16,  true  );
+  bench( VW_PIXEL_RGB,  VW_CHANNEL_UINT16,  VW_PIXEL_RGB,  VW_CHANNEL_UINT8,   true  );
+}
+
+TEST( BenchImageResource, PixelConvert ) {
+  bench( VW_PIXEL_RGB,  VW_CHANNEL_UINT8,   VW_PIXEL_RGBA, VW_CHANNEL_UINT8,   false );
+  bench( VW_PIXEL_RGB,  VW_CHANNEL_FLOAT32, VW_PIXEL_RGBA, VW_CHANNEL_FLOAT32, false );
+  bench( VW_PIXEL_RGB,  VW_CHANNEL_UINT8,   VW_PIXEL_GRAY, VW_CHANNEL_UINT8,   false );
+  bench( VW_PIXEL_RGB,  VW_CHANNEL_FLOAT32, VW_PIXEL_GRAY, VW_CHANNEL_FLOAT32, false );
+  bench( VW_PIXEL_RGBA, VW_CHANNEL_UINT8,   VW_PIXEL_RGBA, VW_CHANNEL_UINT8,   false, false );
+  bench( VW_PIXEL_RGBA, VW_CHANNEL_FLOAT32, VW_PIXEL_RGBA, VW_CHANNEL_FLOAT32, false, false );
+}
@@ -0,0 +1,109 @@
+// __BEGIN_LICENSE__
+//  Copyright (c) 2006-2013, United States Government as represented by the
+//  Administrator of the National Aeronautics and Space Administration. All
+//  rights reserved.
+//
+//  The NASA Vision Workbench is licensed under the Apache License,
+//  Version 2.0 (the "License"); you may not use this file except in
+//  compliance with the License. You may obtain a copy of the License at
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+// __END_LICENSE__
+
+#include <test/Helpers.h>
+#include <vw/Image/BlockProcessor.h>
+#include <vw/Image/ImageView.h>
+
+using namespace vw;
+
+namespace {
+  // Counts how many times each pixel is visited.
+  struct CountFunc {
+    ImageView<int32>& m_count;
+    CountFunc( ImageView<int32>& count ) : m_count(count) {}
+    void operator()( BBox2i const& bbox ) const {
+      for (int32 y = bbox.min().y(); y < bbox.max().y(); ++y)
+        for (int32 x = bbox.min().x(); x < bbox.max().x(); ++x)
+          m_count(x,y)++;
+    }
+  };
+
+  // Fails on the block that contains the given pixel.
+  struct FailFunc {
+    Vector2i m_bad;
+    FailFunc( Vector2i const& bad ) : m_bad(bad) {}
+    void operator()( BBox2i const& bbox ) const {
+      if (bbox.contains(m_bad))
+        vw_throw(ArgumentErr() << "bad block");
+    }
+  };
+}
+
+TEST(BlockProcessor, ZOrder) {
+  std::vector<Vector2i> blocks = block_traversal(4, 4, ZOrderTraversal);
+  ASSERT_EQ(16u, blocks.size());
+  EXPECT_VECTOR_EQ(Vector2i(0,0), blocks[0]);
+  EXPECT_VECTOR_EQ(Vector2i(1,0), blocks[1]);
+  EXPECT_VECTOR_EQ(Vector2i(0,1), blocks[2]);
+  EXPECT_VECTOR_EQ(Vector2i(1,1), blocks[3]);
+  EXPECT_VECTOR_EQ(Vector2i(2,0), blocks[4]);
+  EXPECT_VECTOR_EQ(Vector2i(3,3), blocks[15]);
+}
+
+TEST(BlockProcessor, Hilbert) {
+  // On a square power-of-two grid each step moves to a neighbour.
+  std::vector<Vector2i> blocks = block_traversal(8, 8, HilbertTraversal);
+  ASSERT_EQ(64u, blocks.size());
+  EXPECT_VECTOR_EQ(Vector2i(0,0), blocks[0]);
+  for (size_t i = 1; i < blocks.size(); ++i) {
+    Vector2i step = blocks[i] - blocks[i-1];
+    EXPECT_EQ(1, abs(step.x()) + abs(step.y()));
+  }
+
+  // Ragged grids still cover every block exactly once.
+  blocks = block_traversal(5, 3, HilbertTraversal);
+  ImageView<int32> seen(5,3);
+  for (size_t i = 0; i < blocks.size(); ++i)
+    seen(blocks[i].x(), blocks[i].y())++;
+  for (int32 y = 0; y < 3; ++y)
+    for (int32 x = 0; x < 5; ++x)
+      EXPECT_EQ(1, seen(x,y));
+}
+
+TEST(BlockProcessor, EmptyGrid) {
+  EXPECT_TRUE(block_traversal(0, 4, HilbertTraversal).empty());
+  EXPECT_TRUE(block_traversal(4, 0, RowMajorTraversal).empty());
+}
+
+TEST(BlockProcessor, Orders) {
+  BlockTraversal orders[] = { RowMajorTraversal, ZOrderTraversal, HilbertTraversal, StripedTraversal };
+  // An origin that is not a block multiple, with ragged edges.
+  BBox2i region(3,2,30,27);
+  for (int o = 0; o < 4; ++o) {
+    for (uint32 threads = 1; threads <= 4; threads += 3) {
+      // Each block is handed out exactly once, so no two threads
+      // ever write the same pixel.
+      ImageView<int32> count(37,29);
+      BlockProcessor<CountFunc> process(CountFunc(count), Vector2i(8,5), threads, orders[o]);
+      process(region);
+      for (int32 y = 0; y < count.rows(); ++y)
+        for (int32 x = 0; x < count.cols(); ++x)
+          EXPECT_EQ(region.contains(Vector2i(x,y)) ? 1 : 0, count(x,y))
+            << "order " << o << " threads " << threads << " at " << x << "," << y;
+    }
+  }
+}
+
+TEST(BlockProcessor, Failure) {
+  // Whichever thread hits the bad block, the caller gets the error
+  // back with its type intact, after every helper has finished.
+  for (uint32 threads = 1; threads <= 4; threads += 3) {
+    BlockProcessor<FailFunc> process(FailFunc(Vector2i(17,11)), Vector2i(4,4), threads);
+    EXPECT_THROW(process(BBox2i(0,0,32,32)), ArgumentErr);
+  }
+}
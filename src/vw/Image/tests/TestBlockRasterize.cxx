@@ -44,3 +44,51 @@ TEST(BlockRasterize, Basic) {
   img2 = b4;
   EXPECT_RANGE_EQ(img1.begin(), img1.end(), img2.begin(), img2.end());
 }
+
+TEST(BlockRasterize, Prefetch) {
+  typedef ImageView<uint32> Image;
+  typedef BlockRasterizeView<Image> Block;
+
+  Image img1(8,8), img2;
+  for (int32 y = 0; y < img1.rows(); ++y)
+    for (int32 x = 0; x < img1.cols(); ++x)
+      img1(x,y) = x + 8*y;
+
+  vw::Cache cache(64*1024);
+  Block b = block_cache(img1, Vector2i(4,4), 1, cache);
+  EXPECT_EQ(0u, b.prefetch_requests());
+
+  // An explicit hint brings in every block, so rasterizing only hits.
+  b.set_prefetch(2);
+  b.prefetch(BBox2i(0,0,8,8));
+  b.join_prefetch();
+  EXPECT_EQ(4u, b.prefetch_requests());
+
+  img2 = b;
+  EXPECT_RANGE_EQ(img1.begin(), img1.end(), img2.begin(), img2.end());
+  EXPECT_EQ(4u, b.prefetch_hits());
+  EXPECT_EQ(0u, b.prefetch_misses());
+
+  // Read-ahead: the first block is a miss, and it queues the rest.
+  Block c = block_cache(img1, Vector2i(4,4), 1, cache);
+  c.set_prefetch(3);
+  img2 = c;
+  c.join_prefetch();
+  EXPECT_RANGE_EQ(img1.begin(), img1.end(), img2.begin(), img2.end());
+  EXPECT_EQ(3u, c.prefetch_requests());
+  EXPECT_EQ(4u, c.prefetch_hits() + c.prefetch_misses());
+  EXPECT_GE(c.prefetch_misses(), 1u);
+
+  // Read-ahead follows the traversal: the Hilbert order over 2x2 blocks
+  // is (0,0) (0,1) (1,1) (1,0), so each block queues the next one and
+  // only the first is a miss.
+  Block d = block_cache(img1, Vector2i(4,4), 1, cache);
+  d.set_traversal(HilbertTraversal);
+  d.set_prefetch(1);
+  img2 = d;
+  d.join_prefetch();
+  EXPECT_RANGE_EQ(img1.begin(), img1.end(), img2.begin(), img2.end());
+  EXPECT_EQ(3u, d.prefetch_requests());
+  EXPECT_EQ(3u, d.prefetch_hits());
+  EXPECT_EQ(1u, d.prefetch_misses());
+}
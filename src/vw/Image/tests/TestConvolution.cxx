@@ -219,3 +219,116 @@ TEST( Convolution, Prerasterize ) {
   EXPECT_EQ(right_buf(1000,100), 0.0);
   EXPECT_EQ(right_buf(900,100), 1.0);
 }
+
+// Separable convolution with each kernel applied by correlate_1d_at_point
+// one pixel at a time, as the generic code path does.
+template <class PixelT, class EdgeT>
+static ImageView<PixelT> separable_reference( ImageView<PixelT> const& src, BBox2i const& bbox,
+                                              std::vector<float> const& ki, std::vector<float> const& kj,
+                                              EdgeT const& edge ) {
+  typedef typename CompoundChannelType<PixelT>::type channel_type;
+  int32 ci = int32((ki.size()-1)/2), cj = int32((kj.size()-1)/2);
+  BBox2i child = bbox;
+  child.min() -= Vector2i( int32(ki.size())-ci-1, int32(kj.size())-cj-1 );
+  child.max() += Vector2i( ci, cj );
+  ImageView<PixelT> buf = edge_extend( src, child, edge );
+  ImageView<PixelT> work( bbox.width(), buf.rows() ), result( bbox.width(), bbox.height() );
+  for( int32 y=0; y<work.rows(); ++y )
+    for( int32 x=0; x<work.cols(); ++x )
+      work(x,y) = channel_cast_clamp_if_int<channel_type>( correlate_1d_at_point( buf.origin().advance(x,y), ki.rbegin(), ki.size() ) );
+  for( int32 y=0; y<result.rows(); ++y )
+    for( int32 x=0; x<result.cols(); ++x )
+      result(x,y) = channel_cast_clamp_if_int<channel_type>( correlate_1d_at_point( transpose(work).origin().advance(y,x), kj.rbegin(), kj.size() ) );
+  return result;
+}
+
+template <class PixelT>
+static void check_separable_fast_path( double scale ) {
+  ImageView<PixelT> src( 67, 41 );
+  for( int32 y=0; y<src.rows(); ++y )
+    for( int32 x=0; x<src.cols(); ++x )
+      for( int32 c=0; c<int32(CompoundNumChannels<PixelT>::value); ++c )
+        compound_select_channel<typename CompoundChannelType<PixelT>::type&>( src(x,y), c ) =
+          typename CompoundChannelType<PixelT>::type( scale * (((x*31 + y*17 + c*7) % 97) / 96.0) );
+  // Kernels with negative taps so that integer results get clamped.
+  std::vector<float> ki, kj;
+  ki.push_back(-0.25f); ki.push_back(0.5f); ki.push_back(1.0f); ki.push_back(0.5f); ki.push_back(-0.25f);
+  kj.push_back(0.3f); kj.push_back(0.4f); kj.push_back(0.3f); kj.push_back(0.1f);
+
+  BBox2i boxes[] = { BBox2i(0,0,67,41), BBox2i(3,5,21,13), BBox2i(-4,-3,9,7), BBox2i(60,35,12,9) };
+  for( int b=0; b<4; ++b ) {
+    ImageView<PixelT> result = crop( separable_convolution_filter( src, ki, kj, ConstantEdgeExtension() ), boxes[b] );
+    ImageView<PixelT> expected = separable_reference( src, boxes[b], ki, kj, ConstantEdgeExtension() );
+    EXPECT_SEQ_EQ( expected, result );
+    result = crop( separable_convolution_filter( src, ki, kj, ZeroEdgeExtension() ), boxes[b] );
+    expected = separable_reference( src, boxes[b], ki, kj, ZeroEdgeExtension() );
+    EXPECT_SEQ_EQ( expected, result );
+    result = crop( separable_convolution_filter( src, ki, kj, ReflectEdgeExtension() ), boxes[b] );
+    expected = separable_reference( src, boxes[b], ki, kj, ReflectEdgeExtension() );
+    EXPECT_SEQ_EQ( expected, result );
+  }
+
+  // One-dimensional kernels.
+  std::vector<float> empty;
+  ImageView<PixelT> result = separable_convolution_filter( src, ki, empty, ConstantEdgeExtension() );
+  std::vector<float> unit( 1, 1.0f );
+  ImageView<PixelT> expected = separable_reference( src, bounding_box(src), ki, unit, ConstantEdgeExtension() );
+  EXPECT_SEQ_EQ( expected, result );
+  result = separable_convolution_filter( src, empty, kj, ConstantEdgeExtension() );
+  expected = separable_reference( src, bounding_box(src), unit, kj, ConstantEdgeExtension() );
+  EXPECT_SEQ_EQ( expected, result );
+}
+
+TEST( Convolution, SeparableFastPath ) {
+  ASSERT_TRUE(( convolution::HasFastPath<float,float>::value ));
+  ASSERT_TRUE(( convolution::HasFastPath<PixelRGB<uint8>,float>::value ));
+  ASSERT_FALSE(( convolution::HasFastPath<float,double>::value ));
+  ASSERT_FALSE(( convolution::HasFastPath<PixelMask<float>,float>::value ));
+  ASSERT_FALSE(( convolution::HasFastPath<int32,float>::value ));
+
+  check_separable_fast_path<float>( 1.0 );
+  check_separable_fast_path<uint8>( 255.0 );
+  check_separable_fast_path<uint16>( 65535.0 );
+  check_separable_fast_path<PixelRGB<uint8> >( 255.0 );
+  check_separable_fast_path<PixelRGBA<float> >( 1.0 );
+}
+
+TEST( Convolution, SeparableFastPathCastsToDest ) {
+  // Dyadic source values and taps keep every sum exact, so the float
+  // kernel (fast path) and the double kernel (generic path) must agree
+  // once both are cast down to uint8.
+  ImageView<float> src( 45, 23 );
+  for( int32 y=0; y<src.rows(); ++y )
+    for( int32 x=0; x<src.cols(); ++x )
+      src(x,y) = float( 2*((x*37 + y*11) % 211) - 80 ) + 0.75f;
+  std::vector<float> ki, kj;
+  ki.push_back(-0.25f); ki.push_back(0.5f); ki.push_back(1.0f); ki.push_back(0.5f); ki.push_back(-0.25f);
+  kj.push_back(0.25f); kj.push_back(0.5f); kj.push_back(0.25f);
+  std::vector<double> ki_d( ki.begin(), ki.end() ), kj_d( kj.begin(), kj.end() );
+  std::vector<float> empty;
+  std::vector<double> empty_d;
+
+  ImageView<uint8> fast, generic;
+  fast = separable_convolution_filter( src, ki, kj, ConstantEdgeExtension() );
+  generic = separable_convolution_filter( src, ki_d, kj_d, ConstantEdgeExtension() );
+  EXPECT_SEQ_EQ( generic, fast );
+
+  // Some values were clamped at each end.
+  ImageView<float> unclamped = separable_convolution_filter( src, ki, kj, ConstantEdgeExtension() );
+  bool low = false, high = false;
+  for( int32 y=0; y<src.rows(); ++y )
+    for( int32 x=0; x<src.cols(); ++x ) {
+      EXPECT_EQ( channel_cast_clamp_if_int<uint8>( unclamped(x,y) ), fast(x,y) );
+      low |= unclamped(x,y) < 0; high |= unclamped(x,y) > 255;
+    }
+  EXPECT_TRUE( low );
+  EXPECT_TRUE( high );
+
+  // One-dimensional kernels.
+  fast = separable_convolution_filter( src, ki, empty, ConstantEdgeExtension() );
+  generic = separable_convolution_filter( src, ki_d, empty_d, ConstantEdgeExtension() );
+  EXPECT_SEQ_EQ( generic, fast );
+  fast = separable_convolution_filter( src, empty, kj, ConstantEdgeExtension() );
+  generic = separable_convolution_filter( src, empty_d, kj_d, ConstantEdgeExtension() );
+  EXPECT_SEQ_EQ( generic, fast );
+}
@@ -129,6 +129,126 @@ TEST( Filter, Gaussian ) {
   EXPECT_NEAR( dst(1,1), 0.3877403988*4+0.2447702197*3, 1e-7 );
 }
 
+// A smooth pattern with some structure at every scale up to 64 pixels.
+static ImageView<float> test_pattern( int32 cols, int32 rows ) {
+  ImageView<float> src( cols, rows );
+  for( int32 y=0; y<rows; ++y )
+    for( int32 x=0; x<cols; ++x )
+      src(x,y) = float( 100 + 40*sin(x/7.0)*cos(y/11.0) + 20*sin((x+2*y)/29.0) + ((x*13+y*7)%5) );
+  return src;
+}
+
+TEST( Filter, RecursiveGaussian ) {
+  ImageView<float> src = test_pattern( 120, 90 );
+  const double sigmas[] = { 0.7, 2.0, 5.0, 12.0 };
+  for( int i=0; i<4; ++i ) {
+    ImageView<float> expected = gaussian_filter( src, sigmas[i], ConstantEdgeExtension() );
+    ImageView<float> recursive = gaussian_filter( src, sigmas[i], RecursiveGaussian, ConstantEdgeExtension() );
+    ImageView<float> box = gaussian_filter( src, sigmas[i], BoxGaussian, ConstantEdgeExtension() );
+    double max_recursive = 0, max_box = 0;
+    for( int32 y=0; y<src.rows(); ++y )
+      for( int32 x=0; x<src.cols(); ++x ) {
+        max_recursive = std::max( max_recursive, fabs( double(recursive(x,y)) - expected(x,y) ) );
+        max_box = std::max( max_box, fabs( double(box(x,y)) - expected(x,y) ) );
+      }
+    // The pattern spans about 130 levels; neither method matches
+    // the frequency response of the true Gaussian exactly.
+    EXPECT_LT( max_recursive, 2.5 ) << "sigma " << sigmas[i];
+    EXPECT_LT( max_box, 2.5 ) << "sigma " << sigmas[i];
+  }
+
+  // A constant image stays constant.
+  ImageView<uint8> flat( 40, 30 );
+  fill( flat, 77 );
+  ImageView<uint8> flat_result = gaussian_filter( flat, 6.0, RecursiveGaussian );
+  for( int32 y=0; y<flat.rows(); ++y )
+    for( int32 x=0; x<flat.cols(); ++x )
+      EXPECT_NEAR( flat_result(x,y), 77, 1 );
+
+  // Below the threshold the automatic method matches the kernel.
+  ImageView<float> kernel = gaussian_filter( src, 1.5, KernelGaussian );
+  ImageView<float> automatic = gaussian_filter( src, 1.5, AutoGaussian );
+  EXPECT_EQ( LineFilter::gaussian( 1.5, AutoGaussian ).type(), LineFilter::Kernel );
+  EXPECT_EQ( LineFilter::gaussian( 20.0, AutoGaussian ).type(), LineFilter::Recursive );
+  EXPECT_EQ( LineFilter::gaussian( 0.0, RecursiveGaussian ).type(), LineFilter::Identity );
+  for( int32 y=0; y<src.rows(); ++y )
+    for( int32 x=0; x<src.cols(); ++x )
+      EXPECT_NEAR( automatic(x,y), kernel(x,y), 1e-3 );
+}
+
+// Rasterizing in tiles must give the same answer as rasterizing the
+// whole image at once, up to the truncation of the filter at the halo.
+TEST( Filter, RecursiveGaussianTiles ) {
+  ImageView<PixelRGB<float> > src( 150, 110 );
+  ImageView<float> pattern = test_pattern( 150, 110 );
+  for( int32 y=0; y<src.rows(); ++y )
+    for( int32 x=0; x<src.cols(); ++x )
+      src(x,y) = PixelRGB<float>( pattern(x,y), 200-pattern(x,y), pattern(y%110,x%110) );
+  const GaussianMethod methods[] = { RecursiveGaussian, BoxGaussian };
+  for( int m=0; m<2; ++m ) {
+    RecursiveFilterView<ImageView<PixelRGB<float> >, ReflectEdgeExtension> view =
+      gaussian_filter( src, 8.0, 3.0, methods[m], ReflectEdgeExtension() );
+    ImageView<PixelRGB<float> > whole = view;
+    for( int32 y0=0; y0<src.rows(); y0+=32 )
+      for( int32 x0=0; x0<src.cols(); x0+=40 ) {
+        BBox2i tile( x0, y0, 40, 32 );
+        tile.crop( bounding_box(src) );
+        ImageView<PixelRGB<float> > part( tile.width(), tile.height() );
+        view.rasterize( part, tile );
+        for( int32 y=0; y<tile.height(); ++y )
+          for( int32 x=0; x<tile.width(); ++x )
+            for( int32 c=0; c<3; ++c )
+              EXPECT_NEAR( part(x,y)[c], whole(x+x0,y+y0)[c], 0.05 );
+      }
+    EXPECT_NEAR( view(17,23)[1], whole(17,23)[1], 0.05 );
+  }
+}
+
+// Invalid pixels are left out and stay invalid; their values do not
+// leak into their neighbors.
+TEST( Filter, RecursiveGaussianMasked ) {
+  ImageView<PixelMask<float> > src( 60, 50 );
+  for( int32 y=0; y<src.rows(); ++y )
+    for( int32 x=0; x<src.cols(); ++x )
+      src(x,y) = PixelMask<float>( 10 );
+  for( int32 y=20; y<25; ++y )
+    for( int32 x=30; x<36; ++x ) {
+      src(x,y) = PixelMask<float>( -1e6 );
+      src(x,y).invalidate();
+    }
+  ImageView<PixelMask<float> > dst = gaussian_filter( src, 7.0, RecursiveGaussian );
+  for( int32 y=0; y<src.rows(); ++y )
+    for( int32 x=0; x<src.cols(); ++x ) {
+      ASSERT_EQ( is_valid( src(x,y) ), is_valid( dst(x,y) ) );
+      if( is_valid( dst(x,y) ) ) {
+        EXPECT_NEAR( dst(x,y).child(), 10, 1e-3 );
+      }
+    }
+}
+
+TEST( Filter, Box ) {
+  ImageView<float> src = test_pattern( 31, 23 );
+  ImageView<float> dst = box_filter( src, 5, 3 );
+  EXPECT_TRUE( has_pixel_type<float>( box_filter( src, 5, 3 ) ) );
+  for( int32 y=0; y<src.rows(); ++y )
+    for( int32 x=0; x<src.cols(); ++x ) {
+      double sum = 0;
+      for( int32 j=-1; j<=1; ++j )
+        for( int32 i=-2; i<=2; ++i )
+          sum += src( std::min( std::max( x+i, 0 ), src.cols()-1 ), std::min( std::max( y+j, 0 ), src.rows()-1 ) );
+      EXPECT_NEAR( dst(x,y), sum/15, 1e-3 );
+    }
+
+  // Repeated passes are the same as repeated filtering.
+  ImageView<float> once = box_filter( src, 3, 5, 1, ZeroEdgeExtension() );
+  ImageView<float> twice = box_filter( src, 3, 5, 2, ZeroEdgeExtension() );
+  ImageView<float> twice_expected = box_filter( box_filter( src, 3, 5, 1, ZeroEdgeExtension() ), 3, 5, 1, ZeroEdgeExtension() );
+  for( int32 y=2*2; y<src.rows()-2*2; ++y )
+    for( int32 x=2*1; x<src.cols()-2*1; ++x )
+      EXPECT_NEAR( twice(x,y), twice_expected(x,y), 1e-3 );
+  EXPECT_NE( once(5,5), twice(5,5) );
+}
+
 TEST( Filter, Laplacian ) {
   ImageView<double> src(2,2); src(0,0)=1; src(1,0)=2; src(0,1)=3; src(1,1)=4;
   ImageView<double> dst = laplacian_filter( src, ZeroEdgeExtension() );
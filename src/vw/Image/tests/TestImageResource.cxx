@@ -29,6 +29,8 @@
 # include <opencv/cxcore.h>
 #endif
 
+#include <limits>
+
 #include <boost/iostreams/device/array.hpp>
 #include <boost/iostreams/device/back_inserter.hpp>
 #include <boost/iostreams/stream.hpp>
@@ -74,6 +76,82 @@ TEST( ImageResource, PreMultiply ) {
   EXPECT_RANGE_EQ(buf3_data+0, buf3_data+4, buf1_data+0, buf1_data+4);
 }
 
+namespace {
+  struct RowKernelCase {
+    PixelFormatEnum src_pf;
+    ChannelTypeEnum src_ct;
+    PixelFormatEnum dst_pf;
+    ChannelTypeEnum dst_ct;
+    bool rescale, src_premultiplied;
+  };
+
+  // Converts the same data with the row kernels on and off, and checks
+  // that the results are bit-for-bit identical.
+  void check_row_kernel( RowKernelCase const& c ) {
+    ImageFormat sfmt, dfmt;
+    sfmt.cols = dfmt.cols = 256;
+    sfmt.rows = dfmt.rows = 257;
+    sfmt.planes = dfmt.planes = 1;
+    sfmt.pixel_format = c.src_pf;
+    sfmt.channel_type = c.src_ct;
+    sfmt.premultiplied = c.src_premultiplied;
+    dfmt.pixel_format = c.dst_pf;
+    dfmt.channel_type = c.dst_ct;
+
+    size_t src_values = sfmt.cols * sfmt.rows * num_channels(sfmt.pixel_format);
+    size_t dst_bytes = dfmt.cols * dfmt.rows * num_channels(dfmt.pixel_format) * channel_size(dfmt.channel_type);
+    std::vector<uint8> src( src_values * channel_size(sfmt.channel_type) );
+    std::vector<uint8> fast( dst_bytes ), slow( dst_bytes );
+
+    // Every 8-bit channel/alpha pair appears in the first 256 rows.
+    for (size_t i = 0; i < src_values; ++i) {
+      switch (sfmt.channel_type) {
+        case VW_CHANNEL_UINT8:   src[i] = uint8( i % 4 == 3 ? i / 1024 : i / 4 + i % 4 ); break;
+        case VW_CHANNEL_UINT16:  reinterpret_cast<uint16*>(&src[0])[i] = uint16( i * 2654435761u >> 7 ); break;
+        case VW_CHANNEL_FLOAT32: reinterpret_cast<float*>(&src[0])[i] = i % 97 == 5 ? std::numeric_limits<float>::quiet_NaN()
+                                                                                     : float( i % 1409 ) / 1000.0f - 0.2f; break;
+        default: FAIL() << "Unsupported test channel type";
+      }
+    }
+
+    // Odd column counts exercise the scalar tails of the kernels.
+    for (uint32 cols = sfmt.cols; cols >= sfmt.cols - 1; --cols) {
+      ImageBuffer sbuf( sfmt, &src[0] ), fbuf( dfmt, &fast[0] ), lbuf( dfmt, &slow[0] );
+      sbuf.format.cols = fbuf.format.cols = lbuf.format.cols = cols;
+      set_convert_simd(true);
+      convert( fbuf, sbuf, c.rescale );
+      set_convert_simd(false);
+      convert( lbuf, sbuf, c.rescale );
+      set_convert_simd(true);
+      EXPECT_TRUE( fast == slow )
+        << pixel_format_name(c.src_pf) << "/" << channel_type_name(c.src_ct) << " -> "
+        << pixel_format_name(c.dst_pf) << "/" << channel_type_name(c.dst_ct)
+        << " rescale " << c.rescale << " cols " << cols;
+    }
+  }
+}
+
+TEST( ImageResource, RowKernels ) {
+  const RowKernelCase cases[] = {
+    { VW_PIXEL_RGB,  VW_CHANNEL_UINT8,   VW_PIXEL_RGB,  VW_CHANNEL_FLOAT32, true,  true  },
+    { VW_PIXEL_RGB,  VW_CHANNEL_UINT8,   VW_PIXEL_RGB,  VW_CHANNEL_FLOAT32, false, true  },
+    { VW_PIXEL_GRAY, VW_CHANNEL_UINT16,  VW_PIXEL_GRAY, VW_CHANNEL_FLOAT32, true,  true  },
+    { VW_PIXEL_GRAY, VW_CHANNEL_UINT16,  VW_PIXEL_GRAY, VW_CHANNEL_FLOAT32, false, true  },
+    { VW_PIXEL_RGBA, VW_CHANNEL_FLOAT32, VW_PIXEL_RGBA, VW_CHANNEL_UINT8,   true,  true  },
+    { VW_PIXEL_GRAY, VW_CHANNEL_FLOAT32, VW_PIXEL_GRAY, VW_CHANNEL_UINT16,  true,  true  },
+    { VW_PIXEL_RGB,  VW_CHANNEL_UINT8,   VW_PIXEL_RGB,  VW_CHANNEL_UINT16,  true,  true  },
+    { VW_PIXEL_RGB,  VW_CHANNEL_UINT16,  VW_PIXEL_RGB,  VW_CHANNEL_UINT8,   true,  true  },
+    { VW_PIXEL_RGB,  VW_CHANNEL_UINT8,   VW_PIXEL_RGBA, VW_CHANNEL_UINT8,   false, true  },
+    { VW_PIXEL_RGB,  VW_CHANNEL_FLOAT32, VW_PIXEL_RGBA, VW_CHANNEL_FLOAT32, false, true  },
+    { VW_PIXEL_RGB,  VW_CHANNEL_UINT8,   VW_PIXEL_GRAY, VW_CHANNEL_UINT8,   false, true  },
+    { VW_PIXEL_RGB,  VW_CHANNEL_FLOAT32, VW_PIXEL_GRAY, VW_CHANNEL_FLOAT32, false, true  },
+    { VW_PIXEL_RGBA, VW_CHANNEL_UINT8,   VW_PIXEL_RGBA, VW_CHANNEL_UINT8,   false, false },
+    { VW_PIXEL_RGBA, VW_CHANNEL_FLOAT32, VW_PIXEL_RGBA, VW_CHANNEL_FLOAT32, false, false }
+  };
+  for (size_t i = 0; i < sizeof(cases)/sizeof(cases[0]); ++i)
+    check_row_kernel( cases[i] );
+}
+
 class SrcNoopResource : public SrcImageResource {
   private:
     const ImageFormat& m_fmt;
@@ -25,6 +25,7 @@
 
 // Data Types
 #include <vw/InterestPoint/InterestData.h>
+#include <vw/InterestPoint/InterestPointSet.h>
 #include <vw/InterestPoint/InterestTraits.h>
 #include <vw/InterestPoint/ImageOctave.h>
 #include <vw/InterestPoint/ImageOctaveHistory.h>
@@ -29,4 +29,30 @@ namespace ip {
   const uint32 SGradDescriptorGenerator::box_size[5] = {2,4,8,10,14};
   const uint32 SGradDescriptorGenerator::box_half[5] = {1,2,4,5,7};
 
+  namespace {
+    // The BRIEF test points, drawn from an isotropic gaussian with a
+    // sigma of a fifth of the support size. Integer math only, so every
+    // build gets the same pattern.
+    std::vector<int8> make_brief_pattern() {
+      const int32 support = 41;
+      const int32 limit = support / 2 - BriefDescriptorGenerator::BOX_RADIUS - 1;
+
+      std::vector<int8> pattern( BriefDescriptorGenerator::TESTS * 4 );
+      uint32 state = 0x2545F491;
+      for ( size_t i = 0; i < pattern.size(); i++ ) {
+        // The sum of 12 uniforms in [0,1) has mean 6 and sigma 1
+        int32 sum = 0;
+        for ( int j = 0; j < 12; j++ ) {
+          state = state * 1664525u + 1013904223u;
+          sum += int32(state >> 22);   // [0,1024)
+        }
+        int32 coord = ( sum - 6 * 1024 ) * support / ( 5 * 1024 );
+        pattern[i] = int8( std::max( -limit, std::min( limit, coord ) ) );
+      }
+      return pattern;
+    }
+  }
+
+  const std::vector<int8> BriefDescriptorGenerator::test_pattern = make_brief_pattern();
+
 }} // namespace vw::ip
@@ -28,10 +28,13 @@
 #include <vw/Image/Transform.h>
 #include <vw/FileIO/DiskImageResource.h>
 #include <vw/InterestPoint/InterestData.h>
+#include <vw/InterestPoint/InterestPointSet.h>
 #include <vw/InterestPoint/MatrixIO.h>
 #include <vw/InterestPoint/VectorIO.h>
 #include <vw/InterestPoint/IntegralImage.h>
 
+#include <boost/foreach.hpp>
+
 namespace vw {
 namespace ip {
 
@@ -75,6 +78,35 @@ namespace ip {
       }
     }
 
+    // The same, for points held in an InterestPointSet. Descriptors are
+    // written straight into the set's rows.
+    template <class ViewT>
+    void operator() ( ImageViewBase<ViewT> const& image,
+                      InterestPointSet& points ) {
+      points.set_descriptor_size( impl().descriptor_size() );
+      std::vector<size_t> indices( points.size() );
+      for ( size_t i = 0; i < indices.size(); ++i )
+        indices[i] = i;
+      (*this)( image, points, indices.begin(), indices.end() );
+    }
+
+    // Describe only the points at the indices in [first, last). The set
+    // must already have the right descriptor size.
+    template <class ViewT, class IndexIterT>
+    void operator() ( ImageViewBase<ViewT> const& image, InterestPointSet& points,
+                      IndexIterT first, IndexIterT last ) {
+      Timer total("\tTotal elapsed time", DebugMessage, "interest_point");
+      VW_ASSERT( points.descriptor_size() == size_t(impl().descriptor_size()),
+                 ArgumentErr() << "InterestPointSet has the wrong descriptor size for this generator." );
+
+      for ( ; first != last; ++first ) {
+        ImageView<PixelGray<float> > support =
+          get_support(points.keypoint(*first), pixel_cast<PixelGray<float> >(channel_cast_rescale<float>(image.impl())));
+        float* row = points.descriptor(*first);
+        impl().compute_descriptor( support, row, row + points.descriptor_size() );
+      }
+    }
+
     // Default suport size ( i.e. descriptor window)
     int support_size() { return 41; }
     // Default descriptor(vector) length
@@ -102,6 +134,21 @@ namespace ip {
 
   };
 
+  /// The region of the image read by the support_size x support_size
+  /// descriptor window of a point at (x,y) with the given scale and
+  /// orientation (see DescriptorGeneratorBase::get_support()).
+  inline BBox2i descriptor_support_bbox( float x, float y, float scale, float orientation, int support_size ) {
+    const float half_size = ((float)( support_size - 1)) / 2.0f;
+    float scaling = 1.0f / scale;
+    double c=cos(-orientation), s=sin(-orientation);
+
+    AffineTransform tx( Matrix2x2(scaling*c, -scaling*s,
+                                  scaling*s, scaling*c),
+                        Vector2(scaling*(s * y - c * x) + half_size,
+                                -scaling*(s * x + c * y) + half_size) );
+    return tx.reverse_bbox( BBox2i( 0, 0, support_size, support_size ) );
+  }
+
   template <class ViewT, class DescriptorT>
   class InterestPointDescriptionTask : public Task, private boost::noncopyable {
     ViewT m_view;
@@ -121,20 +168,10 @@ namespace ip {
 
     void operator()() {
       BBox2i image_crop_bounds;
-      const float half_size = ((float)( m_descriptor.support_size() - 1)) / 2.0f;
-      BBox2i support_size( 0, 0, m_descriptor.support_size(),
-                           m_descriptor.support_size() );
       for ( typename InterestPointList::iterator it = m_start;
-            it != m_stop; it++ ) {
-        float scaling = 1.0f / it->scale;
-        double c=cos(-it->orientation), s=sin(-it->orientation);
-
-        AffineTransform tx( Matrix2x2(scaling*c, -scaling*s,
-                                      scaling*s, scaling*c),
-                            Vector2(scaling*(s * it->y - c * it->x) + half_size,
-                                    -scaling*(s * it->x + c * it->y) + half_size) );
-        image_crop_bounds.grow( tx.reverse_bbox( support_size ) );
-      }
+            it != m_stop; it++ )
+        image_crop_bounds.grow( descriptor_support_bbox( it->x, it->y, it->scale, it->orientation,
+                                                         m_descriptor.support_size() ) );
       image_crop_bounds.expand( 1 );
       vw_out(InfoMessage, "interest_point") << "Describing interest points in block "
                                             << m_id + 1 << "/" << m_max_id << "   [ "
@@ -215,6 +252,91 @@ namespace ip {
     }
   };
 
+  // The InterestPointSet version of InterestPointDescriptionTask. The
+  // points in a block are picked out by index instead of by reordering
+  // the set.
+  template <class ViewT, class DescriptorT>
+  class InterestPointSetDescriptionTask : public Task, private boost::noncopyable {
+    ViewT m_view;
+    DescriptorT& m_descriptor;
+    InterestPointSet& m_points;
+    std::vector<size_t> m_indices;
+    int m_id, m_max_id;
+
+  public:
+    InterestPointSetDescriptionTask( ImageViewBase<ViewT> const& view, DescriptorT& descriptor,
+                                     InterestPointSet& points, std::vector<size_t> const& indices,
+                                     int id, int max_id ) :
+      m_view( view.impl() ), m_descriptor( descriptor ), m_points( points ),
+      m_indices( indices ), m_id( id ), m_max_id( max_id ) {}
+
+    virtual ~InterestPointSetDescriptionTask(){}
+
+    void operator()() {
+      BBox2i image_crop_bounds;
+      BOOST_FOREACH( size_t i, m_indices )
+        image_crop_bounds.grow( descriptor_support_bbox( m_points.x(i), m_points.y(i), m_points.scale(i),
+                                                         m_points.orientation(i), m_descriptor.support_size() ) );
+      image_crop_bounds.expand( 1 );
+      vw_out(InfoMessage, "interest_point") << "Describing interest points in block "
+                                            << m_id + 1 << "/" << m_max_id << "   [ "
+                                            << image_crop_bounds << " ]\n";
+
+      // Reindex the points to use image_crop_bounds
+      BOOST_FOREACH( size_t i, m_indices ) {
+        m_points.x(i) -= image_crop_bounds.min().x();
+        m_points.y(i) -= image_crop_bounds.min().y();
+      }
+
+      ImageView<PixelGray<float> > image =
+        crop( edge_extend(m_view.impl(), ZeroEdgeExtension()), image_crop_bounds );
+      m_descriptor( image, m_points, m_indices.begin(), m_indices.end() );
+
+      // And back to the global origin
+      BOOST_FOREACH( size_t i, m_indices ) {
+        m_points.x(i) += image_crop_bounds.min().x();
+        m_points.y(i) += image_crop_bounds.min().y();
+      }
+    }
+  };
+
+  template <class ViewT, class DescriptorT>
+  class InterestSetDescriptionQueue : public WorkQueue {
+    ViewT m_view;
+    DescriptorT& m_descriptor;
+    InterestPointSet& m_points;
+    std::vector<std::vector<size_t> > m_sections;
+    Mutex m_mutex;
+    size_t m_index;
+
+    typedef InterestPointSetDescriptionTask<ViewT, DescriptorT> task_type;
+
+  public:
+
+    InterestSetDescriptionQueue( ImageViewBase<ViewT> const& view, DescriptorT& descriptor,
+                                 InterestPointSet& points,
+                                 std::vector<std::vector<size_t> > const& sections ) :
+      m_view(view.impl()), m_descriptor(descriptor), m_points(points),
+      m_sections(sections), m_index(0) {
+      this->notify();
+    }
+
+    size_t size() {
+      return m_sections.size();
+    }
+
+    virtual boost::shared_ptr<Task> get_next_task() {
+      Mutex::Lock lock(m_mutex);
+      if ( m_index == m_sections.size() )
+        return boost::shared_ptr<Task>();
+
+      m_index++;
+      return boost::shared_ptr<Task> ( new task_type( m_view, m_descriptor, m_points,
+                                                      m_sections[m_index-1],
+                                                      m_index-1, m_sections.size() ) );
+    }
+  };
+
   /// This function implements multithreaded interest point
   /// description. Threads are spun off to process the image in 1024 x
   /// 1024 pixel block plus some padding.
@@ -250,6 +372,45 @@ namespace ip {
     return;
   }
 
+  /// The same, for an InterestPointSet. The set keeps its order; each
+  /// block describes the points that fall in it.
+  template <class ViewT, class DescriptorT>
+  void describe_interest_points( ImageViewBase<ViewT> const& view, DescriptorT& descriptor,
+                                 InterestPointSet& points ) {
+    VW_OUT(DebugMessage, "interest_point")
+      << "Running MT interest point descriptor.  Input image: [ "
+      << view.impl().cols() << " x " << view.impl().rows() << " ]\n";
+
+    points.set_descriptor_size( descriptor.descriptor_size() );
+
+    // Process the image in 1024x1024 pixel blocks.
+    int tile_size = vw_settings().default_tile_size();
+    if (tile_size < 1024) tile_size = 1024;
+    std::vector<BBox2i> bboxes = image_blocks(view.impl(), tile_size, tile_size);
+
+    // Blocks tile the image, so a point belongs to the block its pixel
+    // falls in. Points off the image belong to no block, as above.
+    const int blocks_x = (view.impl().cols() + tile_size - 1) / tile_size;
+    std::vector<std::vector<size_t> > sections( bboxes.size() );
+    for ( size_t i = 0; i < points.size(); ++i ) {
+      Vector2i px( points.x(i), points.y(i) );
+      if ( px.x() < 0 || px.y() < 0 || px.x() >= view.impl().cols() || px.y() >= view.impl().rows() )
+        continue;
+      sections[ (px.y() / tile_size) * blocks_x + px.x() / tile_size ].push_back( i );
+    }
+    std::vector<std::vector<size_t> > nonempty;
+    BOOST_FOREACH( std::vector<size_t> const& section, sections )
+      if ( !section.empty() )
+        nonempty.push_back( section );
+
+    InterestSetDescriptionQueue<ViewT, DescriptorT> descriptor_que(view, descriptor, points, nonempty);
+
+    VW_OUT(DebugMessage, "interest_point") << "Waiting for threads to terminate.\n";
+    descriptor_que.join_all();
+
+    VW_OUT(DebugMessage, "interest_point") << "MT interest point description complete.\n";
+  }
+
   /// A basic example descriptor class. The descriptor for an interest
   /// point is simply the pixel values in the support region around
   /// the point. It is normalized to provide some tolerance to changes
@@ -346,7 +507,7 @@ namespace ip {
                             IterT first, IterT last) const {
 
       typedef typename PixelChannelType<typename ViewT::pixel_type>::type channel_type;
-      ImageView<channel_type> iimage = IntegralImage(support);
+      ImageView<channel_type> iimage = IntegralImage(support, 1);
 
       channel_type sqr_length = 0;
 
@@ -411,6 +572,56 @@ namespace ip {
     int descriptor_size() { return 180; }
   };
 
+  /// A BRIEF-style binary descriptor. Each bit compares the 5x5 box
+  /// sums around a pair of points in the support region. The pairs come
+  /// from a fixed pseudo-random pattern. get_support() has already
+  /// scaled and rotated the region, so the tests follow the point.
+  ///
+  /// The bits are packed 16 to a float, stored as whole numbers, so
+  /// they survive anything a float descriptor does (.vwip files,
+  /// copies, InterestPointSet rows). Match them with HammingMetric.
+  struct BriefDescriptorGenerator : public DescriptorGeneratorBase<BriefDescriptorGenerator> {
+
+    static const int TESTS = 256;
+    static const int BITS_PER_WORD = 16;
+    static const int BOX_RADIUS = 2;
+
+    // x0, y0, x1, y1 for each test, relative to the center of the support
+    static const std::vector<int8> test_pattern;
+
+    template <class ViewT, class IterT>
+    void compute_descriptor(ImageViewBase<ViewT> const& support,
+                            IterT first, IterT last) const {
+
+      typedef typename PixelChannelType<typename ViewT::pixel_type>::type channel_type;
+      ImageView<channel_type> iimage = IntegralImage(support, 1);
+      const int32 center = support.impl().cols() / 2;
+
+      const int8* test = &test_pattern[0];
+      IterT fill = first;
+      for ( int word = 0; word < TESTS / BITS_PER_WORD; word++ ) {
+        uint32 bits = 0;
+        for ( int b = 0; b < BITS_PER_WORD; b++, test += 4 ) {
+          if ( box_sum( iimage, center + test[0], center + test[1] ) <
+               box_sum( iimage, center + test[2], center + test[3] ) )
+            bits |= 1u << b;
+        }
+        *fill = float(bits);
+        fill++;
+      }
+      VW_DEBUG_ASSERT( fill == last, LogicErr() << "Allocated Vector size does not appear to match code's expectations." );
+    }
+
+    int descriptor_size() { return TESTS / BITS_PER_WORD; }
+
+    template <class PixelT>
+    static PixelT box_sum( ImageView<PixelT> const& iimage, int32 x, int32 y ) {
+      return IntegralBlock( iimage,
+                            Vector2i( x - BOX_RADIUS, y - BOX_RADIUS ),
+                            Vector2i( x + BOX_RADIUS + 1, y + BOX_RADIUS + 1 ) );
+    }
+  };
+
 }} // namespace vw::ip
 
 
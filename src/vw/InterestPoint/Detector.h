@@ -31,12 +31,15 @@
 #include <vw/Image/Filter.h>
 
 #include <vw/InterestPoint/InterestData.h>
+#include <vw/InterestPoint/InterestPointSet.h>
 #include <vw/InterestPoint/Extrema.h>
 #include <vw/InterestPoint/Localize.h>
 #include <vw/InterestPoint/InterestOperator.h>
 #include <vw/InterestPoint/WeightedHistogram.h>
 #include <vw/InterestPoint/ImageOctaveHistory.h>
 
+#include <algorithm>
+
 namespace vw {
 namespace ip {
 
@@ -87,90 +90,227 @@ namespace ip {
       return interest_points;
     }
 
+    /// Find the interest points in one region of an image, in the
+    /// region's coordinates. detect_interest_points() calls this for
+    /// every padded block. Detectors that keep something for the
+    /// whole image (see IntegralInterestPointDetector::set_integral())
+    /// provide their own.
+    template <class ViewT>
+    InterestPointList operator() (vw::ImageViewBase<ViewT> const& image, BBox2i const& region) {
+      return impl()(crop(image.impl(), region), 0);
+    }
+
+    /// The number of pixels of context a tile needs on each side for
+    /// the points found in its interior to match the ones found in the
+    /// whole image. detect_interest_points() pads every tile by this
+    /// much and keeps only the points that fall in the tile itself.
+    /// Detectors with a wider filter support hide this with their own.
+    int32 tile_halo() const { return 0; }
+
   };
 
+  /// Keeps the max_points most interesting of the points pushed into
+  /// it. The least interesting point sits on top of a heap, so a push
+  /// costs O(log max_points) and memory never grows past max_points.
+  /// Ties in interest go to the point that was pushed first, and
+  /// pop_all() hands the survivors back in the order they were pushed,
+  /// so the selection does not depend on how the input was split up.
+  class InterestPointHeap {
+    struct Entry {
+      InterestPoint point;
+      uint64 seq;
+    };
+
+    // Heap order: an entry is "less" than another if it is the better
+    // point, which leaves the worst point at the front.
+    struct Better {
+      bool operator()(Entry const& a, Entry const& b) const {
+        if (a.point.interest != b.point.interest)
+          return a.point.interest > b.point.interest;
+        return a.seq < b.seq;
+      }
+    };
+    struct Pushed {
+      bool operator()(Entry const& a, Entry const& b) const { return a.seq < b.seq; }
+    };
+
+    std::vector<Entry> m_heap;
+    size_t m_max_points;
+    uint64 m_seq;
+
+  public:
+    explicit InterestPointHeap(size_t max_points)
+      : m_max_points(max_points), m_seq(0) {
+      VW_ASSERT(max_points > 0, ArgumentErr() << "InterestPointHeap: max_points must be positive.");
+    }
+
+    size_t size() const { return m_heap.size(); }
+    size_t max_points() const { return m_max_points; }
+
+    void push(InterestPoint const& pt) {
+      Entry e;
+      e.seq = m_seq++;
+      if (m_heap.size() < m_max_points) {
+        e.point = pt;
+        m_heap.push_back(e);
+        std::push_heap(m_heap.begin(), m_heap.end(), Better());
+        return;
+      }
+      // Full: only replace the front if the new point beats it. Later
+      // points lose ties, so equal interest is not enough.
+      if (!(pt.interest > m_heap.front().point.interest))
+        return;
+      std::pop_heap(m_heap.begin(), m_heap.end(), Better());
+      e.point = pt;
+      m_heap.back() = e;
+      std::push_heap(m_heap.begin(), m_heap.end(), Better());
+    }
+
+    /// Move the kept points onto the end of points, in the order they
+    /// were pushed, and empty the heap.
+    void pop_all(InterestPointList& points) {
+      std::sort(m_heap.begin(), m_heap.end(), Pushed());
+      for (size_t i = 0; i < m_heap.size(); ++i)
+        points.push_back(m_heap[i].point);
+      m_heap.clear();
+    }
+  };
+
+  namespace detail {
+    // Hand a tile's points over to the output of detect_interest_points().
+    inline void append_points( InterestPointList& global_points, InterestPointList& points ) {
+      global_points.splice( global_points.end(), points );
+    }
+    inline void append_points( InterestPointSet& global_points, InterestPointList& points ) {
+      global_points.reserve( global_points.size() + points.size() );
+      for (InterestPointList::const_iterator pt = points.begin(); pt != points.end(); ++pt)
+        global_points.push_back( *pt );
+      points.clear();
+    }
+    inline void append_points( InterestPointHeap& global_points, InterestPointList& points ) {
+      for (InterestPointList::const_iterator pt = points.begin(); pt != points.end(); ++pt)
+        global_points.push( *pt );
+      points.clear();
+    }
+  }
+
   // This task class is used to insure that interest points are
   // written to their list in a repeatable order that is not effected
   // by the order in which the detection threads start and finish.
+  template <class OutputT>
   class InterestPointWriteTask : public Task, private boost::noncopyable {
     InterestPointList m_points;
-    InterestPointList& m_global_points;
+    OutputT& m_global_points;
 
   public:
     InterestPointWriteTask( InterestPointList local_points,
-                            InterestPointList& global_points ) :
+                            OutputT& global_points ) :
       m_points(local_points), m_global_points(global_points) {}
 
     virtual ~InterestPointWriteTask(){}
     virtual void operator() () {
-      m_global_points.splice( m_global_points.end(), m_points );
+      detail::append_points( m_global_points, m_points );
     }
   };
 
-  template <class ViewT, class DetectorT>
+  /// Detects the points owned by one tile. The detector runs on the
+  /// tile grown by the detector's tile_halo() (clipped to the image), so
+  /// filters near the tile edge see the same pixels they would in the
+  /// whole image. A point is owned by the tile whose pixels contain
+  /// floor(x), floor(y); since the tiles partition the image, each point
+  /// found in the overlap is kept by exactly one tile. If max_points is
+  /// nonzero only the max_points most interesting owned points are
+  /// passed on, which is all a global top-max_points selection needs.
+  template <class ViewT, class DetectorT, class OutputT = InterestPointList>
   class InterestPointDetectionTask : public Task, private boost::noncopyable {
 
     ViewT m_view;
     DetectorT& m_detector;
     BBox2i m_bbox;
     int m_id, m_max_id;
-    InterestPointList& m_global_points;
+    OutputT& m_global_points;
     OrderedWorkQueue& m_write_queue;
+    int32 m_halo;
+    size_t m_max_points;
+
+    bool owns( InterestPoint const& pt ) const {
+      // Subpixel localization can push a point just outside the image;
+      // it still belongs to the tile on that edge.
+      int32 col = std::min(std::max(int32(floor(pt.x)), int32(0)), int32(m_view.cols() - 1));
+      int32 row = std::min(std::max(int32(floor(pt.y)), int32(0)), int32(m_view.rows() - 1));
+      return m_bbox.contains( Vector2i(col, row) );
+    }
 
   public:
     InterestPointDetectionTask(ImageViewBase<ViewT> const& view, DetectorT& detector, BBox2i const& bbox, int id, int max_id,
-                               InterestPointList& global_list, OrderedWorkQueue& write_queue) :
+                               OutputT& global_list, OrderedWorkQueue& write_queue,
+                               int32 halo = 0, size_t max_points = 0) :
       m_view(view.impl()), m_detector(detector), m_bbox(bbox), m_id(id), m_max_id(max_id),
-      m_global_points(global_list), m_write_queue(write_queue) {}
+      m_global_points(global_list), m_write_queue(write_queue), m_halo(halo), m_max_points(max_points) {}
 
     virtual ~InterestPointDetectionTask(){}
 
     void operator()() {
+      BBox2i region = m_bbox;
+      region.expand( m_halo );
+      region.crop( bounding_box( m_view.impl() ) );
+
       vw_out(InfoMessage, "interest_point") << "Locating interest points in block "
                                             << m_id + 1 << "/" << m_max_id << "   [ " << m_bbox << " ]\n";
-      InterestPointList new_ip_list =
-        m_detector(crop(m_view.impl(), m_bbox),0);
-      for (InterestPointList::iterator pt = new_ip_list.begin(); pt != new_ip_list.end(); ++pt) {
-        (*pt).x +=  m_bbox.min().x();
-        (*pt).ix += m_bbox.min().x();
-        (*pt).y +=  m_bbox.min().y();
-        (*pt).iy += m_bbox.min().y();
+      InterestPointList new_ip_list = m_detector(m_view.impl(), region);
+      InterestPointList::iterator pt = new_ip_list.begin();
+      while (pt != new_ip_list.end()) {
+        (*pt).x +=  region.min().x();
+        (*pt).ix += region.min().x();
+        (*pt).y +=  region.min().y();
+        (*pt).iy += region.min().y();
+        if (owns(*pt))
+          ++pt;
+        else
+          pt = new_ip_list.erase(pt);
+      }
+
+      if (m_max_points > 0 && new_ip_list.size() > m_max_points) {
+        InterestPointHeap best( m_max_points );
+        detail::append_points( best, new_ip_list );
+        best.pop_all( new_ip_list );
       }
 
       // Append these interest points to the master list owned by the
       // detect_interest_points() function.
-      boost::shared_ptr<Task> write_task( new InterestPointWriteTask( new_ip_list, m_global_points ) );
+      boost::shared_ptr<Task> write_task( new InterestPointWriteTask<OutputT>( new_ip_list, m_global_points ) );
       m_write_queue.add_task( write_task, m_id );
 
       vw_out(InfoMessage, "interest_point") << "Finished block " << m_id + 1 << "/" << m_max_id << std::endl;
     }
 
-    InterestPointList interest_point_list() { return m_global_points; }
+    OutputT const& interest_point_list() { return m_global_points; }
   };
 
   // There is a lot of memory allocation created on task generation. I
   // couldn't figure it out in a reasonable time frame. Thus now we
   // generate tasks on demand which should lower the instantaneous
   // memory requirement.
-  template <class ViewT, class DetectorT>
+  template <class ViewT, class DetectorT, class OutputT = InterestPointList>
   class InterestDetectionQueue : public WorkQueue {
     ViewT m_view;
     DetectorT& m_detector;
     OrderedWorkQueue& m_write_queue;
-    InterestPointList& m_ip_list;
+    OutputT& m_ip_list;
     std::vector<BBox2i> m_bboxes;
     Mutex m_mutex;
     size_t m_index;
+    size_t m_max_points;
 
-    typedef InterestPointDetectionTask<ViewT, DetectorT> task_type;
+    typedef InterestPointDetectionTask<ViewT, DetectorT, OutputT> task_type;
 
   public:
 
     InterestDetectionQueue( ImageViewBase<ViewT> const& view, DetectorT& detector,
-                            OrderedWorkQueue& write_queue, InterestPointList& ip_list,
-                            int tile_size ) :
+                            OrderedWorkQueue& write_queue, OutputT& ip_list,
+                            int tile_size, size_t max_points = 0 ) :
       m_view(view.impl()), m_detector(detector), m_write_queue(write_queue), m_ip_list(ip_list),
-      m_index(0) {
+      m_index(0), m_max_points(max_points) {
       m_bboxes = image_blocks( m_view, tile_size, tile_size );
       this->notify();
     }
@@ -186,17 +326,26 @@ namespace ip {
 
       m_index++;
       return boost::shared_ptr<Task>( new task_type( m_view, m_detector, m_bboxes[m_index-1], m_index-1,
-                                                     m_bboxes.size(), m_ip_list, m_write_queue ) );
+                                                     m_bboxes.size(), m_ip_list, m_write_queue,
+                                                     m_detector.tile_halo(), m_max_points ) );
     }
   };
 
   /// This free function implements a multithreaded interest point
   /// detector.  Threads are spun off to process the image in
-  /// 1024x1024 pixel blocks.
-  template <class ViewT, class DetectorT>
-  InterestPointList detect_interest_points (ImageViewBase<ViewT> const& view, DetectorT& detector) {
-    typedef InterestPointDetectionTask<ViewT, DetectorT> task_type;
-
+  /// 1024x1024 pixel blocks, each padded by the detector's tile_halo()
+  /// so that points near block edges are neither lost nor found twice.
+  /// The points are appended to ip_list, which may be an
+  /// InterestPointList or an InterestPointSet, in block order.
+  ///
+  /// If max_points is nonzero only the max_points most interesting
+  /// points in the whole image are kept. Each block keeps at most
+  /// max_points itself and the blocks are merged into a single heap, so
+  /// memory stays bounded by the blocks in flight plus max_points
+  /// however large the image is.
+  template <class ViewT, class DetectorT, class OutputT>
+  void detect_interest_points (ImageViewBase<ViewT> const& view, DetectorT& detector, OutputT& ip_list,
+                               size_t max_points) {
     VW_OUT(DebugMessage, "interest_point") << "Running MT interest point detector.  Input image: [ "
                                            << view.impl().cols() << " x " << view.impl().rows() << " ]\n";
 
@@ -204,18 +353,41 @@ namespace ip {
     int tile_size = vw_settings().default_tile_size();
     if (tile_size < 1024) tile_size = 1024;
 
-    InterestPointList ip_list;
     OrderedWorkQueue write_queue(1); // Used to insure that interest
                                      // points are written in a
                                      // specific order and not by the
                                      // random way threads finish.
-    InterestDetectionQueue<ViewT, DetectorT>
-      detect_queue( view, detector, write_queue, ip_list, tile_size );
-    VW_OUT(DebugMessage, "interest_point") << "Waiting for threads to terminate.\n";
-    detect_queue.join_all();
-    write_queue.join_all();
+    if (max_points == 0) {
+      InterestDetectionQueue<ViewT, DetectorT, OutputT>
+        detect_queue( view, detector, write_queue, ip_list, tile_size );
+      VW_OUT(DebugMessage, "interest_point") << "Waiting for threads to terminate.\n";
+      detect_queue.join_all();
+      write_queue.join_all();
+    } else {
+      InterestPointHeap best( max_points );
+      InterestDetectionQueue<ViewT, DetectorT, InterestPointHeap>
+        detect_queue( view, detector, write_queue, best, tile_size, max_points );
+      VW_OUT(DebugMessage, "interest_point") << "Waiting for threads to terminate.\n";
+      detect_queue.join_all();
+      write_queue.join_all();
+
+      InterestPointList points;
+      best.pop_all( points );
+      detail::append_points( ip_list, points );
+    }
     VW_OUT(DebugMessage, "interest_point") << "MT interest point detection complete.  "
                                            << ip_list.size() << " interest point detected.\n";
+  }
+
+  template <class ViewT, class DetectorT, class OutputT>
+  void detect_interest_points (ImageViewBase<ViewT> const& view, DetectorT& detector, OutputT& ip_list) {
+    detect_interest_points( view, detector, ip_list, 0 );
+  }
+
+  template <class ViewT, class DetectorT>
+  InterestPointList detect_interest_points (ImageViewBase<ViewT> const& view, DetectorT& detector) {
+    InterestPointList ip_list;
+    detect_interest_points( view, detector, ip_list );
     return ip_list;
   }
 
@@ -351,6 +523,10 @@ namespace ip {
       return points;
     }
 
+    /// Blur, gradient, interest window, the extrema neighborhood and
+    /// the orientation window all fit in 16 pixels.
+    int32 tile_halo() const { return 16; }
+
   protected:
     InterestT m_interest;
     int m_max_points;
@@ -562,6 +738,13 @@ namespace ip {
       return points;
     }
 
+    /// The coarsest octave samples every 2^(octaves-1) pixels and needs
+    /// about 16 of its own pixels of context (three sigma of the widest
+    /// plane plus the orientation window). Being a multiple of the
+    /// octave step also keeps a padded tile on the same sampling grid
+    /// as the whole image.
+    int32 tile_halo() const { return 16 << (m_octaves - 1); }
+
   protected:
     InterestT m_interest;
     int m_scales, m_octaves, m_max_points;
@@ -37,6 +37,23 @@ namespace ip {
 
     ImageView<double> m_integral;
 
+    template <class ViewT>
+    void build_integral( ViewT const& image ) {
+      m_integral = IntegralImage<double>(pixel_cast<double>(channel_cast<double>(image)), 1);
+    }
+    // Handed a shared integral image view, use its table rather than
+    // build another one. A double table is used as is; any other
+    // accumulator is converted, which is still cheaper than summing
+    // the image again.
+    template <class ViewT>
+    void build_integral( IntegralImageView<ViewT, double> const& integral ) {
+      m_integral = integral.table();
+    }
+    template <class ViewT, class AccumT>
+    void build_integral( IntegralImageView<ViewT, AccumT> const& integral ) {
+      m_integral = channel_cast<double>( integral.table() );
+    }
+
   public:
 
     // Methods to access the derived type
@@ -45,7 +62,8 @@ namespace ip {
 
     // Given an image and a list of interest points, set the
     // descriptor field of the interest points using compute_descriptor()
-    // method.
+    // method. The image may also be an IntegralImageView of the image,
+    // in which case its table is used instead of building one.
     template <class ViewT>
     void operator() ( ImageViewBase<ViewT> const& image, InterestPointList& points ) {
       (*this)( image, points.begin(), points.end() );
@@ -57,7 +75,7 @@ namespace ip {
       // Timing
       Timer total("\tTotal elapsed time", DebugMessage, "interest_point");
 
-      m_integral = IntegralImage(pixel_cast<double>(channel_cast<double>(image.impl())));
+      build_integral( image.impl() );
 
       for (IterT i = start; i != end; i++ ) {
         // Wrapping integral image for interpolation
@@ -66,6 +84,36 @@ namespace ip {
       }
     }
 
+    // The same, for points held in an InterestPointSet. Each descriptor
+    // is computed into a scratch InterestPoint and copied into its row.
+    template <class ViewT>
+    void operator() ( ImageViewBase<ViewT> const& image, InterestPointSet& points ) {
+      points.set_descriptor_size( impl().descriptor_size() );
+      std::vector<size_t> indices( points.size() );
+      for ( size_t i = 0; i < indices.size(); ++i )
+        indices[i] = i;
+      (*this)( image, points, indices.begin(), indices.end() );
+    }
+    template <class ViewT, class IndexIterT>
+    void operator() ( ImageViewBase<ViewT> const& image, InterestPointSet& points,
+                      IndexIterT first, IndexIterT last ) {
+
+      // Timing
+      Timer total("\tTotal elapsed time", DebugMessage, "interest_point");
+      VW_ASSERT( points.descriptor_size() == size_t(impl().descriptor_size()),
+                 ArgumentErr() << "InterestPointSet has the wrong descriptor size for this generator." );
+
+      build_integral( image.impl() );
+
+      for ( ; first != last; ++first ) {
+        InterestPoint ip = points.keypoint(*first);
+        ip.descriptor.set_size( impl().descriptor_size() );
+        std::fill( ip.begin(), ip.end(), 0.0f );
+        impl().compute_descriptor( interpolate(m_integral), ip );
+        std::copy( ip.begin(), ip.end(), points.descriptor(*first) );
+      }
+    }
+
     // Default suport size ( i.e. descriptor window)
     int support_size() { return 41; }
     // Default descriptor(vector) length
@@ -113,33 +113,94 @@ namespace ip {
 
     /// Setting max_points = 0 will disable interest point culling.
     IntegralInterestPointDetector( int max_points = 1000 )
-      : m_interest(InterestT()), m_scales(IP_DEFAULT_SCALES), m_max_points(max_points) {}
+      : m_interest(InterestT()), m_scales(IP_DEFAULT_SCALES), m_max_points(max_points), m_integral_scale(1) {}
 
     IntegralInterestPointDetector( InterestT const& interest, int max_points = 1000 )
-      : m_interest(interest), m_scales(IP_DEFAULT_SCALES), m_max_points(max_points) {}
+      : m_interest(interest), m_scales(IP_DEFAULT_SCALES), m_max_points(max_points), m_integral_scale(1) {}
 
     IntegralInterestPointDetector( InterestT const& interest, int scales, int max_points )
-      : m_interest(interest), m_scales(scales), m_max_points(max_points) {}
+      : m_interest(interest), m_scales(scales), m_max_points(max_points), m_integral_scale(1) {}
+
+    using InterestDetectorBase<IntegralInterestPointDetector<InterestT> >::operator();
+
+    /// Cut the integral image of every block detect_interest_points()
+    /// hands this detector from one shared table of the whole image,
+    /// instead of summing each padded block again. The table must be of
+    /// the image that is then passed to detect_interest_points(). The
+    /// same view can be given straight to an
+    /// IntegralDescriptorGeneratorBase to describe the points.
+    template <class ViewT>
+    void set_integral( IntegralImageView<ViewT, double> const& integral ) {
+      m_integral = integral.table();
+      m_integral_scale = 1.0 / ChannelRange<typename ViewT::pixel_type>::max();
+    }
+    template <class ViewT, class AccumT>
+    void set_integral( IntegralImageView<ViewT, AccumT> const& integral ) {
+      m_integral = channel_cast<double>( integral.table() );
+      m_integral_scale = 1.0 / ChannelRange<typename ViewT::pixel_type>::max();
+    }
 
     /// Detect Interest Points in the source image.
     template <class ViewT>
     InterestPointList process_image(ImageViewBase<ViewT> const& image ) const {
       typedef ImageView<typename PixelChannelType<typename ViewT::pixel_type>::type> ImageT;
-      typedef ImageInterestData<ImageT,InterestT> DataT;
 
       Timer total("\t\tTotal elapsed time", DebugMessage, "interest_point");
 
       // Rendering own standard copy of the image as the passed in view is just a cropview
       ImageT original_image = image.impl();
 
-      // Producing Integral Image
+      // Producing Integral Image. Each block gets a table of its own:
+      // sums taken from the block's corner stay small enough for float.
+      // The blocks are already spread over threads, so build it on this
+      // one.
       ImageT integral_image;
       {
         vw_out(DebugMessage, "interest_point") << "\tCreating Integral Image ...";
         Timer t("done, elapsed time", DebugMessage, "interest_point");
-        integral_image= IntegralImage( original_image );
+        integral_image= IntegralImage( original_image, 1 );
       }
 
+      return process_image( original_image, integral_image );
+    }
+
+    /// Detect Interest Points in one region of an image. With a shared
+    /// table from set_integral() the region's integral image is taken
+    /// from it, measured from the region's corner so that it holds the
+    /// same sums a table of the region alone would.
+    template <class ViewT>
+    InterestPointList operator() (ImageViewBase<ViewT> const& image, BBox2i const& region) {
+      if ( m_integral.cols() == 0 )
+        return InterestDetectorBase<IntegralInterestPointDetector<InterestT> >::operator()( image, region );
+      VW_ASSERT( m_integral.cols() == image.impl().cols() + 1 && m_integral.rows() == image.impl().rows() + 1,
+                 ArgumentErr() << "IntegralInterestPointDetector: shared integral image is "
+                 << m_integral.cols() << "x" << m_integral.rows() << ", not the size of the integral of a "
+                 << image.impl().cols() << "x" << image.impl().rows() << " image." );
+      typedef ImageView<float> ImageT;
+
+      vw_out(DebugMessage, "interest_point") << "Finding interest points in block: [ " << region.width() << " x " << region.height() << " ]\n";
+      Timer total("\t\tTotal elapsed time", DebugMessage, "interest_point");
+
+      ImageT original_image = pixel_cast_rescale<PixelGray<float> >( crop( image.impl(), region ) );
+      ImageT integral_image( region.width() + 1, region.height() + 1 );
+      const double* top = &m_integral( region.min().x(), region.min().y() );
+      for ( int32 y = 0; y <= region.height(); y++ ) {
+        const double* row = &m_integral( region.min().x(), region.min().y() + y );
+        float* out = &integral_image( 0, y );
+        for ( int32 x = 0; x <= region.width(); x++ )
+          out[x] = float( ( row[x] - row[0] - top[x] + top[0] ) * m_integral_scale );
+      }
+
+      InterestPointList points = process_image( original_image, integral_image );
+      vw_out(DebugMessage, "interest_point") << "Finished processing block. Found " << points.size() << " interest points.\n";
+      return points;
+    }
+
+    /// Detect Interest Points in an image, given its integral image.
+    template <class ImageT>
+    InterestPointList process_image( ImageT const& original_image, ImageT const& integral_image ) const {
+      typedef ImageInterestData<ImageT,InterestT> DataT;
+
       // Creating Scales
       std::deque<DataT> interest_data;
       interest_data.push_back( DataT(original_image, integral_image) );
@@ -228,10 +289,19 @@ namespace ip {
       return new_points;
     }
 
+    /// The orientation window reaches 8 scales out from a point
+    /// (radius 6 plus half a 4-scale Haar wavelet), which also covers
+    /// the widest box filter. Add the extrema neighborhood.
+    int32 tile_halo() const {
+      return int32(ceil(8 * m_interest.float_scale(m_scales - 1))) + 2;
+    }
+
   protected:
 
     InterestT m_interest;
     int m_scales, m_max_points;
+    ImageView<double> m_integral;
+    double m_integral_scale;
 
     template <class AccessT>
     bool inline is_extrema( AccessT const& low,
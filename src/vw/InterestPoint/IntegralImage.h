@@ -24,63 +24,278 @@
 #define __VW_INTERESTPOINT_INTEGRALIMAGE_H__
 
 #include <boost/utility/enable_if.hpp>
+#include <boost/type_traits/is_floating_point.hpp>
+#include <boost/mpl/if.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/noncopyable.hpp>
 #include <vw/Core/FundamentalTypes.h>
+#include <vw/Core/Cache.h>
+#include <vw/Core/Settings.h>
+#include <vw/Core/System.h>
+#include <vw/Core/ThreadPool.h>
 #include <vw/Image/ImageView.h>
+#include <vw/Image/PixelTypes.h>
+#include <vw/Image/PixelAccessors.h>
+
+#include <algorithm>
 
 namespace vw {
 namespace ip {
 
-  /// Creates Integral Image
-  template <class ViewT>
-  inline ImageView<typename PixelChannelType<typename ViewT::pixel_type>::type>
-  IntegralImage( ImageViewBase<ViewT> const& source ) {
+  /// The channel type IntegralImage() sums into by default. Floating
+  /// point images keep their own channel type, so float images get a
+  /// float table at half the memory traffic of double. Integer images
+  /// sum exactly into int64; their own channel type would overflow
+  /// almost at once.
+  template <class ChannelT>
+  struct IntegralAccumulatorType {
+    typedef typename boost::mpl::if_<boost::is_floating_point<ChannelT>, ChannelT, int64>::type type;
+  };
+
+  namespace detail {
+
+    // Rows of the table are built in stripes of about this many bytes
+    // each. A stripe is the unit of work handed to a thread.
+    static const size_t INTEGRAL_STRIPE_BYTES = 4 << 20;
+
+    // Pass one: fill table rows row0+1 .. row1 with the summed area
+    // table of source rows row0 .. row1-1 alone, as if the stripe were
+    // the top of the image. Each row is a running sum along the row
+    // added to the row above, so the source and table are both read
+    // in order. Lazy sources are rasterized one stripe at a time.
+    template <class AccumT, class ViewT>
+    void integral_stripe( ViewT const& source, ImageView<AccumT>& integral, int32 row0, int32 row1 ) {
+      typedef typename PixelChannelType<typename ViewT::pixel_type>::type channel_type;
+      typedef typename ViewT::prerasterize_type stripe_type;
+
+      const int32 cols = source.cols();
+      stripe_type stripe = source.prerasterize( BBox2i( 0, row0, cols, row1 - row0 ) );
+      typename stripe_type::pixel_accessor src_row = stripe.origin();
+      src_row.advance( 0, row0 );
+
+      for ( int32 y = row0; y < row1; y++ ) {
+        AccumT* out = &integral( 0, y + 1 );
+        const AccumT* above = &integral( 0, y );
+        typename stripe_type::pixel_accessor src = src_row;
+        AccumT sum = 0;
+        out[0] = 0;
+        if ( y == row0 ) {
+          for ( int32 x = 1; x <= cols; x++ ) {
+            sum += AccumT( pixel_cast<PixelGray<channel_type> >(*src).v() );
+            out[x] = sum;
+            src.next_col();
+          }
+        } else {
+          for ( int32 x = 1; x <= cols; x++ ) {
+            sum += AccumT( pixel_cast<PixelGray<channel_type> >(*src).v() );
+            out[x] = sum + above[x];
+            src.next_col();
+          }
+        }
+        src_row.next_row();
+      }
+    }
 
-    typedef typename PixelChannelType<typename ViewT::pixel_type>::type channel_type;
+    // Pass two: add the table row above the stripe, which by now holds
+    // the true sums, to the stripe's rows row0+1 .. last-1. This is a
+    // plain vector add the compiler can vectorize.
+    template <class AccumT>
+    void integral_carry( ImageView<AccumT>& integral, int32 row0, int32 last ) {
+      const int32 cols = integral.cols();
+      const AccumT* carry = &integral( 0, row0 );
+      for ( int32 y = row0 + 1; y < last; y++ ) {
+        AccumT* out = &integral( 0, y );
+        for ( int32 x = 0; x < cols; x++ )
+          out[x] += carry[x];
+      }
+    }
 
-    // Allocating space
-    ImageView<channel_type> integral( source.impl().cols()+1, source.impl().rows()+1 );
+    template <class AccumT, class ViewT>
+    class IntegralStripeTask : public Task, private boost::noncopyable {
+      ViewT const& m_source;
+      ImageView<AccumT>& m_integral;
+      int32 m_row0, m_row1;
+    public:
+      IntegralStripeTask( ViewT const& source, ImageView<AccumT>& integral, int32 row0, int32 row1 )
+        : m_source(source), m_integral(integral), m_row0(row0), m_row1(row1) {}
+      virtual void operator()() { integral_stripe( m_source, m_integral, m_row0, m_row1 ); }
+    };
+
+    template <class AccumT>
+    class IntegralCarryTask : public Task, private boost::noncopyable {
+      ImageView<AccumT>& m_integral;
+      int32 m_row0, m_last;
+    public:
+      IntegralCarryTask( ImageView<AccumT>& integral, int32 row0, int32 last )
+        : m_integral(integral), m_row0(row0), m_last(last) {}
+      virtual void operator()() { integral_carry( m_integral, m_row0, m_last ); }
+    };
+
+  } // namespace detail
+
+  /// Creates an Integral Image (summed area table) with one more row
+  /// and column than the source, summing into AccumT.
+  ///
+  /// The table is built in two passes over horizontal stripes: each
+  /// stripe first gets a table of its own rows, then the stripes are
+  /// chained together by adding the true row above each one. Both
+  /// passes run on num_threads threads (0 means the default thread
+  /// count). Stripes are stripe_rows rows high, or about
+  /// INTEGRAL_STRIPE_BYTES of table if stripe_rows is 0. Images that
+  /// fit in one stripe are done in a single pass on the calling thread.
+  template <class AccumT, class ViewT>
+  ImageView<AccumT>
+  IntegralImage( ImageViewBase<ViewT> const& source, int num_threads = 0, int32 stripe_rows = 0 ) {
+    ViewT const& src = source.impl();
+    const int32 cols = src.cols(), rows = src.rows();
+
+    ImageView<AccumT> integral( cols + 1, rows + 1 );
+    std::fill( &integral(0,0), &integral(0,0) + cols + 1, AccumT(0) );
+    if ( rows == 0 )
+      return integral;
+
+    if ( stripe_rows <= 0 ) {
+      size_t row_bytes = size_t(cols + 1) * sizeof(AccumT);
+      stripe_rows = int32( std::max( size_t(16), detail::INTEGRAL_STRIPE_BYTES / row_bytes ) );
+    }
+    if ( stripe_rows >= rows ) {
+      detail::integral_stripe( src, integral, 0, rows );
+      return integral;
+    }
 
-    typedef typename ImageView<channel_type>::pixel_accessor dst_accessor;
-    typedef typename ViewT::pixel_accessor src_accessor;
+    std::vector<int32> starts;
+    for ( int32 row0 = 0; row0 < rows; row0 += stripe_rows )
+      starts.push_back( row0 );
+    starts.push_back( rows );
+    const size_t stripes = starts.size() - 1;
+
+    if ( num_threads <= 0 )
+      num_threads = vw_settings().default_num_threads();
+    num_threads = std::min( num_threads, int(stripes) );
+
+    if ( num_threads > 1 ) {
+      FifoWorkQueue queue( num_threads );
+      for ( size_t s = 0; s < stripes; s++ )
+        queue.add_task( boost::shared_ptr<Task>( new detail::IntegralStripeTask<AccumT, ViewT>( src, integral, starts[s], starts[s+1] ) ) );
+      queue.join_all();
+    } else {
+      for ( size_t s = 0; s < stripes; s++ )
+        detail::integral_stripe( src, integral, starts[s], starts[s+1] );
+    }
 
-    // Zero-ing the first row and col
-    dst_accessor dest_row = integral.origin();
-    *dest_row = 0;
-    for ( int i = 1; i < integral.cols(); i++ ) {
-      dest_row.next_col();
-      *dest_row = 0;
+    // Chain the last row of each stripe onto the one above. This is one
+    // row per stripe, so it is cheap enough to do serially, and it
+    // leaves every stripe's carry row final before pass two.
+    for ( size_t s = 1; s < stripes; s++ ) {
+      AccumT* out = &integral( 0, starts[s+1] );
+      const AccumT* carry = &integral( 0, starts[s] );
+      for ( int32 x = 0; x <= cols; x++ )
+        out[x] += carry[x];
     }
-    dest_row = integral.origin();
-    for ( int i = 1; i < integral.rows(); i++ ) {
-      dest_row.next_row();
-      *dest_row = 0;
+
+    if ( num_threads > 1 ) {
+      FifoWorkQueue queue( num_threads );
+      for ( size_t s = 1; s < stripes; s++ )
+        queue.add_task( boost::shared_ptr<Task>( new detail::IntegralCarryTask<AccumT>( integral, starts[s], starts[s+1] ) ) );
+      queue.join_all();
+    } else {
+      for ( size_t s = 1; s < stripes; s++ )
+        detail::integral_carry( integral, starts[s], starts[s+1] );
     }
 
-    // Pointer and pointer offset
-    int offset = integral.cols();
-    channel_type* p;
-
-    // Now filling in integral image
-    dest_row = integral.origin();
-    dest_row.advance(1,1);
-    src_accessor src_row = source.impl().origin();
-    for ( int iy = 0; iy < source.impl().rows(); iy++ ) {
-      dst_accessor dest_col = dest_row;
-      src_accessor src_col = src_row;
-      for ( int ix = 0; ix < source.impl().cols(); ix++ ) {
-        p = &(*dest_col);
-
-        // Summing
-        *dest_col = pixel_cast<PixelGray<channel_type> >(*src_col).v() + *(p-1) + *(p-offset) - *(p-offset-1);
-
-        dest_col.next_col();
-      src_col.next_col();
+    return integral;
+  }
+
+  /// Creates an Integral Image, summing into the channel type picked
+  /// by IntegralAccumulatorType.
+  template <class ViewT>
+  inline ImageView<typename IntegralAccumulatorType<typename PixelChannelType<typename ViewT::pixel_type>::type>::type>
+  IntegralImage( ImageViewBase<ViewT> const& source, int num_threads = 0 ) {
+    typedef typename IntegralAccumulatorType<typename PixelChannelType<typename ViewT::pixel_type>::type>::type accum_type;
+    return IntegralImage<accum_type>( source, num_threads );
+  }
+
+  /// A view of the integral image of another view that is built the
+  /// first time it is used and then kept in a Cache. Copies of the
+  /// view share the one table, so a detector and a descriptor
+  /// generator that are handed the same IntegralImageView only build
+  /// it once. If the cache evicts the table it is rebuilt on the next
+  /// access.
+  ///
+  /// Reading single pixels goes through the cache each time; code
+  /// that walks the table should take table() once and use that.
+  template <class ViewT, class AccumT = typename IntegralAccumulatorType<typename PixelChannelType<typename ViewT::pixel_type>::type>::type>
+  class IntegralImageView : public ImageViewBase<IntegralImageView<ViewT, AccumT> > {
+  public:
+    typedef AccumT pixel_type;
+    typedef AccumT result_type;
+    typedef ProceduralPixelAccessor<IntegralImageView> pixel_accessor;
+
+    // Builds the table for the cache.
+    class TableGenerator {
+      boost::shared_ptr<ViewT> m_source;
+    public:
+      typedef ImageView<AccumT> value_type;
+
+      TableGenerator( boost::shared_ptr<ViewT> const& source ) : m_source( source ) {}
+
+      size_t size() const {
+        return size_t(m_source->cols() + 1) * size_t(m_source->rows() + 1) * sizeof(AccumT);
+      }
+
+      boost::shared_ptr<value_type> generate() const {
+        return boost::shared_ptr<value_type>( new value_type( IntegralImage<AccumT>( *m_source ) ) );
       }
-      dest_row.next_row();
-      src_row.next_row();
+    };
+
+    IntegralImageView( ViewT const& source, Cache& cache = vw_system_cache() )
+      : m_source( new ViewT(source) ), m_table( cache.insert( TableGenerator( m_source ) ) ) {}
+
+    inline int32 cols() const { return m_source->cols() + 1; }
+    inline int32 rows() const { return m_source->rows() + 1; }
+    inline int32 planes() const { return 1; }
+    inline pixel_accessor origin() const { return pixel_accessor( *this, 0, 0, 0 ); }
+
+    inline result_type operator()( int32 x, int32 y, int32 /*p*/ = 0 ) const {
+      result_type result = (*m_table)( x, y );
+      m_table.release();
+      return result;
     }
 
-    return integral;
+    /// The whole table, building it if need be. The returned image
+    /// shares its memory with the cache and stays valid even if the
+    /// cache later drops its copy.
+    ImageView<AccumT> table() const {
+      ImageView<AccumT> result = *m_table;
+      m_table.release();
+      return result;
+    }
+
+    ViewT const& source() const { return *m_source; }
+
+    typedef ImageView<AccumT> prerasterize_type;
+    inline prerasterize_type prerasterize( BBox2i const& /*bbox*/ ) const { return table(); }
+    template <class DestT> inline void rasterize( DestT const& dest, BBox2i const& bbox ) const {
+      vw::rasterize( prerasterize(bbox), dest, bbox );
+    }
+
+  private:
+    // Held by pointer so the generator's copy stays put when the view
+    // is copied.
+    boost::shared_ptr<ViewT> m_source;
+    Cache::Handle<TableGenerator> m_table;
+  };
+
+  /// Returns a cached, shared integral image of a view (see
+  /// IntegralImageView), kept in the system cache.
+  template <class ViewT>
+  inline IntegralImageView<ViewT> integral_image( ImageViewBase<ViewT> const& image ) {
+    return IntegralImageView<ViewT>( image.impl() );
+  }
+
+  template <class ViewT>
+  inline IntegralImageView<ViewT> integral_image( ImageViewBase<ViewT> const& image, Cache& cache ) {
+    return IntegralImageView<ViewT>( image.impl(), cache );
   }
 
   /// Integral Block Evaluation
@@ -0,0 +1,332 @@
+// __BEGIN_LICENSE__
+//  Copyright (c) 2006-2013, United States Government as represented by the
+//  Administrator of the National Aeronautics and Space Administration. All
+//  rights reserved.
+//
+//  The NASA Vision Workbench is licensed under the Apache License,
+//  Version 2.0 (the "License"); you may not use this file except in
+//  compliance with the License. You may obtain a copy of the License at
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+// __END_LICENSE__
+
+
+/// \file InterestPointSet.cc
+///
+/// A column-wise container for large numbers of interest points.
+///
+#include <vw/InterestPoint/InterestPointSet.h>
+#include <vw/Core/Exception.h>
+
+#include <fstream>
+#include <cstring>
+#include <cstdlib>
+#include <new>
+
+namespace vw {
+namespace ip {
+
+  namespace {
+    // Rows are padded to a multiple of this many floats (16 bytes), and
+    // the block itself starts on a cache line.
+    const size_t ROW_ALIGN   = 4;
+    const size_t BLOCK_ALIGN = 64;
+
+    size_t row_stride(size_t n) {
+      return (n + ROW_ALIGN - 1) / ROW_ALIGN * ROW_ALIGN;
+    }
+
+    float* allocate_rows(size_t floats) {
+      if (floats == 0)
+        return 0;
+      void* ptr = 0;
+      if (posix_memalign(&ptr, BLOCK_ALIGN, floats * sizeof(float)) != 0)
+        throw std::bad_alloc();
+      std::memset(ptr, 0, floats * sizeof(float));
+      return static_cast<float*>(ptr);
+    }
+
+    template <class T>
+    inline char* put(char* p, T const& v) {
+      std::memcpy(p, &v, sizeof(T));
+      return p + sizeof(T);
+    }
+
+    template <class T>
+    inline const char* get(const char* p, T& v) {
+      std::memcpy(&v, p, sizeof(T));
+      return p + sizeof(T);
+    }
+
+    // x, y, ix, iy, orientation, scale, interest, polarity, octave,
+    // scale_lvl, then the uint64 descriptor length
+    const size_t RECORD_HEADER = 7*sizeof(float) + sizeof(bool) + 2*sizeof(uint32) + sizeof(uint64);
+  }
+
+  InterestPointSet::InterestPointSet()
+    : m_descriptor_size(0), m_stride(0), m_capacity(0), m_descriptors(0) {}
+
+  InterestPointSet::InterestPointSet(size_t descriptor_size)
+    : m_descriptor_size(descriptor_size), m_stride(row_stride(descriptor_size)), m_capacity(0), m_descriptors(0) {}
+
+  InterestPointSet::InterestPointSet(InterestPointSet const& other)
+    : m_x(other.m_x), m_y(other.m_y), m_scale(other.m_scale), m_orientation(other.m_orientation),
+      m_interest(other.m_interest), m_ix(other.m_ix), m_iy(other.m_iy), m_polarity(other.m_polarity),
+      m_octave(other.m_octave), m_scale_lvl(other.m_scale_lvl),
+      m_descriptor_size(other.m_descriptor_size), m_stride(other.m_stride),
+      m_capacity(other.size()), m_descriptors(allocate_rows(other.size() * other.m_stride)) {
+    if (m_descriptors)
+      std::memcpy(m_descriptors, other.m_descriptors, size() * m_stride * sizeof(float));
+  }
+
+  InterestPointSet::~InterestPointSet() {
+    std::free(m_descriptors);
+  }
+
+  InterestPointSet& InterestPointSet::operator=(InterestPointSet const& other) {
+    if (this != &other) {
+      InterestPointSet copy(other);
+      swap(copy);
+    }
+    return *this;
+  }
+
+  void InterestPointSet::swap(InterestPointSet& other) {
+    m_x.swap(other.m_x);
+    m_y.swap(other.m_y);
+    m_scale.swap(other.m_scale);
+    m_orientation.swap(other.m_orientation);
+    m_interest.swap(other.m_interest);
+    m_ix.swap(other.m_ix);
+    m_iy.swap(other.m_iy);
+    m_polarity.swap(other.m_polarity);
+    m_octave.swap(other.m_octave);
+    m_scale_lvl.swap(other.m_scale_lvl);
+    std::swap(m_descriptor_size, other.m_descriptor_size);
+    std::swap(m_stride, other.m_stride);
+    std::swap(m_capacity, other.m_capacity);
+    std::swap(m_descriptors, other.m_descriptors);
+  }
+
+  void InterestPointSet::reallocate(size_t capacity, size_t descriptor_size) {
+    const size_t stride = row_stride(descriptor_size);
+    float* rows = allocate_rows(capacity * stride);
+    const size_t keep = std::min(m_descriptor_size, descriptor_size);
+    if (rows && m_descriptors && keep > 0)
+      for (size_t i = 0; i < size(); ++i)
+        std::memcpy(rows + i * stride, descriptor(i), keep * sizeof(float));
+
+    std::free(m_descriptors);
+    m_descriptors     = rows;
+    m_capacity        = capacity;
+    m_descriptor_size = descriptor_size;
+    m_stride          = stride;
+  }
+
+  void InterestPointSet::clear() {
+    resize(0);
+  }
+
+  void InterestPointSet::reserve(size_t n) {
+    m_x.reserve(n);
+    m_y.reserve(n);
+    m_scale.reserve(n);
+    m_orientation.reserve(n);
+    m_interest.reserve(n);
+    m_ix.reserve(n);
+    m_iy.reserve(n);
+    m_polarity.reserve(n);
+    m_octave.reserve(n);
+    m_scale_lvl.reserve(n);
+    if (n > m_capacity)
+      reallocate(n, m_descriptor_size);
+  }
+
+  void InterestPointSet::resize(size_t n) {
+    const size_t old_size = size();
+    if (n > m_capacity)
+      reallocate(std::max(n, 2 * m_capacity), m_descriptor_size);
+    else if (n < old_size && m_descriptors)
+      // Keep the unused rows zeroed so a later resize() doesn't revive them
+      std::memset(descriptor(n), 0, (old_size - n) * m_stride * sizeof(float));
+
+    m_x.resize(n, 0);
+    m_y.resize(n, 0);
+    m_scale.resize(n, 0);
+    m_orientation.resize(n, 0);
+    m_interest.resize(n, 0);
+    m_ix.resize(n, 0);
+    m_iy.resize(n, 0);
+    m_polarity.resize(n, 0);
+    m_octave.resize(n, 0);
+    m_scale_lvl.resize(n, 0);
+  }
+
+  void InterestPointSet::set_descriptor_size(size_t n) {
+    if (n != m_descriptor_size)
+      reallocate(m_capacity, n);
+  }
+
+  void InterestPointSet::push_back(InterestPoint const& ip) {
+    if (m_descriptor_size == 0 && ip.size() > 0)
+      set_descriptor_size(ip.size());
+    check_descriptor(ip);  // before the set grows
+    resize(size() + 1);
+    set_point(size() - 1, ip);
+  }
+
+  void InterestPointSet::check_descriptor(InterestPoint const& ip) const {
+    VW_ASSERT( ip.size() == 0 || ip.size() == m_descriptor_size,
+               ArgumentErr() << "InterestPointSet: descriptor of size " << ip.size()
+               << " does not match the set's " << m_descriptor_size << "." );
+  }
+
+  void InterestPointSet::set_descriptor(size_t i, InterestPoint const& ip) {
+    check_descriptor(ip);
+    if (ip.size() > 0)
+      std::copy(ip.begin(), ip.end(), descriptor(i));
+  }
+
+  void InterestPointSet::set_point(size_t i, InterestPoint const& ip) {
+    m_x[i]           = ip.x;
+    m_y[i]           = ip.y;
+    m_scale[i]       = ip.scale;
+    m_ix[i]          = ip.ix;
+    m_iy[i]          = ip.iy;
+    m_orientation[i] = ip.orientation;
+    m_interest[i]    = ip.interest;
+    m_polarity[i]    = ip.polarity;
+    m_octave[i]      = ip.octave;
+    m_scale_lvl[i]   = ip.scale_lvl;
+    set_descriptor(i, ip);
+  }
+
+  InterestPoint InterestPointSet::keypoint(size_t i) const {
+    InterestPoint ip;
+    ip.x           = m_x[i];
+    ip.y           = m_y[i];
+    ip.scale       = m_scale[i];
+    ip.ix          = m_ix[i];
+    ip.iy          = m_iy[i];
+    ip.orientation = m_orientation[i];
+    ip.interest    = m_interest[i];
+    ip.polarity    = m_polarity[i] != 0;
+    ip.octave      = m_octave[i];
+    ip.scale_lvl   = m_scale_lvl[i];
+    return ip;
+  }
+
+  InterestPoint InterestPointSet::point(size_t i) const {
+    InterestPoint ip = keypoint(i);
+    ip.descriptor.set_size(m_descriptor_size);
+    std::copy(descriptor(i), descriptor(i) + m_descriptor_size, ip.begin());
+    return ip;
+  }
+
+  InterestPointList InterestPointSet::to_list() const {
+    InterestPointList result;
+    for (size_t i = 0; i < size(); ++i)
+      result.push_back(point(i));
+    return result;
+  }
+
+  std::vector<InterestPoint> InterestPointSet::to_vector() const {
+    std::vector<InterestPoint> result;
+    result.reserve(size());
+    for (size_t i = 0; i < size(); ++i)
+      result.push_back(point(i));
+    return result;
+  }
+
+  void write_binary_ip_file(std::string ip_file, InterestPointSet const& ip) {
+    std::ofstream f;
+    f.open(ip_file.c_str(), std::ios::binary | std::ios::out);
+    if ( !f.is_open() )
+      vw_throw( IOErr() << "Failed to open \"" << ip_file << "\" for writing." );
+
+    uint64 size = ip.size();
+    f.write((char*)&size, sizeof(uint64));
+
+    const uint64 length = ip.descriptor_size();
+    std::vector<char> record(RECORD_HEADER + length * sizeof(float));
+    for (size_t i = 0; i < ip.size(); ++i) {
+      char* p = &record[0];
+      p = put(p, ip.x(i));
+      p = put(p, ip.y(i));
+      p = put(p, ip.ix(i));
+      p = put(p, ip.iy(i));
+      p = put(p, ip.orientation(i));
+      p = put(p, ip.scale(i));
+      p = put(p, ip.interest(i));
+      p = put(p, ip.polarity(i));
+      p = put(p, ip.octave(i));
+      p = put(p, ip.scale_lvl(i));
+      p = put(p, length);
+      std::memcpy(p, ip.descriptor(i), length * sizeof(float));
+      f.write(&record[0], record.size());
+    }
+    f.close();
+  }
+
+  void read_binary_ip_file(std::string ip_file, InterestPointSet& ip) {
+    std::ifstream f;
+    f.open(ip_file.c_str(), std::ios::binary | std::ios::in);
+
+    // Error Handling
+    if ( !f.is_open() )
+      vw_throw( IOErr() << "Failed to open \"" << ip_file << "\" as VWIP file." );
+
+    uint64 size;
+    f.read((char*)&size, sizeof(uint64));
+
+    // The count comes from the file, so don't reserve more records than
+    // the rest of the file could possibly hold.
+    const std::streampos start = f.tellg();
+    f.seekg(0, std::ios::end);
+    const uint64 remaining = f.tellg() - start;
+    f.seekg(start);
+
+    ip.clear();
+    ip.reserve(std::min(size, remaining / RECORD_HEADER));
+
+    char header[RECORD_HEADER];
+    for (size_t i = 0; i < size && f; ++i) {
+      if (!f.read(header, RECORD_HEADER))
+        break;
+
+      ip.resize(i + 1);
+      bool polarity;
+      uint64 length;
+      const char* p = header;
+      p = get(p, ip.x(i));
+      p = get(p, ip.y(i));
+      p = get(p, ip.ix(i));
+      p = get(p, ip.iy(i));
+      p = get(p, ip.orientation(i));
+      p = get(p, ip.scale(i));
+      p = get(p, ip.interest(i));
+      p = get(p, polarity);
+      p = get(p, ip.octave(i));
+      p = get(p, ip.scale_lvl(i));
+      p = get(p, length);
+      ip.polarity(i) = polarity;
+
+      if (i == 0)
+        ip.set_descriptor_size(length);
+      else if (length != ip.descriptor_size())
+        vw_throw( IOErr() << "\"" << ip_file << "\" has descriptors of different sizes; "
+                  << "it can only be read as a list of InterestPoints." );
+      f.read((char*)ip.descriptor(i), length * sizeof(float));
+    }
+
+    if ( !f )
+      vw_throw( IOErr() << "\"" << ip_file << "\" is truncated." );
+    f.close();
+  }
+
+}} // namespace vw::ip
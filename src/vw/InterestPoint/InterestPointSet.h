@@ -0,0 +1,200 @@
+// __BEGIN_LICENSE__
+//  Copyright (c) 2006-2013, United States Government as represented by the
+//  Administrator of the National Aeronautics and Space Administration. All
+//  rights reserved.
+//
+//  The NASA Vision Workbench is licensed under the Apache License,
+//  Version 2.0 (the "License"); you may not use this file except in
+//  compliance with the License. You may obtain a copy of the License at
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+// __END_LICENSE__
+
+
+/// \file InterestPointSet.h
+///
+/// A column-wise container for large numbers of interest points.
+///
+#ifndef __VW_INTERESTPOINT_INTEREST_POINT_SET_H__
+#define __VW_INTERESTPOINT_INTEREST_POINT_SET_H__
+
+#include <vw/Math/Vector.h>
+#include <vw/InterestPoint/InterestData.h>
+
+#include <vector>
+#include <string>
+#include <iterator>
+
+namespace vw {
+namespace ip {
+
+  /// InterestPointSet holds the same information as a list of
+  /// InterestPoints, but keeps each keypoint field in its own column and
+  /// every descriptor in one contiguous block of floats. Descriptor rows
+  /// start on 16 byte boundaries and are zero padded out to
+  /// descriptor_stride() floats, so a million points cost a dozen
+  /// allocations instead of a million, and matchers can walk the
+  /// descriptors as a plain matrix.
+  ///
+  /// Points are addressed by index. point() and set_point() convert to
+  /// and from InterestPoint. keypoint() skips the descriptor, so it never
+  /// allocates and is cheap enough to hand to the constraint functors.
+  /// descriptor_vector() and descriptor_ref() look at a row in place.
+  class InterestPointSet {
+  public:
+
+    /// A read-only handle to one descriptor row that looks enough like a
+    /// container for KDTree and the metrics. It is invalidated by
+    /// anything that reallocates the set.
+    class DescriptorRef {
+      const float* m_data;
+      uint32 m_size;
+      size_t m_index;
+    public:
+      typedef float value_type;
+      typedef const float* iterator;
+      typedef const float* const_iterator;
+
+      DescriptorRef() : m_data(0), m_size(0), m_index(0) {}
+      DescriptorRef(const float* data, uint32 size, size_t index) : m_data(data), m_size(size), m_index(index) {}
+
+      const_iterator begin() const { return m_data; }
+      const_iterator end() const { return m_data + m_size; }
+      size_t size() const { return m_size; }
+      float operator[](size_t i) const { return m_data[i]; }
+
+      /// Which point of the set this row belongs to
+      size_t index() const { return m_index; }
+    };
+
+    InterestPointSet();
+    explicit InterestPointSet(size_t descriptor_size);
+    InterestPointSet(InterestPointSet const& other);
+    ~InterestPointSet();
+
+    /// Copy a range of InterestPoints into a new set.
+    template <class IterT>
+    InterestPointSet(IterT first, IterT last) : m_descriptor_size(0), m_stride(0), m_capacity(0), m_descriptors(0) {
+      assign(first, last);
+    }
+
+    InterestPointSet& operator=(InterestPointSet const& other);
+    void swap(InterestPointSet& other);
+
+    size_t size() const { return m_x.size(); }
+    bool empty() const { return m_x.empty(); }
+
+    /// Remove all points. The descriptor size is kept.
+    void clear();
+    void reserve(size_t n);
+
+    /// Grow or shrink the set. New points are all zeros.
+    void resize(size_t n);
+
+    /// Append a point. If the set has no descriptor size yet, it takes
+    /// the size of the first point that has a descriptor. Points without
+    /// a descriptor get a row of zeros; any other size mismatch throws.
+    void push_back(InterestPoint const& ip);
+
+    template <class IterT>
+    void assign(IterT first, IterT last) {
+      clear();
+      reserve(std::distance(first, last));
+      for ( ; first != last; ++first)
+        push_back(*first);
+    }
+
+    // ---------------------------- Keypoints ----------------------------
+    // The same fields as InterestPoint, one column each.
+
+    float& x(size_t i) { return m_x[i]; }
+    float& y(size_t i) { return m_y[i]; }
+    float& scale(size_t i) { return m_scale[i]; }
+    int32& ix(size_t i) { return m_ix[i]; }
+    int32& iy(size_t i) { return m_iy[i]; }
+    float& orientation(size_t i) { return m_orientation[i]; }
+    float& interest(size_t i) { return m_interest[i]; }
+    uint8& polarity(size_t i) { return m_polarity[i]; }
+    uint32& octave(size_t i) { return m_octave[i]; }
+    uint32& scale_lvl(size_t i) { return m_scale_lvl[i]; }
+
+    float x(size_t i) const { return m_x[i]; }
+    float y(size_t i) const { return m_y[i]; }
+    float scale(size_t i) const { return m_scale[i]; }
+    int32 ix(size_t i) const { return m_ix[i]; }
+    int32 iy(size_t i) const { return m_iy[i]; }
+    float orientation(size_t i) const { return m_orientation[i]; }
+    float interest(size_t i) const { return m_interest[i]; }
+    bool polarity(size_t i) const { return m_polarity[i] != 0; }
+    uint32 octave(size_t i) const { return m_octave[i]; }
+    uint32 scale_lvl(size_t i) const { return m_scale_lvl[i]; }
+
+    // --------------------------- Descriptors ---------------------------
+
+    size_t descriptor_size() const { return m_descriptor_size; }
+
+    /// Floats from the start of one row to the next
+    size_t descriptor_stride() const { return m_stride; }
+
+    /// Change the descriptor length of every point. Existing values are
+    /// kept up to the new length; anything new is zero.
+    void set_descriptor_size(size_t n);
+
+    float* descriptor(size_t i) { return m_descriptors + i * m_stride; }
+    const float* descriptor(size_t i) const { return m_descriptors + i * m_stride; }
+
+    /// Row i as a vw::Vector, without copying
+    VectorProxy<float> descriptor_vector(size_t i) {
+      return VectorProxy<float>(m_descriptor_size, descriptor(i));
+    }
+
+    DescriptorRef descriptor_ref(size_t i) const {
+      return DescriptorRef(descriptor(i), uint32(m_descriptor_size), i);
+    }
+
+    /// All the rows, size() * descriptor_stride() floats
+    float* descriptor_data() { return m_descriptors; }
+    const float* descriptor_data() const { return m_descriptors; }
+
+    // ---------------------- InterestPoint adapters ----------------------
+
+    /// A copy of point i, descriptor included
+    InterestPoint point(size_t i) const;
+
+    /// Point i without its descriptor
+    InterestPoint keypoint(size_t i) const;
+
+    /// Overwrite point i. A point without a descriptor leaves the row
+    /// alone.
+    void set_point(size_t i, InterestPoint const& ip);
+
+    InterestPointList to_list() const;
+    std::vector<InterestPoint> to_vector() const;
+
+  private:
+    std::vector<float>  m_x, m_y, m_scale, m_orientation, m_interest;
+    std::vector<int32>  m_ix, m_iy;
+    std::vector<uint8>  m_polarity;
+    std::vector<uint32> m_octave, m_scale_lvl;
+
+    size_t m_descriptor_size, m_stride;
+    size_t m_capacity;           // rows allocated
+    float* m_descriptors;
+
+    void reallocate(size_t capacity, size_t stride);
+    void check_descriptor(InterestPoint const& ip) const;
+    void set_descriptor(size_t i, InterestPoint const& ip);
+  };
+
+  /// Read and write the same .vwip format as the InterestPoint versions.
+  void write_binary_ip_file(std::string ip_file, InterestPointSet const& ip);
+  void read_binary_ip_file(std::string ip_file, InterestPointSet& ip);
+
+}} // namespace vw::ip
+
+#endif // __VW_INTERESTPOINT_INTEREST_POINT_SET_H__
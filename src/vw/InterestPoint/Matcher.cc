@@ -21,9 +21,29 @@
 /// Classes and functions for matching image interest points.
 ///
 #include <vw/InterestPoint/Matcher.h>
+#include <vw/Core/ThreadPool.h>
+#include <vw/Core/Thread.h>
 #include <boost/filesystem/operations.hpp>
+#include <set>
+#include <cstring>
 namespace fs = boost::filesystem;
 
+#if defined(__GNUC__) && ( defined(__x86_64__) || defined(__i386__) )
+#define VW_MATCHER_X86 1
+#endif
+
+#if defined(__GNUC__)
+#define VW_MATCHER_INLINE inline __attribute__((always_inline))
+#else
+#define VW_MATCHER_INLINE inline
+#endif
+
+#if VW_HAVE_PKG_FLANN
+#include <vw/Math/FLANNTree.h>
+#else
+#include <vw/Math/KDTree.h>
+#endif
+
 namespace vw {
 namespace ip {
 
@@ -38,6 +58,17 @@ namespace ip {
     return dist;
   }
 
+  float
+  L2NormMetric::operator()( const float* desc1, const float* desc2, size_t size,
+                            float maxdist ) const {
+    float dist = 0.0;
+    for (size_t i = 0; i < size; i++) {
+      dist += (desc1[i] - desc2[i])*(desc1[i] - desc2[i]);
+      if (dist > maxdist) break;  // abort calculation if distance exceeds upper bound
+    }
+    return dist;
+  }
+
   float
   RelativeEntropyMetric::operator()( InterestPoint const& ip1,
                                      InterestPoint const& ip2,
@@ -50,6 +81,312 @@ namespace ip {
     return dist;
   }
 
+  float
+  RelativeEntropyMetric::operator()( const float* desc1, const float* desc2, size_t size,
+                                     float maxdist ) const {
+    float dist = 0.0;
+    for (size_t i = 0; i < size; i++) {
+      dist += desc1[i] * logf(desc1[i]/(desc2[i]+1e-16)+1e-16)/logf(2.) ;
+      if (dist > maxdist) break;  // abort calculation if distance exceeds upper bound
+    }
+    return dist;
+  }
+
+  namespace {
+    // Queries per batch. Big enough that FLANN's per-call overhead
+    // disappears, small enough to keep every thread busy.
+    const size_t QUERY_BATCH = 1024;
+
+#if VW_HAVE_PKG_FLANN
+    // Searches one batch of query rows. FLANN's kd-tree search doesn't
+    // modify the index, so any number of these can share one tree.
+    class NearestBatchTask : public Task, private boost::noncopyable {
+      math::FLANNTree<float>& m_tree;
+      std::vector<const float*> const& m_query;
+      size_t m_dim, m_knn, m_begin, m_end, m_ref_size;
+      std::vector<size_t>& m_nearest;
+      const ProgressCallback& m_progress;
+      Mutex& m_progress_mutex;
+      float m_inc_amt;
+
+    public:
+      NearestBatchTask( math::FLANNTree<float>& tree, std::vector<const float*> const& query,
+                        size_t dim, size_t knn, size_t begin, size_t end, size_t ref_size,
+                        std::vector<size_t>& nearest, const ProgressCallback& progress,
+                        Mutex& progress_mutex, float inc_amt )
+        : m_tree(tree), m_query(query), m_dim(dim), m_knn(knn), m_begin(begin), m_end(end),
+          m_ref_size(ref_size), m_nearest(nearest), m_progress(progress),
+          m_progress_mutex(progress_mutex), m_inc_amt(inc_amt) {}
+
+      void operator()() {
+        if (m_progress.abort_requested())
+          return;
+
+        Matrix<float> batch( m_end - m_begin, m_dim );
+        for (size_t i = m_begin; i < m_end; ++i)
+          std::copy( m_query[i], m_query[i] + m_dim, &batch(i - m_begin, 0) );
+
+        Vector<int> indices;
+        Vector<float> distances;
+        m_tree.knn_search( batch, indices, distances, m_knn );
+
+        // FLANN leaves garbage past the end of a small tree
+        const size_t found = std::min( m_knn, m_ref_size );
+        for (size_t r = 0; r < batch.rows(); ++r)
+          for (size_t j = 0; j < found; ++j)
+            m_nearest[(m_begin + r) * m_knn + j] = indices[r * m_knn + j];
+
+        Mutex::Lock lock( m_progress_mutex );
+        m_progress.report_incremental_progress( m_inc_amt * float(m_end - m_begin) );
+      }
+    };
+#endif
+  }
+
+  void detail::find_nearest( std::vector<const float*> const& ref,
+                             std::vector<const float*> const& query, size_t dim,
+                             size_t knn, std::vector<size_t>& nearest,
+                             const ProgressCallback &progress_callback ) {
+    nearest.assign( query.size() * knn, size_t(-1) );
+    if (ref.empty() || query.empty() || knn == 0)
+      return;
+
+    float inc_amt = 1.0f/float(query.size());
+
+#if VW_HAVE_PKG_FLANN
+    Matrix<float> ref_matrix( ref.size(), dim );
+    for (size_t i = 0; i < ref.size(); ++i)
+      std::copy( ref[i], ref[i] + dim, &ref_matrix(i,0) );
+
+    math::FLANNTree<float> tree( ref_matrix );
+    vw_out(InfoMessage,"interest_point") << "FLANN-Tree created. Searching...\n";
+    progress_callback.report_progress(0);
+
+    typedef boost::shared_ptr<NearestBatchTask> task_t;
+    std::vector<task_t> tasks;
+    Mutex progress_mutex;
+    for (size_t begin = 0; begin < query.size(); begin += QUERY_BATCH)
+      tasks.push_back( task_t( new NearestBatchTask( tree, query, dim, knn, begin,
+                                                     std::min( begin + QUERY_BATCH, query.size() ),
+                                                     ref.size(), nearest, progress_callback,
+                                                     progress_mutex, inc_amt ) ) );
+
+    int threads = std::min( int(vw_settings().default_num_threads()), int(tasks.size()) );
+    if (threads > 1) {
+      FifoWorkQueue queue( threads );
+      BOOST_FOREACH( task_t const& task, tasks )
+        queue.add_task( task );
+      queue.join_all();
+    } else {
+      BOOST_FOREACH( task_t const& task, tasks )
+        (*task)();
+    }
+    if (progress_callback.abort_requested())
+      vw_throw( Aborted() << "Aborted by ProgressCallback" );
+#else
+    // The tree holds handles to the rows, and hands back their index.
+    // Its search keeps state in the tree, so this one runs serially.
+    std::vector<InterestPointSet::DescriptorRef> rows( ref.size() );
+    for (size_t i = 0; i < ref.size(); ++i)
+      rows[i] = InterestPointSet::DescriptorRef( ref[i], uint32(dim), i );
+
+    math::KDTree<std::vector<InterestPointSet::DescriptorRef> > tree( dim, rows );
+    vw_out(InfoMessage,"interest_point") << "KD-Tree created with " << tree.size() << " nodes and depth ranging from " << tree.min_depth() << " to " << tree.max_depth() << ".  Searching...\n";
+    progress_callback.report_progress(0);
+
+    std::vector<InterestPointSet::DescriptorRef> nearest_records;
+    for (size_t i = 0; i < query.size(); ++i) {
+      if (i % QUERY_BATCH == 0) {
+        if (progress_callback.abort_requested())
+          vw_throw( Aborted() << "Aborted by ProgressCallback" );
+        progress_callback.report_incremental_progress( inc_amt * float(std::min( QUERY_BATCH, query.size() - i )) );
+      }
+
+      size_t found = tree.m_nearest_neighbors( InterestPointSet::DescriptorRef( query[i], uint32(dim), 0 ),
+                                               nearest_records, knn );
+      for (size_t j = 0; j < found; ++j)
+        nearest[i * knn + j] = nearest_records[j].index();
+    }
+#endif
+  }
+
+  namespace {
+    VW_MATCHER_INLINE uint32 popcount64( uint64 x ) {
+#if defined(__GNUC__)
+      return __builtin_popcountll( x );
+#else
+      uint32 count = 0;
+      for ( ; x; x &= x - 1 ) ++count;
+      return count;
+#endif
+    }
+  }
+
+  float
+  HammingMetric::operator()( InterestPoint const& ip1, InterestPoint const& ip2,
+                             float maxdist ) const {
+    return (*this)( &ip1.descriptor[0], &ip2.descriptor[0], ip1.descriptor.size(), maxdist );
+  }
+
+  float
+  HammingMetric::operator()( const float* desc1, const float* desc2, size_t size,
+                             float maxdist ) const {
+    uint32 dist = 0;
+    for (size_t i = 0; i < size; i++) {
+      dist += popcount64( uint32(desc1[i]) ^ uint32(desc2[i]) );
+      if (float(dist) > maxdist) break;  // abort calculation if distance exceeds upper bound
+    }
+    return float(dist);
+  }
+
+  namespace {
+    // Refs scanned per block, so a block of packed rows stays in cache
+    // while a batch of queries runs against it.
+    const size_t REF_BLOCK = 512;
+
+    // Compares queries [0, query_rows) against every ref. best holds the
+    // knn smallest distances so far for each query, in order, and
+    // nearest their ref indices.
+    VW_MATCHER_INLINE void
+    hamming_scan_impl( const uint64* ref, size_t ref_rows,
+                       const uint64* query, size_t query_rows, size_t words,
+                       size_t knn, uint32* best, size_t* nearest ) {
+      for (size_t block = 0; block < ref_rows; block += REF_BLOCK) {
+        const size_t block_end = std::min( block + REF_BLOCK, ref_rows );
+        for (size_t q = 0; q < query_rows; ++q) {
+          const uint64* qrow = query + q * words;
+          uint32* qbest = best + q * knn;
+          size_t* qnearest = nearest + q * knn;
+          for (size_t r = block; r < block_end; ++r) {
+            const uint64* rrow = ref + r * words;
+            uint32 dist = 0;
+            for (size_t w = 0; w < words; ++w)
+              dist += popcount64( qrow[w] ^ rrow[w] );
+            if (dist >= qbest[knn-1])
+              continue;
+            size_t k = knn - 1;
+            for ( ; k > 0 && qbest[k-1] > dist; --k) {
+              qbest[k] = qbest[k-1];
+              qnearest[k] = qnearest[k-1];
+            }
+            qbest[k] = dist;
+            qnearest[k] = r;
+          }
+        }
+      }
+    }
+
+    void hamming_scan_generic( const uint64* ref, size_t ref_rows,
+                               const uint64* query, size_t query_rows, size_t words,
+                               size_t knn, uint32* best, size_t* nearest ) {
+      hamming_scan_impl( ref, ref_rows, query, query_rows, words, knn, best, nearest );
+    }
+
+#ifdef VW_MATCHER_X86
+    // The same loop, with the popcnt instruction instead of a bit-twiddling
+    // fallback
+    __attribute__((target("popcnt")))
+    void hamming_scan_popcnt( const uint64* ref, size_t ref_rows,
+                              const uint64* query, size_t query_rows, size_t words,
+                              size_t knn, uint32* best, size_t* nearest ) {
+      hamming_scan_impl( ref, ref_rows, query, query_rows, words, knn, best, nearest );
+    }
+#endif
+
+    typedef void (*hamming_scan_func)( const uint64*, size_t, const uint64*, size_t, size_t,
+                                       size_t, uint32*, size_t* );
+
+    hamming_scan_func pick_hamming_scan() {
+#ifdef VW_MATCHER_X86
+      __builtin_cpu_init();
+      if ( __builtin_cpu_supports("popcnt") )
+        return &hamming_scan_popcnt;
+#endif
+      return &hamming_scan_generic;
+    }
+
+    const hamming_scan_func hamming_scan = pick_hamming_scan();
+
+    // Packs descriptor rows of 16-bit words, 4 to a uint64
+    void pack_rows( std::vector<const float*> const& rows, size_t dim, size_t words,
+                    std::vector<uint64>& packed ) {
+      packed.assign( rows.size() * words, 0 );
+      for (size_t i = 0; i < rows.size(); ++i)
+        for (size_t j = 0; j < dim; ++j)
+          packed[i * words + j / 4] |= uint64( uint32(rows[i][j]) & 0xFFFF ) << ( 16 * (j % 4) );
+    }
+
+    class HammingBatchTask : public Task, private boost::noncopyable {
+      std::vector<uint64> const& m_ref;
+      std::vector<uint64> const& m_query;
+      size_t m_words, m_knn, m_begin, m_end;
+      std::vector<size_t>& m_nearest;
+      const ProgressCallback& m_progress;
+      Mutex& m_progress_mutex;
+      float m_inc_amt;
+
+    public:
+      HammingBatchTask( std::vector<uint64> const& ref, std::vector<uint64> const& query,
+                        size_t words, size_t knn, size_t begin, size_t end,
+                        std::vector<size_t>& nearest, const ProgressCallback& progress,
+                        Mutex& progress_mutex, float inc_amt )
+        : m_ref(ref), m_query(query), m_words(words), m_knn(knn), m_begin(begin), m_end(end),
+          m_nearest(nearest), m_progress(progress), m_progress_mutex(progress_mutex),
+          m_inc_amt(inc_amt) {}
+
+      void operator()() {
+        if (m_progress.abort_requested())
+          return;
+
+        std::vector<uint32> best( (m_end - m_begin) * m_knn, std::numeric_limits<uint32>::max() );
+        hamming_scan( &m_ref[0], m_ref.size() / m_words,
+                      &m_query[m_begin * m_words], m_end - m_begin, m_words,
+                      m_knn, &best[0], &m_nearest[m_begin * m_knn] );
+
+        Mutex::Lock lock( m_progress_mutex );
+        m_progress.report_incremental_progress( m_inc_amt * float(m_end - m_begin) );
+      }
+    };
+  }
+
+  void detail::find_nearest_hamming( std::vector<const float*> const& ref,
+                                     std::vector<const float*> const& query, size_t dim,
+                                     size_t knn, std::vector<size_t>& nearest,
+                                     const ProgressCallback &progress_callback ) {
+    nearest.assign( query.size() * knn, size_t(-1) );
+    if (ref.empty() || query.empty() || knn == 0 || dim == 0)
+      return;
+
+    const size_t words = (dim + 3) / 4;
+    std::vector<uint64> packed_ref, packed_query;
+    pack_rows( ref, dim, words, packed_ref );
+    pack_rows( query, dim, words, packed_query );
+    progress_callback.report_progress(0);
+
+    typedef boost::shared_ptr<HammingBatchTask> task_t;
+    std::vector<task_t> tasks;
+    Mutex progress_mutex;
+    float inc_amt = 1.0f/float(query.size());
+    for (size_t begin = 0; begin < query.size(); begin += QUERY_BATCH)
+      tasks.push_back( task_t( new HammingBatchTask( packed_ref, packed_query, words, knn, begin,
+                                                     std::min( begin + QUERY_BATCH, query.size() ),
+                                                     nearest, progress_callback,
+                                                     progress_mutex, inc_amt ) ) );
+
+    int threads = std::min( int(vw_settings().default_num_threads()), int(tasks.size()) );
+    if (threads > 1) {
+      FifoWorkQueue queue( threads );
+      BOOST_FOREACH( task_t const& task, tasks )
+        queue.add_task( task );
+      queue.join_all();
+    } else {
+      BOOST_FOREACH( task_t const& task, tasks )
+        (*task)();
+    }
+    if (progress_callback.abort_requested())
+      vw_throw( Aborted() << "Aborted by ProgressCallback" );
+  }
+
   bool ScaleOrientationConstraint::operator()( InterestPoint const& baseline_ip,
                                                InterestPoint const& test_ip ) const {
     double sr = test_ip.scale / baseline_ip.scale;
@@ -87,16 +424,19 @@ namespace ip {
     ip1_fltr.reserve( ip1.size() );
     ip2_fltr.reserve( ip2.size() );
 
+    // A pair is dropped if a later pair shares either of its
+    // locations. Walk backwards, remembering the locations seen so far.
+    typedef std::pair<float,float> location_t;
+    std::set<location_t> seen1, seen2;
+    std::vector<bool> bad_entry( ip1.size() );
+    for ( size_t i = ip1.size(); i-- > 0; ) {
+      bool dup1 = !seen1.insert( location_t(ip1[i].x, ip1[i].y) ).second;
+      bool dup2 = !seen2.insert( location_t(ip2[i].x, ip2[i].y) ).second;
+      bad_entry[i] = dup1 || dup2;
+    }
+
     for ( size_t i = 0; i < ip1.size(); ++i ) {
-      bool bad_entry = false;
-      for ( size_t j = i + 1; j < ip1.size(); ++j ) {
-        if ( (ip1[i].x == ip1[j].x && ip1[i].y == ip1[j].y) ||
-             (ip2[i].x == ip2[j].x && ip2[i].y == ip2[j].y) ) {
-          bad_entry = true;
-          break;
-        }
-      }
-      if (!bad_entry) {
+      if (!bad_entry[i]) {
         ip1_fltr.push_back( ip1[i] );
         ip2_fltr.push_back( ip2[i] );
       }
@@ -27,14 +27,10 @@
 
 #include <vw/Core/Log.h>
 #include <vw/InterestPoint/Descriptor.h>
+#include <vw/InterestPoint/InterestPointSet.h>
 #include <vector>
 #include <boost/foreach.hpp>
 
-#if VW_HAVE_PKG_FLANN
-#include <vw/Math/FLANNTree.h>
-#else
-#include <vw/Math/KDTree.h>
-#endif
 
 namespace vw {
 namespace ip {
@@ -42,6 +38,10 @@ namespace ip {
   /// Interest point metrics must be of form:
   ///
   /// float operator() (const InterestPoint& ip1, const InterestPoint &ip2, float maxdist = DBL_MAX)
+  ///
+  /// InterestPointMatcher compares descriptors in place, so it also needs:
+  ///
+  /// float operator() (const float* desc1, const float* desc2, size_t size, float maxdist = DBL_MAX)
 
   /// L2 Norm: returns Euclidian distance squared between pair of
   /// interest point descriptors.  Optional argument "maxdist" to
@@ -50,6 +50,9 @@ namespace ip {
   struct L2NormMetric {
     float operator() (InterestPoint const& ip1, InterestPoint const& ip2,
                       float maxdist = std::numeric_limits<float>::max()) const;
+    /// The same, for two descriptor rows of an InterestPointSet
+    float operator() (const float* desc1, const float* desc2, size_t size,
+                      float maxdist = std::numeric_limits<float>::max()) const;
   };
 
   /// KL distance (relative entropy) between interest point
@@ -58,6 +61,18 @@ namespace ip {
   struct RelativeEntropyMetric {
     float operator() (InterestPoint const& ip1, InterestPoint const& ip2,
                       float maxdist = std::numeric_limits<float>::max()) const;
+    float operator() (const float* desc1, const float* desc2, size_t size,
+                      float maxdist = std::numeric_limits<float>::max()) const;
+  };
+
+  /// Hamming distance between binary descriptors, such as the ones from
+  /// BriefDescriptorGenerator: the number of bits that differ. Each
+  /// descriptor element holds 16 bits as a whole number.
+  struct HammingMetric {
+    float operator() (InterestPoint const& ip1, InterestPoint const& ip2,
+                      float maxdist = std::numeric_limits<float>::max()) const;
+    float operator() (const float* desc1, const float* desc2, size_t size,
+                      float maxdist = std::numeric_limits<float>::max()) const;
   };
 
   template <class ListT>
@@ -146,6 +161,50 @@ namespace ip {
   //                         Interest Point Matcher
   // ---------------------------------------------------------------------------
 
+  namespace detail {
+    /// Finds the knn nearest rows of ref, by L2 distance, for every row
+    /// of query. Rows are dim floats long. nearest gets knn entries per
+    /// query row, nearest first; missing neighbours are size_t(-1).
+    ///
+    /// Queries are searched in batches. With FLANN the batches are
+    /// spread over vw_settings().default_num_threads() threads.
+    void find_nearest( std::vector<const float*> const& ref,
+                       std::vector<const float*> const& query, size_t dim,
+                       size_t knn, std::vector<size_t>& nearest,
+                       const ProgressCallback &progress_callback = ProgressCallback::dummy_instance() );
+  }
+
+  namespace detail {
+    /// The same as find_nearest(), by Hamming distance. The descriptors
+    /// are repacked 64 bits to a word and searched by brute force.
+    void find_nearest_hamming( std::vector<const float*> const& ref,
+                               std::vector<const float*> const& query, size_t dim,
+                               size_t knn, std::vector<size_t>& nearest,
+                               const ProgressCallback &progress_callback = ProgressCallback::dummy_instance() );
+  }
+
+  /// How InterestPointMatcher finds the candidates for a metric. The
+  /// default is a kd-tree search by L2 distance.
+  template <class MetricT>
+  struct NearestNeighborSearch {
+    static void find_nearest( std::vector<const float*> const& ref,
+                              std::vector<const float*> const& query, size_t dim,
+                              size_t knn, std::vector<size_t>& nearest,
+                              const ProgressCallback &progress_callback = ProgressCallback::dummy_instance() ) {
+      detail::find_nearest( ref, query, dim, knn, nearest, progress_callback );
+    }
+  };
+
+  template <>
+  struct NearestNeighborSearch<HammingMetric> {
+    static void find_nearest( std::vector<const float*> const& ref,
+                              std::vector<const float*> const& query, size_t dim,
+                              size_t knn, std::vector<size_t>& nearest,
+                              const ProgressCallback &progress_callback = ProgressCallback::dummy_instance() ) {
+      detail::find_nearest_hamming( ref, query, dim, knn, nearest, progress_callback );
+    }
+  };
+
   /// Interest point matcher class
   template < class MetricT, class ConstraintT >
   class InterestPointMatcher {
@@ -153,6 +212,33 @@ namespace ip {
     MetricT m_distance_metric;
     double m_threshold;
     bool m_bidirectional;
+    bool m_mutual;
+
+    // Random access to the points of a list. An InterestPointSet
+    // already provides the same interface.
+    template <class ListT>
+    class ListPoints {
+      std::vector<const InterestPoint*> m_points;
+    public:
+      ListPoints( ListT const& list ) {
+        m_points.reserve( list.size() );
+        BOOST_FOREACH( InterestPoint const& ip, list )
+          m_points.push_back( &ip );
+      }
+      size_t size() const { return m_points.size(); }
+      bool empty() const { return m_points.empty(); }
+      size_t descriptor_size() const { return m_points.empty() ? 0 : m_points[0]->size(); }
+      const float* descriptor(size_t i) const { return &(m_points[i]->descriptor[0]); }
+      InterestPoint const& keypoint(size_t i) const { return *m_points[i]; }
+      InterestPoint const& point(size_t i) const { return *m_points[i]; }
+
+      void check_descriptors() const {
+        const size_t dim = descriptor_size();
+        BOOST_FOREACH( const InterestPoint* ip, m_points )
+          VW_ASSERT( ip->size() == dim && dim > 0,
+                     ArgumentErr() << "InterestPointMatcher: every point needs a descriptor of the same size." );
+      }
+    };
 
     // Helper function to help reduce conditionals in the event of
     // NullConstraint. (Which is common).
@@ -176,88 +262,126 @@ namespace ip {
       return true;
     }
 
-  public:
-
-    InterestPointMatcher(double threshold = 0.5, MetricT metric = MetricT(), ConstraintT constraint = ConstraintT(), bool bidirectional = false)
-      : m_constraint(constraint), m_distance_metric(metric), m_threshold(threshold), m_bidirectional(bidirectional) { }
+    // Same as above, for points given by index. Sets hand out keypoint()
+    // copies, so this skips making them when there is no constraint.
+    template <class InConstraintT, class PointsT>
+    typename boost::disable_if<boost::is_same<InConstraintT,NullConstraint>, bool>::type
+    check_constraint( PointsT const& pts1, size_t i1, PointsT const& pts2, size_t i2 ) const {
+      return check_constraint<InConstraintT>( pts1.keypoint(i1), pts2.keypoint(i2) );
+    }
 
-    /// Given two lists of interest points, this write to index_list
-    /// the corresponding matching index in ip2. index_list is the
-    /// same length as ip1. index_list will be filled with max value
-    /// of size_t in the event that a match was not found.
-    template <class ListT, class IndexListT >
-    void operator()( ListT const& ip1, ListT const& ip2,
-                     IndexListT& index_list,
-                     const ProgressCallback &progress_callback = ProgressCallback::dummy_instance() ) const {
-      typedef typename ListT::const_iterator IterT;
+    template <class InConstraintT, class PointsT>
+    typename boost::enable_if<boost::is_same<InConstraintT,NullConstraint>, bool>::type
+    check_constraint( PointsT const& /*pts1*/, size_t /*i1*/, PointsT const& /*pts2*/, size_t /*i2*/ ) const {
+      return true;
+    }
 
+    // Find the match in ip2 for each point of ip1, or size_t(-1) if there
+    // isn't a good enough one.
+    template <class PointsT>
+    void find_matches( PointsT const& ip1, PointsT const& ip2,
+                       std::vector<size_t>& match,
+                       const ProgressCallback &progress_callback ) const {
       Timer total_time("Total elapsed time", DebugMessage, "interest_point");
-      size_t ip1_size = ip1.size(), ip2_size = ip2.size();
 
-      index_list.clear();
-      if (!ip1_size || !ip2_size) {
+      match.assign( ip1.size(), size_t(-1) );
+      if (ip1.empty() || ip2.empty()) {
         vw_out(InfoMessage,"interest_point") << "KD-Tree: no points to match, exiting\n";
         progress_callback.report_finished();
         return;
       }
+      VW_ASSERT( ip1.descriptor_size() == ip2.descriptor_size(),
+                 ArgumentErr() << "InterestPointMatcher: the two sides have different descriptor sizes." );
+
+      const size_t dim = ip2.descriptor_size();
+      std::vector<const float*> rows1( ip1.size() ), rows2( ip2.size() );
+      for (size_t i = 0; i < ip1.size(); ++i)
+        rows1[i] = ip1.descriptor(i);
+      for (size_t i = 0; i < ip2.size(); ++i)
+        rows2[i] = ip2.descriptor(i);
+
+      std::vector<size_t> nearest;
+      NearestNeighborSearch<MetricT>::find_nearest( rows2, rows1, dim, 2, nearest, progress_callback );
+
+      for (size_t i = 0; i < ip1.size(); ++i) {
+        size_t best = nearest[2*i], second = nearest[2*i+1];
+        if (second == size_t(-1))
+          continue; // Ignore if there are no matches
 
-      float inc_amt = 1.0f/float(ip1_size);
+        if ( check_constraint<ConstraintT>( ip2, best, ip1, i ) ) {
+          double dist0 = m_distance_metric(rows2[best], rows1[i], dim);
+          double dist1 = m_distance_metric(rows2[second], rows1[i], dim);
 
-#if VW_HAVE_PKG_FLANN
-      Matrix<float> ip2_matrix( ip2_size, ip2.begin()->size() );
-      Matrix<float>::iterator ip2_matrix_it = ip2_matrix.begin();
-      BOOST_FOREACH( InterestPoint const& ip, ip2 )
-        ip2_matrix_it = std::copy( ip.begin(), ip.end(), ip2_matrix_it );
+          if (dist0 < m_threshold * dist1)
+            match[i] = best;
+        }
+      }
 
-      math::FLANNTree<float> kd( ip2_matrix );
-      vw_out(InfoMessage,"interest_point") << "FLANN-Tree created. Searching...\n";
+      if (m_mutual)
+        keep_mutual( rows1, rows2, dim, match );
 
-      Vector<int> indices(2);
-      Vector<float> distances(2);
-#else
-      math::KDTree<ListT> kd(ip2.begin()->size(), ip2);
-      vw_out(InfoMessage,"interest_point") << "KD-Tree created with " << kd.size() << " nodes and depth ranging from " << kd.min_depth() << " to " << kd.max_depth() << ".  Searching...\n";
-#endif
-      progress_callback.report_progress(0);
+      progress_callback.report_finished();
+    }
 
-      BOOST_FOREACH( InterestPoint ip, ip1 ) {
-        if (progress_callback.abort_requested())
-          vw_throw( Aborted() << "Aborted by ProgressCallback" );
-        progress_callback.report_incremental_progress(inc_amt);
+    // Drop every match whose ip2 point doesn't pick the same ip1 point
+    // back. Only the ip2 points that were matched get searched.
+    void keep_mutual( std::vector<const float*> const& rows1,
+                      std::vector<const float*> const& rows2, size_t dim,
+                      std::vector<size_t>& match ) const {
+      std::vector<size_t> targets;
+      BOOST_FOREACH( size_t m, match )
+        if (m != size_t(-1))
+          targets.push_back( m );
+      std::sort( targets.begin(), targets.end() );
+      targets.erase( std::unique( targets.begin(), targets.end() ), targets.end() );
+      if (targets.empty())
+        return;
 
-        std::vector<InterestPoint> nearest_records(2);
-#if VW_HAVE_PKG_FLANN
-        kd.knn_search( ip.descriptor, indices, distances, 2 );
-        typename ListT::const_iterator iterator = ip2.begin();
-        std::advance( iterator, indices[0] );
-        nearest_records[0] = *iterator;
-        iterator = ip2.begin();
-        std::advance( iterator, indices[1] );
-        nearest_records[1] = *iterator;
-#else
-        int num_records = kd.m_nearest_neighbors(ip, nearest_records, 2);
-        if (num_records != 2)
-          continue; // Ignore if there are no matches
-#endif
-
-        if ( check_constraint<ConstraintT>( nearest_records[0], ip ) ) {
-          double dist0 = m_distance_metric(nearest_records[0], ip);
-          double dist1 = m_distance_metric(nearest_records[1], ip);
-
-          if (dist0 < m_threshold * dist1) {
-#if VW_HAVE_PKG_FLANN
-            index_list.push_back( indices[0] );
-#else
-            index_list.push_back( (size_t)(std::find(ip2.begin(),ip2.end(),
-                                                     nearest_records[0]) - ip2.begin()) );
-#endif
-          } else {
-            index_list.push_back( (size_t)(-1) ); // Last value of size_t
-          }
-        }
+      std::vector<const float*> queries( targets.size() );
+      for (size_t t = 0; t < targets.size(); ++t)
+        queries[t] = rows2[targets[t]];
+
+      std::vector<size_t> reverse;
+      NearestNeighborSearch<MetricT>::find_nearest( rows1, queries, dim, 1, reverse );
+
+      for (size_t i = 0; i < match.size(); ++i) {
+        if (match[i] == size_t(-1))
+          continue;
+        size_t t = std::lower_bound( targets.begin(), targets.end(), match[i] ) - targets.begin();
+        // Ties go to whichever point the search saw first, so compare
+        // distances rather than indices
+        if ( reverse[t] != i &&
+             m_distance_metric(rows1[reverse[t]], rows2[match[i]], dim) < m_distance_metric(rows1[i], rows2[match[i]], dim) )
+          match[i] = size_t(-1);
       }
     }
 
+  public:
+
+    /// bidirectional applies the constraint in both directions. mutual
+    /// additionally requires that each matched ip2 point has its ip1
+    /// point as its own nearest neighbour.
+    InterestPointMatcher(double threshold = 0.5, MetricT metric = MetricT(), ConstraintT constraint = ConstraintT(), bool bidirectional = false, bool mutual = false)
+      : m_constraint(constraint), m_distance_metric(metric), m_threshold(threshold), m_bidirectional(bidirectional), m_mutual(mutual) { }
+
+    /// Given two lists of interest points, this write to index_list
+    /// the corresponding matching index in ip2. index_list is the
+    /// same length as ip1. index_list will be filled with max value
+    /// of size_t in the event that a match was not found.
+    template <class ListT, class IndexListT >
+    void operator()( ListT const& ip1, ListT const& ip2,
+                     IndexListT& index_list,
+                     const ProgressCallback &progress_callback = ProgressCallback::dummy_instance() ) const {
+      ListPoints<ListT> pts1( ip1 ), pts2( ip2 );
+      pts1.check_descriptors(); pts2.check_descriptors();
+
+      std::vector<size_t> match;
+      find_matches( pts1, pts2, match, progress_callback );
+      index_list.clear();
+      BOOST_FOREACH( size_t m, match )
+        index_list.push_back( m );
+    }
+
     /// Given two lists of interest points, this routine returns the two lists
     /// of matching interest points based on the Metric and Constraints
     /// provided by the user.
@@ -265,69 +389,48 @@ namespace ip {
     void operator()( ListT const& ip1, ListT const& ip2,
                      MatchListT& matched_ip1, MatchListT& matched_ip2,
                      const ProgressCallback &progress_callback = ProgressCallback::dummy_instance() ) const {
-      typedef typename ListT::const_iterator IterT;
-
-      Timer total_time("Total elapsed time", DebugMessage, "interest_point");
-      size_t ip1_size = ip1.size(), ip2_size = ip2.size();
-
-      matched_ip1.clear(); matched_ip2.clear();
-      if (!ip1_size || !ip2_size) {
-        vw_out(InfoMessage,"interest_point") << "KD-Tree: no points to match, exiting\n";
-        progress_callback.report_finished();
-        return;
-      }
-
-      float inc_amt = 1.0f/float(ip1_size);
-
-#if VW_HAVE_PKG_FLANN
-      Matrix<float> ip2_matrix( ip2_size, ip2.begin()->size() );
-      Matrix<float>::iterator ip2_matrix_it = ip2_matrix.begin();
-      BOOST_FOREACH( InterestPoint const& ip, ip2 )
-        ip2_matrix_it = std::copy( ip.begin(), ip.end(), ip2_matrix_it );
-
-      math::FLANNTree<float> kd( ip2_matrix );
-      vw_out(InfoMessage,"interest_point") << "FLANN-Tree created. Searching...\n";
-
-      Vector<int> indices(2);
-      Vector<float> distances(2);
-#else
-      math::KDTree<ListT> kd(ip2.begin()->size(), ip2);
-      vw_out(InfoMessage,"interest_point") << "KD-Tree created with " << kd.size() << " nodes and depth ranging from " << kd.min_depth() << " to " << kd.max_depth() << ".  Searching...\n";
-#endif
-      progress_callback.report_progress(0);
+      ListPoints<ListT> pts1( ip1 ), pts2( ip2 );
+      pts1.check_descriptors(); pts2.check_descriptors();
 
-      BOOST_FOREACH( InterestPoint ip, ip1 ) {
-        if (progress_callback.abort_requested())
-          vw_throw( Aborted() << "Aborted by ProgressCallback" );
-        progress_callback.report_incremental_progress(inc_amt);
+      std::vector<size_t> match;
+      find_matches( pts1, pts2, match, progress_callback );
+      copy_matches( pts1, pts2, match, matched_ip1, matched_ip2 );
+    }
 
-        std::vector<InterestPoint> nearest_records(2);
-#if VW_HAVE_PKG_FLANN
-        kd.knn_search( ip.descriptor, indices, distances, 2 );
-        typename ListT::const_iterator iterator = ip2.begin();
-        std::advance( iterator, indices[0] );
-        nearest_records[0] = *iterator;
-        iterator = ip2.begin();
-        std::advance( iterator, indices[1] );
-        nearest_records[1] = *iterator;
-#else
-        int num_records = kd.m_nearest_neighbors(ip, nearest_records, 2);
-        if (num_records != 2)
-          continue; // Ignore if there are no matches
-#endif
+    /// The InterestPointSet versions of the above. The descriptors are
+    /// searched in place.
+    template <class IndexListT>
+    void operator()( InterestPointSet const& ip1, InterestPointSet const& ip2,
+                     IndexListT& index_list,
+                     const ProgressCallback &progress_callback = ProgressCallback::dummy_instance() ) const {
+      std::vector<size_t> match;
+      find_matches( ip1, ip2, match, progress_callback );
+      index_list.clear();
+      BOOST_FOREACH( size_t m, match )
+        index_list.push_back( m );
+    }
 
-        if ( check_constraint<ConstraintT>( nearest_records[0], ip ) ) {
-          double dist0 = m_distance_metric(nearest_records[0], ip);
-          double dist1 = m_distance_metric(nearest_records[1], ip);
+    template <class MatchListT>
+    void operator()( InterestPointSet const& ip1, InterestPointSet const& ip2,
+                     MatchListT& matched_ip1, MatchListT& matched_ip2,
+                     const ProgressCallback &progress_callback = ProgressCallback::dummy_instance() ) const {
+      std::vector<size_t> match;
+      find_matches( ip1, ip2, match, progress_callback );
+      copy_matches( ip1, ip2, match, matched_ip1, matched_ip2 );
+    }
 
-          if (dist0 < m_threshold * dist1) {
-            matched_ip1.push_back(ip);
-            matched_ip2.push_back(nearest_records[0]);
-          }
-        }
+  private:
+    template <class PointsT, class MatchListT>
+    static void copy_matches( PointsT const& ip1, PointsT const& ip2,
+                              std::vector<size_t> const& match,
+                              MatchListT& matched_ip1, MatchListT& matched_ip2 ) {
+      matched_ip1.clear(); matched_ip2.clear();
+      for (size_t i = 0; i < match.size(); ++i) {
+        if (match[i] == size_t(-1))
+          continue;
+        matched_ip1.push_back( ip1.point(i) );
+        matched_ip2.push_back( ip2.point(match[i]) );
       }
-
-      progress_callback.report_finished();
     }
   };
 
@@ -412,6 +515,7 @@ namespace ip {
   // Convenience Typedefs
   typedef InterestPointMatcher< L2NormMetric, NullConstraint > DefaultMatcher;
   typedef InterestPointMatcher< L2NormMetric, ScaleOrientationConstraint > ConstraintedMatcher;
+  typedef InterestPointMatcher< HammingMetric, NullConstraint > BinaryMatcher;
 
   // Matching doesn't constraint a point to being matched to only one
   // other point. Here's a way to remove duplicates and have only
@@ -0,0 +1,127 @@
+// __BEGIN_LICENSE__
+//  Copyright (c) 2006-2013, United States Government as represented by the
+//  Administrator of the National Aeronautics and Space Administration. All
+//  rights reserved.
+//
+//  The NASA Vision Workbench is licensed under the Apache License,
+//  Version 2.0 (the "License"); you may not use this file except in
+//  compliance with the License. You may obtain a copy of the License at
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+// __END_LICENSE__
+
+
+#include <gtest/gtest_VW.h>
+#include <test/Helpers.h>
+#include <vw/InterestPoint/Descriptor.h>
+#include <vw/InterestPoint/IntegralDescriptor.h>
+#include <vw/InterestPoint/Matcher.h>
+
+using namespace vw;
+using namespace vw::ip;
+
+namespace {
+  ImageView<PixelGray<float> > random_patch( int size ) {
+    ImageView<PixelGray<float> > patch( size, size );
+    for ( int j = 0; j < size; j++ )
+      for ( int i = 0; i < size; i++ )
+        patch(i,j) = float(rand()) / float(RAND_MAX);
+    return patch;
+  }
+
+  Vector<float> brief( ImageView<PixelGray<float> > const& patch ) {
+    BriefDescriptorGenerator generator;
+    Vector<float> result( generator.descriptor_size() );
+    generator.compute_descriptor( patch, result.begin(), result.end() );
+    return result;
+  }
+}
+
+TEST( Descriptor, BriefPattern ) {
+  const std::vector<int8>& pattern = BriefDescriptorGenerator::test_pattern;
+  ASSERT_EQ( size_t(BriefDescriptorGenerator::TESTS * 4), pattern.size() );
+
+  // Every box has to fit in the default support region
+  const int limit = 41 / 2 - BriefDescriptorGenerator::BOX_RADIUS - 1;
+  int nonzero = 0;
+  for ( size_t i = 0; i < pattern.size(); i++ ) {
+    EXPECT_LE( abs(pattern[i]), limit );
+    if ( pattern[i] != 0 )
+      nonzero++;
+  }
+  EXPECT_GT( nonzero, int(pattern.size()) / 2 );
+}
+
+TEST( Descriptor, Brief ) {
+  ImageView<PixelGray<float> > patch = random_patch( 41 );
+  Vector<float> desc = brief( patch );
+  ASSERT_EQ( 16u, desc.size() );
+
+  // Whole 16 bit words, and about half the bits set
+  size_t bits = 0;
+  for ( size_t i = 0; i < desc.size(); i++ ) {
+    EXPECT_EQ( floor(desc[i]), desc[i] );
+    EXPECT_LT( desc[i], 65536 );
+    for ( uint32 word = uint32(desc[i]); word; word &= word - 1 )
+      bits++;
+  }
+  EXPECT_GT( bits, 64u );
+  EXPECT_LT( bits, 192u );
+
+  // The tests only compare intensities, so gain and offset don't matter
+  ImageView<PixelGray<float> > brighter( 41, 41 );
+  for ( int j = 0; j < 41; j++ )
+    for ( int i = 0; i < 41; i++ )
+      brighter(i,j) = patch(i,j) * 2 + 1;
+  EXPECT_VECTOR_EQ( desc, brief( brighter ) );
+
+  // A different patch is about half the bits away
+  HammingMetric hamming;
+  float dist = hamming( &desc[0], &brief( random_patch( 41 ) )[0], desc.size() );
+  EXPECT_GT( dist, 64 );
+  EXPECT_LT( dist, 192 );
+  EXPECT_EQ( 0, hamming( &desc[0], &desc[0], desc.size() ) );
+}
+
+// Describing through a shared integral image has to give the same
+// descriptors as describing the image, whatever the table sums into.
+TEST( Descriptor, SharedIntegral ) {
+  srand( 7 );
+  ImageView<PixelGray<float> > image = random_patch( 96 );
+  ImageView<uint8> image8( 96, 96 );
+  for ( int j = 0; j < 96; j++ )
+    for ( int i = 0; i < 96; i++ )
+      image8(i,j) = uint8( image(i,j).v() * 255 );
+
+  InterestPointList points;
+  points.push_back( InterestPoint( 40, 45, 1.0, 0, 0.0 ) );
+  points.push_back( InterestPoint( 50, 52, 1.5, 0, 0.7 ) );
+  points.push_back( InterestPoint( 47, 38, 2.0, 0, -1.2 ) );
+  Cache cache( 16 << 20 );
+
+  SGrad2DescriptorGenerator generator;
+  InterestPointList direct = points, shared = points, shared_double = points;
+  generator( image, direct );
+  generator( integral_image( image, cache ), shared );
+  generator( IntegralImageView<ImageView<PixelGray<float> >, double>( image, cache ), shared_double );
+
+  InterestPointList direct8 = points, shared8 = points;
+  generator( image8, direct8 );
+  generator( integral_image( image8, cache ), shared8 );
+
+  InterestPointList::const_iterator d = direct.begin(), s = shared.begin(), sd = shared_double.begin(),
+    d8 = direct8.begin(), s8 = shared8.begin();
+  for ( ; d != direct.end(); ++d, ++s, ++sd, ++d8, ++s8 ) {
+    ASSERT_EQ( d->size(), s->size() );
+    ASSERT_EQ( d->size(), sd->size() );
+    EXPECT_GT( norm_2( d->descriptor ), 0 );
+    EXPECT_VECTOR_NEAR( d->descriptor, s->descriptor, 1e-4 );
+    EXPECT_VECTOR_NEAR( d->descriptor, sd->descriptor, 1e-6 );
+    EXPECT_VECTOR_NEAR( d8->descriptor, s8->descriptor, 1e-6 );
+  }
+}
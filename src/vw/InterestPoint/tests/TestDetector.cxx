@@ -0,0 +1,152 @@
+// __BEGIN_LICENSE__
+//  Copyright (c) 2006-2013, United States Government as represented by the
+//  Administrator of the National Aeronautics and Space Administration. All
+//  rights reserved.
+//
+//  The NASA Vision Workbench is licensed under the Apache License,
+//  Version 2.0 (the "License"); you may not use this file except in
+//  compliance with the License. You may obtain a copy of the License at
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+// __END_LICENSE__
+
+
+#include <gtest/gtest_VW.h>
+#include <test/Helpers.h>
+#include <vw/InterestPoint/IntegralDetector.h>
+#include <vw/InterestPoint/IntegralInterestOperator.h>
+
+#include <set>
+
+using namespace vw;
+using namespace vw::ip;
+
+namespace {
+  // Bright blobs of a few sizes scattered over a black background,
+  // including some that straddle the 1024 pixel block edges. The black
+  // background keeps the sums in the whole-image integral small enough
+  // for float to compare it with the per-block ones.
+  ImageView<PixelGray<float> > blob_image( int cols, int rows, int count ) {
+    ImageView<PixelGray<float> > image( cols, rows );
+    fill( image, PixelGray<float>(0) );
+    srand(7);
+    for ( int b = 0; b < count; b++ ) {
+      float cx = 10 + rand() % (cols - 20), cy = 10 + rand() % (rows - 20);
+      float sigma = 1.5 + 3.0 * float(rand()) / float(RAND_MAX);
+      int r = int(3 * sigma) + 1;
+      for ( int j = std::max(0, int(cy) - r); j < std::min(rows, int(cy) + r + 1); j++ )
+        for ( int i = std::max(0, int(cx) - r); i < std::min(cols, int(cx) + r + 1); i++ ) {
+          float d2 = (i - cx)*(i - cx) + (j - cy)*(j - cy);
+          image(i,j) = image(i,j) + 0.6 * exp( -d2 / (2 * sigma * sigma) );
+        }
+    }
+    return image;
+  }
+
+  // A point is its position and scale; the detector can report one
+  // position at several scales.
+  typedef std::pair<std::pair<int,int>, float> Location;
+
+  std::set<Location> locations( InterestPointList const& points ) {
+    std::set<Location> result;
+    for ( InterestPointList::const_iterator pt = points.begin(); pt != points.end(); ++pt )
+      result.insert( std::make_pair( std::make_pair( pt->ix, pt->iy ), pt->scale ) );
+    return result;
+  }
+}
+
+TEST( Detector, InterestPointHeap ) {
+  InterestPointHeap heap( 3 );
+  float interest[] = { 1, 5, 2, 5, 9, 0, 5 };
+  for ( int i = 0; i < 7; i++ )
+    heap.push( InterestPoint( i, 0, 1, interest[i] ) );
+  EXPECT_EQ( 3u, heap.size() );
+
+  // The best three, ties going to the earlier point, in push order
+  InterestPointList points;
+  heap.pop_all( points );
+  ASSERT_EQ( 3u, points.size() );
+  InterestPointList::const_iterator pt = points.begin();
+  EXPECT_EQ( 1, pt->x ); ++pt;
+  EXPECT_EQ( 3, pt->x ); ++pt;
+  EXPECT_EQ( 4, pt->x );
+  EXPECT_EQ( 0u, heap.size() );
+}
+
+TEST( Detector, TiledMatchesWhole ) {
+  ImageView<PixelGray<float> > image = blob_image( 2200, 1100, 1000 );
+  IntegralInterestPointDetector<OBALoGInterestOperator> detector( 0 );
+  EXPECT_GT( detector.tile_halo(), 0 );
+
+  InterestPointList whole = detector( image );
+  InterestPointList tiled = detect_interest_points( image, detector );
+  ASSERT_GT( whole.size(), 1000u );
+
+  // No point is reported by two blocks
+  std::set<Location> tiled_at = locations( tiled );
+  EXPECT_EQ( tiled.size(), tiled_at.size() );
+
+  // and the block edges don't lose any. The integral image sums start
+  // from a different corner in each block, so allow for a few points
+  // sitting right on the threshold.
+  std::set<Location> whole_at = locations( whole );
+  size_t common = 0;
+  for ( std::set<Location>::const_iterator it = whole_at.begin(); it != whole_at.end(); ++it )
+    common += tiled_at.count( *it );
+  EXPECT_GE( common, whole_at.size() - whole_at.size() / 200 );
+  EXPECT_LE( tiled_at.size(), whole_at.size() + whole_at.size() / 200 );
+}
+
+TEST( Detector, SharedIntegral ) {
+  ImageView<PixelGray<float> > image = blob_image( 2200, 1100, 1000 );
+  IntegralInterestPointDetector<OBALoGInterestOperator> detector( 0 ), shared( 0 );
+  Cache cache( 64 << 20 );
+  shared.set_integral( IntegralImageView<ImageView<PixelGray<float> >, double>( image, cache ) );
+
+  // Each block's table is cut from the shared one instead of summed
+  // again, so the same points come out.
+  InterestPointList own = detect_interest_points( image, detector );
+  InterestPointList cut = detect_interest_points( image, shared );
+  ASSERT_GT( own.size(), 1000u );
+  std::set<Location> own_at = locations( own ), cut_at = locations( cut );
+  size_t common = 0;
+  for ( std::set<Location>::const_iterator it = own_at.begin(); it != own_at.end(); ++it )
+    common += cut_at.count( *it );
+  EXPECT_GE( common, own_at.size() - own_at.size() / 200 );
+  EXPECT_LE( cut_at.size(), own_at.size() + own_at.size() / 200 );
+
+  // A table of some other image is refused
+  shared.set_integral( IntegralImageView<ImageView<PixelGray<float> >, double>( blob_image( 100, 100, 5 ), cache ) );
+  EXPECT_THROW( shared( image, BBox2i( 0, 0, 100, 100 ) ), ArgumentErr );
+}
+
+TEST( Detector, TopK ) {
+  ImageView<PixelGray<float> > image = blob_image( 2200, 1100, 1000 );
+  IntegralInterestPointDetector<OBALoGInterestOperator> detector( 0 );
+
+  InterestPointList all = detect_interest_points( image, detector );
+  InterestPointList best;
+  detect_interest_points( image, detector, best, 100 );
+  ASSERT_EQ( 100u, best.size() );
+
+  // Same points as culling the full list
+  all.sort();
+  all.resize( 100 );
+  best.sort();
+  InterestPointList::const_iterator a = all.begin(), b = best.begin();
+  for ( ; a != all.end(); ++a, ++b ) {
+    EXPECT_EQ( a->interest, b->interest );
+    EXPECT_EQ( a->x, b->x );
+    EXPECT_EQ( a->y, b->y );
+  }
+
+  // The set output gets the same points
+  InterestPointSet set;
+  detect_interest_points( image, detector, set, 100 );
+  EXPECT_EQ( 100u, set.size() );
+}
@@ -23,6 +23,7 @@
 #include <vw/Image/ImageView.h>
 #include <vw/Image/Interpolation.h>
 #include <vw/FileIO/DiskImageResource.h>
+#include <boost/type_traits/is_same.hpp>
 
 using namespace vw;
 using namespace vw::ip;
@@ -247,3 +248,72 @@ TEST( Integral, InterpolationProof ) {
                              10.5, 10.0, 10 ),
                1e-4 );
 }
+
+TEST( Integral, Stripes ) {
+  ImageView<uint8> image( 97, 203 );
+  srand(3);
+  for ( int j = 0; j < image.rows(); j++ )
+    for ( int i = 0; i < image.cols(); i++ )
+      image(i,j) = rand() % 256;
+
+  ImageView<int64> expected( image.cols()+1, image.rows()+1 );
+  for ( int j = 0; j < expected.rows(); j++ )
+    for ( int i = 0; i < expected.cols(); i++ ) {
+      int64 sum = 0;
+      for ( int y = 0; y < j; y++ )
+        for ( int x = 0; x < i; x++ )
+          sum += image(x,y);
+      expected(i,j) = sum;
+    }
+
+  // One stripe, several stripes serially, and several in parallel,
+  // including a short last stripe.
+  ImageView<int64> whole = IntegralImage( image );
+  ImageView<int64> serial = IntegralImage<int64>( image, 1, 16 );
+  ImageView<int64> parallel = IntegralImage<int64>( image, 4, 16 );
+  ImageView<int64> cropped = IntegralImage<int64>( crop( image, 5, 7, 60, 150 ), 4, 16 );
+  for ( int j = 0; j < expected.rows(); j++ )
+    for ( int i = 0; i < expected.cols(); i++ ) {
+      ASSERT_EQ( expected(i,j), whole(i,j) );
+      ASSERT_EQ( expected(i,j), serial(i,j) );
+      ASSERT_EQ( expected(i,j), parallel(i,j) );
+    }
+  for ( int j = 0; j < cropped.rows(); j++ )
+    for ( int i = 0; i < cropped.cols(); i++ )
+      ASSERT_EQ( expected(i+5,j+7) - expected(5,j+7) - expected(i+5,7) + expected(5,7), cropped(i,j) );
+}
+
+TEST( Integral, Accumulator ) {
+  EXPECT_TRUE(( boost::is_same<float,  IntegralAccumulatorType<float>::type>::value ));
+  EXPECT_TRUE(( boost::is_same<double, IntegralAccumulatorType<double>::type>::value ));
+  EXPECT_TRUE(( boost::is_same<int64,  IntegralAccumulatorType<uint8>::type>::value ));
+  EXPECT_TRUE(( boost::is_same<int64,  IntegralAccumulatorType<int16>::type>::value ));
+
+  // 8-bit sums that overflow 32 bits
+  ImageView<uint8> image( 4096, 4096 );
+  fill( image, 255 );
+  ImageView<int64> integral = IntegralImage( image );
+  EXPECT_EQ( int64(255) * 4096 * 4096, integral(4096,4096) );
+}
+
+TEST( Integral, SharedView ) {
+  ImageView<float> image( 120, 80 );
+  for ( int j = 0; j < image.rows(); j++ )
+    for ( int i = 0; i < image.cols(); i++ )
+      image(i,j) = float(i*j % 17) / 17;
+  Cache cache( 16 << 20 );
+
+  IntegralImageView<ImageView<float>, double> view( image, cache );
+  IntegralImageView<ImageView<float>, double> copy = view;
+  EXPECT_EQ( image.cols() + 1, view.cols() );
+  EXPECT_EQ( image.rows() + 1, view.rows() );
+
+  // Built once, shared by copies
+  ImageView<double> a = view.table(), b = copy.table();
+  EXPECT_EQ( &a(0,0), &b(0,0) );
+
+  ImageView<double> expected = IntegralImage<double>( image );
+  EXPECT_EQ( expected(10,20), copy(10,20) );
+  ImageView<double> rasterized = view;
+  EXPECT_EQ( expected(image.cols(), image.rows()), rasterized(image.cols(), image.rows()) );
+}
@@ -19,6 +19,9 @@
 #include <gtest/gtest_VW.h>
 #include <test/Helpers.h>
 #include <vw/InterestPoint/InterestData.h>
+#include <vw/InterestPoint/InterestPointSet.h>
+
+#include <fstream>
 
 using namespace vw;
 using namespace vw::ip;
@@ -108,3 +111,89 @@ TEST( InterestData, MATCH_IO_Loop ) {
     ip1iter++; ip2iter++;
   }
 }
+
+TEST( InterestData, SetLayout ) {
+  InterestPointList ip;
+  for ( uint32 i = 0; i < 5; i++ ) {
+    ip.push_back( InterestPoint( 2*i, 2*i+5, 1.0, -i, i, true, 5 ) );
+    ip.back().descriptor = Vector3(5,6,i);
+  }
+
+  InterestPointSet set( ip.begin(), ip.end() );
+  ASSERT_EQ( 5u, set.size() );
+  EXPECT_EQ( 3u, set.descriptor_size() );
+  EXPECT_GE( set.descriptor_stride(), set.descriptor_size() );
+  EXPECT_EQ( 0u, size_t(set.descriptor_data()) % 16 );
+
+  InterestPointList::iterator ipiter = ip.begin();
+  for ( uint32 i = 0; i < 5; i++, ipiter++ ) {
+    EXPECT_EQ( ipiter->x, set.x(i) );
+    EXPECT_EQ( ipiter->orientation, set.orientation(i) );
+    EXPECT_EQ( set.descriptor_data() + i * set.descriptor_stride(), set.descriptor(i) );
+    EXPECT_VECTOR_FLOAT_EQ( ipiter->descriptor, set.descriptor_vector(i) );
+    EXPECT_VECTOR_FLOAT_EQ( ipiter->descriptor, set.point(i).descriptor );
+    EXPECT_EQ( 0u, set.keypoint(i).size() );
+  }
+
+  // Writes through the proxy land in the set
+  set.descriptor_vector(2)[1] = 42;
+  EXPECT_EQ( 42, set.point(2).descriptor[1] );
+
+  InterestPoint odd( 1, 1 );
+  odd.descriptor = Vector2(1,2);
+  EXPECT_THROW( set.push_back( odd ), ArgumentErr );
+  EXPECT_EQ( 5u, set.size() );
+}
+
+TEST( InterestData, VWIP_Set_IO_Loop ) {
+  InterestPointList ip;
+  for ( uint32 i = 0; i < 5; i++ ) {
+    ip.push_back( InterestPoint( 2*i, 2*i+5, 1.0, -i, i, i % 2, 5 ) );
+    ip.back().descriptor = Vector3(5,6,i);
+  }
+
+  // Sets and lists read each other's files
+  UnlinkName vwip_file( "monkey_set.vwip" );
+  write_binary_ip_file( vwip_file, InterestPointSet( ip.begin(), ip.end() ) );
+  std::vector<InterestPoint> result = read_binary_ip_file( vwip_file );
+  InterestPointSet set_result;
+  read_binary_ip_file( vwip_file, set_result );
+
+  ASSERT_EQ( 5u, result.size() );
+  ASSERT_EQ( 5u, set_result.size() );
+  InterestPointList::iterator ipiter = ip.begin();
+  for ( uint32 i = 0; i < 5; i++, ipiter++ ) {
+    InterestPoint from_set = set_result.point(i);
+    EXPECT_EQ( ipiter->x, result[i].x );
+    EXPECT_EQ( ipiter->y, from_set.y );
+    EXPECT_EQ( ipiter->scale, from_set.scale );
+    EXPECT_EQ( ipiter->ix, from_set.ix );
+    EXPECT_EQ( ipiter->iy, from_set.iy );
+    EXPECT_EQ( ipiter->interest, from_set.interest );
+    EXPECT_EQ( ipiter->polarity, result[i].polarity );
+    EXPECT_EQ( ipiter->polarity, from_set.polarity );
+    EXPECT_EQ( ipiter->octave, from_set.octave );
+    EXPECT_EQ( ipiter->scale_lvl, from_set.scale_lvl );
+    EXPECT_VECTOR_FLOAT_EQ( ipiter->descriptor, result[i].descriptor );
+    EXPECT_VECTOR_FLOAT_EQ( ipiter->descriptor, from_set.descriptor );
+  }
+}
+
+TEST( InterestData, VWIP_Set_Bad_Count ) {
+  InterestPointList ip;
+  ip.push_back( InterestPoint( 1, 2, 1.0, 0, 0, true, 5 ) );
+  ip.back().descriptor = Vector3(5,6,7);
+
+  // Claim far more points than the file holds; this should fail as a
+  // truncated file rather than trying to allocate for the bogus count.
+  UnlinkName vwip_file( "monkey_bad.vwip" );
+  write_binary_ip_file( vwip_file, ip );
+  {
+    std::fstream f( vwip_file.c_str(), std::ios::binary | std::ios::in | std::ios::out );
+    uint64 size = uint64(1) << 60;
+    f.write( (char*)&size, sizeof(uint64) );
+  }
+
+  InterestPointSet set;
+  EXPECT_THROW( read_binary_ip_file( vwip_file, set ), IOErr );
+}
@@ -118,3 +118,153 @@ TEST( Matcher, Matcher ) {
 }
 
 
+
+TEST( Matcher, MatcherSet ) {
+  std::vector<InterestPoint> ip1_list, ip2_list;
+  ip1_list.push_back( InterestPoint(0,0,1.0,1.0,0.0) );
+  ip1_list.back().descriptor = Vector3(0,7.7,0);
+  for ( int i = 5; i < 10; i++ ) {
+    ip2_list.push_back( InterestPoint(20,0,2.0,2.0,M_PI) );
+    ip2_list.back().descriptor = Vector3(0,i,0);
+  }
+
+  InterestPointSet ip1( ip1_list.begin(), ip1_list.end() );
+  InterestPointSet ip2( ip2_list.begin(), ip2_list.end() );
+  std::vector<InterestPoint> matched_ip1, matched_ip2;
+  std::vector<size_t> matched_indexes;
+
+  InterestPointMatcher<L2NormMetric,NullConstraint> matcher;
+  matcher(ip1, ip2, matched_ip1, matched_ip2);
+  matcher(ip1, ip2, matched_indexes);
+
+  ASSERT_EQ( 1u, matched_ip1.size() );
+  ASSERT_EQ( 1u, matched_ip2.size() );
+  ASSERT_EQ( 1u, matched_indexes.size() );
+  EXPECT_VECTOR_NEAR( matched_ip1[0].descriptor, Vector3( 0, 7.7, 0 ), 1e-6 );
+  EXPECT_VECTOR_EQ( matched_ip2[0].descriptor, Vector3(0,8,0) );
+  EXPECT_EQ( 3u, matched_indexes[0] );
+
+  // Constraints see the keypoints; this one rejects every match
+  InterestPointMatcher<L2NormMetric,ScaleOrientationConstraint> strict( 0.5, L2NormMetric(), ScaleOrientationConstraint() );
+  strict(ip1, ip2, matched_indexes);
+  ASSERT_EQ( 1u, matched_indexes.size() );
+  EXPECT_EQ( size_t(-1), matched_indexes[0] );
+}
+
+TEST( Matcher, ManyPoints ) {
+  // Enough points for several search batches. ip2 is ip1 shuffled, with
+  // a little noise on the descriptors.
+  const size_t count = 3000;
+  std::vector<InterestPoint> ip1(count), ip2(count);
+  std::vector<size_t> order(count);
+  for ( size_t i = 0; i < count; i++ ) {
+    ip1[i] = InterestPoint( i, 0 );
+    ip1[i].descriptor = Vector3( rand() % 10000, rand() % 10000, rand() % 10000 );
+    order[i] = i;
+  }
+  std::random_shuffle( order.begin(), order.end() );
+  for ( size_t i = 0; i < count; i++ ) {
+    ip2[order[i]] = ip1[i];
+    ip2[order[i]].descriptor += Vector3(0.1,-0.1,0.1);
+  }
+
+  std::vector<size_t> matched_indexes;
+  InterestPointMatcher<L2NormMetric,NullConstraint> matcher(0.8);
+  matcher(ip1, ip2, matched_indexes);
+
+  // The tree search is not exact, so allow a few misses
+  ASSERT_EQ( count, matched_indexes.size() );
+  size_t correct = 0;
+  for ( size_t i = 0; i < count; i++ )
+    if ( matched_indexes[i] == order[i] )
+      correct++;
+  EXPECT_GT( correct, count * 95 / 100 );
+}
+
+TEST( Matcher, Mutual ) {
+  // Both points of ip1 pick ip2[0], but ip2[0] only picks ip1[1] back
+  std::vector<InterestPoint> ip1(2), ip2(3);
+  ip1[0].descriptor = Vector3(0,1.5,0);
+  ip1[1].descriptor = Vector3(0,1.1,0);
+  ip2[0].descriptor = Vector3(0,1,0);
+  ip2[1].descriptor = Vector3(0,9,0);
+  ip2[2].descriptor = Vector3(0,-9,0);
+
+  std::vector<size_t> matched_indexes;
+  InterestPointMatcher<L2NormMetric,NullConstraint> one_way(0.5);
+  one_way(ip1, ip2, matched_indexes);
+  ASSERT_EQ( 2u, matched_indexes.size() );
+  EXPECT_EQ( 0u, matched_indexes[0] );
+  EXPECT_EQ( 0u, matched_indexes[1] );
+
+  InterestPointMatcher<L2NormMetric,NullConstraint> mutual(0.5, L2NormMetric(), NullConstraint(), false, true);
+  mutual(ip1, ip2, matched_indexes);
+  ASSERT_EQ( 2u, matched_indexes.size() );
+  EXPECT_EQ( size_t(-1), matched_indexes[0] );
+  EXPECT_EQ( 0u, matched_indexes[1] );
+}
+
+TEST( Matcher, RemoveDuplicates ) {
+  std::vector<InterestPoint> ip1, ip2;
+  ip1.push_back( InterestPoint(1,1) ); ip2.push_back( InterestPoint(5,5) );
+  ip1.push_back( InterestPoint(2,2) ); ip2.push_back( InterestPoint(6,6) );
+  ip1.push_back( InterestPoint(1,1) ); ip2.push_back( InterestPoint(7,7) );
+  ip1.push_back( InterestPoint(3,3) ); ip2.push_back( InterestPoint(6,6) );
+  ip1.push_back( InterestPoint(4,4) ); ip2.push_back( InterestPoint(8,8) );
+
+  // Only the last pair sharing a location survives
+  remove_duplicates( ip1, ip2 );
+  ASSERT_EQ( 3u, ip1.size() );
+  ASSERT_EQ( 3u, ip2.size() );
+  EXPECT_EQ( 1, ip1[0].x ); EXPECT_EQ( 7, ip2[0].x );
+  EXPECT_EQ( 3, ip1[1].x ); EXPECT_EQ( 6, ip2[1].x );
+  EXPECT_EQ( 4, ip1[2].x ); EXPECT_EQ( 8, ip2[2].x );
+}
+
+TEST( Matcher, Hamming ) {
+  InterestPoint ip1, ip2;
+  ip1.descriptor = Vector3(0, 0xFFFF, 5);
+  ip2.descriptor = Vector3(1, 0x00FF, 5);
+  HammingMetric hamming;
+  EXPECT_EQ( 9, hamming(ip1, ip2) );
+  EXPECT_EQ( 0, hamming(ip1, ip1) );
+}
+
+TEST( Matcher, BinaryMatcher ) {
+  // Random 256 bit descriptors. ip2 is ip1 shuffled, with a few bits
+  // flipped in each.
+  const size_t count = 2500, words = 16;
+  std::vector<InterestPoint> ip1(count), ip2(count);
+  std::vector<size_t> order(count);
+  for ( size_t i = 0; i < count; i++ ) {
+    ip1[i] = InterestPoint( i, 0 );
+    ip1[i].descriptor.set_size( words );
+    for ( size_t w = 0; w < words; w++ )
+      ip1[i].descriptor[w] = rand() & 0xFFFF;
+    order[i] = i;
+  }
+  std::random_shuffle( order.begin(), order.end() );
+  for ( size_t i = 0; i < count; i++ ) {
+    ip2[order[i]] = ip1[i];
+    for ( int flip = 0; flip < 10; flip++ ) {
+      float& word = ip2[order[i]].descriptor[rand() % words];
+      word = float( uint32(word) ^ (1u << (rand() % 16)) );
+    }
+  }
+
+  // Brute force is exact, so every point finds its partner
+  std::vector<size_t> matched_indexes;
+  BinaryMatcher matcher(0.8);
+  matcher(ip1, ip2, matched_indexes);
+  ASSERT_EQ( count, matched_indexes.size() );
+  for ( size_t i = 0; i < count; i++ )
+    EXPECT_EQ( order[i], matched_indexes[i] );
+
+  // The same through InterestPointSets, both ways round
+  InterestPointSet set1( ip1.begin(), ip1.end() ), set2( ip2.begin(), ip2.end() );
+  BinaryMatcher mutual(0.8, HammingMetric(), NullConstraint(), false, true);
+  mutual(set2, set1, matched_indexes);
+  ASSERT_EQ( count, matched_indexes.size() );
+  for ( size_t i = 0; i < count; i++ )
+    EXPECT_EQ( i, order[matched_indexes[i]] );
+}
@@ -27,14 +27,14 @@ namespace math {
                                           Vector<int>& indices,
                                           Vector<float>& dists,
                                           size_t knn ) {
-    if ( indices.size() != knn )
-      indices.set_size( knn );
-    if ( dists.size() != knn )
-      dists.set_size( knn );
+    if ( indices.size() != rows * knn )
+      indices.set_size( rows * knn );
+    if ( dists.size() != rows * knn )
+      dists.set_size( rows * knn );
 
     flann::Matrix<float> query_mat( (float*)data_ptr, rows, cols );
-    flann::Matrix<int> indice_mat( &indices[0], 1, knn );
-    flann::Matrix<float> dists_mat( &dists[0], 1, dists.size() );
+    flann::Matrix<int> indice_mat( &indices[0], rows, knn );
+    flann::Matrix<float> dists_mat( &dists[0], rows, knn );
     ((flann::Index<flann::L2<float> >*)(m_index_ptr))->knnSearch( query_mat, indice_mat, dists_mat, knn, flann::SearchParams(128) );
   }
 
@@ -43,14 +43,14 @@ namespace math {
                                            Vector<int>& indices,
                                            Vector<double>& dists,
                                            size_t knn ) {
-    if ( indices.size() != knn )
-      indices.set_size( knn );
-    if ( dists.size() != knn )
-      dists.set_size( knn );
+    if ( indices.size() != rows * knn )
+      indices.set_size( rows * knn );
+    if ( dists.size() != rows * knn )
+      dists.set_size( rows * knn );
 
     flann::Matrix<double> query_mat( (double*)data_ptr, rows, cols );
-    flann::Matrix<int> indice_mat( &indices[0], 1, knn );
-    flann::Matrix<double> dists_mat( &dists[0], 1, dists.size() );
+    flann::Matrix<int> indice_mat( &indices[0], rows, knn );
+    flann::Matrix<double> dists_mat( &dists[0], rows, knn );
     ((flann::Index<flann::L2<double> >*)(m_index_ptr))->knnSearch( query_mat, indice_mat, dists_mat, knn, flann::SearchParams(128) );
   }
 
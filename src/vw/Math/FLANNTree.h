@@ -50,7 +50,17 @@ namespace math {
 
     ~FLANNTree();
 
-    // Multiple query access via VW's Matrix
+    // Multiple query access via VW's Matrix. There is one query per
+    // row; indices and dists come back with knn entries per query, in
+    // row order.
+    void knn_search( Matrix<FloatT> const& query,
+                     Vector<int>& indices,
+                     Vector<FloatT>& dists,
+                     size_t knn ) {
+      knn_search_help( (void*)&query(0,0), query.rows(), query.cols(),
+                       indices, dists, knn );
+    }
+
     template <class MatrixT>
     void knn_search( MatrixBase<MatrixT> const& query,
                      Vector<int>& indices,
@@ -27,9 +27,18 @@
 
 #include <fstream>
 #include <string>
+#include <cstring>
+#include <algorithm>
 #include <boost/shared_array.hpp>
 #include <boost/scoped_array.hpp>
 
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+
 #define WHEREAMI if(::vw::vw_log().is_enabled(VerboseDebugMessage, "platefile.blob")) ::vw::vw_out(VerboseDebugMessage, "platefile.blob")
 
 #if 0
@@ -47,6 +56,48 @@ namespace vw {
 namespace platefile {
   using detail::BlobRecord;
 
+BlobMapping::BlobMapping(const std::string& filename)
+  : m_data(0), m_size(0)
+{
+  int fd = ::open(filename.c_str(), O_RDONLY);
+  VW_ASSERT(fd >= 0, BlobIoErr() << "Could not open blob file " << filename << ": " << ::strerror(errno));
+
+  struct stat st;
+  if (::fstat(fd, &st) != 0) {
+    int err = errno;
+    ::close(fd);
+    vw_throw(BlobIoErr() << "Could not stat blob file " << filename << ": " << ::strerror(err));
+  }
+  m_size = st.st_size;
+
+  // mmap refuses zero-length mappings. An empty file maps to nothing,
+  // and every read from it fails the bounds check.
+  if (m_size > 0) {
+    void* p = ::mmap(0, boost::numeric_cast<size_t>(m_size), PROT_READ, MAP_SHARED, fd, 0);
+    int err = errno;
+    ::close(fd);
+    VW_ASSERT(p != MAP_FAILED, BlobIoErr() << "Could not map blob file " << filename << ": " << ::strerror(err));
+    m_data = reinterpret_cast<const uint8*>(p);
+  } else
+    ::close(fd);
+}
+
+BlobMapping::~BlobMapping() {
+  if (m_data)
+    ::munmap(const_cast<uint8*>(m_data), boost::numeric_cast<size_t>(m_size));
+}
+
+boost::shared_ptr<BlobMapping> ReadBlob::mapping_for(uint64 offset, uint64 size, const char* context) const {
+  Mutex::Lock lock(m_mapping_mutex);
+  // Someone else may have appended to the blob since we mapped it (and
+  // updated an index that points past our end). Map it again; tiles
+  // already handed out keep the old mapping alive.
+  if (!m_mapping || offset + size > m_mapping->size())
+    m_mapping.reset(new BlobMapping(m_blob_filename));
+  check_mapped(*m_mapping, offset, size, context);
+  return m_mapping;
+}
+
 void ReadBlob::check_fail(const char* c1, const char* c2) const {
   if (m_fstream->fail()) {
     m_fstream->clear();
@@ -55,6 +106,12 @@ void ReadBlob::check_fail(const char* c1, const char* c2) const {
 }
 
 void ReadBlob::read_at(uint64 offset64, char* dst, uint64 size, const char* context) const {
+  if (m_mode == MAPPED) {
+    boost::shared_ptr<BlobMapping> mapping = mapping_for(offset64, size, context);
+    std::memcpy(dst, mapping->data() + offset64, boost::numeric_cast<size_t>(size));
+    return;
+  }
+
   if (m_fstream->eof())
     m_fstream->clear();
 
@@ -75,6 +132,13 @@ uint32 tile_header_offset(const uint32& base_offset, const BlobRecord& blob_reco
   return boost::numeric_cast<uint32>(offset64);
 }
 
+// One past the last byte of the entry at base_offset; the next entry
+// starts here.
+uint64 blob_record_end(const uint64& base_offset, const BlobRecord& blob_record, const BlobRecordSizeType& blob_record_size) {
+  uint64 blob_offset_metadata = sizeof(BlobRecordSizeType) + blob_record_size;
+  return base_offset + blob_offset_metadata + blob_record.data_offset() + blob_record.data_size();
+}
+
 uint32 tile_data_offset(const uint32& base_offset, const BlobRecord& blob_record, const BlobRecordSizeType& blob_record_size) {
   uint64 blob_offset_metadata = sizeof(BlobRecordSizeType) + blob_record_size;
   uint64 offset64 = base_offset + blob_offset_metadata + blob_record.data_offset();
@@ -82,22 +146,58 @@ uint32 tile_data_offset(const uint32& base_offset, const BlobRecord& blob_record
 }
 
 BlobRecord ReadBlob::read_blob_record(const uint32& base_offset, BlobRecordSizeType& blob_record_size) const {
+  BlobRecord blob_record;
+
+  if (m_mode == MAPPED) {
+    // Parse the record where it lies. Records aren't aligned, so the
+    // size still has to be copied out.
+    boost::shared_ptr<BlobMapping> mapping = mapping_for(base_offset, sizeof(BlobRecordSizeType), "reading blob record size");
+    std::memcpy(&blob_record_size, mapping->data() + base_offset, sizeof(BlobRecordSizeType));
+    mapping = mapping_for(base_offset + sizeof(BlobRecordSizeType), blob_record_size, "reading a blob record");
+    return parse_blob_record(*mapping, base_offset, blob_record_size);
+  }
+
   read_at(base_offset, (char*)&blob_record_size, sizeof(BlobRecordSizeType), "reading blob record size");
 
   boost::shared_array<uint8> blob_rec_data(new uint8[blob_record_size]);
   m_fstream->read(reinterpret_cast<char*>(blob_rec_data.get()), blob_record_size);
   check_fail("reading a blob record");
 
-  BlobRecord blob_record;
   bool worked = blob_record.ParseFromArray(blob_rec_data.get(),  boost::numeric_cast<int>(blob_record_size));
   VW_ASSERT(worked, BlobIoErr() << "failed to parse blob record in " << m_blob_filename << " at base_offset " << base_offset);
   return blob_record;
 }
 
+void ReadBlob::check_mapped(const BlobMapping& mapping, uint64 offset, uint64 size, const char* context) const {
+  VW_ASSERT(offset + size <= mapping.size(),
+            BlobIoErr() << "BlobIoErr occured on blob " << m_blob_filename << " while " << context
+                        << ": [" << offset << "," << offset + size << ") is past the end of the file");
+}
+
+BlobRecord ReadBlob::parse_blob_record(const BlobMapping& mapping, uint64 base_offset, BlobRecordSizeType& blob_record_size) const {
+  check_mapped(mapping, base_offset, sizeof(BlobRecordSizeType), "reading blob record size");
+  std::memcpy(&blob_record_size, mapping.data() + base_offset, sizeof(BlobRecordSizeType));
+  check_mapped(mapping, base_offset + sizeof(BlobRecordSizeType), blob_record_size, "reading a blob record");
+
+  BlobRecord blob_record;
+  bool worked = blob_record.ParseFromArray(mapping.data() + base_offset + sizeof(BlobRecordSizeType),
+                                           boost::numeric_cast<int>(blob_record_size));
+  VW_ASSERT(worked, BlobIoErr() << "failed to parse blob record in " << m_blob_filename << " at base_offset " << base_offset);
+  return blob_record;
+}
+
 TileHeader ReadBlob::read_tile_header(const uint32& base_offset, const BlobRecord& blob_record, const BlobRecordSizeType& blob_record_size) const {
   uint64 offset = tile_header_offset(base_offset, blob_record, blob_record_size);
   uint64 size   = blob_record.header_size();
 
+  if (m_mode == MAPPED) {
+    boost::shared_ptr<BlobMapping> mapping = mapping_for(offset, size, "reading a tile header");
+    TileHeader header;
+    bool worked = header.ParseFromArray(mapping->data() + offset, boost::numeric_cast<int>(size));
+    VW_ASSERT(worked, BlobIoErr() << "read_tile_record() failed in " << m_blob_filename << " at offset " << offset);
+    return header;
+  }
+
   boost::scoped_array<uint8> data(new uint8[size]);
   read_at(offset, (char*)data.get(), size, "reading a tile header");
 
@@ -110,23 +210,67 @@ TileHeader ReadBlob::read_tile_header(const uint32& base_offset, const BlobRecor
 TileData ReadBlob::read_tile_data(const uint32& base_offset, const BlobRecord& blob_record, const BlobRecordSizeType& blob_record_size) const {
   uint64 offset = tile_data_offset(base_offset, blob_record, blob_record_size);
   uint64 size   = blob_record.data_size();
+  return read_data_at(offset, size);
+}
 
-  TileData data(new std::vector<uint8>(size));
-  read_at(offset, (char*)(&data->operator[](0)), size, "reading tile data");
+TileData ReadBlob::read_data_at(uint64 offset, uint64 size) const {
+  if (m_mode == MAPPED) {
+    boost::shared_ptr<BlobMapping> mapping = mapping_for(offset, size, "reading tile data");
+    return TileData(new TileBuffer(mapping->data() + offset, boost::numeric_cast<size_t>(size), mapping));
+  }
+
+  TileData data(new TileBuffer(boost::numeric_cast<size_t>(size)));
+  read_at(offset, reinterpret_cast<char*>(data->mutable_data()), size, "reading tile data");
   return data;
 }
 
+BlobTileRecord ReadBlob::parse_record(const boost::shared_ptr<BlobMapping>& mapping, uint64 base_offset) const {
+  BlobTileRecord ret;
+  BlobRecordSizeType blob_record_size;
+  ret.rec = parse_blob_record(*mapping, base_offset, blob_record_size);
+
+  uint64 offset = tile_header_offset(boost::numeric_cast<uint32>(base_offset), ret.rec, blob_record_size);
+  uint64 size   = ret.rec.header_size();
+  check_mapped(*mapping, offset, size, "reading a tile header");
+  bool worked = ret.hdr.ParseFromArray(mapping->data() + offset, boost::numeric_cast<int>(size));
+  VW_ASSERT(worked, BlobIoErr() << "read_tile_record() failed in " << m_blob_filename << " at offset " << offset);
+
+  offset = tile_data_offset(boost::numeric_cast<uint32>(base_offset), ret.rec, blob_record_size);
+  size   = ret.rec.data_size();
+  check_mapped(*mapping, offset, size, "reading tile data");
+  ret.data.reset(new TileBuffer(mapping->data() + offset, boost::numeric_cast<size_t>(size), mapping));
+  return ret;
+}
+
+// The iterator only walks records below the end-of-file pointer, so a
+// single mapping that covers it serves every record; there is no need
+// to go through mapping_for() (and its lock) once per record.
+const boost::shared_ptr<BlobMapping>& ReadBlob::iterator::mapping() const {
+  if (!m_mapping)
+    m_mapping = m_blob->mapping_for(0, m_blob->size(), "iterating over blob records");
+  return m_mapping;
+}
+
 bool ReadBlob::iterator::equal(iterator const& iter) const {
-  return m_blob->m_blob_filename == iter.m_blob->m_blob_filename
+  return m_blob == iter.m_blob
       && m_current_base_offset == iter.m_current_base_offset;
 }
 
 void ReadBlob::iterator::increment() {
-  m_current_base_offset = m_blob->next_base_offset(m_current_base_offset);
+  if (m_blob->mode() != MAPPED) {
+    m_current_base_offset = m_blob->next_base_offset(m_current_base_offset);
+    return;
+  }
+  BlobRecordSizeType blob_record_size;
+  BlobRecord blob_record = m_blob->parse_blob_record(*mapping(), m_current_base_offset, blob_record_size);
+  m_current_base_offset = blob_record_end(m_current_base_offset, blob_record, blob_record_size);
 }
 
 BlobTileRecord ReadBlob::iterator::dereference() const {
-  return m_blob->read_record(m_current_base_offset);
+  if (m_blob->mode() != MAPPED)
+    return m_blob->read_record(m_current_base_offset);
+  VW_ASSERT(m_current_base_offset >= 24, LogicErr() << "No base_offset will ever be < 24. Something's wrong.");
+  return m_blob->parse_record(mapping(), m_current_base_offset);
 }
 
 ReadBlob::iterator::iterator( ReadBlob *blob, uint64 base_offset )
@@ -147,10 +291,7 @@ TileData ReadBlob::read_data(vw::uint64 base_offset) {
   uint64 offset, size;
   std::string dontcare;
   read_sendfile(base_offset, dontcare, offset, size);
-
-  TileData data(new std::vector<uint8>(size));
-  read_at(offset, (char*)(&data->operator[](0)), size, "reading tile data");
-  return data;
+  return read_data_at(offset, size);
 }
 
 BlobTileRecord ReadBlob::read_record(vw::uint64 base_offset) {
@@ -164,12 +305,59 @@ BlobTileRecord ReadBlob::read_record(vw::uint64 base_offset) {
   return ret;
 }
 
+std::vector<std::pair<uint64, uint64> >
+ReadBlob::prefetch_runs(const std::vector<uint64>& base_offsets, uint64 max_gap) const {
+  std::vector<std::pair<uint64, uint64> > runs;
+  if (base_offsets.empty())
+    return runs;
+
+  for (size_t i = 1; i < base_offsets.size(); ++i)
+    VW_ASSERT(base_offsets[i] >= base_offsets[i-1], ArgumentErr() << "ReadBlob::prefetch(): offsets must be sorted");
+
+  // Each record's extent comes from its own metadata, which sits at its
+  // start. Parse them all from one mapping rather than going through
+  // mapping_for() (and its lock) for every record.
+  boost::shared_ptr<BlobMapping> mapping =
+    mapping_for(base_offsets.back(), sizeof(BlobRecordSizeType), "prefetching blob records");
+
+  for (size_t i = 0; i < base_offsets.size(); ++i) {
+    const uint64 begin = base_offsets[i];
+    BlobRecordSizeType blob_record_size;
+    BlobRecord blob_record = parse_blob_record(*mapping, begin, blob_record_size);
+    const uint64 end = blob_record_end(begin, blob_record, blob_record_size);
+
+    if (!runs.empty() && begin <= runs.back().second + max_gap)
+      runs.back().second = std::max(runs.back().second, end);
+    else
+      runs.push_back(std::make_pair(begin, end));
+  }
+  return runs;
+}
+
+void ReadBlob::prefetch(const std::vector<uint64>& base_offsets, uint64 max_gap) const {
+  std::vector<std::pair<uint64, uint64> > runs = prefetch_runs(base_offsets, max_gap);
+  if (runs.empty())
+    return;
+
+  boost::shared_ptr<BlobMapping> mapping =
+    mapping_for(runs.front().first, runs.back().second - runs.front().first, "prefetching blob records");
+
+  // madvise wants a page-aligned start; the mapping itself is.
+  const uint64 page = boost::numeric_cast<uint64>(::sysconf(_SC_PAGESIZE));
+  for (size_t i = 0; i < runs.size(); ++i) {
+    uint64 begin = runs[i].first - runs[i].first % page, end = runs[i].second;
+    WHEREAMI << "[prefetch " << begin << " +" << end - begin << "]\n";
+    // This is only a hint, so a failure isn't an error.
+    if (::madvise(const_cast<uint8*>(mapping->data()) + begin, boost::numeric_cast<size_t>(end - begin), MADV_WILLNEED) != 0)
+      WHEREAMI << "[prefetch failed: " << ::strerror(errno) << "]\n";
+  }
+}
+
 uint64 ReadBlob::next_base_offset(uint64 current_base_offset) {
   BlobRecordSizeType blob_record_size;
   BlobRecord blob_record = this->read_blob_record(current_base_offset, blob_record_size);
 
-  uint64 blob_offset_metadata = sizeof(BlobRecordSizeType) + blob_record_size;
-  uint64 next_offset = current_base_offset + blob_offset_metadata + blob_record.data_offset() + blob_record.data_size();
+  uint64 next_offset = blob_record_end(current_base_offset, blob_record, blob_record_size);
 
   WHEREAMI << "[next_offset: " <<  next_offset << "]\n";
 
@@ -187,17 +375,24 @@ uint64 ReadBlob::data_size(uint64 base_offset) const {
 }
 
 ReadBlob::ReadBlob(const std::string& filename, bool skip_init)
-  : m_blob_filename(filename)
+  : m_blob_filename(filename), m_mode(BUFFERED)
 {
   if (!skip_init)
     init();
 }
 
-ReadBlob::ReadBlob(const std::string& filename)
-  : m_blob_filename(filename)
+ReadBlob::ReadBlob(const std::string& filename, ReadMode mode)
+  : m_blob_filename(filename), m_mode(mode)
 { init(); }
 
 void ReadBlob::init() {
+  if (m_mode == MAPPED) {
+    m_mapping.reset(new BlobMapping(m_blob_filename));
+    m_end_of_file_ptr = read_end_of_file_ptr();
+    WHEREAMI << m_blob_filename << " (mapped)" << std::endl;
+    return;
+  }
+
   m_fstream.reset(new std::fstream(m_blob_filename.c_str(), std::ios::in | std::ios::binary));
   VW_ASSERT(m_fstream->is_open(), BlobIoErr() << "Could not open blob file " << m_blob_filename);
   m_end_of_file_ptr = read_end_of_file_ptr();
@@ -247,11 +442,7 @@ uint64 ReadBlob::read_end_of_file_ptr() const {
   uint64 data[3];
 
   // The end of file ptr is stored at the beginning of the blob file.
-  if (m_fstream->eof())
-    m_fstream->clear();
-  m_fstream->seekg(0, std::ios_base::beg);
-  m_fstream->read(reinterpret_cast<char*>(data), 3*sizeof(uint64));
-  check_fail("Failed to read end of file ptr");
+  read_at(0, reinterpret_cast<char*>(data), 3*sizeof(uint64), "reading end of file ptr");
 
   // Make sure the read ptr is valid by comparing the three
   // entries.
@@ -269,6 +460,8 @@ uint64 ReadBlob::read_end_of_file_ptr() const {
     return data[1];
   else {
     VW_OUT(ErrorMessage) << "end of file ptr in blobfile " << m_blob_filename << " is inconsistent. This file may be corrupt. Proceed with caution.\n";
+    if (m_mode == MAPPED)
+      return m_mapping->size();
     if (m_fstream->eof())
       m_fstream->seekg(0, std::ios_base::end);
     return m_fstream->tellg();
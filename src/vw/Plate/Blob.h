@@ -47,38 +47,77 @@
 
 #include <vw/Plate/IndexData.pb.h>
 #include <vw/Plate/IndexDataPrivate.pb.h>
+#include <vw/Plate/FundamentalTypes.h>
 #include <vw/Core/Exception.h>
 #include <vw/Core/FundamentalTypes.h>
 #include <vw/Core/Log.h>
+#include <vw/Core/Thread.h>
 #include <boost/shared_array.hpp>
 #include <fstream>
 #include <string>
+#include <vector>
 
 namespace vw {
 namespace platefile {
 
-  typedef boost::shared_ptr<std::vector<vw::uint8> > TileData;
-
   struct BlobTileRecord {
     detail::BlobRecord rec;
     TileHeader hdr;
     TileData data;
   };
 
+  /// A read-only mapping of a whole blob file.  Tile data read through
+  /// a mapped ReadBlob points into one of these and holds a reference to
+  /// it, so the mapping lives as long as any tile read from it.
+  class BlobMapping : boost::noncopyable {
+      const uint8* m_data;
+      uint64 m_size;
+    public:
+      explicit BlobMapping(const std::string& filename);
+      ~BlobMapping();
+
+      const uint8* data() const { return m_data; }
+      uint64 size() const { return m_size; }
+  };
+
   class ReadBlob : boost::noncopyable {
+    public:
+      /// BUFFERED reads every record through a std::fstream and copies
+      /// tile data into a new buffer.  MAPPED maps the file, parses
+      /// records in place and hands out tile data as views into the
+      /// mapping without copying; reads in this mode are thread-safe.
+      enum ReadMode { BUFFERED, MAPPED };
+
     protected:
       std::string m_blob_filename;
       uint64 m_end_of_file_ptr;
       boost::shared_ptr<std::fstream> m_fstream;
+      ReadMode m_mode;
+      mutable boost::shared_ptr<BlobMapping> m_mapping;
+      mutable Mutex m_mapping_mutex;
 
       void read_at(uint64 offset, char* dst, uint64 size, const char* context) const;
       void check_fail(const char* context, const char* context2 = "") const;
 
+      /// Returns a mapping that covers [offset, offset+size), mapping
+      /// the file again if it has grown since it was last mapped.
+      boost::shared_ptr<BlobMapping> mapping_for(uint64 offset, uint64 size, const char* context) const;
+
       typedef vw::uint16 BlobRecordSizeType;
       /// Returns the metadata (i.e. BlobRecord) for a blob entry.
       detail::BlobRecord read_blob_record(const uint32& base_offset, BlobRecordSizeType &blob_record_size) const;
+      /// Throws unless [offset, offset+size) lies inside mapping.
+      void check_mapped(const BlobMapping& mapping, uint64 offset, uint64 size, const char* context) const;
+
+      /// Parses the blob entry's metadata in place, from a mapping that
+      /// the caller already holds.
+      detail::BlobRecord parse_blob_record(const BlobMapping& mapping, uint64 base_offset, BlobRecordSizeType &blob_record_size) const;
+      /// Parses a whole blob entry in place; the tile data is a view into
+      /// mapping.
+      BlobTileRecord     parse_record(const boost::shared_ptr<BlobMapping>& mapping, uint64 base_offset) const;
       TileHeader         read_tile_header(const uint32& base_offset, const detail::BlobRecord& blob_record, const BlobRecordSizeType& blob_record_size) const;
       TileData           read_tile_data  (const uint32& base_offset, const detail::BlobRecord& blob_record, const BlobRecordSizeType& blob_record_size) const;
+      TileData           read_data_at    (uint64 offset, uint64 size) const;
 
       uint64 read_end_of_file_ptr() const;
 
@@ -94,7 +133,11 @@ namespace platefile {
           // Private variables
           ReadBlob* m_blob;
           uint64 m_current_base_offset;
+          // In MAPPED mode, one mapping of the whole blob that every
+          // record is parsed from, looked up on first use.
+          mutable boost::shared_ptr<BlobMapping> m_mapping;
 
+          const boost::shared_ptr<BlobMapping>& mapping() const;
           bool equal (iterator const& iter) const;
           void increment();
           BlobTileRecord dereference() const;
@@ -105,9 +148,11 @@ namespace platefile {
 
       typedef iterator const_iterator;
 
-      explicit ReadBlob(const std::string& filename);
+      explicit ReadBlob(const std::string& filename, ReadMode mode = BUFFERED);
       ~ReadBlob();
 
+      ReadMode mode() const { return m_mode; }
+
       /// Returns the size of the blob in bytes.  Note: only counts
       /// valid entries.  (Invalid data may exist beyond the end of the
       /// end_of_file_ptr)
@@ -138,6 +183,22 @@ namespace platefile {
       /// Returns the whole blob record (this is faster than calling read_header then real_tile_data)
       BlobTileRecord read_record(vw::uint64 base_offset);
 
+      /// Tell the OS we are about to read the records at base_offsets,
+      /// which must be in ascending order.  The records are grouped as
+      /// prefetch_runs() describes, and each run is requested from disk
+      /// (with madvise on the blob's mapping) as one large read instead
+      /// of as many small ones.  This only schedules the I/O; the
+      /// records still have to be read.  In BUFFERED mode the file is
+      /// mapped just for the hint.
+      void prefetch(const std::vector<uint64>& base_offsets, uint64 max_gap = 256*1024) const;
+
+      /// Returns the byte ranges [first, second) that prefetch() asks
+      /// for.  Each run starts at a record and ends where its last
+      /// record ends.  A record that starts no more than max_gap bytes
+      /// past the end of the run before it joins that run, so a gap of
+      /// zero still merges records that lie back to back.
+      std::vector<std::pair<uint64, uint64> > prefetch_runs(const std::vector<uint64>& base_offsets, uint64 max_gap = 256*1024) const;
+
       /// Returns the parameters necessary to call sendfile(2)
       void read_sendfile(vw::uint64 base_offset, std::string& filename, vw::uint64& offset, vw::uint64& size);
 
@@ -24,6 +24,7 @@
 #include <vw/Core/Exception.h>
 #include <vw/Core/FundamentalTypes.h>
 #include <vw/Core/Log.h>
+#include <vw/Core/Thread.h>
 
 #include <boost/format.hpp>
 #include <boost/filesystem/operations.hpp>
@@ -76,6 +77,17 @@ uint64 BlobManager::blob_size(uint32 blob_id) const {
 uint32 BlobManager::request_lock() {
   WHEREAMI << std::endl;
   Mutex::Lock lock(m_mutex);
+
+  std::map<uint64, uint32>::const_iterator last = m_last_blob.find(Thread::id());
+  if (last != m_last_blob.end()) {
+    blob_by_id_t& by_id = m_blobs.get<0>();
+    blob_by_id_t::iterator j = by_id.find(last->second);
+    if (j != by_id.end() && j->can_write()) {
+      by_id.modify(j, BlobKey::SetLock(true));
+      return j->id;
+    }
+  }
+
   blob_by_score_t& lookup = m_blobs.get<1>();
 
   blob_by_score_t::iterator i = lookup.begin();
@@ -118,6 +130,16 @@ void BlobManager::release_lock(uint32 blob_id) {
     size = fs::file_size(fn);
 
   lookup.modify(i, BlobKey::SetUnlockSize(size));
+
+  // Each blob is remembered by at most the last thread to release it, so
+  // this never outgrows m_blobs no matter how many threads come and go.
+  for (std::map<uint64, uint32>::iterator j = m_last_blob.begin(); j != m_last_blob.end();) {
+    if (j->second == blob_id)
+      m_last_blob.erase(j++);
+    else
+      ++j;
+  }
+  m_last_blob[Thread::id()] = blob_id;
 }
 
 BlobManager::BlobManager(const std::string& directory)
@@ -27,6 +27,8 @@
 #include <boost/multi_index/mem_fun.hpp>
 #include <boost/multi_index/member.hpp>
 
+#include <map>
+
 namespace vw {
 namespace platefile {
 
@@ -36,6 +38,10 @@ namespace platefile {
   // locking/unlocking of blobs, and can load balance blobs writes by
   // alternating which blob is offered up for writing data.
   //
+  // A thread that releases a blob is offered the same blob again on its next
+  // request (if it still has room), so each writer thread keeps appending to
+  // its own file instead of all of them taking turns on the largest one.
+  //
   // The BlobManager is thread safe.
   class BlobManager {
 
@@ -78,6 +84,10 @@ namespace platefile {
     std::string m_directory;
     blob_tracker_t m_blobs;
 
+    // thread id -> the blob that thread released last. A blob appears at
+    // most once, so this is bounded by the number of blobs.
+    std::map<uint64, uint32> m_last_blob;
+
     uint32 locked_add_blob();
 
   public:
@@ -92,7 +102,8 @@ namespace platefile {
     BlobManager(const std::string& directory);
 
     // Request a blob to write to that has sufficient space. Returns the blob
-    // index of a locked blob that you have sole access to write to.
+    // index of a locked blob that you have sole access to write to. The blob
+    // this thread released last is preferred, if it is still writable.
     uint32 request_lock();
 
     // Given a blob id, return the filename of the corresponding blob
@@ -21,6 +21,8 @@
 #include <vw/Plate/detail/Blobstore.h>
 #include <vw/Plate/detail/Dirstore.h>
 
+#include <boost/foreach.hpp>
+
 namespace vw { namespace platefile {
 
 Datastore* Datastore::open(const Url& url) {
@@ -49,4 +51,13 @@ Datastore::TileSearch& Datastore::get(TileSearch& buf, uint32 level,   const BBo
   return this->populate(buf);
 }
 
+std::vector<TileHeader>& Datastore::head_headers(std::vector<TileHeader>& hdrs, uint32 level, const BBox2u& region, TransactionRange range) {
+  TileSearch buf;
+  this->head(buf, level, region, range);
+  hdrs.reserve(hdrs.size() + buf.size());
+  BOOST_FOREACH(const Tile& t, buf)
+    hdrs.push_back(t.hdr);
+  return hdrs;
+}
+
 }}
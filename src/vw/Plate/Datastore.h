@@ -34,7 +34,6 @@
 namespace vw {
 namespace platefile {
 
-typedef boost::shared_ptr<std::vector<vw::uint8> > TileData;
 class TileHeader;
 
 // An opaque type that data stores can use to hide their write state
@@ -82,6 +81,8 @@ class Datastore {
     virtual TileSearch& head(TileSearch& tiles, uint32 level,   const BBox2u& region, TransactionRange range, uint32 limit = 0) = 0;
     virtual TileSearch&  get(TileSearch& tiles, uint32 level, uint32 row, uint32 col, TransactionRange range, uint32 limit = 0);
     virtual TileSearch&  get(TileSearch& tiles, uint32 level,   const BBox2u& region, TransactionRange range, uint32 limit = 0);
+    // Like the region head(), but appends just the headers to hdrs.
+    virtual std::vector<TileHeader>& head_headers(std::vector<TileHeader>& hdrs, uint32 level, const BBox2u& region, TransactionRange range);
 
     // Return a url that should work to retrieve tile data [might be unimplemented]
     //virtual Url map_to_url(uint32 level, uint32 row, uint32 col, Transaction id, std::string filetype) = 0;
@@ -25,6 +25,8 @@
 #include <boost/shared_ptr.hpp>
 #include <boost/shared_container_iterator.hpp>
 #include <boost/range/iterator_range.hpp>
+#include <boost/noncopyable.hpp>
+#include <vector>
 
 namespace google { namespace protobuf {
   class Closure;
@@ -148,6 +150,43 @@ class TransactionRange : private std::pair<TransactionOrNeg, TransactionOrNeg> {
 
 std::ostream& operator<<(std::ostream& o, const vw::platefile::TransactionRange& range);
 
+// The encoded bytes of one tile.  A TileBuffer either owns its bytes, or
+// is a read-only view of memory that belongs to something else (a mapped
+// blob file, for instance) and holds a reference to that owner so the
+// bytes stay valid for as long as the buffer does.
+class TileBuffer : private boost::noncopyable {
+    std::vector<uint8> m_storage;
+    boost::shared_ptr<const void> m_owner;
+    const uint8* m_data;
+    size_t m_size;
+  public:
+    typedef const uint8* const_iterator;
+    typedef const_iterator iterator;
+
+    // An owned, zero-filled buffer
+    explicit TileBuffer(size_t size = 0)
+      : m_storage(size), m_data(size ? &m_storage[0] : 0), m_size(size) {}
+    // A view of size bytes at data, which owner keeps alive
+    TileBuffer(const uint8* data, size_t size, boost::shared_ptr<const void> owner)
+      : m_owner(owner), m_data(data), m_size(size) {}
+
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+    bool is_view() const { return !!m_owner; }
+
+    const uint8* data() const { return m_data; }
+    const_iterator begin() const { return m_data; }
+    const_iterator end() const { return m_data + m_size; }
+    const uint8& operator[](size_t i) const { return m_data[i]; }
+
+    // Only owned buffers can be written to.
+    uint8* mutable_data() {
+      VW_ASSERT(!m_owner, LogicErr() << "Cannot write to a TileBuffer that views someone else's memory");
+      return m_storage.empty() ? 0 : &m_storage[0];
+    }
+};
+typedef boost::shared_ptr<TileBuffer> TileData;
+
 // We can't edit the protobuf-generated code, so this is next best place for this
 class TileHeader;
 class Tile;
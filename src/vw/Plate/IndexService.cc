@@ -242,6 +242,23 @@ METHOD_IMPL(ReadRequest, IndexReadRequest, IndexReadReply) {
                             request->transaction_id(), request->exact_transaction_match());
 }
 
+METHOD_IMPL(MultiReadRequest, IndexMultiReadRequest, IndexMultiReadReply) {
+  METHOD_BOILERPLATE(read_lock_t);
+  for (int i = 0; i < request->reads().size(); ++i) {
+    const IndexReadRequest& read = request->reads().Get(i);
+    IndexServiceRecord rec = find_id_throw(read.platefile_id());
+
+    IndexReadResult* result = response->add_results();
+    try {
+      *(result->mutable_index_record()) =
+        rec.index->read_request(read.col(), read.row(), read.level(),
+                                read.transaction_id(), read.exact_transaction_match());
+    } catch (const TileNotFoundErr&) {
+      // leave this result empty
+    }
+  }
+}
+
 METHOD_IMPL(WriteRequest, IndexWriteRequest, IndexWriteReply) {
   METHOD_BOILERPLATE(read_lock_t);
   IndexServiceRecord rec = find_id_throw(request->platefile_id());
@@ -92,6 +92,13 @@ namespace platefile {
                              IndexReadReply* response,
                              ::google::protobuf::Closure* done);
 
+    // Like ReadRequest, but batches reads. A missing tile doesn't fail
+    // the whole batch; its result is just left empty.
+    virtual void MultiReadRequest(::google::protobuf::RpcController* controller,
+                                  const IndexMultiReadRequest* request,
+                                  IndexMultiReadReply* response,
+                                  ::google::protobuf::Closure* done);
+
     virtual void WriteRequest(::google::protobuf::RpcController* controller,
                               const IndexWriteRequest* request,
                               IndexWriteReply* response,
@@ -22,6 +22,7 @@
 #include <vw/Core/Settings.h>
 #include <vw/Core/Debugging.h>
 #include <boost/iostreams/tee.hpp>
+#include <iterator>
 
 using namespace vw::platefile;
 using namespace vw;
@@ -147,7 +148,7 @@ ReadOnlyPlateFile::read_to_file(std::string const& base_name, int col, int row,
   std::string filename = ret.get<0>();
   TileHeader  th       = ret.get<1>(); 
   TileData    td       = ret.get<2>(); 
-  dump_to_file(filename, &(td->operator[](0)), td->size());
+  dump_to_file(filename, td->data(), td->size());
   return std::make_pair(filename, th);
 }
 
@@ -188,6 +189,11 @@ ReadOnlyPlateFile::search_by_region(int level, vw::BBox2i const& region, const T
   return tiles;
 }
 
+std::vector<TileHeader>&
+ReadOnlyPlateFile::search_by_region(std::vector<TileHeader>& tiles, int level, vw::BBox2i const& region, const TransactionRange& range) const {
+  return m_data->head_headers(tiles, level, region, range);
+}
+
 std::list<TileHeader>
 ReadOnlyPlateFile::search_by_location(int col, int row, int level, const TransactionRange& range) {
   Datastore::TileSearch r;
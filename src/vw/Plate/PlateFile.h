@@ -175,7 +175,7 @@ namespace platefile {
                       TransactionOrNeg transaction_id, bool exact_transaction_match = false) const {
 
         std::pair<TileHeader, TileData> ret = this->read(col, row, level, transaction_id, exact_transaction_match);
-        boost::scoped_ptr<SrcImageResource> r(SrcMemoryImageResource::open(ret.first.filetype(), &ret.second->operator[](0), ret.second->size()));
+        boost::scoped_ptr<SrcImageResource> r(SrcMemoryImageResource::open(ret.first.filetype(), ret.second->data(), ret.second->size()));
         read_image(view, *r);
         return ret.first;
       }
@@ -186,6 +186,10 @@ namespace platefile {
       /// Note: the region is EXCLUSIVE: i.e. BBox2i(0,0,1,1) does not include the point (1,1)
       std::list<TileHeader> search_by_region(int level, vw::BBox2i const& region, const TransactionRange& range) const;
 
+      /// Same as above, but appends the tiles to 'tiles'. Cheaper for large regions.
+      std::vector<TileHeader>&
+      search_by_region(std::vector<TileHeader>& tiles, int level, vw::BBox2i const& region, const TransactionRange& range) const;
+
       /// Read one ore more images at a specified location in the
       /// platefile by specifying a range of transaction ids of
       /// interest.  This range is inclusive at both ends.
@@ -213,12 +217,15 @@ namespace platefile {
       /// be used to write tiles.
       void write_request();
 
-      /// Writing, pt. 2: Write an image to the specified tile location
-      /// in the plate file.
+      /// Encode an image in the platefile's default file type, ready to
+      /// be handed to the raw write_update() below.  The "auto" type
+      /// becomes jpg for opaque tiles and png otherwise; the type chosen
+      /// is returned in type.  This does not touch the blob or the
+      /// index, so several threads may encode tiles at once.
       template <class ViewT>
-      void write_update(ImageViewBase<ViewT> const& view, int col, int row, int level) {
-
-        std::string type = this->default_file_type();
+      boost::shared_ptr<DstMemoryImageResource>
+      encode_tile(ImageViewBase<ViewT> const& view, std::string& type) const {
+        type = this->default_file_type();
         if (type == "auto") {
           // This specialization saves us TONS of space by storing opaque tiles
           // as jpgs.  However it does come at a small cost of having to conduct
@@ -228,8 +235,17 @@ namespace platefile {
           else
             type = "png";
         }
-        boost::scoped_ptr<DstMemoryImageResource> r(DstMemoryImageResource::create(type, view.format()));
+        boost::shared_ptr<DstMemoryImageResource> r(DstMemoryImageResource::create(type, view.format()));
         write_image(*r, view);
+        return r;
+      }
+
+      /// Writing, pt. 2: Write an image to the specified tile location
+      /// in the plate file.
+      template <class ViewT>
+      void write_update(ImageViewBase<ViewT> const& view, int col, int row, int level) {
+        std::string type;
+        boost::shared_ptr<DstMemoryImageResource> r = this->encode_tile(view, type);
         this->write_update(r->data(), r->size(), col, row, level, type);
       }
 
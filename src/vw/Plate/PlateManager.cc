@@ -18,6 +18,7 @@
 
 #include <vw/Plate/PlateManager.h>
 #include <vw/Plate/TileManipulation.h>
+#include <vw/Plate/TileWriter.h>
 #include <vw/Plate/PlateCarreePlateManager.h>
 #include <vw/Plate/PolarStereoPlateManager.h>
 #include <vw/Plate/ToastPlateManager.h>
@@ -225,43 +226,68 @@ template <typename PixelT>
 void cache_consume_tiles(PlateFile& plate, Datastore::TileSearch& headers, tile_cache_t<PixelT>& cache) {
   BOOST_FOREACH(const Tile& t, plate.batch_read(headers)) {
     ImageView<PixelT>& image = cache[d::rowcol_t(t.hdr.row(), t.hdr.col())];
-    boost::scoped_ptr<SrcImageResource> r(SrcMemoryImageResource::open(t.hdr.filetype(), &t.data->operator[](0), t.data->size()));
+    boost::scoped_ptr<SrcImageResource> r(SrcMemoryImageResource::open(t.hdr.filetype(), t.data->data(), t.data->size()));
     read_image(image, *r);
   }
   headers.clear();
 }
 
+// Builds one parent tile from its (up to four) children, for
+// ThreadedTileWriter.  If output is set the new tile is also kept
+// there, for the next level up.
+template <typename PixelT>
+class MipmapTile {
+  ImageView<PixelT> m_children[4];
+  ImageView<PixelT>* m_output;
+  uint32 m_tile_size;
+  bool m_preblur;
+public:
+  MipmapTile(ImageView<PixelT>* output, uint32 tile_size, bool preblur)
+    : m_output(output), m_tile_size(tile_size), m_preblur(preblur) {}
+
+  ImageView<PixelT>& child(uint32 id) { return m_children[id]; }
+
+  bool operator()(ImageView<PixelT>& dest) const {
+    mipmap_one_tile(dest, m_tile_size, m_children[0], m_children[1], m_children[2], m_children[3], m_preblur);
+    if (m_output)
+      *m_output = dest;
+    return true;
+  }
+};
+
 template <typename PixelT, typename CompositeT>
-void build_tiles(PlateFile& plate, const CompositeT& output_hdrs, const tile_cache_t<PixelT>& input_tiles, uint32 level, bool preblur, tile_cache_t<PixelT> *output_tiles, const d::RememberCallback& pc) {
-  typedef ImageView<PixelT> image_t;
+void build_tiles(boost::shared_ptr<PlateFile> plate, const CompositeT& output_hdrs, const tile_cache_t<PixelT>& input_tiles, uint32 level, bool preblur, tile_cache_t<PixelT> *output_tiles, const d::RememberCallback& pc) {
   typedef typename CompositeT::mapped_type VectorT;
   typedef typename     VectorT::value_type HeaderT;
 
-  // build the new tiles
+  // Make room for all of the new tiles up front, so that the workers
+  // only ever write into existing entries.
+  if (output_tiles) {
+    BOOST_FOREACH(const typename CompositeT::value_type& v, output_hdrs)
+      output_tiles->operator[](v.first);
+  }
+
+  // build the new tiles.  Parents are independent of each other, so
+  // they are built and encoded in parallel and written in order.
+  ThreadedTileWriter writer(plate);
+  boost::function<void ()> tick = boost::bind(&d::RememberCallback::tick, &pc, 1);
   BOOST_FOREACH(const typename CompositeT::value_type& v, output_hdrs) {
     const d::rowcol_t& parent = v.first;
     const std::vector<HeaderT>& children = v.second;
     VW_ASSERT(children.size() > 0,  LogicErr() << "How can there be zero here?");
     VW_ASSERT(children.size() <= 4, LogicErr() << "How can there be more than four here?");
 
-    std::map<uint32, image_t> c;
+    MipmapTile<PixelT> job(output_tiles ? &output_tiles->find(parent)->second : 0,
+                           plate->default_tile_size(), preblur);
     BOOST_FOREACH(const HeaderT& child, children) {
       typename tile_cache_t<PixelT>::const_iterator i = input_tiles.find(d::rowcol_t(d::therow(child), d::thecol(child)));
       if (i != input_tiles.end())
-        c[d::calc_composite_id(parent, child)] = i->second;
+        job.child(d::calc_composite_id(parent, child)) = i->second;
     }
 
-    boost::shared_ptr<image_t> new_image;
-
-    if (output_tiles)
-      new_image.reset(&output_tiles->operator[](parent), NOP());
-    else
-      new_image.reset(new image_t());
-
-    mipmap_one_tile(*new_image, plate.default_tile_size(), c[0], c[1], c[2], c[3], preblur);
-    plate.write_update(*new_image, d::thecol(parent), d::therow(parent), level);
-    pc.tick();
+    writer.add_tile<PixelT>(job, d::thecol(parent), d::therow(parent), level, tick);
   }
+  writer.process_tiles();
 }
 }
 
@@ -298,7 +324,7 @@ void PlateManager<PixelT>::slow_mipmap( uint32 output_level, std::list<TileHeade
     BOOST_FOREACH(const composite_map_t::value_type& t, composite_batch)
       std::copy(t.second.begin(), t.second.end(), std::back_inserter(tile_lookup));
     cache_consume_tiles<PixelT>(*m_platefile, tile_lookup, tile_cache);
-    build_tiles<PixelT>(*m_platefile, composite_batch, tile_cache, output_level, preblur, 0, pc);
+    build_tiles<PixelT>(m_platefile, composite_batch, tile_cache, output_level, preblur, 0, pc);
     composite_batch.clear();
     size = 0;
   } while (i != end);
@@ -330,7 +356,7 @@ void PlateManager<PixelT>::fast_mipmap( uint32 starting_output_level, int32 stop
     BOOST_FOREACH(const thin_composite_map_t::value_type& v, prev->hdrs)
       curr->hdrs[d::parent_tile(d::therow(v.first), d::thecol(v.first))].push_back(v.first);
 
-    build_tiles<PixelT>(*m_platefile, curr->hdrs, prev->cache, level, preblur, &curr->cache, pc);
+    build_tiles<PixelT>(m_platefile, curr->hdrs, prev->cache, level, preblur, &curr->cache, pc);
   }
 }
 
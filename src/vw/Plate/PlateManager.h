@@ -21,10 +21,12 @@
 
 #include <vw/Plate/FundamentalTypes.h>
 #include <vw/Plate/PlateFile.h>
+#include <vw/Plate/TileWriter.h>
 #include <vw/Cartography/GeoReference.h>
 #include <vw/Image/Transform.h>
 #include <vw/Image/Filter.h>
 #include <boost/foreach.hpp>
+#include <boost/bind.hpp>
 
 namespace vw {
 
@@ -36,8 +38,8 @@ namespace platefile {
     class RememberCallback;
   }
 
-  template <class ViewT>
-  class WritePlateFileTask;
+  template <class ViewT, class DstPixelT>
+  class CropPlateTile;
 
   // The Tile Entry is used to keep track of the bounding box of
   // tiles and their location in the grid.
@@ -79,6 +81,21 @@ namespace platefile {
     void fast_mipmap( uint32 starting_level, int32 stopping_level, std::list<TileHeader>& src_hdrs, bool preblur, const detail::RememberCallback& pc) const;
     uint64 calc_cache_tile_count() const;
 
+    // Write the given tiles of view to the platefile, converted to the
+    // platefile's pixel type DstPixelT.
+    template <class DstPixelT, class ViewT>
+    void write_tiles( ImageViewBase<ViewT> const& view, std::list<TileInfo> const& tiles,
+                      int level, ProgressCallback const& progress ) const {
+      ThreadedTileWriter writer( m_platefile );
+      boost::function<void ()> tick =
+        boost::bind( &ProgressCallback::report_incremental_progress, &progress,
+                     1.0 / double(tiles.size()) );
+      BOOST_FOREACH( TileInfo const& tile, tiles )
+        writer.add_tile<DstPixelT>( CropPlateTile<ViewT, DstPixelT>(view.impl(), tile, level),
+                                    tile.i, tile.j, level, tick );
+      writer.process_tiles();
+    }
+
   public:
     PlateManager(boost::shared_ptr<PlateFile> platefile) : m_platefile(platefile) {}
 
@@ -142,16 +159,39 @@ namespace platefile {
       // the two operations below.
       m_platefile->write_request();
 
-      // Add each tile
+      // Add each tile.  Tiles are rasterized and encoded on the worker
+      // threads, then appended to the blob one at a time in the order
+      // they were listed, so the blob and index see the same sequence
+      // of writes as before.
       progress.report_progress(0);
-      BOOST_FOREACH( TileInfo const& tile, tiles ) {
-        typedef WritePlateFileTask<ImageViewRef<typename ViewT::pixel_type> > Job;
-
-        boost::scoped_ptr<Task> task(
-          new Job(m_platefile,
-                  tile, pyramid_level,
-                  trans_view, false, boost::numeric_cast<int>(tiles_size), progress));
-        (*task)();
+      switch(m_platefile->pixel_format()) {
+      case VW_PIXEL_GRAYA:
+        switch(m_platefile->channel_type()) {
+        case VW_CHANNEL_UINT8:
+        case VW_CHANNEL_UINT16:
+          this->write_tiles<PixelGrayA<uint8> >(trans_view, tiles, pyramid_level, progress);
+          break;
+        case VW_CHANNEL_INT16:
+          this->write_tiles<PixelGrayA<int16> >(trans_view, tiles, pyramid_level, progress);
+          break;
+        case VW_CHANNEL_FLOAT32:
+          this->write_tiles<PixelGrayA<float32> >(trans_view, tiles, pyramid_level, progress);
+          break;
+        default:
+          vw_throw(NoImplErr() << "Unsupported GrayA channel type in PlateManager.");
+        }
+        break;
+      case VW_PIXEL_RGBA:
+        switch(m_platefile->channel_type()) {
+        case VW_CHANNEL_UINT8:
+          this->write_tiles<PixelRGBA<uint8> >(trans_view, tiles, pyramid_level, progress);
+          break;
+        default:
+          vw_throw(NoImplErr() << "Unsupported RGBA channel type in PlateManager.");
+        }
+        break;
+      default:
+        vw_throw(NoImplErr() << "Unsupported pixel type in PlateManager.");
       }
       progress.report_finished();
 
@@ -181,85 +221,40 @@ namespace platefile {
   //                            WRITE PLATEFILE TASK
   // -------------------------------------------------------------------------
 
-  template <class ViewT>
-  class WritePlateFileTask : public Task {
-    boost::shared_ptr<PlateFile> m_platefile;
+  // Rasterizes one tile of an image being inserted into a platefile,
+  // for ThreadedTileWriter.  Tiles with no data at all are skipped.
+  template <class ViewT, class DstPixelT>
+  class CropPlateTile {
+    ViewT const* m_view;
     TileInfo m_tile_info;
     int m_level;
-    ViewT const& m_view;
-    bool m_verbose;
-    SubProgressCallback m_progress;
 
   public:
-    WritePlateFileTask(boost::shared_ptr<PlateFile> platefile,
-                       TileInfo const& tile_info,
-                       int level, ImageViewBase<ViewT> const& view,
-                       bool verbose, int total_num_blocks,
-                       const ProgressCallback &progress_callback = ProgressCallback::dummy_instance()) : m_platefile(platefile),
-      m_tile_info(tile_info), m_level(level), m_view(view.impl()),
-      m_verbose(verbose), m_progress(progress_callback,0.0,1.0/float(total_num_blocks)) {}
-
-    virtual ~WritePlateFileTask() {}
-    virtual void operator() () {
+    CropPlateTile( ViewT const& view, TileInfo const& tile_info, int level ) :
+      m_view(&view), m_tile_info(tile_info), m_level(level) {}
+
+    bool operator()( ImageView<DstPixelT>& dest ) const {
       VW_OUT(DebugMessage, "platefile") << "\t    Generating tile: [ "
                                         << m_tile_info.i << " " << m_tile_info.j
                                         << " @ level " <<  m_level << "]    BBox: "
                                         << m_tile_info.bbox << "\n";
 
       // Generate the tile from the image data
-      ImageView<typename ViewT::pixel_type> tile = crop(m_view, m_tile_info.bbox);
+      ImageView<typename ViewT::pixel_type> tile = crop(*m_view, m_tile_info.bbox);
 
       // If this tile contains no data at all, then we bail early without
       // doing anything.
-      if (is_transparent(tile)) {
-        m_progress.report_incremental_progress(1.0);
-        return;
-      }
+      if (is_transparent(tile))
+        return false;
 
-      // If the data is valid, we write it to the platefile.
-      //
       // TODO: This is where we could strip the tile of its alpha
       // channel to save space in the placefile.  This will require a
       // view that strips off the alpha channel.
-      //      m_platefile->write_request();
-
-      switch(m_platefile->pixel_format()) {
-      case VW_PIXEL_GRAYA:
-        switch(m_platefile->channel_type()) {
-        case VW_CHANNEL_UINT8:
-        case VW_CHANNEL_UINT16:
-          m_platefile->write_update(pixel_cast<PixelGrayA<uint8> >(tile), m_tile_info.i, m_tile_info.j, m_level);
-          break;
-        case VW_CHANNEL_INT16:
-          m_platefile->write_update(pixel_cast<PixelGrayA<int16> >(tile), m_tile_info.i, m_tile_info.j, m_level);
-          break;
-        case VW_CHANNEL_FLOAT32:
-          m_platefile->write_update(pixel_cast<PixelGrayA<float32> >(tile), m_tile_info.i, m_tile_info.j, m_level);
-          break;
-        default:
-          vw_throw(NoImplErr() << "Unsupported GrayA channel type in PlateManager.");
-        }
-        break;
-      case VW_PIXEL_RGBA:
-        switch(m_platefile->channel_type()) {
-        case VW_CHANNEL_UINT8:
-          m_platefile->write_update(pixel_cast<PixelRGBA<uint8> >(tile), m_tile_info.i, m_tile_info.j, m_level);
-          break;
-        default:
-          vw_throw(NoImplErr() << "Unsupported RGBA channel type in PlateManager.");
-        }
-        break;
-      default:
-        vw_throw(NoImplErr() << "Unsupported pixel type in PlateManager.");
-      }
-
-      //      m_platefile->write_complete();
-      m_progress.report_incremental_progress(1.0);
+      dest = pixel_cast<DstPixelT>(tile);
+      return true;
     }
   };
 
-
-
 }} // namespace vw::plate
 
 #endif // __VW_PLATE_PLATEMANAGER_H__
@@ -251,18 +251,36 @@ bool RpcServerBase::Task::handle_one_request() {
 }
 
 // TODO: Make the clientname settable here.
+// The stubs call through this, so an ordinary call can't overtake
+// pipelined calls that are still in flight.
+class RpcClientBase::OrderedChannel : public pb::RpcChannel {
+    IChannel* m_chan;
+  public:
+    boost::function<void ()> before_call;
+
+    OrderedChannel(IChannel* chan) : m_chan(chan) {}
+
+    void CallMethod(const pb::MethodDescriptor* method, pb::RpcController* controller,
+                    const pb::Message* request, pb::Message* response, pb::Closure* done) {
+      if (before_call)
+        before_call();
+      m_chan->drain();
+      m_chan->CallMethod(method, controller, request, response, done);
+    }
+};
+
 RpcClientBase::RpcClientBase(const Url& u)
-  : m_chan(IChannel::make_conn(u, u.string())) {}
+  : m_chan(IChannel::make_conn(u, u.string())), m_ordered(new OrderedChannel(m_chan.get())) {}
 
 // TODO: Make the clientname settable here.
 RpcClientBase::RpcClientBase(const Url& u, int32 timeout, uint32 retries)
-  : m_chan(IChannel::make_conn(u, u.string())) {
+  : m_chan(IChannel::make_conn(u, u.string())), m_ordered(new OrderedChannel(m_chan.get())) {
   m_chan->set_timeout(timeout);
   m_chan->set_retries(retries);
 }
 
 pb::RpcChannel* RpcClientBase::base_channel() {
-  return m_chan.get();
+  return m_ordered.get();
 }
 
 void RpcClientBase::set_timeout(int32 t) {
@@ -274,3 +292,29 @@ void RpcClientBase::set_retries(uint32 t) {
   VW_ASSERT(m_chan, LogicErr() << "Cannot set retries before constructing channel");
   m_chan->set_retries(t);
 }
+
+void RpcClientBase::send_request(const std::string& method, const pb::Message* request) {
+  const pb::MethodDescriptor* m = this->service()->GetDescriptor()->FindMethodByName(method);
+  VW_ASSERT(m, ArgumentErr() << "Unrecognized RPC method: " << method);
+  m_chan->send_request(m, request);
+}
+
+void RpcClientBase::recv_reply(pb::Message* response) {
+  m_chan->recv_reply(response);
+}
+
+size_t RpcClientBase::in_flight() const {
+  return m_chan->in_flight();
+}
+
+bool RpcClientBase::pipelined() const {
+  return m_chan->pipelined();
+}
+
+void RpcClientBase::drain() {
+  m_chan->drain();
+}
+
+void RpcClientBase::set_before_call(boost::function<void ()> const& f) {
+  m_ordered->before_call = f;
+}
@@ -23,6 +23,7 @@
 #include <google/protobuf/service.h>
 #include <boost/lambda/construct.hpp>
 #include <boost/lambda/bind.hpp>
+#include <boost/function.hpp>
 
 namespace vw {
 namespace platefile {
@@ -109,7 +110,9 @@ namespace platefile {
 
   class RpcClientBase : public RpcBase {
     private:
+      class OrderedChannel;
       boost::shared_ptr<IChannel> m_chan;
+      boost::shared_ptr<OrderedChannel> m_ordered;
     protected:
       // This exists to allow a fwd-decl of IChannel
       ::google::protobuf::RpcChannel* base_channel();
@@ -121,6 +124,20 @@ namespace platefile {
       // -1 means "never", other values in ms
       void set_timeout(int32 t);
       void set_retries(uint32 t);
+
+      // Pipelined calls; see IChannel::send_request. method is the name of
+      // one of the service's methods. The ordinary stub methods wait for
+      // any pipelined calls to finish before they send.
+      void send_request(const std::string& method, const ::google::protobuf::Message* request);
+      void recv_reply(::google::protobuf::Message* response);
+      size_t in_flight() const;
+      bool pipelined() const;
+      void drain();
+
+      // Called before each ordinary stub call, ahead of the drain, so
+      // that whoever made the pipelined calls can collect (and deal with)
+      // their replies itself. Pass an empty function to remove it.
+      void set_before_call(boost::function<void ()> const& f);
   };
 
   template <typename ServiceT>
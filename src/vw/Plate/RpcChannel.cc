@@ -28,11 +28,18 @@
 #include <vw/Plate/detail/ZeroMQChannel.h>
 #endif
 
+#if defined(VW_HAVE_PKG_RT) && VW_HAVE_PKG_RT==1
+#include <vw/Plate/detail/ShmChannel.h>
+#endif
+
 #include <vw/Plate/HTTPUtils.h>
+#include <vw/Plate/Exception.h>
 #include <vw/Core/Stopwatch.h>
 #include <google/protobuf/descriptor.h>
+#include <google/protobuf/message.h>
 #include <boost/numeric/conversion/cast.hpp>
 #include <boost/scoped_array.hpp>
+#include <boost/scoped_ptr.hpp>
 
 namespace pb = ::google::protobuf;
 
@@ -72,6 +79,34 @@ int32 IChannel::recv_message(RpcWrapper& message) {
   return 1;
 }
 
+void IChannel::send_request(const pb::MethodDescriptor* method, const pb::Message* request) {
+  boost::shared_ptr<pb::Message> copy(request->New());
+  copy->CopyFrom(*request);
+  m_deferred.push_back(std::make_pair(method, copy));
+}
+
+void IChannel::recv_reply(pb::Message* response) {
+  VW_ASSERT(!m_deferred.empty(), LogicErr() << "recv_reply() called with no request in flight");
+  Deferred call = m_deferred.front();
+  m_deferred.pop_front();
+
+  boost::scoped_ptr<pb::Message> discard;
+  if (!response) {
+    discard.reset(pb::MessageFactory::generated_factory()->GetPrototype(call.first->output_type())->New());
+    response = discard.get();
+  }
+  this->CallMethod(call.first, 0, call.second.get(), response, null_callback());
+}
+
+size_t IChannel::in_flight() const {
+  return m_deferred.size();
+}
+
+void IChannel::drain() {
+  while (this->in_flight() > 0)
+    this->recv_reply(0);
+}
+
 IChannel* IChannel::make(const std::string& scheme, const std::string& clientname) {
 
 #if defined(VW_HAVE_PKG_RABBITMQ_C) && VW_HAVE_PKG_RABBITMQ_C==1
@@ -84,6 +119,11 @@ IChannel* IChannel::make(const std::string& scheme, const std::string& clientnam
     return new ZeroMQChannel(clientname);
 #endif
 
+#if defined(VW_HAVE_PKG_RT) && VW_HAVE_PKG_RT==1
+  if (scheme == "shm")
+    return new ShmChannel(clientname);
+#endif
+
   vw_throw(NoImplErr() << "Unsupported channel scheme: " << scheme);
 }
 
@@ -21,7 +21,9 @@
 
 #include <vw/Core/FundamentalTypes.h>
 #include <google/protobuf/service.h>
+#include <boost/shared_ptr.hpp>
 #include <vector>
+#include <deque>
 
 namespace vw {
 namespace platefile {
@@ -55,6 +57,23 @@ class IChannel : public ::google::protobuf::RpcChannel {
                             google::protobuf::Message*,
                             google::protobuf::Closure*) = 0;
 
+    // Pipelined calls. send_request() sends a request without waiting for
+    // the reply, and recv_reply() waits for the reply to the oldest request
+    // still in flight (a null response discards it, but still throws if the
+    // call failed). Pipelined calls are never retried.
+    //
+    // Channels that can't have more than one request in flight hold on to
+    // the request and make the whole call in recv_reply(), so this works
+    // (without the speedup) on any channel. Call drain() before going back
+    // to CallMethod(); RpcClient does this for you.
+    virtual void send_request(const google::protobuf::MethodDescriptor* method,
+                              const google::protobuf::Message* request);
+    virtual void recv_reply(google::protobuf::Message* response);
+    virtual size_t in_flight() const;
+    // True if send_request() really sends.
+    virtual bool pipelined() const { return false; }
+    void drain();
+
     // -1 means "never timeout", other values in ms
     virtual void set_timeout(int32 val) = 0;
     virtual void set_retries(uint32 r) = 0;
@@ -72,6 +91,13 @@ class IChannel : public ::google::protobuf::RpcChannel {
     IChannel() {}
     virtual ~IChannel() {}
 
+  private:
+    typedef std::pair<const google::protobuf::MethodDescriptor*,
+                      boost::shared_ptr<google::protobuf::Message> > Deferred;
+    std::deque<Deferred> m_deferred;
+
+  public:
+
     // Factories
     static IChannel* make(const std::string& scheme, const std::string& clientname);
     static IChannel* make_conn(const Url& url, const std::string& clientname);
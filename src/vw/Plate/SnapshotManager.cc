@@ -41,7 +41,7 @@ namespace {
   template <typename PixelT>
   void parse_image_and_store(const Tile& t, tile_cache_t<PixelT>& tile_cache) {
     ImageView<PixelT>& image = tile_cache[d::rowcoltid_t(t.hdr.row(), t.hdr.col(), t.hdr.transaction_id())];
-    boost::scoped_ptr<SrcImageResource> r(SrcMemoryImageResource::open(t.hdr.filetype(), &t.data->operator[](0), t.data->size()));
+    boost::scoped_ptr<SrcImageResource> r(SrcMemoryImageResource::open(t.hdr.filetype(), t.data->data(), t.data->size()));
     read_image(image, *r);
   }
 
@@ -101,7 +101,9 @@ void SnapshotManager<PixelT>::snapshot(uint32 level, BBox2i const& tile_region,
     composite_map_t composite_map;
 
     // Grab the tiles in the zone
-    BOOST_FOREACH(const TileHeader& hdr, m_read_plate->search_by_region(level, region, range))
+    std::vector<TileHeader> hdrs;
+    m_read_plate->search_by_region(hdrs, level, region, range);
+    BOOST_FOREACH(const TileHeader& hdr, hdrs)
       composite_map[d::rowcol_t(hdr.row(), hdr.col())].push_back(hdr);
 
     if (composite_map.size() == 0) {
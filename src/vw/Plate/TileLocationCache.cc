@@ -0,0 +1,104 @@
+// __BEGIN_LICENSE__
+//  Copyright (c) 2006-2013, United States Government as represented by the
+//  Administrator of the National Aeronautics and Space Administration. All
+//  rights reserved.
+//
+//  The NASA Vision Workbench is licensed under the Apache License,
+//  Version 2.0 (the "License"); you may not use this file except in
+//  compliance with the License. You may obtain a copy of the License at
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+// __END_LICENSE__
+
+
+#include <vw/Plate/TileLocationCache.h>
+
+#include <boost/foreach.hpp>
+#include <boost/algorithm/string/trim.hpp>
+#include <boost/algorithm/string/split.hpp>
+#include <boost/algorithm/string/classification.hpp>
+#include <sstream>
+#include <vector>
+
+using std::string;
+
+namespace vw {
+namespace platefile {
+
+std::string TileLocation::etag() const {
+  std::ostringstream ostr;
+  ostr << '"' << std::hex << uint32(platefile_id) << '-' << blob_id << '-' << blob_offset << '"';
+  return ostr.str();
+}
+
+bool etag_matches(const string& if_none_match, const string& etag) {
+  std::vector<string> tags;
+  boost::split(tags, if_none_match, boost::is_any_of(","));
+  BOOST_FOREACH(string& tag, tags) {
+    boost::trim(tag);
+    // If-None-Match uses the weak comparison, so ignore W/
+    if (tag.compare(0, 2, "W/") == 0)
+      tag.erase(0, 2);
+    if (tag == "*" || tag == etag)
+      return true;
+  }
+  return false;
+}
+
+bool TileLocationCache::Key::operator<(const Key& o) const {
+  if (platefile_id   != o.platefile_id)   return platefile_id   < o.platefile_id;
+  if (level          != o.level)          return level          < o.level;
+  if (row            != o.row)            return row            < o.row;
+  if (col            != o.col)            return col            < o.col;
+  if (transaction_id != o.transaction_id) return transaction_id < o.transaction_id;
+  return exact < o.exact;
+}
+
+bool TileLocationCache::get(const Key& key, TileLocation& loc) {
+  map_t::iterator i = m_map.find(key);
+  if (i == m_map.end()) {
+    m_misses++;
+    return false;
+  }
+  m_hits++;
+  m_lru.splice(m_lru.begin(), m_lru, i->second);
+  loc = i->second->second;
+  return true;
+}
+
+void TileLocationCache::insert(const Key& key, const TileLocation& loc) {
+  if (m_max_size == 0)
+    return;
+
+  map_t::iterator i = m_map.find(key);
+  if (i != m_map.end()) {
+    i->second->second = loc;
+    m_lru.splice(m_lru.begin(), m_lru, i->second);
+    return;
+  }
+
+  m_lru.push_front(std::make_pair(key, loc));
+  m_map.insert(std::make_pair(key, m_lru.begin()));
+
+  while (m_map.size() > m_max_size) {
+    m_map.erase(m_lru.back().first);
+    m_lru.pop_back();
+    m_evictions++;
+  }
+}
+
+void TileLocationCache::invalidate(int32 platefile_id) {
+  Key first = {platefile_id, 0, 0, 0, 0, false};
+  map_t::iterator i = m_map.lower_bound(first);
+  while (i != m_map.end() && i->first.platefile_id == platefile_id) {
+    m_lru.erase(i->second);
+    m_map.erase(i++);
+  }
+}
+
+}} // namespace vw::platefile
@@ -0,0 +1,102 @@
+// __BEGIN_LICENSE__
+//  Copyright (c) 2006-2013, United States Government as represented by the
+//  Administrator of the National Aeronautics and Space Administration. All
+//  rights reserved.
+//
+//  The NASA Vision Workbench is licensed under the Apache License,
+//  Version 2.0 (the "License"); you may not use this file except in
+//  compliance with the License. You may obtain a copy of the License at
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+// __END_LICENSE__
+
+
+// \file TileLocationCache.h
+//
+// What mod_plate remembers about tiles it has already looked up, so that
+// repeated requests (and conditional ones) don't have to go back to the
+// index.
+//
+#ifndef __VW_PLATE_TILELOCATIONCACHE_H__
+#define __VW_PLATE_TILELOCATIONCACHE_H__
+
+#include <vw/Core/FundamentalTypes.h>
+#include <string>
+#include <list>
+#include <map>
+
+namespace vw {
+namespace platefile {
+
+// Everything handle_image needs to answer a tile request without going back
+// to the index: the record it found, and the sendfile(2) parameters for it.
+struct TileLocation {
+  int32       platefile_id;
+  int32       transaction_id; // what the lookup was made at (never -1)
+  bool        exact;
+  std::string filetype;
+  uint32      blob_id;
+  uint64      blob_offset;
+
+  // sendfile(2) parameters. have_data is false until they've been looked up.
+  bool        have_data;
+  std::string filename;
+  uint64      offset, size;
+
+  TileLocation() : platefile_id(0), transaction_id(0), exact(false), blob_id(0), blob_offset(0),
+                   have_data(false), offset(0), size(0) {}
+
+  // A strong entity tag. Blobs are append-only, so a (blob, offset) pair
+  // always names the same bytes within a platefile.
+  std::string etag() const;
+};
+
+// True if an If-None-Match header value matches etag
+bool etag_matches(const std::string& if_none_match, const std::string& etag);
+
+// A size-bounded, least-recently-used cache of tile locations. Only results
+// that can't change are stored: the transaction must be at or below the
+// platefile's read cursor, and the owner must invalidate() a platefile
+// whenever its read cursor moves.
+class TileLocationCache {
+  public:
+    struct Key {
+      int32  platefile_id;
+      uint32 level, col, row;
+      uint32 transaction_id;
+      bool   exact;
+      bool operator<(const Key& o) const;
+    };
+
+    TileLocationCache(size_t max_size) : m_max_size(max_size), m_hits(0), m_misses(0), m_evictions(0) {}
+
+    // Copies the cached location into loc and returns true on a hit
+    bool get(const Key& key, TileLocation& loc);
+    void insert(const Key& key, const TileLocation& loc);
+    // Forget every location from one platefile
+    void invalidate(int32 platefile_id);
+
+    size_t size() const { return m_map.size(); }
+    size_t max_size() const { return m_max_size; }
+    uint64 hits() const { return m_hits; }
+    uint64 misses() const { return m_misses; }
+    uint64 evictions() const { return m_evictions; }
+
+  private:
+    typedef std::list<std::pair<Key, TileLocation> > lru_t;
+    typedef std::map<Key, lru_t::iterator> map_t;
+
+    size_t m_max_size;
+    lru_t  m_lru;      // most recently used first
+    map_t  m_map;
+    uint64 m_hits, m_misses, m_evictions;
+};
+
+}} // namespace vw::platefile
+
+#endif
@@ -25,6 +25,7 @@
 #include <vw/Image/Interpolation.h>
 #include <vw/Image/ImageView.h>
 #include <vw/Image/Filter.h>
+#include <vw/Image/Algorithms.h>
 #include <vw/Math/BBox.h>
 #include <list>
 
@@ -37,30 +38,67 @@ namespace platefile {
   // tile the space of the larger bbox.
   std::list<vw::BBox2i> bbox_tiles(vw::BBox2i const& bbox, int width, int height);
 
+  namespace detail {
+    // Writes the 2x2 reduction of one child tile into the quadrant of
+    // dest whose top left corner is (x0,y0).  With blur each output
+    // pixel is the mean of a 2x2 block, taken first along rows and
+    // then down columns and cast back to the channel type after each
+    // pass, which matches a separable [0.5 0.5] convolution followed by
+    // subsample(2) bit for bit.  Without blur it just takes the top
+    // left pixel of each block.
+    template <class PixelT>
+    void box_downsample_quadrant(ImageView<PixelT>& dest, int32 x0, int32 y0,
+                                 ImageView<PixelT> const& src, bool blur) {
+      typedef typename CompoundChannelType<PixelT>::type channel_type;
+      const int32 n = CompoundNumChannels<PixelT>::value;
+      const int32 cols = src.cols() / 2, rows = src.rows() / 2;
+
+      for (int32 y = 0; y < rows; ++y) {
+        const channel_type *top = reinterpret_cast<const channel_type*>(&src(0, 2*y));
+        const channel_type *bot = reinterpret_cast<const channel_type*>(&src(0, 2*y+1));
+        channel_type *out = reinterpret_cast<channel_type*>(&dest(x0, y0+y));
+        if (!blur) {
+          for (int32 x = 0; x < cols; ++x, top += 2*n, out += n)
+            for (int32 c = 0; c < n; ++c)
+              out[c] = top[c];
+          continue;
+        }
+        for (int32 x = 0; x < cols; ++x, top += 2*n, bot += 2*n, out += n) {
+          for (int32 c = 0; c < n; ++c) {
+            channel_type upper = channel_type(0.5f*top[c] + 0.5f*top[c+n]);
+            channel_type lower = channel_type(0.5f*bot[c] + 0.5f*bot[c+n]);
+            out[c] = channel_type(0.5f*upper + 0.5f*lower);
+          }
+        }
+      }
+    }
+  }
+
+  // Builds a tile one level up from its four children, any of which
+  // may be missing (an empty ImageView).  Missing children leave their
+  // quadrant zero, i.e. transparent.  The result is written straight
+  // into dest, one quadrant per child, without assembling the children
+  // into a double size image first.
   template <class PixelT>
   void mipmap_one_tile(ImageView<PixelT>& dest, uint32 tile_size, const ImageView<PixelT>& UL, const ImageView<PixelT>& UR, const ImageView<PixelT>& LL, const ImageView<PixelT>& LR, bool blur = true)
   {
-    VW_ASSERT(!UL || (UL.cols() == int32(tile_size) && UL.rows() == int32(tile_size)), LogicErr() << "Tiles must be the same size as tile_size");
-    VW_ASSERT(!UR || (UR.cols() == int32(tile_size) && UR.rows() == int32(tile_size)), LogicErr() << "Tiles must be the same size as tile_size");
-    VW_ASSERT(!LL || (LL.cols() == int32(tile_size) && LL.rows() == int32(tile_size)), LogicErr() << "Tiles must be the same size as tile_size");
-    VW_ASSERT(!LR || (LR.cols() == int32(tile_size) && LR.rows() == int32(tile_size)), LogicErr() << "Tiles must be the same size as tile_size");
-    VW_ASSERT(UL || UR || LL || LR, LogicErr() << "Must compose at least one tile");
-
-    ImageView<PixelT> super(2*tile_size, 2*tile_size);
-
-    if (UL) crop(super, 0,         0,         tile_size, tile_size) = UL;
-    if (UR) crop(super, tile_size, 0,         tile_size, tile_size) = UR;
-    if (LL) crop(super, 0,         tile_size, tile_size, tile_size) = LL;
-    if (LR) crop(super, tile_size, tile_size, tile_size, tile_size) = LR;
-
-    // We subsample after blurring with a standard 2x2 box filter.
-    std::vector<float> kernel(2);
-    kernel[0] = kernel[1] = 0.5;
-
-    if (blur)
-      dest = subsample( separable_convolution_filter( super, kernel, kernel, 1, 1, ConstantEdgeExtension() ), 2);
-    else
-      dest = subsample( super, 2 );
+    VW_ASSERT(!UL.is_valid_image() || (UL.cols() == int32(tile_size) && UL.rows() == int32(tile_size)), LogicErr() << "Tiles must be the same size as tile_size");
+    VW_ASSERT(!UR.is_valid_image() || (UR.cols() == int32(tile_size) && UR.rows() == int32(tile_size)), LogicErr() << "Tiles must be the same size as tile_size");
+    VW_ASSERT(!LL.is_valid_image() || (LL.cols() == int32(tile_size) && LL.rows() == int32(tile_size)), LogicErr() << "Tiles must be the same size as tile_size");
+    VW_ASSERT(!LR.is_valid_image() || (LR.cols() == int32(tile_size) && LR.rows() == int32(tile_size)), LogicErr() << "Tiles must be the same size as tile_size");
+    VW_ASSERT(UL.is_valid_image() || UR.is_valid_image() || LL.is_valid_image() || LR.is_valid_image(), LogicErr() << "Must compose at least one tile");
+    VW_ASSERT(tile_size % 2 == 0, LogicErr() << "Tile size must be even to mipmap");
+
+    dest.set_size(tile_size, tile_size);
+    const int32 half = tile_size / 2;
+    const ImageView<PixelT>* children[4] = { &UL, &UR, &LL, &LR };
+    for (int32 i = 0; i < 4; ++i) {
+      int32 x0 = (i % 2) * half, y0 = (i / 2) * half;
+      if (children[i]->is_valid_image())
+        detail::box_downsample_quadrant(dest, x0, y0, *children[i], blur);
+      else
+        fill(crop(dest, x0, y0, half, half), PixelT());
+    }
   }
 
   // Resample image by reaching up a few levels and using the data there.
@@ -0,0 +1,298 @@
+// __BEGIN_LICENSE__
+//  Copyright (c) 2006-2013, United States Government as represented by the
+//  Administrator of the National Aeronautics and Space Administration. All
+//  rights reserved.
+//
+//  The NASA Vision Workbench is licensed under the Apache License,
+//  Version 2.0 (the "License"); you may not use this file except in
+//  compliance with the License. You may obtain a copy of the License at
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+// __END_LICENSE__
+
+
+/// \file TileWriter.h
+///
+/// A pipeline for writing many tiles to a platefile at once.  Tiles
+/// are produced and encoded on a pool of worker threads, then appended
+/// to the blob and the index one at a time, in the order they were
+/// added, by a single commit thread.  This is the tile analogue of
+/// the ThreadedBlockWriter in vw/Image/ImageIO.h.
+///
+/// The caller still owns the transaction and the blob lock: call
+/// write_request() before adding tiles and write_complete() after
+/// process_tiles() returns.  Nothing else may use the platefile while
+/// tiles are in flight.
+///
+#ifndef __VW_PLATE_TILEWRITER_H__
+#define __VW_PLATE_TILEWRITER_H__
+
+#include <vw/Plate/PlateFile.h>
+#include <vw/Core/ThreadPool.h>
+#include <vw/Core/Settings.h>
+#include <vw/Core/Debugging.h>
+
+#include <boost/function.hpp>
+
+namespace vw {
+namespace platefile {
+
+  // Limits the memory held by tiles that have been produced but not
+  // yet written to the blob.  Tiles reserve their share in the order
+  // they will be written, and only the write gives it back, so the
+  // next tile to be written always holds its reservation and the
+  // pipeline can't wedge with the budget spent on later tiles.  A tile
+  // larger than the whole budget is let through when nothing else is
+  // in flight.
+  class TileMemoryBudget : private boost::noncopyable {
+    Mutex m_mutex;
+    Condition m_condition;
+    uint64 m_budget, m_in_use;
+    int m_next_index;
+
+  public:
+    TileMemoryBudget( uint64 budget ) : m_budget(budget), m_in_use(0), m_next_index(0) {}
+
+    void reserve( int index, uint64 bytes ) {
+      {
+        Mutex::Lock lock(m_mutex);
+        while ( index != m_next_index ||
+                ( m_in_use > 0 && m_in_use + bytes > m_budget ) )
+          m_condition.wait(lock);
+        m_in_use += bytes;
+        m_next_index++;
+      }
+      m_condition.notify_all();
+    }
+
+    void release( uint64 bytes ) {
+      {
+        Mutex::Lock lock(m_mutex);
+        m_in_use -= bytes;
+      }
+      m_condition.notify_all();
+    }
+  };
+
+  // Holds the first error raised by any stage of the pipeline, so that
+  // it can be rethrown on the caller's thread.  Once an error is set
+  // the remaining tiles are drained without being generated or
+  // written.
+  class TileWriterError : private boost::noncopyable {
+    mutable Mutex m_mutex;
+    boost::shared_ptr<Exception> m_error;
+
+  public:
+    void set( Exception const& e ) {
+      Mutex::Lock lock(m_mutex);
+      if (!m_error)
+        m_error.reset( e.clone() );
+    }
+
+    void set( std::exception const& e ) {
+      Exception err;
+      err.set( e.what() );
+      this->set( err );
+    }
+
+    bool failed() const {
+      Mutex::Lock lock(m_mutex);
+      return bool(m_error);
+    }
+
+    // Throws the stored error, if any, and clears it.
+    void rethrow() {
+      boost::shared_ptr<Exception> error;
+      {
+        Mutex::Lock lock(m_mutex);
+        error.swap(m_error);
+      }
+      if (error)
+        vw_throw( *error );
+    }
+  };
+
+  // The last stage: appends one encoded tile to the blob and updates
+  // the index.  These run one at a time, in tile order, on an
+  // OrderedWorkQueue.  Tiles with nothing to write (or whose encode
+  // failed) arrive with no data and only release their memory.
+  class CommitTileTask : public Task {
+    boost::shared_ptr<PlateFile> m_platefile;
+    int m_col, m_row, m_level;
+    boost::shared_ptr<DstMemoryImageResource> m_data;
+    std::string m_type;
+    uint64 m_bytes;
+    TileMemoryBudget& m_budget;
+    TileWriterError& m_error;
+    boost::function<void ()> m_on_commit;
+
+  public:
+    CommitTileTask(boost::shared_ptr<PlateFile> platefile,
+                   int col, int row, int level,
+                   boost::shared_ptr<DstMemoryImageResource> data,
+                   std::string const& type, uint64 bytes,
+                   TileMemoryBudget& budget, TileWriterError& error,
+                   boost::function<void ()> const& on_commit) :
+      m_platefile(platefile), m_col(col), m_row(row), m_level(level),
+      m_data(data), m_type(type), m_bytes(bytes), m_budget(budget),
+      m_error(error), m_on_commit(on_commit) {}
+
+    virtual ~CommitTileTask() {}
+    virtual void operator() () {
+      if (m_data && !m_error.failed()) {
+        try {
+          m_platefile->write_update(m_data->data(), m_data->size(),
+                                    m_col, m_row, m_level, m_type);
+        } catch (const Exception& e) {
+          m_error.set(e);
+        } catch (const std::exception& e) {
+          m_error.set(e);
+        }
+      }
+      m_data.reset();
+      m_budget.release(m_bytes);
+      if (m_on_commit)
+        m_on_commit();
+    }
+  };
+
+  // The parallel stage: asks the generator for a tile, encodes it and
+  // queues it for commit.  The generator is called as
+  //
+  //   bool generator( ImageView<PixelT>& tile );
+  //
+  // and returns false if there is nothing to write at this location.
+  // Whatever happens, exactly one CommitTileTask is queued for this
+  // tile's index: the commit queue and the memory budget both wait
+  // for every index in turn, so a missing one would stall the writer.
+  // Errors are handed to the TileWriterError instead of escaping the
+  // worker thread.
+  template <class PixelT, class GeneratorT>
+  class EncodeTileTask : public Task {
+    boost::shared_ptr<PlateFile> m_platefile;
+    GeneratorT m_generator;
+    int m_col, m_row, m_level, m_index;
+    uint64 m_bytes;
+    TileMemoryBudget& m_budget;
+    TileWriterError& m_error;
+    OrderedWorkQueue& m_commit_queue;
+    boost::function<void ()> m_on_commit;
+
+  public:
+    EncodeTileTask(boost::shared_ptr<PlateFile> platefile, GeneratorT const& generator,
+                   int col, int row, int level, int index, uint64 bytes,
+                   TileMemoryBudget& budget, TileWriterError& error,
+                   OrderedWorkQueue& commit_queue,
+                   boost::function<void ()> const& on_commit) :
+      m_platefile(platefile), m_generator(generator),
+      m_col(col), m_row(row), m_level(level), m_index(index), m_bytes(bytes),
+      m_budget(budget), m_error(error), m_commit_queue(commit_queue), m_on_commit(on_commit) {}
+
+    virtual ~EncodeTileTask() {}
+    virtual void operator() () {
+      m_budget.reserve(m_index, m_bytes);
+
+      boost::shared_ptr<DstMemoryImageResource> data;
+      std::string type;
+      if (!m_error.failed()) {
+        try {
+          ImageView<PixelT> tile;
+          if (m_generator(tile))
+            data = m_platefile->encode_tile(tile, type);
+        } catch (const Exception& e) {
+          m_error.set(e);
+          data.reset();
+        } catch (const std::exception& e) {
+          m_error.set(e);
+          data.reset();
+        }
+      }
+
+      boost::shared_ptr<Task> commit( new CommitTileTask(m_platefile, m_col, m_row, m_level,
+                                                         data, type, m_bytes, m_budget,
+                                                         m_error, m_on_commit) );
+      m_commit_queue.add_task(commit, m_index);
+    }
+  };
+
+  /// Generates, encodes and writes tiles to a platefile using
+  /// vw_settings().default_num_threads() worker threads.  Tiles are
+  /// written in the order they were added.  At most budget bytes of
+  /// raw tiles (by default the size of the system cache) are in
+  /// flight at once; a worker that would exceed that waits for the
+  /// commit thread to catch up.
+  ///
+  /// If generating, encoding or writing any tile fails, the remaining
+  /// tiles are skipped and process_tiles() rethrows the first error.
+  class ThreadedTileWriter : private boost::noncopyable {
+    boost::shared_ptr<PlateFile> m_platefile;
+    TileMemoryBudget m_budget;
+    TileWriterError m_error;
+    FifoWorkQueue m_encode_queue;
+    OrderedWorkQueue m_commit_queue;
+    int m_next_index;
+    PixelFormatEnum m_checked_pixel;
+    ChannelTypeEnum m_checked_channel;
+
+    // Encode a dummy tile on the caller's thread, so that a pixel type
+    // or file type the platefile can't write is reported by add_tile()
+    // rather than by every worker.
+    template <class PixelT>
+    void check_format() {
+      if (PixelFormatID<PixelT>::value == m_checked_pixel &&
+          ChannelTypeID<typename PixelChannelType<PixelT>::type>::value == m_checked_channel)
+        return;
+      std::string type;
+      m_platefile->encode_tile(ImageView<PixelT>(1, 1), type);
+      m_checked_pixel   = PixelFormatID<PixelT>::value;
+      m_checked_channel = ChannelTypeID<typename PixelChannelType<PixelT>::type>::value;
+    }
+
+  public:
+    ThreadedTileWriter( boost::shared_ptr<PlateFile> platefile,
+                        uint64 budget = vw_settings().system_cache_size() ) :
+      m_platefile(platefile), m_budget(budget), m_commit_queue(1), m_next_index(0),
+      m_checked_pixel(VW_PIXEL_UNKNOWN), m_checked_channel(VW_CHANNEL_UNKNOWN) {}
+
+    // Waits for the tiles in flight, but never throws; call
+    // process_tiles() to find out whether they were written.
+    ~ThreadedTileWriter() {
+      m_encode_queue.join_all();
+      m_commit_queue.join_all();
+    }
+
+    /// Queue the tile at (col,row,level).  See EncodeTileTask for what
+    /// the generator must look like; it is copied, and called on a
+    /// worker thread.  on_commit, if given, is called on the commit
+    /// thread after the tile has been written (or skipped).  Throws
+    /// right away if the platefile can't encode PixelT.
+    template <class PixelT, class GeneratorT>
+    void add_tile( GeneratorT const& generator, int col, int row, int level,
+                   boost::function<void ()> const& on_commit = boost::function<void ()>() ) {
+      this->check_format<PixelT>();
+      const uint64 bytes = uint64(m_platefile->default_tile_size()) *
+        m_platefile->default_tile_size() * uint32(PixelNumBytes<PixelT>::value);
+      boost::shared_ptr<Task> task(
+        new EncodeTileTask<PixelT, GeneratorT>(m_platefile, generator, col, row, level,
+                                               m_next_index++, bytes, m_budget, m_error,
+                                               m_commit_queue, on_commit) );
+      m_encode_queue.add_task(task);
+    }
+
+    /// Wait until every tile added so far has been written.  Rethrows
+    /// the first error raised by any tile since the last call.
+    void process_tiles() {
+      m_encode_queue.join_all();
+      m_commit_queue.join_all();
+      m_error.rethrow();
+    }
+  };
+
+}} // namespace vw::platefile
+
+#endif // __VW_PLATE_TILEWRITER_H__
@@ -77,7 +77,7 @@ int main( int argc, char *argv[] ) {
 
   // -------------------
 
-  ReadBlob blob(blob_name);
+  ReadBlob blob(blob_name, ReadBlob::MAPPED);
 
   std::string blob_prefix = fs::path(blob_name).stem().string();
 
@@ -106,7 +106,7 @@ int main( int argc, char *argv[] ) {
     // Here is where we actually write the data to file
     std::ofstream ofile(ostr.str().c_str(), std::ios::binary);
     VW_ASSERT(ofile.is_open(), IOErr() << "could not open dst file for writing (" << ostr.str() << ")");
-    ofile.write(reinterpret_cast<char*>(&rec.data->operator[](0)), rec.data->size());
+    ofile.write(reinterpret_cast<const char*>(rec.data->data()), rec.data->size());
     VW_ASSERT(!ofile.fail(), IOErr() << ": failed to write to " << ostr.str());
     ofile.close();
   }
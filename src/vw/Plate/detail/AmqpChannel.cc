@@ -305,6 +305,51 @@ CallMethod_receive_again:
   vw_throw(RpcErr() << "CallMethod timed out completely");
 }
 
+void AmqpChannel::send_request(const pb::MethodDescriptor* method, const pb::Message* request) {
+  RpcWrapper q_wrap;
+  q_wrap.set_method(method->name());
+  q_wrap.set_payload(request->SerializeAsString());
+  q_wrap.set_requestor(this->name());
+  q_wrap.set_seq(++m_seq);
+
+  send_message(q_wrap);
+  m_pipeline.push_back(m_seq);
+}
+
+void AmqpChannel::recv_reply(pb::Message* response) {
+  VW_ASSERT(!m_pipeline.empty(), LogicErr() << "recv_reply() called with no request in flight");
+  const uint32 seq = m_pipeline.front();
+  m_pipeline.pop_front();
+
+  RpcWrapper a_wrap;
+  while (true) {
+    switch (recv_message(a_wrap)) {
+      case 0:
+        vw_throw(NetworkErr() << "Timeout waiting for pipelined reply " << seq << " on \"" << this->name() << "\"");
+      case -1:
+        // We can't tell whose reply this was, so we can't trust the ones
+        // after it either.
+        vw_throw(RpcErr() << "Corrupted pipelined reply on \"" << this->name() << "\"");
+      default: {
+        // Replies to calls we already gave up on can still show up late
+        const uint32 got = a_wrap.seq();
+        if (got < seq)
+          continue;
+        if (got != seq)
+          vw_throw(RpcErr() << "Lost pipelined reply on \"" << this->name() << "\" (expected " << seq << ", got " << got << ")");
+        throw_rpc_error(a_wrap.error());
+        if (response)
+          response->ParseFromString(a_wrap.payload());
+        return;
+      }
+    }
+  }
+}
+
+size_t AmqpChannel::in_flight() const {
+  return m_pipeline.size();
+}
+
 void AmqpChannel::locked_exchange_declare(std::string const& exchange_name,
                                           std::string const& exchange_type,
                                           bool durable, bool auto_delete) {
@@ -68,6 +68,7 @@ namespace platefile {
       int32 m_timeout;
       uint32 m_seq;
       uint32 m_retries;
+      std::deque<uint32> m_pipeline; // seqs of the pipelined requests in flight
     protected:
       void locked_check_error(const amqp_rpc_reply_t& x, const std::string& context);
       void locked_exchange_declare(std::string const& exchange_name, std::string const& exchange_type, bool durable, bool auto_delete);
@@ -103,6 +104,14 @@ namespace platefile {
                               google::protobuf::Message*,
                               google::protobuf::Closure*);
 
+      // Replies carry the request's seq, so several requests can be in
+      // flight at once.
+      virtual void send_request(const google::protobuf::MethodDescriptor* method,
+                                const google::protobuf::Message* request);
+      virtual void recv_reply(google::protobuf::Message* response);
+      virtual size_t in_flight() const;
+      virtual bool pipelined() const { return true; }
+
       // url format:
       // amqp://${rabbit_ip}:${port}/${exchange}
       // or
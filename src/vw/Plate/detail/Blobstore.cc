@@ -20,17 +20,24 @@
 #include <vw/Plate/detail/Index.h>
 #include <vw/Plate/Blob.h>
 #include <vw/Plate/Exception.h>
+#include <vw/Core/ThreadPool.h>
 #include <boost/foreach.hpp>
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
 #include <boost/filesystem/operations.hpp>
 #include <boost/format.hpp>
 #include <boost/iostreams/tee.hpp>
 #include <boost/iostreams/stream.hpp>
 
+#include <sstream>
+#include <vector>
+
 namespace fs = boost::filesystem;
 namespace io = boost::iostreams;
 
 namespace {
   static const size_t DEFAULT_BLOB_CACHE_SIZE = 8;
+  static const vw::uint32 DEFAULT_READ_DEPTH = 4;
   static const boost::format blob_tmpl("%s/plate_%u.blob");
 
   class BlobWriteState : public vw::platefile::WriteState {
@@ -42,6 +49,9 @@ namespace {
       vw::platefile::Transaction transaction;
       boost::shared_ptr<vw::platefile::Blob> blob;
       vw::uint32 blob_id;
+      // Index records for the tiles written to the blob so far, when the
+      // store defers index updates to write_complete()
+      std::vector<std::pair<vw::platefile::TileHeader, vw::platefile::detail::IndexRecord> > pending;
   };
 
 }
@@ -58,7 +68,7 @@ class BlobOpener {
     }
     size_t size() const {return 1;}
     boost::shared_ptr<value_type> generate() const {
-      return boost::shared_ptr<value_type>(new ReadBlob(fn));
+      return boost::shared_ptr<value_type>(new ReadBlob(fn, ReadBlob::MAPPED));
     }
 };
 
@@ -70,17 +80,41 @@ void Blobstore::init() {
 }
 
 Blobstore::Blobstore(const Url& u)
-  : m_index(Index::construct_open(u)) {init();}
+  : m_index(Index::construct_open(u)), m_read_depth(u.query().get("read_depth", DEFAULT_READ_DEPTH)),
+    m_leased_writes(u.query().get("write_mode", std::string("shared")) == "leased") {init();}
 
 Blobstore::Blobstore(const Url& u, const IndexHeader& d)
-  : m_index(Index::construct_create(u, d)) {init();}
+  : m_index(Index::construct_create(u, d)), m_read_depth(u.query().get("read_depth", DEFAULT_READ_DEPTH)),
+    m_leased_writes(u.query().get("write_mode", std::string("shared")) == "leased") {init();}
+
+void Blobstore::set_read_depth(uint32 depth) {
+  VW_ASSERT(depth > 0, ArgumentErr() << "Blobstore read depth must be at least 1");
+  m_read_depth = depth;
+}
+
+uint32 Blobstore::read_depth() const {
+  return m_read_depth;
+}
+
+void Blobstore::set_leased_writes(bool leased) {
+  m_leased_writes = leased;
+}
+
+bool Blobstore::leased_writes() const {
+  return m_leased_writes;
+}
 
 boost::shared_ptr<ReadBlob> Blobstore::open_read_blob(uint32 blob_id) {
   Mutex::Lock lock(m_mutex);
 
-  write_cache_t::const_iterator i = m_write_cache.find(blob_id);
-  if (i != m_write_cache.end())
-    return i->second;
+  // A leased blob is only ever touched by its writer. The index can't
+  // point into it past the last write_complete(), which flushed it, so
+  // readers can map the file instead.
+  if (!m_leased_writes) {
+    write_cache_t::const_iterator i = m_write_cache.find(blob_id);
+    if (i != m_write_cache.end())
+      return i->second;
+  }
 
   read_cache_by_filename_t& fn_cache = m_read_cache.get<1>();
 
@@ -93,7 +127,7 @@ boost::shared_ptr<ReadBlob> Blobstore::open_read_blob(uint32 blob_id) {
     m_read_cache.relocate(m_read_cache.begin(), k);
     return *k;
   } else {
-    boost::shared_ptr<ReadBlob> blob(new ReadBlob(fn));
+    boost::shared_ptr<ReadBlob> blob(new ReadBlob(fn, ReadBlob::MAPPED));
     std::pair<read_cache_t::iterator, bool> i = m_read_cache.push_front(blob);
     VW_ASSERT(i.second, LogicErr() << "We just checked for the key " << fn << " and it's gone now!");
     if (m_read_cache.size() > DEFAULT_BLOB_CACHE_SIZE)
@@ -137,6 +171,7 @@ Datastore::TileSearch& Blobstore::head(TileSearch& buf, uint32 level, uint32 row
 
   buf.clear();
   {
+    Mutex::ReadLock lock(m_index_mutex);
     std::list<TileHeader> hdrs = m_index->search_by_location(col, row, level, range.first(), range.last());
     size_t len = hdrs.size();
     if (limit > 0 && len > limit) {
@@ -159,19 +194,28 @@ Datastore::TileSearch& Blobstore::head(TileSearch& buf, uint32 level,   const BB
 
   buf.clear();
   {
-    std::list<TileHeader> hdrs = m_index->search_by_region(level, region, range.first(), range.last());
-    size_t len = hdrs.size();
-    if (limit > 0 && len > limit) {
+    std::vector<TileHeader> hdrs;
+    Mutex::ReadLock lock(m_index_mutex);
+    m_index->search_by_region(hdrs, level, region, range.first(), range.last());
+    if (limit > 0 && hdrs.size() > limit)
       hdrs.resize(limit);
-      len = limit;
-    }
 
-    buf.reserve(len);
+    buf.reserve(hdrs.size());
     std::copy(hdrs.begin(), hdrs.end(), std::back_inserter(buf));
   }
   return buf;
 }
 
+std::vector<TileHeader>& Blobstore::head_headers(std::vector<TileHeader>& hdrs, uint32 level, const BBox2u& region, TransactionRange range) {
+  vw_out(VerboseDebugMessage, "datastore") << "Blobstore::head_headers("
+    << "level=" << level
+    << ", region=" << region
+    << ", range=" << range << ")" << std::endl;
+
+  Mutex::ReadLock lock(m_index_mutex);
+  return m_index->search_by_region(hdrs, level, region, range.first(), range.last());
+}
+
 struct SortByPage {
   const Index& idx;
   SortByPage(const Index& idx) : idx(idx) {}
@@ -189,6 +233,98 @@ struct SortByIndexRecord {
   }
 };
 
+// Reads every requested tile from one blob: asks for the whole run from
+// disk up front, then reads the tiles in offset order. Failures are kept
+// for populate() to report.
+class PopulateBlobTask : public Task {
+    boost::function<boost::shared_ptr<ReadBlob> ()> m_open;
+    uint32 m_blob_id;
+    std::vector<uint64> m_offsets;
+    std::vector<Tile*> m_tiles;
+    std::vector<std::string> m_mismatches, m_errors;
+    boost::shared_ptr<Exception> m_failure;
+
+  public:
+    PopulateBlobTask(boost::function<boost::shared_ptr<ReadBlob> ()> const& open, uint32 blob_id)
+      : m_open(open), m_blob_id(blob_id) {}
+    virtual ~PopulateBlobTask() {}
+
+    uint32 blob_id() const { return m_blob_id; }
+    const std::vector<std::string>& mismatches() const { return m_mismatches; }
+    const std::vector<std::string>& errors() const { return m_errors; }
+
+    // Anything other than an I/O error stops the task; populate()
+    // rethrows it once every task has finished.
+    const boost::shared_ptr<Exception>& failure() const { return m_failure; }
+
+    void add(uint64 offset, Tile* tile) {
+      m_offsets.push_back(offset);
+      m_tiles.push_back(tile);
+    }
+
+    virtual void operator()() {
+      try {
+        read_tiles();
+      } catch (const Exception& e) {
+        m_failure.reset(e.clone());
+      } catch (const std::exception& e) {
+        // Nothing may escape into the pool worker, not even bad_alloc
+        m_failure.reset(new Exception());
+        m_failure->set(e.what());
+      }
+    }
+
+  private:
+    void read_tiles() {
+      boost::shared_ptr<ReadBlob> blob;
+      try {
+        blob = m_open();
+        blob->prefetch(m_offsets);
+      } catch (const BlobIoErr& e) {
+        for (size_t i = 0; i < m_tiles.size(); ++i)
+          m_errors.push_back(error(m_tiles[i]->hdr, "BlobIoErr", e));
+        return;
+      } catch (const IOErr& e) {
+        for (size_t i = 0; i < m_tiles.size(); ++i)
+          m_errors.push_back(error(m_tiles[i]->hdr, "IOErr", e));
+        return;
+      }
+
+      for (size_t i = 0; i < m_tiles.size(); ++i) {
+        Tile& t = *m_tiles[i];
+        const TileHeader& hdr = t.hdr;
+        try {
+          BlobTileRecord tile_rec = blob->read_record(m_offsets[i]);
+          if (tile_rec.hdr.col() != hdr.col()
+              || tile_rec.hdr.row() != hdr.row()
+              || tile_rec.hdr.level() != hdr.level()
+              || tile_rec.hdr.transaction_id() != hdr.transaction_id()
+              || (hdr.has_filetype() && hdr.filetype().size() && tile_rec.hdr.filetype() != hdr.filetype())) {
+            std::ostringstream msg;
+            msg << "output TileHeader doesn't match IndexRecord. skipping. [" << tile_rec.hdr << "] vs [" << hdr << "]\n";
+            m_mismatches.push_back(msg.str());
+            continue;
+          }
+          // Must copy the tilerec one, because we won't necessarily have a filetype in the search
+          t.hdr  = tile_rec.hdr;
+          t.data = tile_rec.data;
+        } catch (const BlobIoErr& e) {
+          // These are bad, and might indicate corruption, but probably shouldn't kill everything.
+          m_errors.push_back(error(hdr, "BlobIoErr", e));
+        } catch (const IOErr& e) {
+          // These are bad, and might indicate corruption, but probably shouldn't kill everything.
+          m_errors.push_back(error(hdr, "IOErr", e));
+        }
+      }
+    }
+
+    static std::string error(const TileHeader& hdr, const char* kind, const std::exception& e) {
+      std::ostringstream msg;
+      msg << kind << " while reading tile " << hdr << ": " << e.what() << std::endl;
+      return msg.str();
+    }
+};
+
 bool HasData(const Tile& t) {
   return t.data;
 }
@@ -200,56 +336,66 @@ Datastore::TileSearch& Blobstore::populate(TileSearch& hdrs) {
   typedef std::map<IndexRecord, Tile*, SortByIndexRecord> map_t;
   map_t recs;
 
-  BOOST_FOREACH(Tile& tile, hdrs) {
-    try {
-      IndexRecord rec = m_index->read_request(tile.hdr.col(), tile.hdr.row(), tile.hdr.level(), tile.hdr.transaction_id(), true);
-      recs[rec] = &tile;
-    } catch (const TileNotFoundErr& e) {
-      // I don't think this is possible if the hdrs are coming from get(). If
-      // they're not coming from get(), the user created their own TileHeader
-      // array incorrectly. In either case, this is a canary of something
-      // really bad being wrong.
-      vw_throw(LogicErr() << "Blobstore::populate(): cannot populate nonexistent tile: " << tile.hdr);
+  {
+    // Leased writers merge into the index under m_index_mutex, so hold it
+    // shared while we look the tiles up.
+    Mutex::ReadLock lock(m_index_mutex);
+    BOOST_FOREACH(Tile& tile, hdrs) {
+      try {
+        IndexRecord rec = m_index->read_request(tile.hdr.col(), tile.hdr.row(), tile.hdr.level(), tile.hdr.transaction_id(), true);
+        recs[rec] = &tile;
+      } catch (const TileNotFoundErr& e) {
+        // I don't think this is possible if the hdrs are coming from get(). If
+        // they're not coming from get(), the user created their own TileHeader
+        // array incorrectly. In either case, this is a canary of something
+        // really bad being wrong.
+        vw_throw(LogicErr() << "Blobstore::populate(): cannot populate nonexistent tile: " << tile.hdr);
+      }
     }
   }
   VW_ASSERT(recs.size() == hdrs.size(), LogicErr() << "TileHeaders and IndexRecords should be 1:1");
 
   // keys in a std::map are sorted in ascending order according to the
   // comparison function.  SortByIndexRecord sorts by by blob and then by
-  // offset, so we keep blob reads together and in order. We need to keep the
-  // headers sorted in the same order, too
-
-  bool prune = false;
+  // offset, so each blob's tiles come out together and in order. Hand each
+  // blob's run to its own task.
+  std::vector<boost::shared_ptr<PopulateBlobTask> > tasks;
   BOOST_FOREACH(map_t::value_type& tile, recs) {
     const IndexRecord& rec = tile.first;
-    const TileHeader&  hdr = tile.second->hdr;
-    Tile& t = *tile.second;
-
-    try {
-      boost::shared_ptr<ReadBlob> blob = open_read_blob(rec.blob_id());
-      BlobTileRecord tile_rec = blob->read_record(rec.blob_offset());
-      if (tile_rec.hdr.col() != hdr.col()
-          || tile_rec.hdr.row() != hdr.row()
-          || tile_rec.hdr.level() != hdr.level()
-          || tile_rec.hdr.transaction_id() != hdr.transaction_id()
-          || (hdr.has_filetype() && hdr.filetype().size() && tile_rec.hdr.filetype() != hdr.filetype())) {
-        vw_out(ErrorMessage) << "output TileHeader doesn't match IndexRecord. skipping. [" << tile_rec.hdr << "] vs [" << hdr << "]\n";
-        continue;
-      }
-      // Must copy the tilerec one, because we won't necessarily have a filetype in the search
-      t.hdr  = tile_rec.hdr;
-      t.data = tile_rec.data;
-    } catch (const BlobIoErr& e) {
-      // These are bad, and might indicate corruption, but probably shouldn't kill everything.
-      error_log()() << "BlobIoErr while reading tile " << hdr << ": " << e.what() << std::endl;
-      prune = true;
-    } catch (const IOErr& e) {
-      // These are bad, and might indicate corruption, but probably shouldn't kill everything.
-      error_log()() << "IOErr while reading tile " << hdr << ": " << e.what() << std::endl;
+    const uint32 blob_id = rec.blob_id();
+    if (tasks.empty() || tasks.back()->blob_id() != blob_id)
+      tasks.push_back(boost::shared_ptr<PopulateBlobTask>(
+        new PopulateBlobTask(boost::bind(&Blobstore::open_read_blob, this, blob_id), blob_id)));
+    tasks.back()->add(rec.blob_offset(), tile.second);
+  }
+
+  if (tasks.size() > 1 && m_read_depth > 1) {
+    FifoWorkQueue queue(std::min(m_read_depth, uint32(tasks.size())));
+    BOOST_FOREACH(const boost::shared_ptr<PopulateBlobTask>& task, tasks)
+      queue.add_task(task);
+    queue.join_all();
+  } else {
+    BOOST_FOREACH(const boost::shared_ptr<PopulateBlobTask>& task, tasks)
+      (*task)();
+  }
+
+  // Report from this thread, so that the logs don't interleave
+  bool prune = false;
+  boost::shared_ptr<Exception> failure;
+  BOOST_FOREACH(const boost::shared_ptr<PopulateBlobTask>& task, tasks) {
+    if (task->failure() && !failure)
+      failure = task->failure();
+    BOOST_FOREACH(const std::string& msg, task->mismatches())
+      vw_out(ErrorMessage) << msg;
+    BOOST_FOREACH(const std::string& msg, task->errors()) {
+      error_log()() << msg;
       prune = true;
     }
   }
 
+  if (failure)
+    vw_throw(*failure);
+
   if (prune) {
     TileSearch::iterator i = std::partition(hdrs.begin(), hdrs.end(), HasData);
     hdrs.erase(i, hdrs.end());
@@ -304,13 +450,18 @@ void Blobstore::write_update(WriteState& state_, uint32 level, uint32 row, uint3
   // 1. Write the data into the blob
   uint64 blob_offset = state->blob->write(header, data, size);
 
-  // 2. Update the index
+  // 2. Update the index (or hold the update until write_complete)
   IndexRecord write_record;
   write_record.set_blob_id(state->blob_id);
   write_record.set_blob_offset(blob_offset);
   write_record.set_filetype(header.filetype());
 
-  m_index->write_update(header, write_record);
+  if (m_leased_writes) {
+    state->pending.push_back(std::make_pair(header, write_record));
+  } else {
+    Mutex::Lock lock(m_index_mutex);
+    m_index->write_update(header, write_record);
+  }
 }
 
 void Blobstore::write_complete(WriteState& state_) {
@@ -332,11 +483,24 @@ void Blobstore::write_complete(WriteState& state_) {
   // For debugging:
   vw_out(DebugMessage, "blob") << "Closed blob " << state->blob_id << " ( size = " << new_blob_size << " )\n";
 
+  // The blob is flushed, so the index never points past what is on disk.
+  // If we die before this, the tiles are still in the blob and
+  // rebuild_index() will find them.
+  if (!state->pending.empty()) {
+    Mutex::Lock lock(m_index_mutex);
+    for (size_t i = 0; i < state->pending.size(); ++i)
+      m_index->write_update(state->pending[i].first, state->pending[i].second);
+  }
+  state->pending.clear();
+
   // Release the blob lock.
   m_index->write_complete(state->blob_id);
 
   // Release cache
-  m_write_cache.erase(state->blob_id);
+  {
+    Mutex::Lock lock(m_mutex);
+    m_write_cache.erase(state->blob_id);
+  }
 
   state->blob_id = 0;
 }
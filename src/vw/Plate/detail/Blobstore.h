@@ -53,6 +53,9 @@ class Blobstore : public Datastore {
     read_cache_t  m_read_cache;
     write_cache_t m_write_cache;
     vw::Mutex m_mutex;
+    vw::Mutex m_index_mutex;
+    uint32 m_read_depth;
+    bool m_leased_writes;
 
     boost::shared_ptr<ReadBlob>  open_read_blob(uint32 blob_id);
     boost::shared_ptr<Blob>     open_write_blob(uint32 blob_id);
@@ -67,8 +70,24 @@ class Blobstore : public Datastore {
 
     virtual TileSearch&     head(TileSearch& buf, uint32 level, uint32 row, uint32 col, TransactionRange range, uint32 limit = 0);
     virtual TileSearch&     head(TileSearch& buf, uint32 level,   const BBox2u& region, TransactionRange range, uint32 limit = 0);
+    virtual std::vector<TileHeader>& head_headers(std::vector<TileHeader>& hdrs, uint32 level, const BBox2u& region, TransactionRange range);
     virtual TileSearch& populate(TileSearch& hdrs);
 
+    // populate() reads the tiles from each blob as one group, with
+    // nearby tiles fetched from disk together, and reads up to this many
+    // blobs at once. Defaults to the url's read_depth parameter, or 4.
+    void set_read_depth(uint32 depth);
+    uint32 read_depth() const;
+
+    // With leased writes, each WriteState appends to its own blob and keeps
+    // its index records until write_complete(), which flushes the blob and
+    // then merges them into the index. Writers on different WriteStates
+    // don't wait on each other, but their tiles are not visible until
+    // write_complete(). Defaults to the url's write_mode parameter
+    // ("leased" or "shared", the default).
+    void set_leased_writes(bool leased);
+    bool leased_writes() const;
+
     //virtual Url map_to_url(uint32 level, uint32 row, uint32 col, Transaction id, std::string filetype);
     //virtual Url map_to_url(const TileHeader& t);
 
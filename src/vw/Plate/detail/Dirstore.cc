@@ -554,8 +554,8 @@ namespace {
     VW_ASSERT(!f.fail(), IOErr() << "Failed to find file size: " << filename);
     VW_ASSERT(size > 0,  IOErr() << "Zero-length file");
 
-    data.reset(new std::vector<uint8>(size));
-    f.read(reinterpret_cast<char*>(&data->operator[](0)), size);
+    data.reset(new TileBuffer(size));
+    f.read(reinterpret_cast<char*>(data->mutable_data()), size);
     VW_ASSERT(!f.fail(), IOErr() << "Failed to read tile file: " << filename);
     return data;
   }
@@ -38,3 +38,11 @@ boost::shared_ptr<Index> Index::construct_open(const Url& url) {
     return boost::shared_ptr<Index>(new RemoteIndex(url));
 }
 
+
+std::list<TileHeader> Index::search_by_region(uint32 level, vw::BBox2i const& region,
+                                              TransactionOrNeg start_transaction_id,
+                                              TransactionOrNeg end_transaction_id) const {
+  std::vector<TileHeader> results;
+  this->search_by_region(results, level, region, start_transaction_id, end_transaction_id);
+  return std::list<TileHeader>(results.begin(), results.end());
+}
@@ -26,6 +26,7 @@
 #include <vw/Math/BBox.h>
 #include <boost/shared_ptr.hpp>
 #include <list>
+#include <vector>
 
 #define VW_PLATE_INDEX_VERSION 3
 
@@ -110,9 +111,16 @@ namespace detail {
     /// range at this col/row/level, but valid_tiles() only returns the
     /// first one.
     /// Note: the region is EXCLUSIVE: i.e. BBox2i(0,0,1,1) does not include the point (1,1)
-    virtual std::list<TileHeader> search_by_region(uint32 level, vw::BBox2i const& region,
-                                                   TransactionOrNeg start_transaction_id,
-                                                   TransactionOrNeg end_transaction_id) const = 0;
+    std::list<TileHeader> search_by_region(uint32 level, vw::BBox2i const& region,
+                                           TransactionOrNeg start_transaction_id,
+                                           TransactionOrNeg end_transaction_id) const;
+
+    /// Same as above, but appends the tiles to results. Prefer this for
+    /// large regions; it doesn't allocate a list node per tile.
+    virtual std::vector<TileHeader>& search_by_region(std::vector<TileHeader>& results,
+                                                      uint32 level, vw::BBox2i const& region,
+                                                      TransactionOrNeg start_transaction_id,
+                                                      TransactionOrNeg end_transaction_id) const = 0;
 
     /// Return multiple tile headers that match the specified
     /// transaction id range.  This range is inclusive at both ends.
@@ -22,9 +22,15 @@
 #include <vw/Math/BBox.h>
 #include <vw/Core/Debugging.h>
 
-#include <boost/shared_array.hpp>
+#include <vw/Plate/google/sparsetable>
+
 #include <boost/foreach.hpp>
 
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <sstream>
+
 #define WHEREAMI (vw::vw_out(VerboseDebugMessage, "platefile.index") << VW_CURRENT_FUNCTION << ": ")
 using namespace vw;
 using namespace vw::platefile;
@@ -34,13 +40,97 @@ using namespace vw::platefile::detail;
 //                            INDEX PAGE
 // ----------------------------------------------------------------------
 
+namespace {
+
+  // Page file layout (host byte order, like the blob files):
+  //
+  //   uint32 magic, version, page_width, page_height
+  //   uint32 filetype count, then for each: uint32 length, bytes
+  //   uint32 occupied slot count, record count
+  //   uint64 occupancy bitmap[ceil(page_width*page_height / 64)]
+  //   uint32 run length for each occupied slot, in slot order
+  //   20 bytes per record: uint64 blob_offset, uint32 transaction_id,
+  //                        int32 blob_id, uint32 filetype
+  //
+  // Legacy pages start with the page width instead of the magic number.
+  static const uint32 PAGE_MAGIC   = 0x50495756; // "VWIP"
+  static const uint32 PAGE_VERSION = 1;
+  static const size_t RECORD_BYTES = 20;
+
+  inline uint32 popcount64( uint64 x ) {
+#if defined(__GNUC__)
+    return __builtin_popcountll( x );
+#else
+    uint32 count = 0;
+    for ( ; x; x &= x - 1 ) ++count;
+    return count;
+#endif
+  }
+
+  // Index of the lowest set bit. x must not be zero.
+  inline uint32 lowest_bit64( uint64 x ) {
+#if defined(__GNUC__)
+    return __builtin_ctzll( x );
+#else
+    uint32 bit = 0;
+    for ( ; !(x & 1); x >>= 1 ) ++bit;
+    return bit;
+#endif
+  }
+
+  // Bits [lo, hi) of a word, with 0 <= lo < hi <= 64
+  inline uint64 bit_range64( uint32 lo, uint32 hi ) {
+    uint64 upto_hi = hi == 64 ? ~uint64(0) : (uint64(1) << hi) - 1;
+    return upto_hi & ~((uint64(1) << lo) - 1);
+  }
+
+  // Map a transaction request onto the stored ids. -1 (newest) compares
+  // greater than every real transaction.
+  inline uint32 bound(TransactionOrNeg t) {
+    return t.newest() ? NO_TRANSACTION : uint32(t.promote());
+  }
+
+  // Records in a run are sorted by decreasing transaction id. This finds
+  // the first one with transaction_id <= t.
+  struct NewerThan {
+    bool operator()(const IndexPage::Record& r, uint32 t) const { return r.transaction_id > t; }
+  };
+
+  template <typename PtrT>
+  inline PtrT first_at_or_before(PtrT first, PtrT last, uint32 t) {
+    return std::lower_bound(first, last, t, NewerThan());
+  }
+
+  template <typename T>
+  void put(std::string& buf, const T& val) {
+    buf.append(reinterpret_cast<const char*>(&val), sizeof(T));
+  }
+
+  class PageReader {
+      const char *m_ptr, *m_end;
+    public:
+      PageReader(const char* data, size_t size) : m_ptr(data), m_end(data + size) {}
+      size_t remaining() const { return m_end - m_ptr; }
+      const char* take(size_t bytes, const char* what) {
+        VW_ASSERT(remaining() >= bytes, IOErr() << "Index page is truncated (while reading " << what << ")");
+        const char* p = m_ptr;
+        m_ptr += bytes;
+        return p;
+      }
+      template <typename T>
+      T get(const char* what) {
+        T val;
+        std::memcpy(&val, take(sizeof(T), what), sizeof(T));
+        return val;
+      }
+  };
+}
+
 IndexPage::IndexPage(uint32 level, uint32 base_col, uint32 base_row,
                      uint32 page_width, uint32 page_height) :
-  m_level(level), m_base_col(base_col), m_base_row(base_row),
-  m_page_width(page_width), m_page_height(page_height) {
+  m_level(level), m_base_col(base_col), m_base_row(base_row) {
 
-  // Set the size of the sparse table.
-  m_sparse_table.resize(page_width*page_height);
+  reset(page_width, page_height);
 
   WHEREAMI << "[" << m_base_col << " " << m_base_row << " @ " << m_level << "]\n";
 }
@@ -49,99 +139,250 @@ IndexPage::~IndexPage() {
   WHEREAMI << "[" << m_base_col << " " << m_base_row << " @ " << m_level << "]\n";
 }
 
-void IndexPage::serialize(std::ostream& ostr) {
-  WHEREAMI << "[" << m_base_col << " " << m_base_row << " @ " << m_level << "]\n";
+void IndexPage::reset(uint32 page_width, uint32 page_height) {
+  m_page_width  = page_width;
+  m_page_height = page_height;
+
+  size_t words = (size_t(page_width) * page_height + 63) / 64;
+  m_occupied.assign(words, 0);
+  m_rank.assign(words, 0);
+  m_runs.clear();
+  m_records.clear();
+  m_unused = 0;
+  m_filetypes.clear();
+  m_min_transaction = NO_TRANSACTION;
+  m_max_transaction = 0;
+}
+
+uint32 IndexPage::slot_rank(uint32 slot) const {
+  uint32 word = slot / 64, bit = slot % 64;
+  return m_rank[word] + popcount64(m_occupied[word] & ((uint64(1) << bit) - 1));
+}
+
+const IndexPage::Run* IndexPage::find_run(uint32 slot) const {
+  if (slot >= m_page_width * m_page_height)
+    return 0;
+  if (!(m_occupied[slot / 64] & (uint64(1) << (slot % 64))))
+    return 0;
+  return &m_runs[slot_rank(slot)];
+}
 
-  // Part 1: Write out the page size
-  ostr.write(reinterpret_cast<char*>(&m_page_width), sizeof(m_page_width));
-  ostr.write(reinterpret_cast<char*>(&m_page_height), sizeof(m_page_height));
+void IndexPage::compact() {
+  std::vector<Record> records;
+  records.reserve(m_records.size() - m_unused);
+  BOOST_FOREACH(Run& run, m_runs) {
+    uint32 begin = boost::numeric_cast<uint32>(records.size());
+    records.insert(records.end(), m_records.begin() + run.begin, m_records.begin() + run.begin + run.size);
+    run.begin    = begin;
+    run.capacity = run.size;
+  }
+  m_records.swap(records);
+  m_unused = 0;
+}
 
-  // Part 2: Write the sparsetable metadata
-  m_sparse_table.write_metadata(&ostr);
+uint32 IndexPage::filetype_index(IndexRecord const& record) {
+  if (!record.has_filetype())
+    return NO_FILETYPE;
+  for (uint32 i = 0; i < m_filetypes.size(); ++i)
+    if (m_filetypes[i] == record.filetype())
+      return i;
+  m_filetypes.push_back(record.filetype());
+  return boost::numeric_cast<uint32>(m_filetypes.size() - 1);
+}
 
-  // Part 3: Write sparse entries
-  for (nonempty_iterator it = m_sparse_table.nonempty_begin(); it != m_sparse_table.nonempty_end(); ++it) {
+IndexRecord IndexPage::to_index_record(Record const& rec) const {
+  IndexRecord ret;
+  ret.set_blob_id(rec.blob_id);
+  ret.set_blob_offset(rec.blob_offset);
+  if (rec.filetype != NO_FILETYPE)
+    ret.set_filetype(m_filetypes[rec.filetype]);
+  return ret;
+}
 
-    // Iterate over transaction_id list.
-    uint32 transaction_list_size = boost::numeric_cast<uint32>(it->size());
-    ostr.write(reinterpret_cast<char*>(&transaction_list_size), sizeof(transaction_list_size));
+size_t IndexPage::memory_usage() const {
+  size_t bytes = sizeof(*this)
+               + m_occupied.capacity() * sizeof(uint64)
+               + m_rank.capacity()     * sizeof(uint32)
+               + m_runs.capacity()     * sizeof(Run)
+               + m_records.capacity()  * sizeof(Record);
+  BOOST_FOREACH(const std::string& type, m_filetypes)
+    bytes += sizeof(std::string) + type.capacity();
+  return bytes;
+}
 
-    multi_value_type::iterator transaction_iter = (*it).begin();
-    while (transaction_iter != (*it).end()) {
+void IndexPage::serialize(std::ostream& ostr) {
+  WHEREAMI << "[" << m_base_col << " " << m_base_row << " @ " << m_level << "]\n";
+
+  size_t num_records = 0;
+  BOOST_FOREACH(const Run& run, m_runs)
+    num_records += run.size;
+
+  std::string buf;
+  buf.reserve(32 + m_occupied.size() * sizeof(uint64) + m_runs.size() * sizeof(uint32) + num_records * RECORD_BYTES);
 
-      // Save the transaction id
-      uint32 t_id = (*transaction_iter).first;
-      ostr.write(reinterpret_cast<char*>(&t_id), sizeof(t_id));
+  put(buf, PAGE_MAGIC);
+  put(buf, PAGE_VERSION);
+  put(buf, m_page_width);
+  put(buf, m_page_height);
 
-      // Save the size of each protobuf, and then serialize it to disk.
-      uint16 protobuf_size = boost::numeric_cast<uint16>(transaction_iter->second.ByteSize());
-      boost::shared_array<uint8> protobuf_bytes( new uint8[protobuf_size] );
-      (*transaction_iter).second.SerializeToArray(protobuf_bytes.get(), protobuf_size);
-      ostr.write(reinterpret_cast<char*>(&protobuf_size), sizeof(protobuf_size));
-      ostr.write(reinterpret_cast<char*>(protobuf_bytes.get()), protobuf_size);
+  put(buf, boost::numeric_cast<uint32>(m_filetypes.size()));
+  BOOST_FOREACH(const std::string& type, m_filetypes) {
+    put(buf, boost::numeric_cast<uint32>(type.size()));
+    buf.append(type);
+  }
 
-      ++transaction_iter;
+  put(buf, boost::numeric_cast<uint32>(m_runs.size()));
+  put(buf, boost::numeric_cast<uint32>(num_records));
+  buf.append(reinterpret_cast<const char*>(&m_occupied[0]), m_occupied.size() * sizeof(uint64));
+  BOOST_FOREACH(const Run& run, m_runs)
+    put(buf, run.size);
+  BOOST_FOREACH(const Run& run, m_runs) {
+    for (uint32 i = run.begin; i < run.begin + run.size; ++i) {
+      const Record& rec = m_records[i];
+      put(buf, rec.blob_offset);
+      put(buf, rec.transaction_id);
+      put(buf, rec.blob_id);
+      put(buf, rec.filetype);
     }
   }
+
+  ostr.write(buf.data(), buf.size());
 }
 
 void IndexPage::deserialize(std::istream& istr) {
+  VW_ASSERT(istr.good(), IOErr() << "while beginning to deserialize.");
+  std::string buf((std::istreambuf_iterator<char>(istr)), std::istreambuf_iterator<char>());
+  deserialize(buf.data(), buf.size());
+}
+
+void IndexPage::deserialize(const char* data, size_t size) {
 
   WHEREAMI << "[" << m_base_col << " " << m_base_row << " @ " << m_level << "]\n";
 
-  VW_ASSERT(istr.good(), IOErr() << "while beginning to deserialize.");
+  PageReader in(data, size);
+  if (in.get<uint32>("magic number") != PAGE_MAGIC) {
+    deserialize_legacy(data, size);
+    return;
+  }
 
-  // Part 1: Read the page size
-  istr.read(reinterpret_cast<char*>(&m_page_width), sizeof(m_page_width));
-  istr.read(reinterpret_cast<char*>(&m_page_height), sizeof(m_page_height));
+  uint32 version = in.get<uint32>("version");
+  VW_ASSERT(version == PAGE_VERSION, IOErr() << "Unsupported index page version " << version);
+
+  uint32 page_width  = in.get<uint32>("page size");
+  uint32 page_height = in.get<uint32>("page size");
+  reset(page_width, page_height);
 
+  uint32 num_filetypes = in.get<uint32>("filetype count");
+  for (uint32 i = 0; i < num_filetypes; ++i) {
+    uint32 len = in.get<uint32>("filetype");
+    m_filetypes.push_back(std::string(in.take(len, "filetype"), len));
+  }
+
+  uint32 num_runs    = in.get<uint32>("slot count");
+  uint32 num_records = in.get<uint32>("record count");
+
+  std::memcpy(&m_occupied[0], in.take(m_occupied.size() * sizeof(uint64), "occupancy bitmap"), m_occupied.size() * sizeof(uint64));
+  uint32 occupied = 0;
+  for (size_t i = 0; i < m_occupied.size(); ++i) {
+    m_rank[i] = occupied;
+    occupied += popcount64(m_occupied[i]);
+  }
+  VW_ASSERT(occupied == num_runs, IOErr() << "Index page bitmap has " << occupied << " slots set, expected " << num_runs);
+
+  m_runs.resize(num_runs);
+  uint32 begin = 0;
+  BOOST_FOREACH(Run& run, m_runs) {
+    run.begin    = begin;
+    run.size     = run.capacity = in.get<uint32>("run length");
+    begin += run.size;
+  }
+  VW_ASSERT(begin == num_records, IOErr() << "Index page runs hold " << begin << " records, expected " << num_records);
+
+  m_records.resize(num_records);
+  const char* rec_data = in.take(size_t(num_records) * RECORD_BYTES, "records");
+  BOOST_FOREACH(Record& rec, m_records) {
+    std::memcpy(&rec.blob_offset,    rec_data,      8);
+    std::memcpy(&rec.transaction_id, rec_data + 8,  4);
+    std::memcpy(&rec.blob_id,        rec_data + 12, 4);
+    std::memcpy(&rec.filetype,       rec_data + 16, 4);
+    VW_ASSERT(rec.filetype == NO_FILETYPE || rec.filetype < m_filetypes.size(), IOErr() << "Index page record has a bad filetype");
+    note_transaction(rec.transaction_id);
+    rec_data += RECORD_BYTES;
+  }
+
+  if (in.remaining())
+    vw_out(WarningMessage, "platefile.index") << "Unparsed data remaining in index page.\n";
+}
+
+// The original page format: the page size, a google::sparsetable's
+// occupancy metadata, then for each occupied slot a count followed by
+// (transaction id, uint16 size, IndexRecord protobuf) triples.
+void IndexPage::deserialize_legacy(const char* data, size_t size) {
+  std::istringstream istr(std::string(data, size), std::ios::binary);
+
+  // Part 1: Read the page size
+  uint32 page_width, page_height;
+  istr.read(reinterpret_cast<char*>(&page_width), sizeof(page_width));
+  istr.read(reinterpret_cast<char*>(&page_height), sizeof(page_height));
   VW_ASSERT(istr.good(), IOErr() << "while reading page size.");
+  reset(page_width, page_height);
 
-  // Part 2: Read the sparsetable metadata
-  if (!m_sparse_table.read_metadata(&istr))
+  // Part 2: Read the sparsetable metadata. We only need to know which
+  // slots are occupied, so the element type doesn't matter.
+  google::sparsetable<uint8> occupied;
+  if (!occupied.read_metadata(&istr))
     vw_throw(IOErr() << "while reading sparse table metadata.");
-
   VW_ASSERT(istr.good(), IOErr() << "after reading sparse table metadata.");
+  VW_ASSERT(occupied.size() == size_t(page_width) * page_height, IOErr() << "sparse table doesn't match the page size.");
 
-  // make sure we initialize everything before we continue
-  BOOST_FOREACH(multi_value_type& x, std::make_pair(m_sparse_table.nonempty_begin(), m_sparse_table.nonempty_end()))
-    new (&x) multi_value_type();
+  // Part 3: Read sparse entries, in slot order
+  for (uint32 slot = 0; slot < occupied.size(); ++slot) {
+    if (!occupied.test(slot))
+      continue;
 
-  size_t count = 0, total = m_sparse_table.num_nonempty();
-
-  // Part 3: Read sparse entries
-  BOOST_FOREACH(multi_value_type& x, std::make_pair(m_sparse_table.nonempty_begin(), m_sparse_table.nonempty_end())) {
-    if (count++ % 4000 == 0)
-      WHEREAMI << "reading tile slot " << count << " of " << total << std::endl;
-    // Iterate over transaction_id list.
     uint32 transaction_list_size;
     istr.read(reinterpret_cast<char*>(&transaction_list_size), sizeof(transaction_list_size));
-
     VW_ASSERT(istr.good(), IOErr() << "while reading transaction list size.");
 
-    for (uint32 tid = 0; tid < transaction_list_size; ++tid) {
+    Run run;
+    run.begin = boost::numeric_cast<uint32>(m_records.size());
+    run.size  = run.capacity = transaction_list_size;
 
-      // Read the transaction id
+    for (uint32 tid = 0; tid < transaction_list_size; ++tid) {
       uint32 t_id;
       istr.read(reinterpret_cast<char*>(&t_id), sizeof(t_id));
       VW_ASSERT(istr.good(), IOErr() << "while reading a transaction id.");
 
-      // Read the size (in bytes) of this protobuffer and then read
-      // the protobuffer and deserialize it.
       uint16 protobuf_size;
       istr.read(reinterpret_cast<char*>(&protobuf_size), sizeof(protobuf_size));
       VW_ASSERT(istr.good(), IOErr() << "while reading a message size.");
 
-      boost::shared_array<uint8> protobuf_bytes( new uint8[protobuf_size] );
-      istr.read(reinterpret_cast<char*>(protobuf_bytes.get()), protobuf_size);
+      std::vector<char> protobuf_bytes(protobuf_size);
+      istr.read(protobuf_size ? &protobuf_bytes[0] : 0, protobuf_size);
       VW_ASSERT(istr.good(), IOErr() << "while reading a message.");
 
       IndexRecord rec;
-      if (!rec.ParseFromArray(protobuf_bytes.get(), protobuf_size))
+      if (!rec.ParseFromArray(protobuf_size ? &protobuf_bytes[0] : 0, protobuf_size))
         vw_throw(IOErr() << "while parsing a message.");
 
-      x.push_back(value_type(t_id, rec));
+      Record r;
+      r.transaction_id = t_id;
+      r.blob_id        = rec.blob_id();
+      r.blob_offset    = rec.blob_offset();
+      r.filetype       = filetype_index(rec);
+      m_records.push_back(r);
+      note_transaction(t_id);
     }
+
+    // The legacy lists were already sorted newest first
+    m_occupied[slot / 64] |= uint64(1) << (slot % 64);
+    m_runs.push_back(run);
+  }
+
+  uint32 count = 0;
+  for (size_t i = 0; i < m_occupied.size(); ++i) {
+    m_rank[i] = count;
+    count += popcount64(m_occupied[i]);
   }
 
   if (istr.peek() != EOF)
@@ -154,42 +395,65 @@ void IndexPage::set(TileHeader const& header, IndexRecord const& record) {
 
   uint32 page_col = header.col() % m_page_width;
   uint32 page_row = header.row() % m_page_height;
+  uint32 slot = page_row*m_page_width + page_col;
+
+  Record rec;
+  rec.transaction_id = header.transaction_id();
+  rec.blob_id        = record.blob_id();
+  rec.blob_offset    = record.blob_offset();
+  rec.filetype       = filetype_index(record);
+  note_transaction(rec.transaction_id);
+
+  uint32 word = slot / 64;
+  uint64 mask = uint64(1) << (slot % 64);
+
+  if (!(m_occupied[word] & mask)) {
+    // Create a new entry. Tiles tend to arrive in slot order, so this is
+    // usually an append.
+    uint32 rank = slot_rank(slot);
+    m_occupied[word] |= mask;
+    for (size_t i = word + 1; i < m_rank.size(); ++i)
+      ++m_rank[i];
+
+    Run run;
+    run.begin = boost::numeric_cast<uint32>(m_records.size());
+    run.size  = run.capacity = 1;
+    m_records.push_back(rec);
+    m_runs.insert(m_runs.begin() + rank, run);
+    return;
+  }
 
-  value_type p(header.transaction_id(), record);
-  uint32 elmnt = page_row*m_page_width + page_col;
-  if (m_sparse_table.test(elmnt)) {
-
-    // Add to existing entry.
-    multi_value_type *entries = m_sparse_table[elmnt].operator&();
-
-    // We need to keep this list sorted in decreasing order of
-    // transaction ID, do a simple insertion sort here.
-    multi_value_type::iterator it = entries->begin();
-    while (it != entries->end() && (*it).first >= header.transaction_id() ) {
-
-      // Handle the case where we replace an entry
-      if ( (*it).first == header.transaction_id() ) {
-        (*it).second = record;
-        return;
-      }
-
-      // Otherwise, we search forward in the list.
-      ++it;
-    }
-
-    // If we reach this point, we are either at the end of the list,
-    // or we have found the correct position.  Either way, we call
-    // insert().
-    entries->insert(it, p);
+  // Add to existing entry, keeping it sorted in decreasing order of
+  // transaction ID.
+  Run& run = m_runs[slot_rank(slot)];
+  Record* first = &m_records[run.begin];
+  Record* pos = first_at_or_before(first, first + run.size, rec.transaction_id);
 
-  } else {
+  // Handle the case where we replace an entry
+  if (pos != first + run.size && pos->transaction_id == rec.transaction_id) {
+    *pos = rec;
+    return;
+  }
+  uint32 at = boost::numeric_cast<uint32>(pos - first);
+
+  // Out of room: move the run to the end of the array with space to grow,
+  // and give back the holes this leaves once enough of them pile up.
+  if (run.size == run.capacity) {
+    uint32 begin = boost::numeric_cast<uint32>(m_records.size());
+    m_records.resize(m_records.size() + 2 * run.capacity);
+    std::copy(m_records.begin() + run.begin, m_records.begin() + run.begin + run.size, m_records.begin() + begin);
+    m_unused += run.capacity;
+    run.begin = begin;
+    run.capacity *= 2;
+  }
 
-    // Create a new entry
-    multi_value_type l;
-    l.push_front(p);
-    m_sparse_table[elmnt] = l;
+  std::vector<Record>::iterator rbegin = m_records.begin() + run.begin;
+  std::copy_backward(rbegin + at, rbegin + run.size, rbegin + run.size + 1);
+  *(rbegin + at) = rec;
+  ++run.size;
 
-  }
+  if (m_unused > m_records.size() / 2)
+    compact();
 }
 
 /// Return the IndexRecord for a the given transaction_id at
@@ -211,38 +475,27 @@ IndexRecord IndexPage::get(uint32 col, uint32 row, TransactionOrNeg transaction_
   uint32 page_col = col % m_page_width;
   uint32 page_row = row % m_page_height;
 
-  // Interate over entries.
-  multi_value_type const& entries = m_sparse_table[page_row*m_page_width + page_col];
-  multi_value_type::const_iterator it = entries.begin();
-
-  if ( it == entries.end() )
+  const Run* run = find_run(page_row*m_page_width + page_col);
+  if (!run)
     vw_throw(TileNotFoundErr() << "No Tiles exist at this location.");
 
+  const Record* first = &m_records[run->begin];
+  const Record* last  = first + run->size;
+
   // A transaction ID of -1 indicates that we should return the most
-  // recent tile (which is the first entry in the list, since it is
+  // recent tile (which is the first entry in the run, since it is
   // sorted from most recent to least recent), regardless of its
   // transaction id.
   if (transaction_id_neg.newest())
-    return (*it).second;
+    return to_index_record(*first);
 
   Transaction transaction_id = transaction_id_neg.promote();
 
-  // Otherwise, we search through the entries in the list, looking for
-  // the requested t_id.  Note: this search is O(n), so it can be slow
-  // if there are a lot of entries and the entry you are looking for
-  // is near the end.  However, most pages will contain very few
-  // entries, and for those with many entries (i.e. tiles near the
-  // root of the mosaic), you will rarely search for old tiles.
-  while (it != entries.end()) {
-    if (exact_match) {
-      if ((*it).first == transaction_id)
-        return (*it).second;
-    } else {
-      if ((*it).first <= transaction_id)
-        return (*it).second;
-    }
-    ++it;
-  }
+  // Otherwise, binary search the run for the newest record at or
+  // before the requested transaction.
+  const Record* it = first_at_or_before(first, last, transaction_id);
+  if (it != last && (!exact_match || it->transaction_id == transaction_id))
+    return to_index_record(*it);
 
   // If we reach this point, then there are no entries before
   // the given transaction_id, so we return an empty (and invalid) record.
@@ -258,43 +511,32 @@ IndexPage::multi_get(uint32 col, uint32 row,
   uint32 page_col = col % m_page_width;
   uint32 page_row = row % m_page_height;
 
-  // Interate over entries.
-  multi_value_type const& entries = m_sparse_table[page_row*m_page_width + page_col];
-  multi_value_type::const_iterator it = entries.begin();
-
-  if ( it == entries.end() )
+  const Run* run = find_run(page_row*m_page_width + page_col);
+  if (!run)
     vw_throw(TileNotFoundErr() << "No Tiles exist at this location.");
-  if ( begin_transaction_id <= 1 && end_transaction_id == detail::MAX_TRANSACTION )
-    return entries;
+
+  const Record* first = &m_records[run->begin];
+  const Record* last  = first + run->size;
 
   multi_value_type result;
+  if ( begin_transaction_id <= 1 && end_transaction_id == detail::MAX_TRANSACTION ) {
+    // The whole run, including transaction 0
+    for (const Record* it = first; it != last; ++it)
+      result.push_back( value_type(it->transaction_id, to_index_record(*it)) );
+    return result;
+  }
   if ( begin_transaction_id.newest() && end_transaction_id.newest() ) {
     // Pull only the top most transaction
-    result.push_back( *it );
+    result.push_back( value_type(first->transaction_id, to_index_record(*first)) );
     return result;
-  } else {
-    // Pull only items that our in our transaction range
-    BOOST_FOREACH(const value_type& elt, entries ) {
-      if ( elt.first < begin_transaction_id )
-        break;
-      if ( elt.first <= end_transaction_id)
-        result.push_back(elt);
-    }
   }
 
-  return result;
-}
-
-void IndexPage::append_if_in_region( std::list<TileHeader> &results,
-                                     multi_value_type const& candidates,
-                                     uint32 col, uint32 row, BBox2i const& region) const {
+  // Pull only items that our in our transaction range
+  const uint32 begin_id = bound(begin_transaction_id);
+  for (const Record* it = first_at_or_before(first, last, bound(end_transaction_id)); it != last && it->transaction_id >= begin_id; ++it)
+    result.push_back( value_type(it->transaction_id, to_index_record(*it)) );
 
-  BOOST_FOREACH(const value_type& t, candidates) {
-    Vector2i loc( m_base_col + col, m_base_row + row);
-    if ( region.contains( loc ) )
-      results.push_back(hdr_from_index(col, row, t));
-  }
-  // Check to see if the tile is in the specified region.
+  return result;
 }
 
 /// Returns a list of valid tiles in this IndexPage.  Returns a list
@@ -306,6 +548,16 @@ std::list<TileHeader>
 IndexPage::search_by_region(BBox2i const& region,
                             TransactionOrNeg start_transaction_id,
                             TransactionOrNeg end_transaction_id) const {
+  std::vector<TileHeader> results;
+  search_by_region(results, region, start_transaction_id, end_transaction_id);
+  return std::list<TileHeader>(results.begin(), results.end());
+}
+
+std::vector<TileHeader>&
+IndexPage::search_by_region(std::vector<TileHeader>& results,
+                            BBox2i const& region,
+                            TransactionOrNeg start_transaction_id,
+                            TransactionOrNeg end_transaction_id) const {
 
   // empty range means something broke upstream
   VW_ASSERT(start_transaction_id <= end_transaction_id,
@@ -319,43 +571,52 @@ IndexPage::search_by_region(BBox2i const& region,
     vw_out(WarningMessage) << VW_CURRENT_FUNCTION << ": " << "asked for a region outside valid area for level " << m_level << ": " << region << std::endl;
 
   // Search through the entries in the index page which are in the current region.
-  uint32 beg_row = (uint32)std::max((int32)0,             (int32)region.min().y() - (int32)m_base_row);
-  uint32 end_row = (uint32)std::min((int32)m_page_height, (int32)region.max().y() - (int32)m_base_row);
-  uint32 beg_col = (uint32)std::max((int32)0,             (int32)region.min().x() - (int32)m_base_col);
-  uint32 end_col = (uint32)std::min((int32)m_page_width,  (int32)region.max().x() - (int32)m_base_col);
+  int32 beg_row = std::max((int32)0,             (int32)region.min().y() - (int32)m_base_row);
+  int32 end_row = std::min((int32)m_page_height, (int32)region.max().y() - (int32)m_base_row);
+  int32 beg_col = std::max((int32)0,             (int32)region.min().x() - (int32)m_base_col);
+  int32 end_col = std::min((int32)m_page_width,  (int32)region.max().x() - (int32)m_base_col);
+  if (m_runs.empty() || beg_row >= end_row || beg_col >= end_col)
+    return results;
 
-  std::list<TileHeader> results;
-  for (uint32 row = beg_row; row < end_row; ++row) {
-    for (uint32 col = beg_col; col < end_col; ++col) {
-      if (m_sparse_table.test(row*m_page_width + col)) {
+  const bool newest_only = start_transaction_id.newest() && end_transaction_id.newest();
+  const uint32 start_id = bound(start_transaction_id), end_id = bound(end_transaction_id);
 
-        // Iterate over entries.
-        multi_value_type const& entries = m_sparse_table[row*m_page_width + col];
-        multi_value_type candidates;
+  // Nothing in this page falls in the transaction range
+  if (!newest_only && (start_id > m_max_transaction || end_id < m_min_transaction))
+    return results;
 
-        if (start_transaction_id.newest() && end_transaction_id.newest()) {
+  for (uint32 row = beg_row; row < uint32(end_row); ++row) {
+    // Walk the occupancy bitmap a word at a time, so empty stretches of
+    // the row cost one test per 64 slots.
+    const uint32 first_slot = row*m_page_width + beg_col;
+    const uint32 last_slot  = row*m_page_width + end_col;
+
+    for (uint32 word = first_slot / 64; word * 64 < last_slot; ++word) {
+      uint32 lo = std::max(first_slot, word * 64) - word * 64;
+      uint32 hi = std::min(last_slot, word * 64 + 64) - word * 64;
+      uint64 bits = m_occupied[word] & bit_range64(lo, hi);
+      if (!bits)
+        continue;
+
+      uint32 rank = m_rank[word] + popcount64(m_occupied[word] & ((uint64(1) << lo) - 1));
+      for (; bits; bits &= bits - 1, ++rank) {
+        const uint32 col = word * 64 + lowest_bit64(bits) - row*m_page_width;
+        const Run& run = m_runs[rank];
+        const Record* first = &m_records[run.begin];
+        const Record* last  = first + run.size;
+
+        if (newest_only) {
           // If the user has specified a transaction range of [-1, -1],
           // then we only return the last valid tile.
-          if (entries.size() > 0)
-            candidates.push_back( *(entries.begin()) );
+          results.push_back(hdr_from_index(col, row, *first));
         } else {
-          // Search through the entries in the list, looking entries
-          // that match the requested transaction_id range.  Note: this
-          // search is O(n), so it can be slow if there are a lot of
-          // entries and the entry you are looking for is near the end.
-          // However, most pages will contain very few entries, and for
-          // those with many entries (i.e. tiles near the root of the
-          // mosaic), you will most likely be searching for recently
-          // added tiles, which are sorted to the beginning.
-          BOOST_FOREACH(const value_type& elt, entries) {
-            if (elt.first < start_transaction_id)
-              break;
-            if (elt.first <= end_transaction_id)
-              candidates.push_back(elt);
-          }
+          // The run is sorted newest first, so the matching records are
+          // one contiguous stretch of it.
+          const Record* begin = first_at_or_before(first, last, end_id);
+          const Record* end   = start_id == 0 ? last : first_at_or_before(begin, last, start_id - 1);
+          for (; begin != end; ++begin)
+            results.push_back(hdr_from_index(col, row, *begin));
         }
-
-        append_if_in_region( results, candidates, col, row, region );
       }
     }
   }
@@ -379,22 +640,19 @@ IndexPage::search_by_location(uint32 col, uint32 row,
   std::list<TileHeader> results;
 
   // Check first to make sure that there are actually tiles at this location.
-  if (!m_sparse_table.test(page_row*m_page_width + page_col))
+  const Run* run = find_run(page_row*m_page_width + page_col);
+  if (!run || run->size == 0)
     return results;
 
-  multi_value_type const& entries = m_sparse_table[page_row*m_page_width + page_col];
-  if (entries.size() == 0)
-    return results;
+  const Record* first = &m_records[run->begin];
+  const Record* last  = first + run->size;
 
   if (start_transaction_id.newest() && end_transaction_id.newest())
-    results.push_back(hdr_from_index(page_col, page_row, *entries.begin()));
+    results.push_back(hdr_from_index(page_col, page_row, *first));
   else {
-    BOOST_FOREACH(const value_type& elt, entries) {
-      if (elt.first < start_transaction_id)
-        break;
-      if (elt.first <= end_transaction_id)
-        results.push_back(hdr_from_index(page_col, page_row, elt));
-    }
+    const uint32 start_id = bound(start_transaction_id);
+    for (const Record* it = first_at_or_before(first, last, bound(end_transaction_id)); it != last && it->transaction_id >= start_id; ++it)
+      results.push_back(hdr_from_index(page_col, page_row, *it));
   }
 
   return results;
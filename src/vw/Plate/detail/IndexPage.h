@@ -22,12 +22,13 @@
 #include <vw/Plate/FundamentalTypes.h>
 #include <vw/Plate/IndexData.pb.h>
 #include <vw/Plate/IndexDataPrivate.pb.h>
-#include <vw/Plate/google/sparsetable>
 #include <vw/Math/BBox.h>
 #include <boost/numeric/conversion/cast.hpp>
 #include <boost/shared_ptr.hpp>
 #include <string>
 #include <list>
+#include <vector>
+#include <algorithm>
 
 namespace vw {
 namespace platefile {
@@ -37,30 +38,72 @@ namespace detail {
   //                            INDEX PAGE
   // ----------------------------------------------------------------------
 
+  // An IndexPage holds the index records for a page_width x page_height
+  // block of tiles on one level. A bitmap marks the occupied slots, and
+  // each occupied slot owns a run of records in one flat array, sorted by
+  // decreasing transaction id. Records are plain structs; IndexRecord
+  // protobufs are only built when a caller asks for one.
   class IndexPage {
 
   public:
     typedef std::pair<uint32, IndexRecord> value_type;
     typedef std::list<value_type> multi_value_type;
-    typedef google::sparsetable<multi_value_type>::nonempty_iterator nonempty_iterator;
+
+    // One index entry. filetype is an index into the page's filetype
+    // table, or NO_FILETYPE if the record didn't have one.
+    struct Record {
+      uint64 blob_offset;
+      uint32 transaction_id;
+      int32  blob_id;
+      uint32 filetype;
+    };
+    static const uint32 NO_FILETYPE = 0xFFFFFFFFu;
 
   protected:
+    // A slot's records live in m_records[begin, begin+size). There is room
+    // for capacity records before the run has to move.
+    struct Run {
+      uint32 begin, size, capacity;
+    };
+
     uint32 m_level, m_base_col, m_base_row;
     uint32 m_page_width, m_page_height;
-    google::sparsetable<multi_value_type> m_sparse_table;
 
-    void append_if_in_region( std::list<TileHeader> &results,
-                              multi_value_type const& candidates,
-                              uint32 col, uint32 row, BBox2i const& region) const;
+    std::vector<uint64> m_occupied;  // one bit per slot
+    std::vector<uint32> m_rank;      // occupied slots before each word of m_occupied
+    std::vector<Run>    m_runs;      // one per occupied slot, in slot order
+    std::vector<Record> m_records;
+    uint32 m_unused;                 // holes left in m_records by runs that moved
+    std::vector<std::string> m_filetypes;
+    uint32 m_min_transaction, m_max_transaction;
+
+    void reset(uint32 page_width, uint32 page_height);
+
+    // Returns the run for a slot, or 0 if the slot is empty
+    const Run* find_run(uint32 slot) const;
+    uint32 slot_rank(uint32 slot) const;
+
+    // Close up the holes between runs
+    void compact();
+
+    uint32 filetype_index(IndexRecord const& record);
+    IndexRecord to_index_record(Record const& rec) const;
+
+    void deserialize_legacy(const char* data, size_t size);
 
-    TileHeader hdr_from_index(uint32 rel_col, uint32 rel_row, const value_type& elt) const {
+    void note_transaction(uint32 transaction_id) {
+      m_min_transaction = std::min(m_min_transaction, transaction_id);
+      m_max_transaction = std::max(m_max_transaction, transaction_id);
+    }
+
+    TileHeader hdr_from_index(uint32 rel_col, uint32 rel_row, const Record& elt) const {
       TileHeader hdr;
       hdr.set_col( m_base_col + rel_col );
       hdr.set_row( m_base_row + rel_row );
       hdr.set_level(m_level);
-      hdr.set_transaction_id(elt.first);
-      if (elt.second.has_filetype())
-        hdr.set_filetype(elt.second.filetype());
+      hdr.set_transaction_id(elt.transaction_id);
+      if (elt.filetype != NO_FILETYPE)
+        hdr.set_filetype(m_filetypes[elt.filetype]);
       return hdr;
     }
 
@@ -76,13 +119,14 @@ namespace detail {
     virtual void sync() = 0;
 
     // For reading/writing to/from disk or a network byte stream.
+    // deserialize() also reads the older, protobuf-per-record page format;
+    // serialize() always writes the current one.
     void serialize(std::ostream& ostr);
     void deserialize(std::istream& istr);
+    void deserialize(const char* data, size_t size);
 
-    // ----------------------- ITERATORS  ----------------------
-
-    nonempty_iterator begin() { return m_sparse_table.nonempty_begin(); }
-    nonempty_iterator end() { return m_sparse_table.nonempty_end(); }
+    /// Bytes of memory held by this page (roughly)
+    size_t memory_usage() const;
 
     // ----------------------- ACCESSORS  ----------------------
 
@@ -107,6 +151,8 @@ namespace detail {
     /// Return multiple index entries that match the specified
     /// transaction id range.  This range is inclusive of the first
     /// entry AND the last entry: [ begin_transaction_id, end_transaction_id ]
+    /// As a special case, a range from 1 (or below) to MAX_TRANSACTION
+    /// returns every entry, transaction 0 included.
     ///
     /// Results are return as a std::pair<int32, IndexRecord>.  The
     /// first value in the pair is the transaction id for that
@@ -118,7 +164,12 @@ namespace detail {
 
     /// Return the number of valid entries in this page.  (Remember
     /// that this is a sparse store of IndexRecords.)
-    uint32 sparse_size() { return boost::numeric_cast<uint32>(m_sparse_table.num_nonempty()); }
+    uint32 sparse_size() const { return boost::numeric_cast<uint32>(m_runs.size()); }
+
+    /// The smallest and largest transaction ids stored in this page.
+    /// Only meaningful if sparse_size() > 0.
+    uint32 min_transaction() const { return m_min_transaction; }
+    uint32 max_transaction() const { return m_max_transaction; }
 
     /// Returns a list of valid tiles in this IndexPage.
     ///
@@ -127,9 +178,18 @@ namespace detail {
                                            TransactionOrNeg start_transaction_id,
                                            TransactionOrNeg end_transaction_id) const;
 
+    /// Same as above, but appends the tiles to results instead of
+    /// building a list.
+    std::vector<TileHeader>& search_by_region(std::vector<TileHeader>& results,
+                                              vw::BBox2i const& region,
+                                              TransactionOrNeg start_transaction_id,
+                                              TransactionOrNeg end_transaction_id) const;
+
     /// Return multiple tile headers that match the specified
     /// transaction id range.  This range is inclusive of the first
     /// entry AND the last entry: [ begin_transaction_id, end_transaction_id ]
+    /// As a special case, a range from 1 (or below) to MAX_TRANSACTION
+    /// returns every entry, transaction 0 included.
     ///
     /// Results are return as a std::pair<int32, IndexRecord>.  The
     /// first value in the pair is the transaction id for that
@@ -155,6 +215,14 @@ namespace detail {
     virtual boost::shared_ptr<IndexPage> generate() const = 0;
   };
 
+  // What a page held the last time an index looked at it. See IndexLevel.
+  struct PageSummary {
+    bool   known;
+    uint32 tiles;
+    uint32 min_transaction, max_transaction;
+    PageSummary() : known(false), tiles(0), min_transaction(0), max_transaction(0) {}
+  };
+
   // PageGeneratorFactory is the base class for entities that can
   // generate PageGenerators.
   class PageGeneratorFactory {
@@ -166,6 +234,19 @@ namespace detail {
              uint32 page_width, uint32 page_height) = 0;
     // Who is this factory manufacturing pages for? (human-readable)
     virtual std::string who() const = 0;
+    // True if pages only change through this process. Indexes use this
+    // to remember what a page holds after it drops out of the cache.
+    virtual bool private_pages() const { return false; }
+
+    // Page summaries for a level that outlive the process, indexed by
+    // page id. read_summaries() returns false if none were saved or if
+    // the pages changed since they were, and drop_summaries() discards
+    // the saved copy before the pages change.
+    virtual bool read_summaries(uint32 /*level*/, uint32 /*page_width*/, uint32 /*page_height*/,
+                                std::vector<PageSummary>& /*summaries*/) const { return false; }
+    virtual void write_summaries(uint32 /*level*/, uint32 /*page_width*/, uint32 /*page_height*/,
+                                 std::vector<PageSummary> const& /*summaries*/) {}
+    virtual void drop_summaries(uint32 /*level*/) {}
   };
 
 }}}
@@ -62,6 +62,10 @@ void LocalIndexPage::set(TileHeader const& header, IndexRecord const& record) {
   m_needs_saving = true;
 }
 
+void LocalIndexPage::rewrite() {
+  this->serialize();
+}
+
 void LocalIndexPage::sync() {
   if (m_needs_saving) {
     this->serialize();
@@ -95,13 +99,22 @@ void LocalIndexPage::serialize() {
 
 void LocalIndexPage::deserialize() {
 
-  std::ifstream istr(m_filename.c_str());
+  std::ifstream istr(m_filename.c_str(), std::ios::binary);
   if (!istr.good())
     vw_throw(IOErr() << "IndexPage::deserialize() failed.  Could not open " << m_filename << " for reading.");
 
+  // Pull the whole page in with one read
+  istr.seekg(0, std::ios::end);
+  std::vector<char> bytes(boost::numeric_cast<size_t>(std::streamoff(istr.tellg())));
+  istr.seekg(0, std::ios::beg);
+  if (!bytes.empty())
+    istr.read(&bytes[0], bytes.size());
+  if (!istr.good())
+    vw_throw(IOErr() << "IndexPage::deserialize() failed.  Could not read " << m_filename);
+
   // Call up to superclass to finish deserializing.
   try {
-    IndexPage::deserialize(istr);
+    IndexPage::deserialize(bytes.empty() ? 0 : &bytes[0], bytes.size());
   } catch (const vw::IOErr &e) {
     // Add more useful error reporting.
     vw_throw(IOErr() << "Failed to load page \"" << m_filename << "\": " << e.what());
@@ -129,24 +142,173 @@ LocalPageGenerator::generate() const {
 boost::shared_ptr<PageGeneratorBase>
 LocalPageGeneratorFactory::create(uint32 level, uint32 base_col, uint32 base_row, uint32 page_width, uint32 page_height)
 {
-  // Generate a filename
+  // Create the proper type of page generator.
+  boost::shared_ptr<PageGeneratorBase> page_gen(
+      new LocalPageGenerator(page_filename(level, base_col, base_row), level, base_col, base_row,
+        page_width, page_height) );
+
+  return page_gen;
+}
+
+std::string LocalPageGeneratorFactory::who() const {
+  return fs::path(m_plate_filename).stem().string();
+}
+
+namespace {
+  // A summary file is a header (magic, count) followed by count records
+  // of (page id, tiles, min transaction, max transaction, page size,
+  // page mtime), the last two as pairs of uint32s. Only pages with a
+  // known summary are stored. The size and mtime are those of the page
+  // file when the summaries were saved; a page file that did not exist
+  // has size NO_PAGE. If any page no longer matches, somebody changed it
+  // behind our back and the whole file is ignored.
+  const uint32 SUMMARY_MAGIC = 0x50534d32; // "PSM2"
+  const size_t SUMMARY_RECORD = 8;
+  const uint64 NO_PAGE = uint64(-1);
+
+  std::string summary_filename(std::string const& plate_filename, uint32 level) {
+    std::ostringstream filename;
+    filename << plate_filename << "/index/" << level << "/summary";
+    return filename.str();
+  }
+
+  void page_stamp(std::string const& filename, uint64& size, uint64& mtime) {
+    boost::system::error_code err;
+    size = fs::file_size(filename, err);
+    if (err) {
+      size = NO_PAGE;
+      mtime = 0;
+      return;
+    }
+    mtime = uint64(fs::last_write_time(filename, err));
+    if (err)
+      mtime = 0;
+  }
+}
+
+std::string LocalPageGeneratorFactory::page_filename(uint32 level, uint32 base_col, uint32 base_row) const {
   std::ostringstream filename;
   filename << m_plate_filename
     << "/index"
     << "/" << level
     << "/" << base_row
     << "/" << base_col;
+  return filename.str();
+}
 
-  // Create the proper type of page generator.
-  boost::shared_ptr<PageGeneratorBase> page_gen(
-      new LocalPageGenerator(filename.str(), level, base_col, base_row,
-        page_width, page_height) );
+// Summaries are indexed by page id, row-major over the pages of the level.
+std::string LocalPageGeneratorFactory::page_filename(uint32 level, uint32 page_width, uint32 page_height, size_t page_id) const {
+  const uint32 tiles_per_side = 1 << level;
+  const uint32 horizontal_pages = (tiles_per_side + page_width - 1) / page_width;
+  return page_filename(level, uint32(page_id % horizontal_pages) * page_width,
+                              uint32(page_id / horizontal_pages) * page_height);
+}
 
-  return page_gen;
+bool LocalPageGeneratorFactory::read_summaries(uint32 level, uint32 page_width, uint32 page_height,
+                                               std::vector<PageSummary>& summaries) const {
+  const std::string filename = summary_filename(m_plate_filename, level);
+  std::ifstream istr(filename.c_str(), std::ios::binary);
+  if (!istr.good())
+    return false;
+
+  uint32 header[2];
+  if (!istr.read(reinterpret_cast<char*>(header), sizeof(header)) || header[0] != SUMMARY_MAGIC) {
+    vw_out(WarningMessage, "plate") << "Ignoring unreadable page summaries in " << filename << std::endl;
+    return false;
+  }
+
+  if (header[1] > summaries.size()) {
+    vw_out(WarningMessage, "plate") << "Ignoring oversized page summaries in " << filename << std::endl;
+    return false;
+  }
+
+  std::vector<uint32> records(SUMMARY_RECORD * size_t(header[1]));
+  if (!records.empty() && !istr.read(reinterpret_cast<char*>(&records[0]), records.size() * sizeof(uint32))) {
+    vw_out(WarningMessage, "plate") << "Ignoring truncated page summaries in " << filename << std::endl;
+    return false;
+  }
+
+  // Check every page before believing any of them.
+  for (size_t i = 0; i < records.size(); i += SUMMARY_RECORD) {
+    if (records[i] >= summaries.size()) {
+      vw_out(WarningMessage, "plate") << "Ignoring page summaries with a bad page id in " << filename << std::endl;
+      return false;
+    }
+    uint64 size, mtime;
+    page_stamp(page_filename(level, page_width, page_height, records[i]), size, mtime);
+    if (size  != (uint64(records[i+5]) << 32 | records[i+4]) ||
+        mtime != (uint64(records[i+7]) << 32 | records[i+6])) {
+      vw_out(DebugMessage, "plate") << "Ignoring stale page summaries in " << filename << std::endl;
+      return false;
+    }
+  }
+
+  for (size_t i = 0; i < records.size(); i += SUMMARY_RECORD) {
+    PageSummary& s = summaries[records[i]];
+    s.known = true;
+    s.tiles = records[i+1];
+    s.min_transaction = records[i+2];
+    s.max_transaction = records[i+3];
+  }
+  return true;
 }
 
-std::string LocalPageGeneratorFactory::who() const {
-  return fs::path(m_plate_filename).stem().string();
+void LocalPageGeneratorFactory::write_summaries(uint32 level, uint32 page_width, uint32 page_height,
+                                                std::vector<PageSummary> const& summaries) {
+  const std::string filename = summary_filename(m_plate_filename, level);
+
+  std::vector<uint32> records;
+  for (size_t i = 0; i < summaries.size(); ++i) {
+    PageSummary const& s = summaries[i];
+    if (!s.known)
+      continue;
+    uint64 size, mtime;
+    page_stamp(page_filename(level, page_width, page_height, i), size, mtime);
+    records.push_back(boost::numeric_cast<uint32>(i));
+    records.push_back(s.tiles);
+    records.push_back(s.min_transaction);
+    records.push_back(s.max_transaction);
+    records.push_back(uint32(size));
+    records.push_back(uint32(size >> 32));
+    records.push_back(uint32(mtime));
+    records.push_back(uint32(mtime >> 32));
+  }
+
+  // The summaries only save work, so failing to write them is not an
+  // error. The next process just starts out knowing nothing.
+  try {
+    fs::path parent(fs::path(filename).parent_path());
+    fs::create_directories(parent);
+
+    std::string tmpname;
+    {
+      TemporaryFile tmp(parent.string(), false);
+      const uint32 header[2] = { SUMMARY_MAGIC, boost::numeric_cast<uint32>(records.size() / SUMMARY_RECORD) };
+      tmp.write(reinterpret_cast<const char*>(header), sizeof(header));
+      if (!records.empty())
+        tmp.write(reinterpret_cast<const char*>(&records[0]), records.size() * sizeof(uint32));
+      tmpname = tmp.filename();
+      if (!tmp.good()) {
+        fs::remove(tmpname);
+        vw_throw(IOErr() << "write failed");
+      }
+    }
+
+    if (::rename(tmpname.c_str(), filename.c_str()) == -1) {
+      fs::remove(tmpname);
+      vw_throw(IOErr() << ::strerror(errno));
+    }
+  } catch (const std::exception& e) {
+    vw_out(WarningMessage, "plate") << "Could not save page summaries to " << filename << ": " << e.what() << std::endl;
+  }
+}
+
+void LocalPageGeneratorFactory::drop_summaries(uint32 level) {
+  const std::string filename = summary_filename(m_plate_filename, level);
+  boost::system::error_code err;
+  fs::remove(filename, err);
+  if (err)
+    vw_throw(IOErr() << "Could not remove stale page summaries " << filename << ": " << err.message());
 }
 
 // -------------------------------------------------------------------
@@ -397,7 +559,7 @@ Transaction LocalIndex::transaction_request(std::string transaction_description,
      TerminalProgressCallback tpc("plate", "\t --> Rebuild from blob" + vw::stringify(blob_id) + " : ");
      tpc.report_progress(0);
 
-     ReadBlob blob(name);
+     ReadBlob blob(name, ReadBlob::MAPPED);
 
      IndexRecord rec;
      typedef Blob::iterator iter_t;
@@ -413,6 +575,39 @@ Transaction LocalIndex::transaction_request(std::string transaction_description,
   }
 }
 
+// Rewrite every page file in the current page format.  Pages in the old
+// format are read transparently and are rewritten anyway the next time
+// they change, so this is only needed to convert a plate all at once.
+void LocalIndex::upgrade_pages() {
+  const std::string base = m_plate_filename + "/index";
+  if (!fs::exists(base))
+    return;
+
+  // Page files live at index/<level>/<base_row>/<base_col>
+  boost::regex re("(\\d+)/(\\d+)/(\\d+)$");
+  uint32 count = 0;
+  for (fs::recursive_directory_iterator i(base), end; i != end; ++i) {
+    if (!fs::is_regular_file(i->status()))
+      continue;
+
+    const std::string fn = i->path().string();
+    boost::smatch matches;
+    if (!boost::regex_search(fn, matches, re)) {
+      vw_out(DebugMessage, "plate") << "Skipping non-page file " << fn << std::endl;
+      continue;
+    }
+
+    uint32 level    = boost::lexical_cast<uint32>(matches[1].str());
+    uint32 base_row = boost::lexical_cast<uint32>(matches[2].str());
+    uint32 base_col = boost::lexical_cast<uint32>(matches[3].str());
+
+    LocalIndexPage page(fn, level, base_col, base_row, m_page_width, m_page_height);
+    page.rewrite();
+    ++count;
+  }
+  this->log() << "Rewrote " << count << " index pages in the current format.\n";
+}
+
 // -----------------------    I/O      ----------------------
 
 /// Writing, pt. 1: Reserve a blob lock
@@ -57,6 +57,10 @@ namespace detail {
     /// Save any unsaved changes to disk.
     virtual void sync();
 
+    /// Write the page back to disk (in the current page format) even if
+    /// nothing has changed.
+    void rewrite();
+
   };
 
   // ----------------------------------------------------------------------
@@ -84,6 +88,9 @@ namespace detail {
   class LocalPageGeneratorFactory : public PageGeneratorFactory {
     std::string m_plate_filename;
 
+    std::string page_filename(uint32 level, uint32 base_col, uint32 base_row) const;
+    std::string page_filename(uint32 level, uint32 page_width, uint32 page_height, size_t page_id) const;
+
   public:
     LocalPageGeneratorFactory(std::string plate_filename) :
       m_plate_filename(plate_filename) {}
@@ -93,6 +100,15 @@ namespace detail {
                                                         uint32 page_width, uint32 page_height);
 
     virtual std::string who() const;
+    virtual bool private_pages() const { return true; }
+
+    // Summaries live in index/<level>/summary, next to the level's
+    // pages, and are stamped with the size and mtime of each page file.
+    virtual bool read_summaries(uint32 level, uint32 page_width, uint32 page_height,
+                                std::vector<PageSummary>& summaries) const;
+    virtual void write_summaries(uint32 level, uint32 page_width, uint32 page_height,
+                                 std::vector<PageSummary> const& summaries);
+    virtual void drop_summaries(uint32 level);
   };
 
   // -------------------------------------------------------------------
@@ -128,6 +144,9 @@ namespace detail {
     // time.
     void rebuild_index();
 
+    // Rewrite all of the index pages on disk in the current page format.
+    void upgrade_pages();
+
     /// Use this to send data to the index's logfile like this:
     ///
     ///   index_instance.log() << "some text for the log...\n";
@@ -36,7 +36,9 @@ using namespace vw::platefile::detail;
 IndexLevel::IndexLevel(boost::shared_ptr<PageGeneratorFactory> page_gen_factory,
                        uint32 level, uint32 page_width, uint32 page_height, uint32 cache_size)
   : m_page_gen_factory(page_gen_factory), m_level(level),
-    m_page_width(page_width), m_page_height(page_height), m_cache(cache_size) {
+    m_page_width(page_width), m_page_height(page_height), m_cache(cache_size),
+    m_summarize(page_gen_factory->private_pages()),
+    m_pages_written(false), m_summaries_saved(false) {
 
   uint32 tiles_per_side = 1 << level;
   m_horizontal_pages = static_cast<uint32>(ceil(float(tiles_per_side) / float(page_width)));
@@ -49,6 +51,10 @@ IndexLevel::IndexLevel(boost::shared_ptr<PageGeneratorFactory> page_gen_factory,
   // load_cache_handle().
   uint32 pages = m_horizontal_pages * m_vertical_pages;
   m_cache_handles.resize(pages);
+  if (m_summarize) {
+    m_summaries.resize(pages);
+    m_summaries_saved = m_page_gen_factory->read_summaries(m_level, m_page_width, m_page_height, m_summaries);
+  }
 }
 
 uint32 IndexLevel::page_id(uint32 col, uint32 row) const {
@@ -65,7 +71,35 @@ uint32 IndexLevel::page_id(uint32 col, uint32 row) const {
 /// Grab an IndexPage.  Useful if you want to serialize it by hand to disk.
 boost::shared_ptr<IndexPage> IndexLevel::get_page(uint32 col, uint32 row) const {
   // Access the page.  This will load it into memory if necessary.
-  return load_page(col, row);
+  boost::shared_ptr<IndexPage> page = load_page(col, row);
+
+  // The caller might change it behind our back, so forget what we knew.
+  if (m_summarize) {
+    Mutex::Lock lock(m_cache_mutex);
+    forget_saved_summaries();
+    m_summaries[page_id(col, row)] = PageSummary();
+  }
+  return page;
+}
+
+void IndexLevel::update_summary(size_t idx, IndexPage const& page) const {
+  if (!m_summarize)
+    return;
+  Mutex::Lock lock(m_cache_mutex);
+  PageSummary& s = m_summaries[idx];
+  s.known = true;
+  s.tiles = page.sparse_size();
+  s.min_transaction = page.min_transaction();
+  s.max_transaction = page.max_transaction();
+}
+
+// Must hold m_cache_mutex. The saved summaries stop matching the pages as
+// soon as one changes, so drop them before that change can reach disk.
+void IndexLevel::forget_saved_summaries() const {
+  if (m_summaries_saved) {
+    m_page_gen_factory->drop_summaries(m_level);
+    m_summaries_saved = false;
+  }
 }
 
 namespace {
@@ -117,9 +151,22 @@ void IndexLevel::sync() {
   m_cache.clear_stats();
 
   // Write the index pages to disk by calling their sync() methods.
+  // Dereferencing a handle locks its cache line, so release it again or
+  // the line can never be invalidated.
   BOOST_FOREACH( handle_t& h, m_cache_handles ) {
-    if (h.attached() && h.valid())
+    if (h.attached() && h.valid()) {
       h->sync();
+      h.release();
+    }
+  }
+
+  // Every page is on disk now, so the summaries describe them. Only a
+  // process that wrote pages saves them, so readers never overwrite
+  // what a writer left behind.
+  if (m_summarize && m_pages_written) {
+    m_page_gen_factory->write_summaries(m_level, m_page_width, m_page_height, m_summaries);
+    m_pages_written = false;
+    m_summaries_saved = true;
   }
 }
 
@@ -132,7 +179,13 @@ IndexRecord IndexLevel::get(int32 col, int32 row, TransactionOrNeg transaction_i
 /// Set the value of an index node at this level.
 void IndexLevel::set(TileHeader const& header, IndexRecord const& rec) {
   boost::shared_ptr<IndexPage> page = load_page(header.col(), header.row());
+  if (m_summarize) {
+    Mutex::Lock lock(m_cache_mutex);
+    forget_saved_summaries();
+    m_pages_written = true;
+  }
   page->set(header, rec);
+  update_summary(page_id(header.col(), header.row()), *page);
 }
 
 namespace {
@@ -141,9 +194,10 @@ namespace {
   }
 }
 
-/// Returns a list of valid tiles at this level.
-std::list<TileHeader>
-IndexLevel::search_by_region(BBox2i const& region,
+/// Appends the valid tiles at this level to results.
+std::vector<TileHeader>&
+IndexLevel::search_by_region(std::vector<TileHeader>& results,
+                             BBox2i const& region,
                              TransactionOrNeg start_transaction_id,
                              TransactionOrNeg end_transaction_id) const {
 
@@ -156,18 +210,32 @@ IndexLevel::search_by_region(BBox2i const& region,
 
   WHEREAMI << "[" << min_level_col << " " << min_level_row << "]" << " to [" << max_level_col << " " << max_level_row << "]\n";
 
+  const bool newest_only = start_transaction_id.newest() && end_transaction_id.newest();
+  const uint32 start_id = start_transaction_id.newest() ? NO_TRANSACTION : uint32(start_transaction_id.promote());
+  const uint32 end_id   = end_transaction_id.newest()   ? NO_TRANSACTION : uint32(end_transaction_id.promote());
+
   // Iterate over the pages that overlap with the region of interest.
-  std::list<TileHeader> result;
   for (uint32 level_row = min_level_row; level_row < max_level_row; level_row += m_page_height) {
     for (uint32 level_col = min_level_col; level_col < max_level_col; level_col += m_page_width) {
+      size_t idx = page_id(level_col, level_row);
+
+      // Skip pages we already know have nothing for us
+      if (m_summarize) {
+        Mutex::Lock lock(m_cache_mutex);
+        const PageSummary& s = m_summaries[idx];
+        if (s.known && (s.tiles == 0 ||
+              (!newest_only && (start_id > s.max_transaction || end_id < s.min_transaction))))
+          continue;
+      }
+
       boost::shared_ptr<IndexPage> page = load_page(level_col, level_row);
+      update_summary(idx, *page);
 
       // Accumulate valid tiles that overlap with region from this IndexPage.
-      std::list<TileHeader> sub_result = page->search_by_region(region, start_transaction_id, end_transaction_id);
-      result.splice(result.end(), sub_result);
+      page->search_by_region(results, region, start_transaction_id, end_transaction_id);
     }
   }
-  return result;
+  return results;
 }
 
 /// Fetch the value of an index node at this level.
@@ -252,16 +320,17 @@ void PagedIndex::write_update(TileHeader const& header, IndexRecord const& recor
 /// valid location.  Note: there may be other tiles in the transaction
 /// range at this col/row/level, but search_by_region() only returns the
 /// first one.
-std::list<TileHeader>
-PagedIndex::search_by_region(uint32 level, BBox2i const& region,
+std::vector<TileHeader>&
+PagedIndex::search_by_region(std::vector<TileHeader>& results,
+                             uint32 level, BBox2i const& region,
                              TransactionOrNeg start_transaction_id, TransactionOrNeg end_transaction_id) const {
 
-  // If the level does not exist, we return an empty list.
+  // If the level does not exist, there is nothing to add.
   if (level >= m_levels.size())
-    return std::list<TileHeader>();
+    return results;
 
   // Otherwise, we delegate to the search_by_region() method for that level.
-  return m_levels[level]->search_by_region(region, start_transaction_id, end_transaction_id);
+  return m_levels[level]->search_by_region(results, region, start_transaction_id, end_transaction_id);
 }
 
 std::list<TileHeader>
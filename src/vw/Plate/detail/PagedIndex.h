@@ -48,8 +48,18 @@ namespace detail {
     mutable std::vector<handle_t> m_cache_handles;
     mutable vw::Cache m_cache;
     mutable Mutex m_cache_mutex;
+    // What each page held the last time we looked at it, so region
+    // searches can skip pages without loading them. Only kept if the page
+    // factory says nobody else can change the pages, and saved through
+    // the factory on sync() after this process writes pages, so the next
+    // process starts out knowing them.
+    bool m_summarize;
+    mutable std::vector<PageSummary> m_summaries;
+    mutable bool m_pages_written, m_summaries_saved;
 
     boost::shared_ptr<IndexPage> load_page(uint32 col, uint32 row) const;
+    void update_summary(size_t idx, IndexPage const& page) const;
+    void forget_saved_summaries() const;
 
   public:
     typedef IndexPage::multi_value_type multi_value_type;
@@ -74,10 +84,11 @@ namespace detail {
     /// Set the value of an index node at this level.
     void set(TileHeader const& hdr, IndexRecord const& rec);
 
-    /// Returns a list of valid tiles at this level.
-    std::list<TileHeader> search_by_region(BBox2i const& region,
-                                           TransactionOrNeg start_transaction_id,
-                                           TransactionOrNeg end_transaction_id) const;
+    /// Appends the valid tiles at this level to results.
+    std::vector<TileHeader>& search_by_region(std::vector<TileHeader>& results,
+                                              BBox2i const& region,
+                                              TransactionOrNeg start_transaction_id,
+                                              TransactionOrNeg end_transaction_id) const;
 
     /// Returns a list of valid tiles at this level and specified location
     std::list<TileHeader> search_by_location(uint32 col, uint32 row,
@@ -158,9 +169,11 @@ namespace detail {
     /// valid location.  Note: there may be other tiles in the transaction
     /// range at this col/row/level, but valid_tiles() only returns the
     /// first one.
-    virtual std::list<TileHeader> search_by_region(uint32 level, BBox2i const& region,
-                                                   TransactionOrNeg start_transaction_id,
-                                                   TransactionOrNeg end_transaction_id) const;
+    using Index::search_by_region;
+    virtual std::vector<TileHeader>& search_by_region(std::vector<TileHeader>& results,
+                                                      uint32 level, BBox2i const& region,
+                                                      TransactionOrNeg start_transaction_id,
+                                                      TransactionOrNeg end_transaction_id) const;
 
     /// Returns a list of tile headers for a given tile location in
     /// the mosaic, subject to the specified transaction_id range.
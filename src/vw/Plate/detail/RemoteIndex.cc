@@ -23,6 +23,8 @@
 #include <vw/Plate/Exception.h>
 
 #include <boost/iostreams/stream.hpp>
+#include <boost/bind.hpp>
+#include <boost/foreach.hpp>
 namespace io = boost::iostreams;
 
 using namespace vw;
@@ -61,13 +63,134 @@ class RemoteIndex::LogRequestSink : public io::sink {
 };
 
 
+// ----------------------------------------------------------------------
+//                         REMOTE WRITE QUEUE
+// ----------------------------------------------------------------------
+
+RemoteWriteQueue::RemoteWriteQueue(boost::shared_ptr<IndexClient> client, uint32 batch_size, uint32 window)
+  : m_client(client), m_batch_size(std::max(batch_size, 1u)), m_window(std::max(window, 1u)),
+    m_pending(new IndexMultiWriteUpdate()), m_lost(0)
+{
+  m_client->set_before_call(boost::bind(&RemoteWriteQueue::collect, this));
+}
+
+RemoteWriteQueue::~RemoteWriteQueue() {
+  m_client->set_before_call(boost::function<void ()>());
+}
+
+// Wait for the oldest batch in flight. If it failed (or we can't tell),
+// the replies behind it can't be trusted to mean anything either, so
+// collect them and send all of those batches again, in their original
+// order, so a later write to a tile still lands last.
+void RemoteWriteQueue::wait_one() {
+  std::vector<batch_t> redo(1, m_in_flight.front());
+  m_in_flight.pop_front();
+  try {
+    m_client->recv_reply(0);
+    return;
+  } catch (const vw::Exception& e) {
+    vw_out(WarningMessage, "plate") << "Pipelined index write failed (" << e.what()
+                                    << "); resending " << (m_in_flight.size() + 1) << " batches" << std::endl;
+  }
+
+  while (!m_in_flight.empty()) {
+    redo.push_back(m_in_flight.front());
+    m_in_flight.pop_front();
+    try {
+      m_client->recv_reply(0);
+    } catch (const vw::Exception&) {}
+  }
+  BOOST_FOREACH(batch_t const& batch, redo)
+    this->resend(batch);
+}
+
+void RemoteWriteQueue::collect() {
+  RecursiveMutex::Lock lock(m_mutex);
+  while (!m_in_flight.empty())
+    this->wait_one();
+}
+
+void RemoteWriteQueue::resend(batch_t const& batch) {
+  RpcNullMsg response;
+  try {
+    m_client->MultiWriteUpdate(m_client.get(), batch.get(), &response, null_callback());
+  } catch (const vw::Exception& e) {
+    vw_out(ErrorMessage, "plate") << "Lost " << batch->write_updates_size()
+                                  << " index writes: " << e.what() << std::endl;
+    m_lost += batch->write_updates_size();
+    if (!m_error)
+      m_error.reset(e.clone());
+  }
+}
+
+void RemoteWriteQueue::push(int platefile_id, TileHeader const& header, IndexRecord const& record) {
+  RecursiveMutex::Lock lock(m_mutex);
+  IndexWriteUpdate* update = m_pending->add_write_updates();
+  update->set_platefile_id(platefile_id);
+  *(update->mutable_header()) = header;
+  *(update->mutable_record()) = record;
+
+  if (uint32(m_pending->write_updates_size()) >= m_batch_size)
+    this->send();
+}
+
+void RemoteWriteQueue::send() {
+  RecursiveMutex::Lock lock(m_mutex);
+  if (m_pending->write_updates_size() == 0)
+    return;
+
+  // Make room in the window
+  while (m_in_flight.size() >= m_window)
+    this->wait_one();
+
+  batch_t batch;
+  batch.swap(m_pending);
+  m_pending.reset(new IndexMultiWriteUpdate());
+  m_in_flight.push_back(batch);
+  try {
+    m_client->send_request("MultiWriteUpdate", batch.get());
+  } catch (const vw::Exception& e) {
+    // Nothing is in flight for it, so once the batches before it are
+    // done, send it the slow way.
+    vw_out(WarningMessage, "plate") << "Failed to send index writes: " << e.what() << std::endl;
+    m_in_flight.pop_back();
+    this->collect();
+    this->resend(batch);
+  }
+}
+
+void RemoteWriteQueue::flush() {
+  RecursiveMutex::Lock lock(m_mutex);
+  this->send();
+  this->collect();
+  if (!m_error)
+    return;
+
+  boost::shared_ptr<Exception> error;
+  error.swap(m_error);
+  const uint64 lost = m_lost;
+  m_lost = 0;
+  vw_out(ErrorMessage, "plate") << "Lost " << lost << " index writes since the last flush" << std::endl;
+  vw_throw(*error);
+}
+
+// ----------------------------------------------------------------------
+//                         REMOTE INDEX PAGE
+// ----------------------------------------------------------------------
+
 RemoteIndexPage::RemoteIndexPage(int platefile_id,
                                  boost::shared_ptr<IndexClient> client,
+                                 boost::shared_ptr<RemoteWriteQueue> writes,
                                  uint32 level, uint32 base_col, uint32 base_row,
                                  uint32 page_width, uint32 page_height)
   : IndexPage(level, base_col, base_row, page_width, page_height),
-    m_platefile_id(platefile_id), m_client(client)
+    m_platefile_id(platefile_id), m_client(client), m_writes(writes)
 {
+  // Our own writes to this page may still be buffered from the last time
+  // it was in the cache. Send them first; the PageRequest below can't
+  // overtake them on the channel, so the page we get back includes them.
+  m_writes->send();
+
   // Use the PageRequest RPC to fetch the remote page from the index
   // server.
   IndexPageRequest request;
@@ -93,49 +216,20 @@ RemoteIndexPage::RemoteIndexPage(int platefile_id,
   }
 }
 
-RemoteIndexPage::~RemoteIndexPage() {
-  this->sync();
-}
+// The page's writes live in the shared queue, so there's nothing to save
+// when the page leaves the cache.
+RemoteIndexPage::~RemoteIndexPage() {}
 
-// Hijack this method momentartarily to mark the page as "dirty" by
-// setting m_needs_saving to true.
 void RemoteIndexPage::set(TileHeader const& header, IndexRecord const& record) {
   // First call up to the parent class and let the original code run.
   IndexPage::set(header, record);
 
-  // Save this write request to the queue, and flush the queue if it
-  // has gotten too full.  (We send an update to the index_server
-  // every 50 writes!)
-  IndexWriteUpdate request;
-  request.set_platefile_id(m_platefile_id);
-  *(request.mutable_header()) = header;
-  *(request.mutable_record()) = record;
-  m_write_queue.push(request);
-  static const unsigned write_queue_size = 50; // arbitrary, but probably good.
-  if (m_write_queue.size() >= write_queue_size)
-    this->flush_write_queue();
-}
-
-void RemoteIndexPage::flush_write_queue() {
-  if (m_write_queue.size() > 0) {
-
-    // For debugging:
-    //    std::cout << "Call to the new flush_write_queue() with "
-    //              << m_write_queue.size() << " entries.\n";
-
-    IndexMultiWriteUpdate request;
-    while (m_write_queue.size() > 0) {
-      *(request.mutable_write_updates()->Add()) = m_write_queue.front();
-      m_write_queue.pop();
-    }
-    RpcNullMsg response;
-    m_client->MultiWriteUpdate(m_client.get(), &request, &response, null_callback());
-
-  }
+  // Then pass the write on to the index server.
+  m_writes->push(m_platefile_id, header, record);
 }
 
 void RemoteIndexPage::sync() {
-  this->flush_write_queue();
+  m_writes->flush();
 }
 
 // ----------------------------------------------------------------------
@@ -144,16 +238,17 @@ void RemoteIndexPage::sync() {
 
 RemotePageGenerator::RemotePageGenerator( int platefile_id,
                                           boost::shared_ptr<IndexClient> client,
+                                          boost::shared_ptr<RemoteWriteQueue> writes,
                                           uint32 level, uint32 base_col, uint32 base_row,
                                           uint32 page_width, uint32 page_height)
-  : m_platefile_id(platefile_id), m_client(client), m_level(level),
+  : m_platefile_id(platefile_id), m_client(client), m_writes(writes), m_level(level),
     m_base_col(base_col), m_base_row(base_row),
     m_page_width(page_width), m_page_height(page_height) {}
 
 boost::shared_ptr<IndexPage>
 RemotePageGenerator::generate() const {
   return boost::shared_ptr<IndexPage>(
-      new RemoteIndexPage(m_platefile_id, m_client, m_level,
+      new RemoteIndexPage(m_platefile_id, m_client, m_writes, m_level,
                           m_base_col, m_base_row, m_page_width, m_page_height) );
 }
 
@@ -164,7 +259,7 @@ RemotePageGeneratorFactory::create(uint32 level, uint32 base_col, uint32 base_ro
 
   // Create the proper type of page generator.
   boost::shared_ptr<PageGeneratorBase> page_gen(
-    new RemotePageGenerator(m_platefile_id, m_client,
+    new RemotePageGenerator(m_platefile_id, m_client, m_writes,
                             level, base_col, base_row,
                             page_width, page_height) );
 
@@ -203,17 +298,7 @@ RemoteIndex::RemoteIndex(const Url& url_)
   m_short_plate_filename = response.short_plate_filename();
   m_full_plate_filename = response.full_plate_filename();
 
-  // Properly initialize the PageGenFactory and set it.
-  boost::shared_ptr<PageGeneratorFactory> factory(
-      new RemotePageGeneratorFactory(m_platefile_id, m_client));
-
-  this->set_page_generator_factory(factory);
-  this->set_default_cache_size(m_url.query().get("cache_size", 100u));
-
-  // Every time you run num_levels, it synchronizes the number of
-  // local (cached) levels with the number of levels on the index
-  // server, so we run it here to synchronize it for the first time.
-  this->num_levels();
+  this->init_pages();
 
   vw_out(InfoMessage, "plate")
     << "Opened remote platefile name[" << m_short_plate_filename
@@ -243,9 +328,22 @@ RemoteIndex::RemoteIndex(const Url& url_, IndexHeader index_header_info)
   m_short_plate_filename = response.short_plate_filename();
   m_full_plate_filename = response.full_plate_filename();
 
+  this->init_pages();
+
+  vw_out(InfoMessage, "plate")
+    << "Created remote platefile name[" << m_short_plate_filename
+    << "] id[" << m_platefile_id << "] levels[" << this->num_levels() << "]" << std::endl;
+}
+
+
+void RemoteIndex::init_pages() {
+  m_writes.reset(new RemoteWriteQueue(m_client,
+                                      m_url.query().get("write_batch", 200u),
+                                      m_url.query().get("write_window", 4u)));
+
   // Properly initialize the PageGenFactory and set it.
   boost::shared_ptr<PageGeneratorFactory> factory(
-      new RemotePageGeneratorFactory(m_platefile_id, m_client));
+      new RemotePageGeneratorFactory(m_platefile_id, m_client, m_writes));
 
   this->set_page_generator_factory(factory);
   this->set_default_cache_size(m_url.query().get("cache_size", 100u));
@@ -254,15 +352,26 @@ RemoteIndex::RemoteIndex(const Url& url_, IndexHeader index_header_info)
   // local (cached) levels with the number of levels on the index
   // server, so we run it here to synchronize it for the first time.
   this->num_levels();
-
-  vw_out(InfoMessage, "plate")
-    << "Created remote platefile name[" << m_short_plate_filename
-    << "] id[" << m_platefile_id << "] levels[" << this->num_levels() << "]" << std::endl;
 }
 
-
 /// Destructor
-RemoteIndex::~RemoteIndex() {}
+RemoteIndex::~RemoteIndex() {
+  // Pages used to send their writes as they were destroyed; now they're
+  // all buffered here.
+  if (m_writes) {
+    try {
+      m_writes->flush();
+    } catch (const vw::Exception& e) {
+      vw_out(ErrorMessage, "plate")
+        << "Lost index writes for platefile " << m_platefile_id << ": " << e.what() << std::endl;
+    }
+  }
+}
+
+void RemoteIndex::sync() {
+  PagedIndex::sync();
+  m_writes->flush();
+}
 
 // Writing, pt. 1: Locks a blob and returns the blob id that can
 // be used to write a tile.
@@ -376,6 +485,9 @@ Transaction RemoteIndex::transaction_request(std::string transaction_description
 // Once a chunk of work is complete, clients can "commit" their
 // work to the mosaic by issuding a transaction_complete method.
 void RemoteIndex::transaction_complete(Transaction transaction_id, bool update_read_cursor) {
+  // The transaction's writes have to land before the read cursor moves.
+  m_writes->flush();
+
   IndexTransactionComplete request;
   request.set_platefile_id(m_platefile_id);
   request.set_transaction_id(transaction_id);
@@ -387,6 +499,8 @@ void RemoteIndex::transaction_complete(Transaction transaction_id, bool update_r
 
 // If a transaction fails, we may need to clean up the mosaic.
 void RemoteIndex::transaction_failed(Transaction transaction_id) {
+  m_writes->flush();
+
   IndexTransactionFailed request;
   request.set_platefile_id(m_platefile_id);
   request.set_transaction_id(transaction_id);
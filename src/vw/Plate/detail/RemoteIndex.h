@@ -22,7 +22,10 @@
 #include <vw/Plate/detail/PagedIndex.h>
 #include <vw/Plate/detail/IndexPage.h>
 #include <vw/Plate/HTTPUtils.h>
-#include <queue>
+#include <vw/Core/Thread.h>
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <deque>
 
 namespace vw {
 namespace platefile {
@@ -31,28 +34,72 @@ namespace platefile {
   class RpcClient;
 
   class IndexService;
-  class IndexWriteUpdate;
+  class IndexMultiWriteUpdate;
 
   typedef RpcClient<IndexService> IndexClient;
 
 namespace detail {
 
   // ----------------------------------------------------------------------
-  //                         LOCAL INDEX PAGE
+  //                         REMOTE WRITE QUEUE
+  // ----------------------------------------------------------------------
+
+  /// Buffers index writes for the index server. Every page of a
+  /// RemoteIndex shares one queue, which sends the writes as
+  /// MultiWriteUpdates of batch_size updates, keeping up to window of them
+  /// in flight before it waits for the server.
+  ///
+  /// Each batch is kept until the server acknowledges it. If a pipelined
+  /// batch fails, it and every batch sent after it are sent again, in
+  /// order, through the ordinary (retrying) stub call. Batches that still
+  /// fail are reported by the next flush(), and nowhere else; in
+  /// particular the client's other calls collect the queue's replies
+  /// without seeing its errors.
+  class RemoteWriteQueue : private boost::noncopyable {
+    typedef boost::shared_ptr<IndexMultiWriteUpdate> batch_t;
+
+    boost::shared_ptr<IndexClient> m_client;
+    const uint32 m_batch_size, m_window;
+    // Recursive, since resending a batch calls back into collect()
+    RecursiveMutex m_mutex;
+    batch_t m_pending;
+    std::deque<batch_t> m_in_flight;
+    boost::shared_ptr<Exception> m_error;
+    uint64 m_lost;
+
+    void wait_one();
+    void collect();
+    void resend(batch_t const& batch);
+
+  public:
+    RemoteWriteQueue(boost::shared_ptr<IndexClient> client, uint32 batch_size, uint32 window);
+    ~RemoteWriteQueue();
+
+    void push(int platefile_id, TileHeader const& header, IndexRecord const& record);
+
+    /// Send whatever is buffered, without waiting for it.
+    void send();
+
+    /// Send whatever is buffered and wait for the server to take it
+    /// all. Throws the first error from any batch that was lost since
+    /// the last flush().
+    void flush();
+  };
+
+  // ----------------------------------------------------------------------
+  //                         REMOTE INDEX PAGE
   // ----------------------------------------------------------------------
 
   class RemoteIndexPage : public IndexPage {
     int m_platefile_id;
     boost::shared_ptr<IndexClient> m_client;
-
-    // For packetizing write requests.
-    std::queue<IndexWriteUpdate> m_write_queue;
-    void flush_write_queue();
+    boost::shared_ptr<RemoteWriteQueue> m_writes;
 
   public:
 
     RemoteIndexPage(int platefile_id,
                     boost::shared_ptr<IndexClient> client,
+                    boost::shared_ptr<RemoteWriteQueue> writes,
                     uint32 level, uint32 base_col, uint32 base_row,
                     uint32 page_width, uint32 page_height);
 
@@ -72,12 +119,14 @@ namespace detail {
   class RemotePageGenerator : public PageGeneratorBase {
     int m_platefile_id;
     boost::shared_ptr<IndexClient> m_client;
+    boost::shared_ptr<RemoteWriteQueue> m_writes;
     uint32 m_level, m_base_col, m_base_row;
     uint32 m_page_width, m_page_height;
 
   public:
     RemotePageGenerator( int platefile_id,
                          boost::shared_ptr<IndexClient> client,
+                         boost::shared_ptr<RemoteWriteQueue> writes,
                          uint32 level, uint32 base_col, uint32 base_row,
                          uint32 page_width, uint32 page_height );
     virtual ~RemotePageGenerator() {}
@@ -92,10 +141,12 @@ namespace detail {
   class RemotePageGeneratorFactory : public PageGeneratorFactory {
     int m_platefile_id;
     boost::shared_ptr<IndexClient> m_client;
+    boost::shared_ptr<RemoteWriteQueue> m_writes;
 
   public:
-    RemotePageGeneratorFactory(int platefile_id, boost::shared_ptr<IndexClient> client)
-      : m_platefile_id(platefile_id), m_client(client) {}
+    RemotePageGeneratorFactory(int platefile_id, boost::shared_ptr<IndexClient> client,
+                               boost::shared_ptr<RemoteWriteQueue> writes)
+      : m_platefile_id(platefile_id), m_client(client), m_writes(writes) {}
     virtual ~RemotePageGeneratorFactory() {}
 
     virtual boost::shared_ptr<PageGeneratorBase>
@@ -108,6 +159,10 @@ namespace detail {
   //                            REMOTE INDEX
   // -------------------------------------------------------------------
 
+  // A RemoteIndex url takes these query options, besides the channel's:
+  //   cache_size   - index pages to keep per level (default 100)
+  //   write_batch  - index writes per MultiWriteUpdate (default 200)
+  //   write_window - MultiWriteUpdates to keep in flight (default 4)
   class RemoteIndex : public PagedIndex {
     vw::platefile::Url m_url;
     int m_platefile_id;
@@ -117,6 +172,7 @@ namespace detail {
 
     // Remote connection
     boost::shared_ptr<IndexClient> m_client;
+    boost::shared_ptr<RemoteWriteQueue> m_writes;
 
     // Log streamer
     struct LogRequestSink;
@@ -124,6 +180,7 @@ namespace detail {
     boost::shared_ptr<std::ostream> m_logger;
 
     void update_header() const;
+    void init_pages();
 
   public:
     /// Constructor (for opening an existing index)
@@ -135,6 +192,9 @@ namespace detail {
     /// destructor
     virtual ~RemoteIndex();
 
+    /// Send any buffered writes to the index server.
+    virtual void sync();
+
     // Writing, pt. 1: Locks a blob and returns the blob id that can
     // be used to write a tile.
     virtual uint32 write_request();
@@ -0,0 +1,597 @@
+// __BEGIN_LICENSE__
+//  Copyright (c) 2006-2013, United States Government as represented by the
+//  Administrator of the National Aeronautics and Space Administration. All
+//  rights reserved.
+//
+//  The NASA Vision Workbench is licensed under the Apache License,
+//  Version 2.0 (the "License"); you may not use this file except in
+//  compliance with the License. You may obtain a copy of the License at
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+// __END_LICENSE__
+
+
+
+#include <vw/Plate/detail/ShmChannel.h>
+#include <vw/Plate/HTTPUtils.h>
+#include <vw/Plate/FundamentalTypes.h>
+#include <vw/Core/Stopwatch.h>
+#include <vw/Core/Log.h>
+
+#include <boost/algorithm/string/trim.hpp>
+#include <boost/algorithm/string/replace.hpp>
+#include <boost/algorithm/string/classification.hpp>
+#include <google/protobuf/descriptor.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <cerrno>
+#include <cstring>
+#include <climits>
+#include <ctime>
+
+using namespace vw;
+using namespace vw::platefile;
+namespace pb = ::google::protobuf;
+
+namespace vw {
+namespace platefile {
+namespace detail {
+
+  static const uint32 SHM_MAGIC   = 0x76777368; // "vwsh"
+  static const uint32 SHM_VERSION = 2;
+  static const uint32 SHM_SLOTS   = 32;
+  static const uint32 RING_SIZE   = 1u << 18;   // bytes each way, per client
+  static const uint32 MAX_MESSAGE = 1u << 26;   // the largest message either side accepts
+  static const uint32 CACHE_LINE  = 64;
+
+  // Set in a slot's owner when the server gives up on a client. Pids fit
+  // well below it (PID_MAX_LIMIT is 2^22).
+  static const int32  SLOT_DROPPED = 0x40000000;
+
+  // A single-producer, single-consumer byte ring. head and tail count the
+  // bytes ever written and read (mod 2^32), so head - tail is the fill.
+  // Each side sets its *_waiting flag before it sleeps on the other's
+  // counter, so the other side only makes a syscall when it has to.
+  struct ShmRing {
+    volatile uint32 head;
+    volatile uint32 reader_waiting;
+    uint8 pad0[CACHE_LINE - 2*sizeof(uint32)];
+    volatile uint32 tail;
+    volatile uint32 writer_waiting;
+    uint8 pad1[CACHE_LINE - 2*sizeof(uint32)];
+    uint8 data[RING_SIZE];
+  };
+
+  struct ShmSlot {
+    // The client's pid; 0 if the slot is free, -pid while it's being set
+    // up, and pid|SLOT_DROPPED once the server has dropped the client.
+    // Only the client itself, or a client that finds it dead, may free a
+    // dropped slot, so nobody else can share its rings while it lives.
+    volatile int32 owner;
+    uint8 pad[CACHE_LINE - sizeof(int32)];
+    ShmRing request, reply;
+  };
+
+  struct ShmSegment {
+    volatile uint32 magic;
+    uint32 version, slots, ring_size;
+    volatile uint32 doorbell;        // bumped by clients for each request
+    volatile uint32 server_waiting;
+    volatile int32 server_pid;
+    uint8 pad[CACHE_LINE - 7*sizeof(uint32)];
+    ShmSlot slot[SHM_SLOTS];
+  };
+
+}}} // namespace vw::platefile::detail
+
+using detail::ShmRing;
+using detail::ShmSlot;
+using detail::ShmSegment;
+
+namespace {
+
+  // How long to poll before going to sleep in the kernel. A round trip to a
+  // busy server on another core is usually well inside this; on a single
+  // core, polling just keeps the other side from running.
+  int spin_count() {
+    static const int count = ::sysconf(_SC_NPROCESSORS_ONLN) > 1 ? 2000 : 0;
+    return count;
+  }
+
+  class Deadline {
+      uint64 m_stop;
+      bool m_forever;
+    public:
+      // timeout in ms; -1 means never
+      Deadline(int32 timeout)
+        : m_stop(Stopwatch::microtime() + uint64(std::max(timeout, 0)) * 1000), m_forever(timeout < 0) {}
+
+      bool expired() const {
+        return !m_forever && Stopwatch::microtime() >= m_stop;
+      }
+
+      // The time left, or 0 for forever
+      const timespec* left(timespec& ts) const {
+        if (m_forever)
+          return 0;
+        const uint64 now = Stopwatch::microtime();
+        const uint64 us = now < m_stop ? m_stop - now : 0;
+        ts.tv_sec  = time_t(us / 1000000);
+        ts.tv_nsec = long(us % 1000000) * 1000;
+        return &ts;
+      }
+  };
+
+  void futex_wait(volatile uint32* addr, uint32 val, const timespec* ts) {
+    ::syscall(SYS_futex, addr, FUTEX_WAIT, val, ts, 0, 0);
+  }
+
+  void futex_wake(volatile uint32* addr) {
+    ::syscall(SYS_futex, addr, FUTEX_WAKE, INT_MAX, 0, 0, 0);
+  }
+
+  // Wait for *word to change from seen. Returns false on timeout.
+  bool wait_change(volatile uint32* word, uint32 seen, volatile uint32* waiting, const Deadline& deadline) {
+    for (int i = 0, n = spin_count(); i < n; ++i)
+      if (*word != seen)
+        return true;
+
+    while (true) {
+      __sync_fetch_and_or(waiting, 1u);
+      if (*word != seen || deadline.expired()) {
+        *waiting = 0;
+        return *word != seen;
+      }
+      timespec ts;
+      futex_wait(word, seen, deadline.left(ts));
+      *waiting = 0;
+      if (*word != seen)
+        return true;
+    }
+  }
+
+  void notify(volatile uint32* word, volatile uint32* waiting) {
+    __sync_synchronize();
+    if (*waiting)
+      futex_wake(word);
+  }
+
+  bool ring_write(ShmRing& r, const uint8* src, size_t len, const Deadline& deadline) {
+    using detail::RING_SIZE;
+    while (len > 0) {
+      const uint32 tail = r.tail, head = r.head;
+      const uint32 space = RING_SIZE - (head - tail);
+      if (space == 0) {
+        if (!wait_change(&r.tail, tail, &r.writer_waiting, deadline))
+          return false;
+        continue;
+      }
+      __sync_synchronize();
+
+      const uint32 n     = uint32(std::min(size_t(space), len));
+      const uint32 off   = head % RING_SIZE;
+      const uint32 first = std::min(n, RING_SIZE - off);
+      ::memcpy(r.data + off, src, first);
+      ::memcpy(r.data, src + first, n - first);
+
+      __sync_synchronize();
+      r.head = head + n;
+      notify(&r.head, &r.reader_waiting);
+      src += n;
+      len -= n;
+    }
+    return true;
+  }
+
+  bool ring_read(ShmRing& r, uint8* dst, size_t len, const Deadline& deadline) {
+    using detail::RING_SIZE;
+    while (len > 0) {
+      const uint32 head = r.head, tail = r.tail;
+      const uint32 avail = head - tail;
+      if (avail == 0) {
+        if (!wait_change(&r.head, head, &r.reader_waiting, deadline))
+          return false;
+        continue;
+      }
+      __sync_synchronize();
+
+      const uint32 n     = uint32(std::min(size_t(avail), len));
+      const uint32 off   = tail % RING_SIZE;
+      const uint32 first = std::min(n, RING_SIZE - off);
+      ::memcpy(dst, r.data + off, first);
+      ::memcpy(dst + first, r.data, n - first);
+
+      __sync_synchronize();
+      r.tail = tail + n;
+      notify(&r.tail, &r.writer_waiting);
+      dst += n;
+      len -= n;
+    }
+    return true;
+  }
+
+  bool pid_alive(int32 pid) {
+    return ::kill(pid, 0) == 0 || errno != ESRCH;
+  }
+
+  // The pid in a slot's owner field, whatever state the slot is in
+  int32 owner_pid(int32 owner) {
+    return (owner < 0 ? -owner : owner) & ~detail::SLOT_DROPPED;
+  }
+
+  std::string shm_name(const Url& u) {
+    std::string name = u.hostname() + u.path();
+    boost::algorithm::trim_if(name, boost::is_any_of("/"));
+    VW_ASSERT(!name.empty(), ArgumentErr() << "shm urls need a name (shm://name)");
+    boost::algorithm::replace_all(name, "/", ".");
+    return "/vwplate." + name;
+  }
+
+  // True if the segment called name was left behind by a server that has
+  // since died. A segment we can't read, or that has another layout, might
+  // still be in use, so it doesn't count.
+  bool stale_segment(const std::string& name) {
+    const int fd = ::shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0)
+      return false;
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || size_t(st.st_size) < sizeof(ShmSegment)) {
+      ::close(fd);
+      return false;
+    }
+    void* addr = ::mmap(0, sizeof(ShmSegment), PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED)
+      return false;
+    const ShmSegment* seg = static_cast<const ShmSegment*>(addr);
+    const bool stale = seg->magic == detail::SHM_MAGIC && seg->version == detail::SHM_VERSION
+                    && !pid_alive(seg->server_pid);
+    ::munmap(addr, sizeof(ShmSegment));
+    return stale;
+  }
+}
+
+ShmChannel::ShmChannel(const std::string& human_name)
+  : m_human_name(human_name), m_server(false), m_seg(0), m_slot(0), m_slot_owner(0), m_next_slot(0),
+    m_timeout(DEFAULT_TIMEOUT), m_retries(DEFAULT_RETRIES), m_seq(0), m_broken(false) {}
+
+ShmChannel::~ShmChannel() VW_NOTHROW {
+  if (!m_seg)
+    return;
+  if (!m_server && m_slot) {
+    __sync_synchronize();
+    const int32 pid = ::getpid();
+    if (!__sync_bool_compare_and_swap(&m_slot->owner, pid, 0))
+      __sync_bool_compare_and_swap(&m_slot->owner, pid | detail::SLOT_DROPPED, 0);
+  }
+  ::munmap(m_seg, sizeof(ShmSegment));
+  if (m_server)
+    ::shm_unlink(m_shm_name.c_str());
+}
+
+void ShmChannel::open_segment(const Url& u, bool create) {
+  VW_ASSERT(!m_seg, LogicErr() << "Please don't reuse shm channels");
+  m_shm_name = shm_name(u);
+
+  int fd;
+  if (create) {
+    // Only clear out the segment of a server that didn't shut down
+    // cleanly; never take over one that's still being served.
+    fd = ::shm_open(m_shm_name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0 && errno == EEXIST && stale_segment(m_shm_name)) {
+      ::shm_unlink(m_shm_name.c_str());
+      fd = ::shm_open(m_shm_name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    }
+    if (fd < 0 && errno == EEXIST)
+      vw_throw(ShmErr() << "Failed to create " << m_shm_name << ": another server is using it");
+  } else
+    fd = ::shm_open(m_shm_name.c_str(), O_RDWR, 0);
+
+  if (fd < 0)
+    vw_throw(ShmErr() << (create ? "Failed to create " : "No server at ") << m_shm_name << ": " << ::strerror(errno));
+
+  struct stat st;
+  if ((create && ::ftruncate(fd, sizeof(ShmSegment)) != 0) || ::fstat(fd, &st) != 0) {
+    const int err = errno;
+    ::close(fd);
+    vw_throw(ShmErr() << "Failed to size " << m_shm_name << ": " << ::strerror(err));
+  }
+  if (size_t(st.st_size) < sizeof(ShmSegment)) {
+    ::close(fd);
+    vw_throw(ShmErr() << m_shm_name << " is not a plate shm segment (or the server is still starting)");
+  }
+
+  void* addr = ::mmap(0, sizeof(ShmSegment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (addr == MAP_FAILED)
+    vw_throw(ShmErr() << "Failed to map " << m_shm_name << ": " << ::strerror(errno));
+  m_seg = static_cast<ShmSegment*>(addr);
+
+  if (create) {
+    // ftruncate gave us zeroes; the magic goes in last
+    m_seg->version   = detail::SHM_VERSION;
+    m_seg->slots     = detail::SHM_SLOTS;
+    m_seg->ring_size = detail::RING_SIZE;
+    m_seg->server_pid = ::getpid();
+    __sync_synchronize();
+    m_seg->magic     = detail::SHM_MAGIC;
+  } else if (m_seg->magic != detail::SHM_MAGIC || m_seg->version != detail::SHM_VERSION ||
+             m_seg->slots != detail::SHM_SLOTS || m_seg->ring_size != detail::RING_SIZE) {
+    ::munmap(m_seg, sizeof(ShmSegment));
+    m_seg = 0;
+    vw_throw(ShmErr() << m_shm_name << " has an incompatible layout (or the server is still starting)");
+  }
+}
+
+void ShmChannel::bind(const Url& self) {
+  m_server = true;
+  this->open_segment(self, true);
+}
+
+void ShmChannel::conn(const Url& server) {
+  this->open_segment(server, false);
+
+  // Take a free slot, or failing that, one whose owner died
+  const int32 pid = ::getpid();
+  for (int pass = 0; pass < 2 && !m_slot; ++pass) {
+    for (uint32 i = 0; i < detail::SHM_SLOTS; ++i) {
+      ShmSlot& s = m_seg->slot[i];
+      const int32 owner = s.owner;
+      const bool take = pass == 0 ? owner == 0 : (owner != 0 && !pid_alive(owner_pid(owner)));
+      if (!take || !__sync_bool_compare_and_swap(&s.owner, owner, -pid))
+        continue;
+
+      s.request.head = s.request.tail = 0;
+      s.reply.head   = s.reply.tail   = 0;
+      __sync_synchronize();
+      s.owner = pid;
+      m_slot = &s;
+      break;
+    }
+  }
+
+  if (!m_slot) {
+    ::munmap(m_seg, sizeof(ShmSegment));
+    m_seg = 0;
+    vw_throw(ShmErr() << "All " << detail::SHM_SLOTS << " client slots on " << m_shm_name << " are taken");
+  }
+}
+
+void ShmChannel::check_owner() {
+  if (m_slot->owner == ::getpid())
+    return;
+  m_broken = true;
+  vw_throw(ShmErr() << m_human_name << ": " << m_shm_name << " dropped this client; reconnect");
+}
+
+bool ShmChannel::find_request() {
+  for (uint32 n = 0; n < detail::SHM_SLOTS; ++n) {
+    const uint32 i = (m_next_slot + n) % detail::SHM_SLOTS;
+    ShmSlot& s = m_seg->slot[i];
+    const int32 owner = s.owner;
+    if (owner > 0 && !(owner & detail::SLOT_DROPPED) && s.request.head != s.request.tail) {
+      m_slot = &s;
+      m_slot_owner = owner;
+      m_next_slot = i + 1;
+      return true;
+    }
+  }
+  return false;
+}
+
+void ShmChannel::send_bytes(const uint8* message, size_t len) {
+  VW_ASSERT(m_seg, LogicErr() << m_human_name << ": shm channel is not connected");
+  VW_ASSERT(!m_broken, ShmErr() << m_human_name << ": shm channel is broken by an earlier timeout");
+  VW_ASSERT(m_slot, LogicErr() << m_human_name << ": Don't know who to send_bytes to.");
+  VW_ASSERT(len <= detail::MAX_MESSAGE, ArgumentErr() << m_human_name << ": message of " << len
+            << " bytes is over the shm limit of " << detail::MAX_MESSAGE);
+
+  const uint32 size = boost::numeric_cast<uint32>(len);
+  Deadline deadline(m_timeout);
+
+  if (m_server) {
+    // A client that's gone away can't stop the server
+    if (m_slot->owner != m_slot_owner)
+      return;
+    if (!ring_write(m_slot->reply, reinterpret_cast<const uint8*>(&size), sizeof(size), deadline) ||
+        !ring_write(m_slot->reply, message, len, deadline)) {
+      vw_out(WarningMessage, "plate.shm") << m_human_name << ": client " << m_slot_owner
+                                          << " stopped reading; dropping it" << std::endl;
+      __sync_bool_compare_and_swap(&m_slot->owner, m_slot_owner, m_slot_owner | detail::SLOT_DROPPED);
+    }
+    return;
+  }
+
+  this->check_owner();
+
+  // Ring the doorbell as soon as the header is in, so the server can start
+  // reading a message that's bigger than the ring.
+  bool ok = ring_write(m_slot->request, reinterpret_cast<const uint8*>(&size), sizeof(size), deadline);
+  if (ok) {
+    __sync_fetch_and_add(&m_seg->doorbell, 1u);
+    notify(&m_seg->doorbell, &m_seg->server_waiting);
+    ok = ring_write(m_slot->request, message, len, deadline);
+  }
+  if (!ok) {
+    m_broken = true;
+    vw_throw(ShmErr() << m_human_name << ": timed out sending to " << m_shm_name);
+  }
+}
+
+bool ShmChannel::recv_bytes(std::vector<uint8>* bytes) {
+  VW_ASSERT(m_seg, LogicErr() << m_human_name << ": shm channel is not connected");
+  VW_ASSERT(!m_broken, ShmErr() << m_human_name << ": shm channel is broken by an earlier timeout");
+
+  if (!m_server)
+    this->check_owner();
+
+  Deadline deadline(m_timeout);
+  ShmRing* ring;
+
+  if (m_server) {
+    while (true) {
+      const uint32 bell = m_seg->doorbell;
+      if (this->find_request())
+        break;
+      if (!wait_change(&m_seg->doorbell, bell, &m_seg->server_waiting, deadline))
+        return false;
+    }
+    ring = &m_slot->request;
+  } else {
+    ring = &m_slot->reply;
+    const uint32 head = ring->head;
+    if (head == ring->tail && !wait_change(&ring->head, head, &ring->reader_waiting, deadline))
+      return false;
+  }
+
+  // Something has arrived, so the rest of the message is on its way. The
+  // size comes from the other side, so don't believe a huge one.
+  uint32 size;
+  bool ok = ring_read(*ring, reinterpret_cast<uint8*>(&size), sizeof(size), deadline);
+  if (ok && size > detail::MAX_MESSAGE) {
+    if (m_server) {
+      vw_out(WarningMessage, "plate.shm") << m_human_name << ": client " << m_slot_owner
+                                          << " sent a " << size << " byte message; dropping it" << std::endl;
+      __sync_bool_compare_and_swap(&m_slot->owner, m_slot_owner, m_slot_owner | detail::SLOT_DROPPED);
+      return false;
+    }
+    m_broken = true;
+    vw_throw(ShmErr() << m_human_name << ": " << m_shm_name << " sent a " << size << " byte reply");
+  }
+  if (ok) {
+    bytes->resize(size);
+    ok = ring_read(*ring, size ? &(*bytes)[0] : 0, size, deadline);
+  }
+  if (ok)
+    return true;
+
+  if (m_server) {
+    // The client died halfway through a message. Its stream can't be
+    // trusted any more, so drop it.
+    vw_out(WarningMessage, "plate.shm") << m_human_name << ": client " << m_slot_owner
+                                        << " stopped halfway through a message; dropping it" << std::endl;
+    __sync_bool_compare_and_swap(&m_slot->owner, m_slot_owner, m_slot_owner | detail::SLOT_DROPPED);
+    return false;
+  }
+  m_broken = true;
+  vw_throw(ShmErr() << m_human_name << ": timed out halfway through a reply from " << m_shm_name);
+}
+
+void ShmChannel::CallMethod(const pb::MethodDescriptor* method,
+                            pb::RpcController* /*controller*/,
+                            const pb::Message* request,
+                            pb::Message* response,
+                            pb::Closure* done)
+{
+  detail::RequireCall call(done);
+  RpcWrapper q_wrap, a_wrap;
+
+  q_wrap.set_method(method->name());
+  q_wrap.set_payload(request->SerializeAsString());
+  q_wrap.set_requestor(this->name());
+
+  for (uint32 trial = 0; trial <= m_retries; ++trial) {
+    if (trial > 0)
+      vw_out(WarningMessage) << "Retry (" << trial << "/" << m_retries << ")" << std::endl;
+    q_wrap.set_seq(++m_seq);
+
+    send_message(q_wrap);
+
+    while (true) {
+      const int32 got = recv_message(a_wrap);
+      if (got == 0) {
+        vw_out(WarningMessage) << "CallMethod Timeout. ";
+        break;
+      }
+      if (got == -1) {
+        vw_out(WarningMessage) << "CallMethod(): corrupted message. ";
+        break;
+      }
+      // A reply to a try we already gave up on; skip it
+      if (a_wrap.seq() < q_wrap.seq())
+        continue;
+      if (a_wrap.seq() != q_wrap.seq()) {
+        vw_out(WarningMessage) << "Sequence mismatch on \"" << this->name() << "\" (expected " << q_wrap.seq() << ", got " << a_wrap.seq() << ") ";
+        break;
+      }
+      throw_rpc_error(a_wrap.error());
+      response->ParseFromString(a_wrap.payload());
+      return;
+    }
+  }
+  vw_out(WarningMessage) << "No more retries." << std::endl;
+  vw_throw(RpcErr() << "CallMethod timed out completely");
+}
+
+void ShmChannel::send_request(const pb::MethodDescriptor* method, const pb::Message* request) {
+  RpcWrapper q_wrap;
+  q_wrap.set_method(method->name());
+  q_wrap.set_payload(request->SerializeAsString());
+  q_wrap.set_requestor(this->name());
+  q_wrap.set_seq(++m_seq);
+
+  send_message(q_wrap);
+  m_pipeline.push_back(m_seq);
+}
+
+void ShmChannel::recv_reply(pb::Message* response) {
+  VW_ASSERT(!m_pipeline.empty(), LogicErr() << "recv_reply() called with no request in flight");
+  const uint32 seq = m_pipeline.front();
+  m_pipeline.pop_front();
+
+  RpcWrapper a_wrap;
+  while (true) {
+    switch (recv_message(a_wrap)) {
+      case 0:
+        vw_throw(NetworkErr() << "Timeout waiting for pipelined reply " << seq << " on \"" << this->name() << "\"");
+      case -1:
+        vw_throw(RpcErr() << "Corrupted pipelined reply on \"" << this->name() << "\"");
+      default: {
+        const uint32 got = a_wrap.seq();
+        if (got < seq)
+          continue;
+        if (got != seq)
+          vw_throw(RpcErr() << "Lost pipelined reply on \"" << this->name() << "\" (expected " << seq << ", got " << got << ")");
+        throw_rpc_error(a_wrap.error());
+        if (response)
+          response->ParseFromString(a_wrap.payload());
+        return;
+      }
+    }
+  }
+}
+
+size_t ShmChannel::in_flight() const {
+  return m_pipeline.size();
+}
+
+int32 ShmChannel::timeout() const {
+  return m_timeout;
+}
+
+void ShmChannel::set_timeout(int32 x) {
+  m_timeout = x;
+}
+
+uint32 ShmChannel::retries() const {
+  return m_retries;
+}
+
+void ShmChannel::set_retries(uint32 x) {
+  m_retries = x;
+}
+
+std::string ShmChannel::name() const {
+  return m_human_name;
+}
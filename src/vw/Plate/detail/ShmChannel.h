@@ -0,0 +1,102 @@
+// __BEGIN_LICENSE__
+//  Copyright (c) 2006-2013, United States Government as represented by the
+//  Administrator of the National Aeronautics and Space Administration. All
+//  rights reserved.
+//
+//  The NASA Vision Workbench is licensed under the Apache License,
+//  Version 2.0 (the "License"); you may not use this file except in
+//  compliance with the License. You may obtain a copy of the License at
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+// __END_LICENSE__
+
+
+
+#ifndef __VW_PLATE_SHMCHANNEL_H__
+#define __VW_PLATE_SHMCHANNEL_H__
+
+#include <vw/Plate/RpcChannel.h>
+#include <vw/Plate/Exception.h>
+#include <boost/noncopyable.hpp>
+
+namespace vw {
+namespace platefile {
+
+  // To recover from this, you must reconnect
+  VW_DEFINE_EXCEPTION(ShmErr, NetworkErr);
+
+  namespace detail {
+    struct ShmSegment;
+    struct ShmSlot;
+  }
+
+  // A channel between processes on the same host, over a POSIX shared
+  // memory segment. The server's segment holds a fixed number of client
+  // slots; each slot is a pair of byte rings (requests and replies) that
+  // carry the same RpcWrapper messages the other channels do. Waiting is
+  // a short spin, then a futex on the ring. Only the server's user may
+  // open the segment, and only one server may bind a name at a time.
+  class ShmChannel : public IChannel,
+                     private boost::noncopyable
+  {
+      std::string m_human_name;
+      std::string m_shm_name;
+      bool m_server;
+      detail::ShmSegment* m_seg;
+      detail::ShmSlot* m_slot;      // ours (client) or the last sender's (server)
+      int32 m_slot_owner;           // the last sender's pid (server)
+      uint32 m_next_slot;           // where the server's scan starts next
+      int32 m_timeout;
+      uint32 m_retries;
+      uint32 m_seq;
+      std::deque<uint32> m_pipeline;
+      bool m_broken;
+
+      void open_segment(const Url& u, bool create);
+      bool find_request();
+      void check_owner();
+
+    protected:
+      void send_bytes(const uint8* message, size_t len);
+      bool recv_bytes(std::vector<uint8>* bytes);
+
+    public:
+      ShmChannel(const std::string& human_name);
+      virtual ~ShmChannel() VW_NOTHROW;
+
+      int32  timeout() const;
+      uint32 retries() const;
+
+      void set_timeout(vw::int32);
+      void set_retries(vw::uint32);
+
+      std::string name() const;
+
+      virtual void CallMethod(const google::protobuf::MethodDescriptor*,
+                              google::protobuf::RpcController*,
+                              const google::protobuf::Message*,
+                              google::protobuf::Message*,
+                              google::protobuf::Closure*);
+
+      // Each client has its own rings and the server answers them in
+      // order, so requests can be pipelined.
+      virtual void send_request(const google::protobuf::MethodDescriptor* method,
+                                const google::protobuf::Message* request);
+      virtual void recv_reply(google::protobuf::Message* response);
+      virtual size_t in_flight() const;
+      virtual bool pipelined() const { return true; }
+
+      // url format:
+      // shm://name[/more/name] -> the POSIX shm object /vwplate.name.more.name
+      void conn(const Url& server);
+      void bind(const Url& self);
+  };
+
+}} // namespace vw::platefile
+
+#endif
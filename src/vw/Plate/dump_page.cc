@@ -68,17 +68,16 @@ void run(const Options& opt) {
   std::cout << "Loaded page at col=" << opt.col << " row=" << opt.row << " level=" << opt.level << std::endl
             << "Page contains " << page->sparse_size() << " entries." << std::endl;
 
-    //typedef std::pair<uint32, IndexRecord> value_type;
-    //typedef std::list<value_type> multi_value_type;
-    //typedef google::sparsetable<multi_value_type>::nonempty_iterator nonempty_iterator;
-
-  BOOST_FOREACH(const detail::IndexPage::multi_value_type& slot, std::make_pair(page->begin(), page->end())) {
-    std::cout << "Loaded page slot with " << slot.size() << " entries" << std::endl;
-    BOOST_FOREACH(const detail::IndexPage::value_type& elt, slot) {
-      std::cout << "TID=" << elt.first << " BLOB=" << elt.second.blob_id() << " OFFSET=" << elt.second.blob_offset() << std::endl;
-      if (opt.verify)
-        dump_tile(opt.plate, elt.second.blob_id(), elt.second.blob_offset());
-    }
+  // Walk every entry on the page. The headers come back grouped by slot,
+  // newest first.
+  const int32 level_size = 1 << opt.level;
+  std::list<TileHeader> hdrs = page->search_by_region(BBox2i(0, 0, level_size, level_size), 0, -1);
+  BOOST_FOREACH(const TileHeader& hdr, hdrs) {
+    detail::IndexRecord rec = page->get(hdr.col(), hdr.row(), hdr.transaction_id(), true);
+    std::cout << "COL=" << hdr.col() << " ROW=" << hdr.row()
+              << " TID=" << hdr.transaction_id() << " BLOB=" << rec.blob_id() << " OFFSET=" << rec.blob_offset() << std::endl;
+    if (opt.verify)
+      dump_tile(opt.plate, rec.blob_id(), rec.blob_offset());
   }
 }
 
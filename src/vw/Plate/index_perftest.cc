@@ -19,11 +19,23 @@
 #include <vw/Plate/Rpc.h>
 #include <vw/Plate/IndexService.h>
 #include <vw/Plate/HTTPUtils.h>
+#include <vw/Plate/detail/IndexPage.h>
+#include <vw/Plate/google/sparsetable>
+#include <vw/Image/PixelTypeInfo.h>
 #include <vw/Core/Stopwatch.h>
 #include  <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <algorithm>
 
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include <boost/foreach.hpp>
 #include <boost/scoped_ptr.hpp>
+#include <boost/lexical_cast.hpp>
 #include <boost/program_options.hpp>
+#include <boost/filesystem/operations.hpp>
 namespace po = boost::program_options;
 
 using namespace vw;
@@ -38,12 +50,357 @@ IndexClient* conn(const Url& url) {
   return new IndexClient(url);
 }
 
+// ----------------------------------------------------------------------
+//                       INDEX PAGE LAYOUT BENCHMARK
+// ----------------------------------------------------------------------
+
+// An in-memory page; nothing is ever written to disk.
+class BenchPage : public detail::IndexPage {
+  public:
+    BenchPage(uint32 page_size) : detail::IndexPage(0, 0, 0, page_size, page_size) {}
+    virtual void sync() {}
+};
+
+// The layout IndexPage used before the dense format: a sparsetable of
+// lists of (transaction, IndexRecord) protobufs, newest first.
+struct LegacyPage {
+  typedef detail::IndexPage::multi_value_type multi_value_type;
+  google::sparsetable<multi_value_type> table;
+  uint32 page_size;
+
+  LegacyPage(uint32 size) : table(size*size), page_size(size) {}
+
+  void set(uint32 col, uint32 row, uint32 tid, detail::IndexRecord const& rec) {
+    size_t slot = row*page_size + col;
+    if (!table.test(slot))
+      table.set(slot, multi_value_type());
+    multi_value_type *entries = table[slot].operator&();
+    multi_value_type::iterator it = entries->begin();
+    while (it != entries->end() && it->first > tid)
+      ++it;
+    entries->insert(it, std::make_pair(tid, rec));
+  }
+
+  const detail::IndexRecord* get(uint32 col, uint32 row, uint32 tid) const {
+    size_t slot = row*page_size + col;
+    if (!table.test(slot))
+      return 0;
+    const multi_value_type& entries = table[slot];
+    for (multi_value_type::const_iterator it = entries.begin(); it != entries.end(); ++it)
+      if (it->first <= tid)
+        return &it->second;
+    return 0;
+  }
+
+  size_t memory_usage() const {
+    // Node overhead is a guess: two list pointers per entry.
+    size_t bytes = sizeof(*this) + table.size() / 8 + table.num_nonempty() * sizeof(multi_value_type);
+    for (google::sparsetable<multi_value_type>::const_nonempty_iterator it = table.nonempty_begin();
+         it != table.nonempty_end(); ++it)
+      BOOST_FOREACH(const detail::IndexPage::value_type& v, *it)
+        bytes += 2*sizeof(void*) + sizeof(uint32) + v.second.SpaceUsed();
+    return bytes;
+  }
+};
+
+void page_bench(uint32 page_size, uint32 tiles, uint32 transactions, uint32 lookups) {
+  BenchPage page(page_size);
+  LegacyPage legacy(page_size);
+
+  std::vector<std::pair<uint32, uint32> > locs;
+  locs.reserve(tiles);
+  for (uint32 i = 0; i < tiles; ++i)
+    locs.push_back(std::make_pair(std::rand() % page_size, std::rand() % page_size));
+
+  TileHeader hdr;
+  hdr.set_level(0);
+  hdr.set_filetype("png");
+  detail::IndexRecord rec;
+  rec.set_filetype("png");
+  for (uint32 t = 1; t <= transactions; ++t) {
+    for (uint32 i = 0; i < tiles; ++i) {
+      hdr.set_col(locs[i].first);
+      hdr.set_row(locs[i].second);
+      hdr.set_transaction_id(t);
+      rec.set_blob_id(i % 64);
+      rec.set_blob_offset(uint64(t) * tiles + i);
+      page.set(hdr, rec);
+      legacy.set(locs[i].first, locs[i].second, t, rec);
+    }
+  }
+
+  std::vector<uint32> probe(lookups), probe_tid(lookups);
+  for (uint32 i = 0; i < lookups; ++i) {
+    probe[i] = std::rand() % tiles;
+    probe_tid[i] = 1 + std::rand() % transactions;
+  }
+
+  uint64 sum = 0, t0, t1;
+
+  t0 = Stopwatch::microtime();
+  for (uint32 i = 0; i < lookups; ++i)
+    sum += page.get(locs[probe[i]].first, locs[probe[i]].second, probe_tid[i]).blob_offset();
+  t1 = Stopwatch::microtime();
+  double dense_get = double(t1-t0) * 1000. / lookups;
+
+  t0 = Stopwatch::microtime();
+  for (uint32 i = 0; i < lookups; ++i)
+    sum -= legacy.get(locs[probe[i]].first, locs[probe[i]].second, probe_tid[i])->blob_offset();
+  t1 = Stopwatch::microtime();
+  double legacy_get = double(t1-t0) * 1000. / lookups;
+
+  if (sum != 0)
+    std::cerr << "Error: layouts disagree on lookup results!\n";
+
+  size_t hits = 0;
+  t0 = Stopwatch::microtime();
+  for (uint32 i = 0; i < lookups; ++i)
+    hits += page.search_by_location(locs[probe[i]].first, locs[probe[i]].second, 0, probe_tid[i]).size();
+  t1 = Stopwatch::microtime();
+  double dense_search = double(t1-t0) * 1000. / lookups;
+
+  std::cout << "Page " << page_size << "x" << page_size << ", " << page.sparse_size() << " tiles, "
+            << transactions << " transactions each\n"
+            << "  dense:  get " << dense_get << " ns, search_by_location " << dense_search << " ns, "
+            << page.memory_usage() << " bytes\n"
+            << "  legacy: get " << legacy_get << " ns, "
+            << legacy.memory_usage() << " bytes (estimated)" << std::endl;
+}
+
+// ----------------------------------------------------------------------
+//                        INDEX SERVER RPC BENCHMARK
+// ----------------------------------------------------------------------
+
+std::vector<uint32> parse_list(const std::string& s) {
+  std::vector<uint32> v;
+  std::istringstream in(s);
+  std::string item;
+  while (std::getline(in, item, ','))
+    v.push_back(boost::lexical_cast<uint32>(item));
+  return v;
+}
+
+// Open (or create) a scratch platefile on the server to read and write.
+int32 open_bench_plate(IndexClient& client, const std::string& name) {
+  IndexCreateRequest request;
+  request.set_plate_name(name);
+  IndexHeader* hdr = request.mutable_index_header();
+  hdr->set_type("toast");
+  hdr->set_description("index_perftest scratch platefile");
+  hdr->set_tile_size(256);
+  hdr->set_tile_filetype("png");
+  hdr->set_pixel_format(VW_PIXEL_RGBA);
+  hdr->set_channel_type(VW_CHANNEL_UINT8);
+
+  IndexOpenReply response;
+  client.CreateRequest(&client, &request, &response, null_callback());
+  return response.index_header().platefile_id();
+}
+
+TileHeader bench_tile(uint32 i) {
+  static const uint32 BENCH_LEVEL = 12;
+  TileHeader hdr;
+  hdr.set_col(i % (1u << BENCH_LEVEL));
+  hdr.set_row(i >> BENCH_LEVEL);
+  hdr.set_level(BENCH_LEVEL);
+  hdr.set_transaction_id(1);
+  hdr.set_filetype("png");
+  return hdr;
+}
+
+// Returns how many tiles the oldest read in flight found
+size_t recv_reads(IndexClient& client, uint32 batch) {
+  if (batch == 1) {
+    IndexReadReply reply;
+    client.recv_reply(&reply);
+    return 1;
+  }
+  IndexMultiReadReply reply;
+  client.recv_reply(&reply);
+  size_t found = 0;
+  for (int i = 0; i < reply.results_size(); ++i)
+    found += reply.results(i).has_index_record();
+  return found;
+}
+
+// Write and then read back ops tiles, batch tiles per call, with up to
+// window calls in flight. A batch of 1 uses the single-tile calls.
+void rpc_bench(IndexClient& client, int32 platefile_id, uint32 ops, uint32 batch, uint32 window) {
+  uint64 t0 = Stopwatch::microtime();
+  for (uint32 i = 0; i < ops; i += batch) {
+    IndexMultiWriteUpdate multi;
+    for (uint32 j = i; j < std::min(i + batch, ops); ++j) {
+      IndexWriteUpdate* update = multi.add_write_updates();
+      update->set_platefile_id(platefile_id);
+      *update->mutable_header() = bench_tile(j);
+      update->mutable_record()->set_blob_id(0);
+      update->mutable_record()->set_blob_offset(j);
+      update->mutable_record()->set_filetype("png");
+    }
+    while (client.in_flight() >= window)
+      client.recv_reply(0);
+    if (batch == 1)
+      client.send_request("WriteUpdate", &multi.write_updates(0));
+    else
+      client.send_request("MultiWriteUpdate", &multi);
+  }
+  client.drain();
+  uint64 t1 = Stopwatch::microtime();
+
+  size_t found = 0;
+  for (uint32 i = 0; i < ops; i += batch) {
+    IndexMultiReadRequest multi;
+    for (uint32 j = i; j < std::min(i + batch, ops); ++j) {
+      TileHeader hdr = bench_tile(j);
+      IndexReadRequest* read = multi.add_reads();
+      read->set_platefile_id(platefile_id);
+      read->set_col(hdr.col());
+      read->set_row(hdr.row());
+      read->set_level(hdr.level());
+      read->set_transaction_id(-1);
+      read->set_exact_transaction_match(false);
+    }
+    while (client.in_flight() >= window)
+      found += recv_reads(client, batch);
+    if (batch == 1)
+      client.send_request("ReadRequest", &multi.reads(0));
+    else
+      client.send_request("MultiReadRequest", &multi);
+  }
+  while (client.in_flight() > 0)
+    found += recv_reads(client, batch);
+  uint64 t2 = Stopwatch::microtime();
+
+  if (found != ops)
+    std::cerr << "Error: wrote " << ops << " tiles but read back " << found << std::endl;
+
+  std::cout << "  batch " << std::setw(5) << batch << "  window " << std::setw(3) << window << ":  "
+            << std::setw(10) << uint64(1e6 * ops / double(t1 - t0)) << " writes/s  "
+            << std::setw(10) << uint64(1e6 * ops / double(t2 - t1)) << " reads/s" << std::endl;
+}
+
+// ----------------------------------------------------------------------
+//                        CHANNEL TRANSPORT BENCHMARK
+// ----------------------------------------------------------------------
+
+// Fork an index server on url with an empty root. It runs until the
+// returned pipe is closed.
+pid_t fork_server(const Url& url, const std::string& root, int* pipe_out) {
+  int fds[2];
+  if (::pipe(fds) != 0)
+    vw_throw(IOErr() << "pipe() failed");
+
+  pid_t pid = ::fork();
+  if (pid < 0)
+    vw_throw(IOErr() << "fork() failed");
+  if (pid > 0) {
+    ::close(fds[0]);
+    *pipe_out = fds[1];
+    return pid;
+  }
+
+  ::close(fds[1]);
+  int status = 1;
+  try {
+    RpcServer<IndexServiceImpl> server(url, new IndexServiceImpl(root));
+    char c;
+    while (::read(fds[0], &c, 1) > 0) {}
+    status = 0;
+  } catch (const std::exception& e) {
+    std::cerr << "Server on " << url.string() << " failed: " << e.what() << std::endl;
+  }
+  ::_exit(status);
+}
+
+IndexClient* conn_retry(const Url& url) {
+  for (int tries = 50; ; --tries) {
+    try {
+      return new IndexClient(url);
+    } catch (const vw::Exception&) {
+      if (tries == 0)
+        throw;
+      Thread::sleep_ms(100);
+    }
+  }
+}
+
+// Round-trip latency and pipelined throughput of TestRequest over one
+// transport. The messages are tiny, so this measures the channel itself.
+void channel_bench(const Url& url, uint32 ops, const std::vector<uint32>& windows) {
+  char root[] = "/tmp/index_perftest.XXXXXX";
+  if (!::mkdtemp(root))
+    vw_throw(IOErr() << "mkdtemp() failed");
+
+  int pipe_fd;
+  pid_t pid = fork_server(url, root, &pipe_fd);
+
+  try {
+    boost::scoped_ptr<IndexClient> client(conn_retry(url));
+    IndexTestRequest request;
+    IndexTestReply response;
+
+    // Warm up, and make sure the server is really there
+    for (uint32 i = 0; i < 1000; ++i) {
+      request.set_value(i);
+      client->TestRequest(client.get(), &request, &response, null_callback());
+    }
+
+    std::vector<uint64> latency(ops);
+    for (uint32 i = 0; i < ops; ++i) {
+      request.set_value(i);
+      uint64 t0 = Stopwatch::microtime();
+      client->TestRequest(client.get(), &request, &response, null_callback());
+      latency[i] = Stopwatch::microtime() - t0;
+    }
+    std::sort(latency.begin(), latency.end());
+
+    std::cout << url.string() << ":\n"
+              << "  round trip:  p50 " << latency[ops / 2] << " us  p99 " << latency[ops * 99 / 100]
+              << " us  max " << latency.back() << " us" << std::endl;
+
+    BOOST_FOREACH(uint32 window, windows) {
+      window = std::max(window, 1u);
+      uint64 t0 = Stopwatch::microtime();
+      for (uint32 i = 0; i < ops; ++i) {
+        while (client->in_flight() >= window)
+          client->recv_reply(0);
+        request.set_value(i);
+        client->send_request("TestRequest", &request);
+      }
+      client->drain();
+      uint64 t1 = Stopwatch::microtime();
+      std::cout << "  window " << std::setw(3) << window << ":  "
+                << std::setw(10) << uint64(1e6 * ops / double(t1 - t0)) << " msg/s" << std::endl;
+    }
+  } catch (const vw::Exception& e) {
+    std::cerr << "Error on " << url.string() << ": " << e.what() << std::endl;
+  }
+
+  ::close(pipe_fd);
+  ::waitpid(pid, 0, 0);
+  boost::filesystem::remove_all(root);
+}
+
 int main(int argc, char** argv) {
   Url url;
+  uint32 page_size, tiles, transactions, lookups, ops;
+  std::string batches, windows, plate, urls;
 
   po::options_description general_options("AMQP Performance Test Program");
   general_options.add_options()
     ("url,u", po::value(&url), "Run requests against this index url.")
+    ("page-bench", "Compare the in-memory index page layouts instead of testing a server.")
+    ("page-size", po::value(&page_size)->default_value(256), "Page width and height for --page-bench.")
+    ("tiles", po::value(&tiles)->default_value(20000), "Tile locations to fill for --page-bench.")
+    ("transactions", po::value(&transactions)->default_value(8), "Transactions per tile for --page-bench.")
+    ("lookups", po::value(&lookups)->default_value(1000000), "Lookups to time for --page-bench.")
+    ("rpc-bench", "Time index reads and writes against the server at --url, instead of test messages.")
+    ("plate", po::value(&plate)->default_value("index_perftest.plate"), "Scratch platefile for --rpc-bench (created if missing).")
+    ("ops", po::value(&ops)->default_value(50000), "Reads and writes to time per setting for --rpc-bench.")
+    ("batch-sizes", po::value(&batches)->default_value("1,10,100,1000"), "Tiles per call for --rpc-bench.")
+    ("windows", po::value(&windows)->default_value("1,4,16"), "Calls in flight for --rpc-bench and --channel-bench.")
+    ("channel-bench", "Compare the transports in --urls, each against its own forked index server.")
+    ("urls", po::value(&urls)->default_value("shm://index_perftest,zmq+ipc:///tmp/index_perftest.sock"), "Comma-separated server urls for --channel-bench.")
     ("help,h", "Display this help message");
 
   po::variables_map vm;
@@ -59,8 +416,31 @@ int main(int argc, char** argv) {
     return 1;
   }
 
+  if (vm.count("page-bench")) {
+    page_bench(page_size, tiles, transactions, lookups);
+    return 0;
+  }
+
+  if (vm.count("channel-bench")) {
+    std::istringstream in(urls);
+    std::string u;
+    while (std::getline(in, u, ','))
+      channel_bench(Url(u), ops, parse_list(windows));
+    return 0;
+  }
+
   boost::scoped_ptr<IndexClient> client(conn(url));
 
+  if (vm.count("rpc-bench")) {
+    int32 platefile_id = open_bench_plate(*client, plate);
+    if (!client->pipelined())
+      std::cout << "Note: this channel can't pipeline; windows > 1 won't help." << std::endl;
+    BOOST_FOREACH(uint32 window, parse_list(windows))
+      BOOST_FOREACH(uint32 batch, parse_list(batches))
+        rpc_bench(*client, platefile_id, ops, std::max(batch, 1u), std::max(window, 1u));
+    return 0;
+  }
+
   uint64 t0, t1;
 
   while (1) {
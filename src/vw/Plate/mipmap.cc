@@ -120,6 +120,7 @@ int main( int argc, char *argv[] ) {
   Url plate_url;
   std::string mode, region_string, level_string;
   TransactionOrNeg transaction_id;
+  uint32 threads;
   bool help;
 
   po::options_description general_options("\nUtility for mipmapping a transaction ID that exists only on one level");
@@ -128,6 +129,7 @@ int main( int argc, char *argv[] ) {
     ("region", po::value(&region_string), "where arg = <ul_x>,<ul_y>:<lr_x>,<lr_y>. Optional.")
     ("transaction-id,t", po::value(&transaction_id), "transaction ID to request and to write.")
     ("mode,m", po::value(&mode), "Output mode [toast, equi, polar]")
+    ("threads", po::value(&threads)->default_value(0), "Number of threads to build and encode tiles with (0 for the default).")
     ("help,h", po::bool_switch(&help), "Display this help message.");
 
   po::options_description hidden_options("");
@@ -160,6 +162,9 @@ int main( int argc, char *argv[] ) {
     return 1;
   }
 
+  if ( threads > 0 )
+    vw_settings().set_default_num_threads( threads );
+
   try {
     MipmapParameters mipmap_params(mode, region_string, level_string, transaction_id);
 
@@ -154,6 +154,12 @@ const char* is_gt_zero(int arg) {
   return NULL;
 }
 
+const char* is_ge_zero(int arg) {
+  if (arg < 0)
+    return "Expected a number greater than or equal to zero";
+  return NULL;
+}
+
 const char* noop(const char* arg) {
   (void)arg;
   return NULL;
@@ -165,6 +171,7 @@ ADD_INT_CONFIG(index_timeout, is_gt_zero);
 ADD_INT_CONFIG(index_tries, is_gt_zero);
 ADD_FLAG_CONFIG(unknown_resync);
 ADD_FLAG_CONFIG(use_blob_cache);
+ADD_INT_CONFIG(tile_cache_size, is_ge_zero);
 ADD_STRING_CONFIG(index_url, noop);
 
 static const command_rec my_cmds[] = {
@@ -177,6 +184,7 @@ static const command_rec my_cmds[] = {
   AP_INIT_TAKE2("PlateAlias",         handle_alias,          NULL, RSRC_CONF, "Name-to-platefile_id mappings"),
   AP_INIT_FLAG("PlateUnknownResync",  handle_unknown_resync, NULL, RSRC_CONF, "Should we resync the platefile list when someone asks for an unknown one?"),
   AP_INIT_FLAG("PlateBlobCache",      handle_use_blob_cache, NULL, RSRC_CONF, "Should the blob cache be used?"),
+  AP_INIT_TAKE1("PlateTileCache",     handle_tile_cache_size, NULL, RSRC_CONF, "How many tile locations to cache per child (0 to disable)"),
   { NULL }
 };
 
@@ -194,6 +202,7 @@ static void* create_plate_config(apr_pool_t* p, server_rec* s) {
   conf->alias = apr_table_make(p, 4);
   conf->unknown_resync = 1;
   conf->use_blob_cache = 1;
+  conf->tile_cache_size = 20000;
   return conf;
   // This is the default config file
 #if 0
@@ -203,6 +212,7 @@ static void* create_plate_config(apr_pool_t* p, server_rec* s) {
   PlateIndexTries 3
   PlateUnknownResync on
   PlateBlobCache on
+  PlateTileCache 20000
 #endif
 
 // these keys not set by default, but here are examples of possible valid ones
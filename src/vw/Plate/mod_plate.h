@@ -48,6 +48,7 @@ typedef struct {
   int index_tries;
   int unknown_resync;
   int use_blob_cache;
+  int tile_cache_size;       // max entries in the tile location cache; 0 disables it
   apr_array_header_t *rules; // This holds rule_entries
   apr_table_t *alias;        // key is name, value is id, an int stored as a const char*
 } plate_config;
@@ -18,14 +18,14 @@
 
 #include "mod_plate_core.h"
 #include "mod_plate_utils.h"
-#include "mod_plate_handlers.h"
 
-#include <httpd.h>
 #include <apr_tables.h>
 #include <vw/Core/Settings.h>
+#include <vw/Core/Stopwatch.h>
 #include <vw/Plate/detail/Index.h>
 #include <vw/Plate/Blob.h>
 #include <vw/Plate/Rpc.h>
+#include <vw/Plate/Exception.h>
 #include <vw/Plate/IndexService.pb.h>
 
 #include <boost/lexical_cast.hpp>
@@ -117,6 +117,10 @@ const Url& PlateModule::get_base_url() const {
 
 namespace {
   boost::shared_ptr<PlateModule> mod_plate_ptr;
+
+  // How long (in us) a platefile's read cursor is trusted before a request
+  // for the latest tile asks the index again
+  const vw::uint64 READ_CURSOR_TTL = 1000000;
 }
 
 const PlateModule& mod_plate() {
@@ -134,7 +138,7 @@ void mod_plate_init(const plate_config *conf) {
 }
 
 PlateModule::PlateModule(const plate_config* conf)
-  : m_connected(false), m_conf(conf), m_base_url(conf->index_url)
+  : tile_cache(conf->tile_cache_size), m_connected(false), m_conf(conf), m_base_url(conf->index_url)
 {
 
   // Disable the config file
@@ -173,33 +177,6 @@ void PlateModule::connect_index() {
   mod_plate().sync_index_cache();
 }
 
-int PlateModule::operator()(const ApacheRequest& r) const {
-
-  if (r.url.empty())
-    return DECLINED;
-
-  static const Handler Handlers[] = {handle_image, handle_wtml};
-
-  BOOST_FOREACH(const Handler h, Handlers) {
-    int ret = h(r);
-    if (ret != DECLINED)
-      return ret;
-  }
-  return DECLINED;
-}
-
-int PlateModule::status(const ApacheRequest& r, int /*flags*/) const {
-  apache_stream out(r.writer());
-
-  out << "IndexCache:<br>" << std::endl;
-  BOOST_FOREACH(const IndexCache::value_type& c, get_index_cache())
-    out << c.second.shortname << ": " << c.first << "<br>";
-
-  out << "BlobCacheSize: " << get_blob_cache().size() << "<br>";
-
-  return OK;
-}
-
 const boost::shared_ptr<ReadBlob> PlateModule::get_blob(int platefile_id, const string& plate_filename, uint32 blob_id) const {
   std::ostringstream ostr;
   ostr << plate_filename << "/plate_" << blob_id << ".blob";
@@ -223,6 +200,92 @@ const boost::shared_ptr<ReadBlob> PlateModule::get_blob(int platefile_id, const
   return ret;
 }
 
+TileLocation PlateModule::locate_tile(const IndexCacheEntry& index, int level, int col, int row,
+                                      int transaction_id, bool exact, bool want_data) const {
+  VW_ASSERT(transaction_id >= -1, BadRequest() << "Illegal transaction_id");
+  VW_ASSERT(level >= 0 && col >= 0 && row >= 0, BadRequest() << "Illegal tile location");
+
+  const int32 id = index.platefile_id;
+
+  // The read cursor is only asked for again once it's READ_CURSOR_TTL old,
+  // so most requests for the latest tile don't have to ask the index.
+  if (transaction_id == -1) {
+    refresh_read_cursor(index);
+    transaction_id = index.read_cursor;
+    exact = false;
+  }
+
+  // Anything newer than the read cursor might still be being written
+  const bool cacheable = transaction_id <= index.read_cursor;
+  TileLocationCache::Key key = {id, uint32(level), uint32(col), uint32(row), uint32(transaction_id), exact};
+
+  TileLocation loc;
+  if (cacheable && tile_cache.get(key, loc)) {
+    if (loc.have_data || !want_data)
+      return loc;
+  } else {
+    detail::IndexRecord idx_record;
+    try {
+      logger(VerboseDebugMessage) << "Sending tile read_request with transaction[" << transaction_id << "] and exact[" << exact << "]" << std::endl;;
+      idx_record = index.index->read_request(col,row,level,transaction_id,exact);
+    } catch(const TileNotFoundErr &) {
+      throw;
+    } catch (const BadRequest &) {
+      throw;
+    } catch(const vw::Exception &e) {
+      vw_throw(ServerError() << "Could not read plate index: " << e.what());
+    }
+
+    loc.platefile_id   = id;
+    loc.transaction_id = transaction_id;
+    loc.exact          = exact;
+    loc.filetype       = idx_record.filetype();
+    loc.blob_id        = idx_record.blob_id();
+    loc.blob_offset    = idx_record.blob_offset();
+  }
+
+  if (want_data) {
+    try {
+      logger(VerboseDebugMessage) << "Fetching blob" << std::endl;
+      // Grab a blob from the blob cache by filename
+      boost::shared_ptr<ReadBlob> blob = get_blob(id, index.filename, loc.blob_id);
+
+      logger(VerboseDebugMessage) << "Fetching data from blob" << std::endl;
+      // And calculate the sendfile(2) parameters
+      blob->read_sendfile(loc.blob_offset, loc.filename, loc.offset, loc.size);
+      loc.have_data = true;
+    } catch (const vw::Exception& e) {
+      vw_throw(ServerError() << "Could not load blob data: " << e.what());
+    }
+  }
+
+  if (cacheable)
+    tile_cache.insert(key, loc);
+  return loc;
+}
+
+void PlateModule::refresh_read_cursor(const IndexCacheEntry& index) const {
+  const uint64 now = Stopwatch::microtime();
+  if (now - index.cursor_checked < READ_CURSOR_TTL)
+    return;
+
+  int cursor;
+  try {
+    cursor = index.index->transaction_cursor();
+  } catch (const vw::Exception& e) {
+    vw_throw(ServerError() << "Could not read plate index: " << e.what());
+  }
+  index.cursor_checked = now;
+
+  // Tiles cached for the old cursor might not be the latest any more
+  if (cursor != index.read_cursor) {
+    logger(DebugMessage) << "Read cursor of " << index.shortname << " moved from "
+                         << index.read_cursor << " to " << cursor << std::endl;
+    index.read_cursor = cursor;
+    tile_cache.invalidate(index.platefile_id);
+  }
+}
+
 void PlateModule::sync_index_cache() const {
 
   VW_ASSERT(m_connected, LogicErr() << "Must connect before trying to sync cache");
@@ -230,6 +293,11 @@ void PlateModule::sync_index_cache() const {
   IndexListRequest request;
   IndexListReply id_list;
 
+  // Remember the old read cursors, so we know which cached tiles to drop
+  std::map<int32, int> old_cursors;
+  BOOST_FOREACH(const IndexCache::value_type& c, index_cache)
+    old_cursors[c.first] = c.second.read_cursor;
+
   index_cache.clear();
 
   m_client->ListRequest(m_client.get(), &request, &id_list, null_callback());
@@ -256,8 +324,10 @@ void PlateModule::sync_index_cache() const {
       entry.shortname   = name;
       entry.filename    = entry.index->platefile_name();
       entry.read_cursor = entry.index->transaction_cursor();
+      entry.cursor_checked = Stopwatch::microtime();
       entry.description = (hdr.has_description() && ! hdr.description().empty()) ? hdr.description() : entry.shortname + "." + vw::stringify(entry.read_cursor);
       id                = hdr.platefile_id();
+      entry.platefile_id = id;
     } catch (const vw::Exception& e) {
       logger(ErrorMessage) << "Tried to add " << name << " to the index cache, but failed: " << e.what() << std::endl;
       continue;
@@ -266,6 +336,13 @@ void PlateModule::sync_index_cache() const {
     index_cache[id] = entry;
     logger(DebugMessage) << "Adding " << entry.shortname << " to index cache [cursor=" << entry.read_cursor << "]" << std::endl;
   }
+
+  typedef std::pair<int32, int> cursor_t;
+  BOOST_FOREACH(const cursor_t& c, old_cursors) {
+    IndexCache::const_iterator i = index_cache.find(c.first);
+    if (i == index_cache.end() || i->second.read_cursor != c.second)
+      tile_cache.invalidate(c.first);
+  }
 }
 
 
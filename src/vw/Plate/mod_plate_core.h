@@ -22,6 +22,8 @@
 #include "mod_plate_utils.h"
 #include "mod_plate.h"
 
+#include <vw/Plate/TileLocationCache.h>
+
 #include <vw/Core/FundamentalTypes.h>
 #include <vw/Core/Log.h>
 #include <boost/shared_ptr.hpp>
@@ -60,7 +62,10 @@ class PlateModule {
       std::string filename;
       std::string description;
       boost::shared_ptr<detail::Index> index;
-      int read_cursor;
+      int32 platefile_id;
+      // Refreshed by locate_tile() once it's older than a second
+      mutable int read_cursor;
+      mutable vw::uint64 cursor_checked; // Stopwatch::microtime()
     };
 
     struct BlobCacheEntry {
@@ -81,6 +86,15 @@ class PlateModule {
     const boost::shared_ptr<ReadBlob> get_blob(int platefile_id, const std::string& plate_filename, uint32 blob_id) const;
     void sync_index_cache() const;
 
+    /// Find a tile in the index (or the tile cache). A transaction_id of -1
+    /// means the platefile's read cursor, as of at most a second ago. If
+    /// want_data is set, the sendfile(2) parameters are filled in as well.
+    /// Throws TileNotFoundErr, BadRequest or ServerError.
+    TileLocation locate_tile(const IndexCacheEntry& index, int level, int col, int row,
+                             int transaction_id, bool exact, bool want_data) const;
+
+    const TileLocationCache& get_tile_cache() const { return tile_cache; }
+
     std::ostream& logger(MessageLevel level, bool child_id = true) const;
 
     std::string get_dem() const;
@@ -91,8 +105,11 @@ class PlateModule {
   private:
     boost::shared_ptr<IndexClient> m_client;
 
+    void refresh_read_cursor(const IndexCacheEntry& index) const;
+
     mutable BlobCache  blob_cache;
     mutable IndexCache index_cache;
+    mutable TileLocationCache tile_cache;
     bool m_connected;
     // We don't manage the data, and I think apache might modify it behind the scenes.
     // As such, mark it volatile.
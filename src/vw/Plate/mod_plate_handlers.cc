@@ -66,42 +66,27 @@ int vw::platefile::handle_image(const ApacheRequest& r) {
 
   const PlateModule::IndexCacheEntry& index = mod_plate().get_index(sid);
 
-  int id = index.index->index_header().platefile_id();
+  int transaction_id = r.args.get("transaction_id", int(-1));
+  bool exact = r.args.get("exact", false);
 
   // --------------  Access Plate Index -----------------
 
-  IndexRecord idx_record;
-  try {
-    int transaction_id = r.args.get("transaction_id", int(-1));
-    bool exact = r.args.get("exact", false);
-
-    VW_ASSERT(transaction_id >= -1, BadRequest() << "Illegal transaction_id");
-
-    if (transaction_id == -1) {
-      transaction_id = index.index->transaction_cursor();
-      exact = false;
-    }
-
-    mod_plate().logger(VerboseDebugMessage) << "Sending tile read_request with transaction[" << transaction_id << "] and exact[" << exact << "]" << std::endl;;
-    idx_record = index.index->read_request(col,row,level,transaction_id,exact);
-  } catch(const TileNotFoundErr &) {
-    throw;
-  } catch (const BadRequest &) {
-    throw;
-  } catch(const vw::Exception &e) {
-    vw_throw(ServerError() << "Could not read plate index: " << e.what());
-  }
+  // The sendfile(2) parameters are only needed if we're sending a body, and
+  // a conditional request probably won't need one.
+  const char* if_none_match = apr_table_get(r.writer()->headers_in, "If-None-Match");
+  TileLocation loc = mod_plate().locate_tile(index, level, col, row, transaction_id, exact,
+                                             !r.header_only() && !if_none_match);
 
   // ---------------- Return the image ------------------
 
-  mod_plate().logger(VerboseDebugMessage) << "Figuring out mime content type from filetype " << idx_record.filetype() << std::endl;
+  mod_plate().logger(VerboseDebugMessage) << "Figuring out mime content type from filetype " << loc.filetype << std::endl;
   // Okay, we've gotten this far without error. Set content type now, so HTTP
   // HEAD returns the correct file type
-  if (idx_record.filetype() == "png")
+  if (loc.filetype == "png")
     ap_set_content_type(r.writer(), "image/png");
-  else if (idx_record.filetype() == "jpg")
+  else if (loc.filetype == "jpg")
     ap_set_content_type(r.writer(), "image/jpeg");
-  else if (idx_record.filetype() == "tif")
+  else if (loc.filetype == "tif")
     ap_set_content_type(r.writer(), "image/tiff");
   else
     ap_set_content_type(r.writer(), "application/octet-stream");
@@ -116,27 +101,25 @@ int vw::platefile::handle_image(const ApacheRequest& r) {
       apr_table_set(r.writer()->headers_out, "Cache-Control", "max-age=1200");
   }
 
+  const string etag = loc.etag();
+  apr_table_set(r.writer()->headers_out, "ETag", etag.c_str());
+
+  // The client already has this tile
+  if (if_none_match && etag_matches(if_none_match, etag))
+    return HTTP_NOT_MODIFIED;
+
   // This is as far as we can go without making the request heavyweight. Bail
   // out on a header request now.
   if (r.header_only())
     return OK;
 
-  // These are the sendfile(2) parameters
-  string filename;
-  vw::uint64 offset, size;
-
-  try {
-    mod_plate().logger(VerboseDebugMessage) << "Fetching blob" << std::endl;
-    // Grab a blob from the blob cache by filename
-    boost::shared_ptr<ReadBlob> blob = mod_plate().get_blob(id, index.filename, idx_record.blob_id());
-
-    mod_plate().logger(VerboseDebugMessage) << "Fetching data from blob" << std::endl;
-    // And calculate the sendfile(2) parameters
-    blob->read_sendfile(idx_record.blob_offset(), filename, offset, size);
+  // Look the data up at the same transaction, in case the cursor just moved
+  if (!loc.have_data)
+    loc = mod_plate().locate_tile(index, level, col, row, loc.transaction_id, loc.exact, true);
 
-  } catch (const vw::Exception& e) {
-    vw_throw(ServerError() << "Could not load blob data: " << e.what());
-  }
+  // These are the sendfile(2) parameters
+  const string& filename = loc.filename;
+  const vw::uint64 offset = loc.offset, size = loc.size;
 
   apr_file_t *fd = 0;
   // Open the blob as an apache file with raii (so it goes away when we return)
@@ -226,6 +209,41 @@ int vw::platefile::handle_wtml(const ApacheRequest& r) {
   return OK;
 }
 
+// --------------------- Plate Module (Apache side) ------------------------
+
+int vw::platefile::PlateModule::operator()(const ApacheRequest& r) const {
+
+  if (r.url.empty())
+    return DECLINED;
+
+  static const Handler Handlers[] = {handle_image, handle_wtml};
+
+  BOOST_FOREACH(const Handler h, Handlers) {
+    int ret = h(r);
+    if (ret != DECLINED)
+      return ret;
+  }
+  return DECLINED;
+}
+
+int vw::platefile::PlateModule::status(const ApacheRequest& r, int /*flags*/) const {
+  apache_stream out(r.writer());
+
+  out << "IndexCache:<br>" << std::endl;
+  BOOST_FOREACH(const IndexCache::value_type& c, get_index_cache())
+    out << c.second.shortname << ": " << c.first << "<br>";
+
+  out << "BlobCacheSize: " << get_blob_cache().size() << "<br>";
+
+  const TileLocationCache& tiles = get_tile_cache();
+  out << "TileCacheSize: " << tiles.size() << "/" << tiles.max_size() << "<br>"
+      << "TileCacheHits: " << tiles.hits() << "<br>"
+      << "TileCacheMisses: " << tiles.misses() << "<br>"
+      << "TileCacheEvictions: " << tiles.evictions() << "<br>";
+
+  return OK;
+}
+
 // --------------------- Apache C++ Entry Points ------------------------
 
 extern "C" int mod_plate_handler(request_rec *r) {
@@ -0,0 +1,191 @@
+// __BEGIN_LICENSE__
+//  Copyright (c) 2006-2013, United States Government as represented by the
+//  Administrator of the National Aeronautics and Space Administration. All
+//  rights reserved.
+//
+//  The NASA Vision Workbench is licensed under the Apache License,
+//  Version 2.0 (the "License"); you may not use this file except in
+//  compliance with the License. You may obtain a copy of the License at
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+// __END_LICENSE__
+
+
+// Replays a tile access log against mod_plate's request core (index lookup,
+// tile cache, blob sendfile parameters) without going through apache.
+
+#include "mod_plate_core.h"
+#include "mod_plate.h"
+
+#include <vw/Plate/Exception.h>
+#include <vw/Plate/HTTPUtils.h>
+#include <vw/Core/Stopwatch.h>
+
+#include <apr_general.h>
+#include <apr_pools.h>
+#include <apr_tables.h>
+
+#include <boost/regex.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/foreach.hpp>
+#include <boost/program_options.hpp>
+namespace po = boost::program_options;
+
+#include <fstream>
+#include <iostream>
+#include <cstring>
+
+using namespace vw;
+using namespace vw::platefile;
+
+struct TileRequest {
+  std::string sid;
+  int level, col, row;
+  int transaction_id;
+  bool exact;
+};
+
+// Pull the tile requests out of a log. Anything that looks like a mod_plate
+// tile url counts, so this reads both apache access logs and bare url lists.
+std::vector<TileRequest> read_log(std::istream& in) {
+  static const boost::regex match_regex("/(\\w+)/(\\d+)/(\\d+)/(\\d+)\\.(\\w+)(\\?[^\\s\"]*)?");
+
+  std::vector<TileRequest> requests;
+  std::string line;
+  while (std::getline(in, line)) {
+    boost::smatch match;
+    if (!boost::regex_search(line, match, match_regex))
+      continue;
+
+    TileRequest r;
+    try {
+      r.sid   = match[1];
+      r.level = boost::lexical_cast<int>(match[2]);
+      r.col   = boost::lexical_cast<int>(match[3]);
+      r.row   = boost::lexical_cast<int>(match[4]);
+
+      QueryMap args(match[6].matched ? std::string(match[6]).substr(1) : std::string());
+      r.transaction_id = args.get("transaction_id", int(-1));
+      r.exact          = args.get("exact", false);
+    } catch (const std::exception&) {
+      continue;
+    }
+    requests.push_back(r);
+  }
+  return requests;
+}
+
+int main(int argc, char** argv) {
+  std::string url, log_file;
+  int passes, tile_cache, timeout, tries;
+
+  po::options_description general_options("Replays a tile access log against mod_plate's request core");
+  general_options.add_options()
+    ("url,u",        po::value(&url)->default_value("amqp://127.0.0.1/index"), "The index server url (PlateIndexUrl)")
+    ("passes,p",     po::value(&passes)->default_value(2), "How many times to replay the log")
+    ("tile-cache,c", po::value(&tile_cache)->default_value(20000), "Tile location cache size (PlateTileCache)")
+    ("timeout",      po::value(&timeout)->default_value(3000), "Index timeout (PlateIndexTimeout)")
+    ("tries",        po::value(&tries)->default_value(3), "Index tries (PlateIndexTries)")
+    ("help,h",       "Display this help message");
+
+  po::options_description hidden_options("");
+  hidden_options.add_options()
+    ("log", po::value(&log_file));
+
+  po::options_description options("Allowed Options");
+  options.add(general_options).add(hidden_options);
+
+  po::positional_options_description p;
+  p.add("log", 1);
+
+  po::variables_map vm;
+  po::store( po::command_line_parser( argc, argv ).options(options).positional(p).run(), vm );
+  po::notify( vm );
+
+  std::ostringstream usage;
+  usage << "Usage: " << argv[0] << " [options] <access log, or - for stdin>\n\n";
+  usage << general_options << std::endl;
+
+  if( vm.count("help") || log_file.empty() ) {
+    std::cout << usage.str();
+    return 1;
+  }
+
+  // PlateTileCache is checked with is_ge_zero; a negative size would wrap
+  if (tile_cache < 0) {
+    std::cerr << "--tile-cache must be zero or more" << std::endl;
+    return 1;
+  }
+
+  std::vector<TileRequest> requests;
+  if (log_file == "-")
+    requests = read_log(std::cin);
+  else {
+    std::ifstream in(log_file.c_str());
+    if (!in) {
+      std::cerr << "Could not open " << log_file << std::endl;
+      return 1;
+    }
+    requests = read_log(in);
+  }
+  std::cout << "Read " << requests.size() << " tile requests from " << log_file << std::endl;
+
+  // Build the same config apache would hand us
+  apr_initialize();
+  apr_pool_t *pool;
+  apr_pool_create(&pool, NULL);
+
+  plate_config conf;
+  std::memset(&conf, 0, sizeof(conf));
+  conf.index_url       = url.c_str();
+  conf.index_timeout   = timeout;
+  conf.index_tries     = tries;
+  conf.unknown_resync  = 1;
+  conf.use_blob_cache  = 1;
+  conf.tile_cache_size = tile_cache;
+  conf.rules = apr_array_make(pool, 2, sizeof(rule_entry));
+  conf.alias = apr_table_make(pool, 4);
+
+  mod_plate_init(&conf);
+  mod_plate_mutable().connect_index();
+  const PlateModule& mod = mod_plate();
+
+  for (int pass = 0; pass < passes; ++pass) {
+    const TileLocationCache& cache = mod.get_tile_cache();
+    uint64 hits = cache.hits(), misses = cache.misses();
+    size_t ok = 0, not_found = 0, errors = 0;
+
+    uint64 t0 = Stopwatch::microtime();
+    BOOST_FOREACH(const TileRequest& r, requests) {
+      try {
+        const PlateModule::IndexCacheEntry& index = mod.get_index(r.sid);
+        mod.locate_tile(index, r.level, r.col, r.row, r.transaction_id, r.exact, true);
+        ok++;
+      } catch (const TileNotFoundErr&) {
+        not_found++;
+      } catch (const UnknownPlatefile&) {
+        not_found++;
+      } catch (const vw::Exception& e) {
+        if (errors++ < 10)
+          std::cerr << "Error: " << e.what() << std::endl;
+      }
+    }
+    uint64 t1 = Stopwatch::microtime();
+
+    double secs = double(t1 - t0) / 1e6;
+    std::cout << "Pass " << pass + 1 << ": " << requests.size() << " requests in " << secs << "s ("
+              << (secs > 0 ? double(requests.size()) / secs : 0) << " req/s). "
+              << ok << " found, " << not_found << " not found, " << errors << " errors. "
+              << "Tile cache: " << cache.hits() - hits << " hits, " << cache.misses() - misses << " misses, "
+              << cache.size() << " entries" << std::endl;
+  }
+
+  apr_pool_destroy(pool);
+  apr_terminate();
+  return 0;
+}
@@ -117,7 +117,7 @@ void copy_job( uint32 level, BBox2i const& region,
       // Load tiles from input and immediately write to output with
       // out decoding the imagery.
       BOOST_FOREACH( const Tile& t, input_plate->batch_read(tile_lookup) ) {
-        output_plate->write_update( &t.data->operator[](0), t.data->size(), t.hdr.col(), t.hdr.row(), level, t.hdr.filetype() );
+        output_plate->write_update( t.data->data(), t.data->size(), t.hdr.col(), t.hdr.row(), level, t.hdr.filetype() );
       }
     }
     progress.report_incremental_progress(inc_amt);
@@ -19,6 +19,7 @@
 #include <vw/Image.h>
 #include <vw/Plate/PlateFile.h>
 #include <vw/Plate/TileManipulation.h>
+#include <vw/Plate/TileWriter.h>
 using namespace vw;
 using namespace vw::platefile;
 
@@ -287,6 +288,7 @@ struct Options {
 
   // For spawning multiple jobs
   int32 job_id, num_jobs;
+  uint32 threads;
 };
 
 void handle_arguments(int argc, char *argv[], Options& opt) {
@@ -301,6 +303,7 @@ void handle_arguments(int argc, char *argv[], Options& opt) {
     ("transaction-id,t",po::value(&opt.transaction_id)->default_value(2000), "Transaction id to write to")
     ("start", po::value(&opt.start_description), "Starts a multi-part plate reduce.")
     ("finish", po::bool_switch(&opt.finish)->default_value(false), "Finish a multi-part plate reduce")
+    ("threads", po::value(&opt.threads)->default_value(0), "Number of threads to reduce and encode tiles with (0 for the default).")
     ("help,h", "Display this help message");
 
   po::options_description hidden_options("");
@@ -327,11 +330,38 @@ void handle_arguments(int argc, char *argv[], Options& opt) {
 
   if ( vm.count("help") || vm.count("input-file") != 1 || opt.transaction_id.newest())
     vw_throw( ArgumentErr() << usage.str() << general_options );
+
+  if ( opt.threads > 0 )
+    vw_settings().set_default_num_threads( opt.threads );
 }
 
 // --- Meta Application of Above Functions ----------
 
+// Runs a reduction over the tiles read for one location, for the
+// ThreadedTileWriter.
+template <typename ReduceT, class PixelT>
+class ReduceTile {
+  ReduceT m_reduce;
+  std::list<ImageView<PixelT> > m_tiles;
+  std::list<TileHeader> m_headers;
+
+public:
+  ReduceTile( ReduceT const& reduce, std::list<ImageView<PixelT> > const& tiles,
+              std::list<TileHeader> const& headers ) :
+    m_reduce(reduce), m_tiles(tiles), m_headers(headers) {}
+
+  bool operator()( ImageView<PixelT>& result ) {
+    m_reduce(m_tiles, m_headers, result);
+    return true;
+  }
+};
+
 // apply_reduce
+//
+// Tiles are read on this thread one work unit at a time, then reduced
+// and encoded in parallel and written in order.  Each work unit is
+// written out before the next is read, so the platefile is never
+// read and written at once.
 template <typename ReduceT, class PixelT>
 void apply_reduce( boost::shared_ptr<PlateFile> platefile,
                    std::list<BBox2i> const& workunits,
@@ -339,6 +369,7 @@ void apply_reduce( boost::shared_ptr<PlateFile> platefile,
 
   TerminalProgressCallback tpc("plate.platereduce", "Processing");
   double inc_tpc = 1.0/float(workunits.size());
+  ThreadedTileWriter writer( platefile );
   BOOST_FOREACH( const BBox2i& workunit, workunits) {
     tpc.report_incremental_progress(inc_tpc);
     for ( int ix = 0; ix < workunit.width(); ix++ ) {
@@ -368,12 +399,11 @@ void apply_reduce( boost::shared_ptr<PlateFile> platefile,
         }
 
         // Calling function
-        ImageView<PixelT> result;
-        reduce(tiles, tile_records, result);
-
-        platefile->write_update(result, location[0], location[1], opt.level);
+        writer.add_tile<PixelT>( ReduceTile<ReduceT, PixelT>( reduce.impl(), tiles, tile_records ),
+                                 location[0], location[1], opt.level );
       }
     }
+    writer.process_tiles();
   }
   tpc.report_finished();
 }
@@ -37,9 +37,11 @@ namespace fs = boost::filesystem;
 int main( int argc, char *argv[] ) {
 
   std::string filename;
+  bool upgrade_pages = false;
 
   po::options_description general_options("\nRebuild a platefile index.\n");
   general_options.add_options()
+    ("upgrade-pages", po::bool_switch(&upgrade_pages), "Rewrite the existing index pages in the current page format instead of rebuilding")
     ("help,h", "Display this help message");
 
   po::options_description hidden_options("");
@@ -87,6 +89,12 @@ int main( int argc, char *argv[] ) {
       return 1;
     }
 
+    if (upgrade_pages) {
+      detail::LocalIndex index(filename);
+      index.upgrade_pages();
+      return 0;
+    }
+
     if (fs::exists(index_str)) {
       std::cout << "Are you sure you want to delete & rebuild \"" << index_str << "\"? ";
       std::string user_input;
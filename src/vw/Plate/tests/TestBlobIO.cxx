@@ -238,3 +238,115 @@ TEST_F(BlobIOTest, Iterator) {
   ++iter;
   EXPECT_EQ( blob.end(), iter );
 }
+
+TEST_F(BlobIOTest, MappedRead) {
+  std::vector<uint64> offsets;
+  {
+    Blob blob(blob_path);
+    for (int i = 0; i < 3; ++i) {
+      hdr.set_col(i);
+      offsets.push_back(blob.write(hdr, test_data + i, data_size - i));
+    }
+  }
+
+  TileData kept;
+  {
+    ReadBlob blob(blob_path, ReadBlob::MAPPED);
+
+    // The records only differ in col and data size, so each one's data
+    // sits at the same distance from its base offset.  Every record the
+    // iterator hands out points into the one mapping it looked up.
+    const uint8* mapped_base = 0;
+    int i = 0;
+    for (ReadBlob::iterator iter = blob.begin(); iter != blob.end(); ++iter, ++i) {
+      ASSERT_LT(i, 3);
+      EXPECT_EQ(offsets[i], iter.current_base_offset());
+      BlobTileRecord rec = *iter;
+      EXPECT_EQ(i, rec.hdr.col());
+      EXPECT_TRUE(rec.data->is_view());
+      EXPECT_RANGE_EQ(test_data+i, test_data+data_size, rec.data->begin(), rec.data->end());
+      if (i == 0)
+        mapped_base = rec.data->data() - offsets[0];
+      EXPECT_EQ(mapped_base, rec.data->data() - offsets[i]);
+    }
+    EXPECT_EQ(3, i);
+
+    // The tile data must outlive the blob it came from
+    kept = blob.read_data(offsets[1]);
+
+    // Appending to the file makes the mapping stale; reading the new
+    // record must map it again rather than fail.
+    uint64 appended;
+    {
+      Blob writer(blob_path);
+      hdr.set_col(7);
+      appended = writer.write(hdr, test_data, data_size);
+    }
+    EXPECT_EQ(7, blob.read_header(appended).col());
+    TileData verify_data = blob.read_data(appended);
+    EXPECT_RANGE_EQ(test_data+0, test_data+data_size, verify_data->begin(), verify_data->end());
+  }
+  EXPECT_RANGE_EQ(test_data+1, test_data+data_size, kept->begin(), kept->end());
+}
+
+TEST_F(BlobIOTest, Prefetch) {
+  std::vector<uint64> offsets;
+  {
+    Blob blob(blob_path);
+    for (int i = 0; i < 4; ++i) {
+      hdr.set_col(i);
+      offsets.push_back(blob.write(hdr, test_data + i, data_size - i));
+    }
+  }
+
+  ReadBlob blob(blob_path, ReadBlob::MAPPED);
+  typedef std::vector<std::pair<uint64, uint64> > Runs;
+
+  // The records lie back to back, so even a gap of 0 makes one run,
+  // and it ends where the last record does.
+  Runs runs = blob.prefetch_runs(offsets, 0);
+  ASSERT_EQ(1u, runs.size());
+  EXPECT_EQ(offsets[0], runs[0].first);
+  EXPECT_EQ(blob.size(), runs[0].second);
+
+  // A lone record covers exactly itself.
+  runs = blob.prefetch_runs(std::vector<uint64>(1, offsets[1]), 0);
+  ASSERT_EQ(1u, runs.size());
+  EXPECT_EQ(offsets[1], runs[0].first);
+  EXPECT_EQ(offsets[2], runs[0].second);
+
+  // Skipping record 2 leaves a hole as long as it is.
+  std::vector<uint64> sparse;
+  sparse.push_back(offsets[0]);
+  sparse.push_back(offsets[1]);
+  sparse.push_back(offsets[3]);
+  const uint64 hole = offsets[3] - offsets[2];
+
+  runs = blob.prefetch_runs(sparse, hole - 1);
+  ASSERT_EQ(2u, runs.size());
+  EXPECT_EQ(offsets[0], runs[0].first);
+  EXPECT_EQ(offsets[2], runs[0].second);
+  EXPECT_EQ(offsets[3], runs[1].first);
+  EXPECT_EQ(blob.size(), runs[1].second);
+
+  runs = blob.prefetch_runs(sparse, hole);
+  ASSERT_EQ(1u, runs.size());
+  EXPECT_EQ(offsets[0], runs[0].first);
+  EXPECT_EQ(blob.size(), runs[0].second);
+
+  EXPECT_TRUE(blob.prefetch_runs(std::vector<uint64>()).empty());
+
+  EXPECT_NO_THROW(blob.prefetch(sparse, 0));
+  EXPECT_NO_THROW(blob.prefetch(offsets));
+  EXPECT_NO_THROW(blob.prefetch(std::vector<uint64>()));
+  EXPECT_NO_THROW(ReadBlob(blob_path).prefetch(offsets));
+
+  std::vector<uint64> unsorted(offsets.rbegin(), offsets.rend());
+  EXPECT_THROW(blob.prefetch(unsorted), ArgumentErr);
+
+  for (int i = 0; i < 4; ++i) {
+    BlobTileRecord rec = blob.read_record(offsets[i]);
+    EXPECT_EQ(i, rec.hdr.col());
+    EXPECT_RANGE_EQ(test_data+i, test_data+data_size, rec.data->begin(), rec.data->end());
+  }
+}
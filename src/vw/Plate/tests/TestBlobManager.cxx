@@ -20,6 +20,7 @@
 #include <test/Helpers.h>
 #include <vw/Plate/BlobManager.h>
 #include <vw/Plate/Exception.h>
+#include <vw/Core/Thread.h>
 #include <boost/filesystem/convenience.hpp>
 #include <fstream>
 
@@ -128,3 +129,63 @@ TEST_F(BlobManagerTest, Scan) {
   EXPECT_EQ(4, bm->blob_size(id2));
   EXPECT_EQ(6, bm->blob_size(id3));
 }
+
+TEST_F(BlobManagerTest, ThreadAffinity) {
+  uint32 id1 = bm->request_lock(),
+         id2 = bm->request_lock();
+
+  write_to_blob(id1, "abcdefg", 6);
+  ASSERT_NO_FATAL_FAILURE();
+  write_to_blob(id2, "abcdefg", 2);
+  ASSERT_NO_FATAL_FAILURE();
+
+  bm->release_lock(id1);
+  bm->release_lock(id2);
+
+  // id1 is the larger blob, but this thread released id2 last, so it gets
+  // id2 back. The other blob is still handed out by size.
+  EXPECT_EQ(id2, bm->request_lock());
+  EXPECT_EQ(id1, bm->request_lock());
+  bm->release_lock(id1);
+  bm->release_lock(id2);
+}
+
+namespace {
+  struct TakeBothBlobs {
+    BlobManager& bm;
+    uint32 first, second;
+    TakeBothBlobs(BlobManager& bm) : bm(bm), first(0), second(0) {}
+    void operator()() {
+      first  = bm.request_lock();
+      second = bm.request_lock();
+      bm.release_lock(first);
+      bm.release_lock(second);
+    }
+  };
+}
+
+TEST_F(BlobManagerTest, ThreadAffinityHandoff) {
+  uint32 id1 = bm->request_lock(),
+         id2 = bm->request_lock();
+
+  write_to_blob(id1, "abcdefg", 6);
+  ASSERT_NO_FATAL_FAILURE();
+  write_to_blob(id2, "abcdefg", 2);
+  ASSERT_NO_FATAL_FAILURE();
+
+  bm->release_lock(id1);
+  bm->release_lock(id2);
+
+  // Another thread releases id2 after us, so id2 is now remembered by that
+  // thread only and we go back to getting the larger blob.
+  boost::shared_ptr<TakeBothBlobs> other(new TakeBothBlobs(*bm));
+  {
+    Thread t(other);
+    t.join();
+  }
+  ASSERT_EQ(id1, other->first);
+  ASSERT_EQ(id2, other->second);
+
+  EXPECT_EQ(id1, bm->request_lock());
+  bm->release_lock(id1);
+}
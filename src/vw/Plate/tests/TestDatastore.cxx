@@ -120,15 +120,15 @@ TEST_P(IDatastore, TwoInsert) {
   vector<Tile> ret(r.begin(), r.end());
   sort(ret.begin(), ret.end(), SortTilesByTidASC);
 
-  EXPECT_EQ(vA, *reinterpret_cast<val_t*>(&ret[0].data->operator[](0)));
-  EXPECT_EQ(vB, *reinterpret_cast<val_t*>(&ret[1].data->operator[](0)));
+  EXPECT_EQ(vA, *reinterpret_cast<const val_t*>(ret[0].data->data()));
+  EXPECT_EQ(vB, *reinterpret_cast<const val_t*>(ret[1].data->data()));
 
   store->write_update(*state1, 0, 0, 0, TYPE2, reinterpret_cast<const uint8*>(&vC), sizeof(val_t));
 
   store->get(r, 0, 0, 0, TransactionRange(id1));
   EXPECT_EQ(1, r.size());
   EXPECT_EQ(string(TYPE2), r[0].hdr.filetype());
-  EXPECT_EQ(vC, *reinterpret_cast<val_t*>(&r[0].data->operator[](0)));
+  EXPECT_EQ(vC, *reinterpret_cast<const val_t*>(r[0].data->data()));
 
   store->write_complete(*state1);
   store->write_complete(*state2);
@@ -196,6 +196,87 @@ TEST_P(IDatastore, InsertRegion) {
   store->transaction_end(id, true);
 }
 
+TEST_P(IDatastore, LeasedWrites) {
+  if (GetParam() == "dir")
+    return;
+  m_url.query().set("write_mode", "leased");
+
+  boost::scoped_ptr<Datastore> store;
+  ASSERT_NO_THROW(store.reset(Datastore::open(m_url, m_hdr)));
+
+  Datastore::TileSearch r;
+  boost::scoped_ptr<WriteState> state1, state2;
+  Transaction id(0);
+
+  ASSERT_NO_THROW(id = store->transaction_begin("leased test"));
+  ASSERT_NO_THROW(state1.reset(store->write_request(id)));
+  ASSERT_NO_THROW(state2.reset(store->write_request(id)));
+
+  store->write_update(*state1, 1, 0, 0, TYPE1, reinterpret_cast<const uint8*>(&vA), sizeof(val_t));
+  store->write_update(*state2, 1, 0, 1, TYPE1, reinterpret_cast<const uint8*>(&vB), sizeof(val_t));
+  store->write_update(*state1, 1, 1, 0, TYPE1, reinterpret_cast<const uint8*>(&vC), sizeof(val_t));
+
+  // Nothing is in the index until the writer completes
+  store->head(r, 1, BBox2u(0,0,2,2), TransactionRange(-1)); EXPECT_EQ(0, r.size());
+
+  store->write_complete(*state1);
+  store->head(r, 1, BBox2u(0,0,2,2), TransactionRange(-1)); EXPECT_EQ(2, r.size());
+
+  store->write_complete(*state2);
+  store->get(r, 1, 0, 1, TransactionRange(id));
+  ASSERT_EQ(1, r.size());
+  EXPECT_EQ(vB, *reinterpret_cast<const val_t*>(r[0].data->data()));
+
+  store->get(r, 1, 1, 0, TransactionRange(id));
+  ASSERT_EQ(1, r.size());
+  EXPECT_EQ(vC, *reinterpret_cast<const val_t*>(r[0].data->data()));
+
+  store->transaction_end(id, true);
+}
+
+TEST_P(IDatastore, GroupedPopulate) {
+  m_url.query().set("read_depth", "4");
+
+  boost::scoped_ptr<Datastore> store;
+  ASSERT_NO_THROW(store.reset(Datastore::open(m_url, m_hdr)));
+
+  Transaction id(0);
+  ASSERT_NO_THROW(id = store->transaction_begin("grouped populate test"));
+
+  // Spread the tiles over three writers, and so three blobs, in an
+  // interleaved order so that each blob's run is out of tile order.
+  boost::scoped_ptr<WriteState> states[3];
+  for (int i = 0; i < 3; ++i)
+    ASSERT_NO_THROW(states[i].reset(store->write_request(id)));
+  for (uint32 row = 0; row < 4; ++row) {
+    for (uint32 col = 0; col < 4; ++col) {
+      val_t v = vA + row * 4 + col;
+      store->write_update(*states[(row + col) % 3], 2, row, col, TYPE1, reinterpret_cast<const uint8*>(&v), sizeof(val_t));
+    }
+  }
+  for (int i = 0; i < 3; ++i)
+    store->write_complete(*states[i]);
+  store->transaction_end(id, true);
+
+  Datastore::TileSearch grouped;
+  store->head(grouped, 2, BBox2u(0,0,4,4), TransactionRange(-1));
+  ASSERT_EQ(16, grouped.size());
+  store->populate(grouped);
+  ASSERT_EQ(16, grouped.size());
+
+  // Each tile on its own is a group of one, read with no concurrency.
+  for (size_t i = 0; i < grouped.size(); ++i) {
+    ASSERT_TRUE(!!grouped[i].data);
+    Datastore::TileSearch single(1);
+    single[0].hdr = grouped[i].hdr;
+    store->populate(single);
+    ASSERT_EQ(1, single.size());
+    EXPECT_EQ(single[0].hdr, grouped[i].hdr);
+    EXPECT_EQ(vA + single[0].hdr.row() * 4 + single[0].hdr.col(), *reinterpret_cast<const val_t*>(single[0].data->data()));
+    EXPECT_RANGE_EQ(single[0].data->begin(), single[0].data->end(), grouped[i].data->begin(), grouped[i].data->end());
+  }
+}
+
 TEST_P(IDatastore, Logging) {
   boost::scoped_ptr<Datastore> store;
   ASSERT_NO_THROW(store.reset(Datastore::open(m_url, m_hdr)));
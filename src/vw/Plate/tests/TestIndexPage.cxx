@@ -20,6 +20,9 @@
 #include <test/Helpers.h>
 #include <vw/Plate/detail/LocalIndex.h>
 #include <vw/Plate/Exception.h>
+#include <vw/Plate/google/sparsetable>
+#include <fstream>
+#include <boost/foreach.hpp>
 
 using namespace std;
 using namespace vw;
@@ -169,3 +172,155 @@ TEST_F(IndexPageTest, Serialization) {
   EXPECT_EQ( rec[2].blob_id(),     out_rec.blob_id() );
   EXPECT_EQ( rec[2].blob_offset(), out_rec.blob_offset() );
 }
+
+TEST_F(IndexPageTest, ManyTransactions) {
+  // Insert out of order, so runs have to grow and move around
+  TileHeader hdr;
+  IndexRecord rec;
+  for (uint32 i = 0; i < 200; ++i) {
+    uint32 tid = (i * 37) % 200 + 1;
+    for (uint32 col = 0; col < 3; ++col) {
+      hdr.set_col(col);
+      hdr.set_row(7);
+      hdr.set_transaction_id(tid);
+      rec.set_blob_id(col);
+      rec.set_blob_offset(tid);
+      page->set(hdr, rec);
+    }
+  }
+  EXPECT_EQ(3, page->sparse_size());
+
+  page->sync();
+  boost::shared_ptr<LocalIndexPage> page2(new LocalIndexPage(page_path,0,0,0,1024,1024));
+
+  for (uint32 col = 0; col < 3; ++col) {
+    EXPECT_EQ(200, page2->get(col, 7, -1).blob_offset());
+    EXPECT_EQ(150, page2->get(col, 7, 150, true).blob_offset());
+    EXPECT_EQ(col, page2->get(col, 7, 150, true).blob_id());
+    EXPECT_EQ(200, page2->get(col, 7, 1000).blob_offset());
+    EXPECT_THROW(page2->get(col, 7, 0), TileNotFoundErr);
+
+    std::list<TileHeader> hdrs = page2->search_by_location(col, 7, 10, 19);
+    ASSERT_EQ(10, hdrs.size());
+    EXPECT_EQ(19, hdrs.front().transaction_id());
+    EXPECT_EQ(10, hdrs.back().transaction_id());
+  }
+}
+
+TEST_F(IndexPageTest, LegacyFormat) {
+  // Write a page the way the original sparsetable-of-lists page did
+  {
+    std::ofstream f(page_path.c_str(), std::ios::binary);
+    uint32 size = 1024;
+    f.write(reinterpret_cast<char*>(&size), sizeof(size));
+    f.write(reinterpret_cast<char*>(&size), sizeof(size));
+
+    google::sparsetable<uint8> table(1024*1024);
+    table.set(5*1024 + 3, 1);
+    table.write_metadata(&f);
+
+    uint32 count = 2;
+    f.write(reinterpret_cast<char*>(&count), sizeof(count));
+    for (uint32 tid = 2; tid > 0; --tid) {
+      IndexRecord rec;
+      rec.set_blob_id(tid * 1000 + 1);
+      rec.set_blob_offset(tid * 1000 + 2);
+      rec.set_filetype("png");
+      std::string bytes;
+      rec.SerializeToString(&bytes);
+      uint16 bytes_size = uint16(bytes.size());
+      f.write(reinterpret_cast<char*>(&tid), sizeof(tid));
+      f.write(reinterpret_cast<char*>(&bytes_size), sizeof(bytes_size));
+      f.write(bytes.data(), bytes.size());
+    }
+  }
+
+  for (int pass = 0; pass < 2; ++pass) {
+    // The second pass reads it back after converting it to the new format
+    boost::shared_ptr<LocalIndexPage> old_page(new LocalIndexPage(page_path,0,0,0,1024,1024));
+    EXPECT_EQ(1, old_page->sparse_size());
+
+    IndexRecord out_rec = old_page->get(3, 5, 1);
+    EXPECT_EQ(1001, out_rec.blob_id());
+    EXPECT_EQ(1002, out_rec.blob_offset());
+    EXPECT_EQ("png", out_rec.filetype());
+
+    out_rec = old_page->get(3, 5, -1);
+    EXPECT_EQ(2001, out_rec.blob_id());
+    EXPECT_EQ(2002, out_rec.blob_offset());
+
+    old_page->rewrite();
+  }
+}
+
+TEST_F(IndexPageTest, RegionSearch) {
+  // A page width that isn't a multiple of 64, so rows straddle bitmap words
+  UnlinkName path("RegionPage");
+  LocalIndexPage page2(path, 10, 100, 200, 100, 50);
+
+  TileHeader hdr;
+  hdr.set_level(10);
+  IndexRecord rec;
+  rec.set_blob_id(1);
+  for (uint32 row = 0; row < 50; ++row) {
+    for (uint32 col = (row * 7) % 5; col < 100; col += 5) {
+      for (uint32 tid = 1; tid <= 3; ++tid) {
+        hdr.set_col(100 + col);
+        hdr.set_row(200 + row);
+        hdr.set_transaction_id(tid * 10 + (col % 2));
+        rec.set_blob_offset(col * 1000 + row);
+        page2.set(hdr, rec);
+      }
+    }
+  }
+  EXPECT_EQ(10, page2.min_transaction());
+  EXPECT_EQ(31, page2.max_transaction());
+
+  const BBox2i region(150, 210, 70, 30);  // runs past the page's right edge
+  const TransactionOrNeg ranges[][2] = { {-1, -1}, {0, 1000}, {11, 21}, {12, 19}, {40, 50} };
+
+  for (size_t i = 0; i < sizeof(ranges)/sizeof(ranges[0]); ++i) {
+    std::vector<TileHeader> found;
+    page2.search_by_region(found, region, ranges[i][0], ranges[i][1]);
+
+    // Compare against asking every location in the region individually
+    size_t expected = 0;
+    for (int32 row = region.min().y(); row < region.max().y(); ++row) {
+      for (int32 col = region.min().x(); col < std::min(region.max().x(), 200); ++col) {
+        std::list<TileHeader> here = page2.search_by_location(col, row, ranges[i][0], ranges[i][1]);
+        expected += ranges[i][0].newest() ? std::min<size_t>(here.size(), 1) : here.size();
+      }
+    }
+    EXPECT_EQ(expected, found.size()) << "range " << i;
+    BOOST_FOREACH(const TileHeader& t, found)
+      EXPECT_TRUE(region.contains(Vector2i(t.col(), t.row())));
+  }
+}
+
+TEST_F(IndexPageTest, MultiGetFullRange) {
+  TileHeader hdr;
+  IndexRecord rec;
+  hdr.set_col(2);
+  hdr.set_row(4);
+  const uint32 tids[] = {5, 0, 1};
+  for (int i = 0; i < 3; ++i) {
+    hdr.set_transaction_id(tids[i]);
+    rec.set_blob_offset(tids[i]);
+    page->set(hdr, rec);
+  }
+
+  // [1, MAX_TRANSACTION] means everything, transaction 0 included
+  IndexPage::multi_value_type all = page->multi_get(2, 4, 1, MAX_TRANSACTION);
+  ASSERT_EQ(3, all.size());
+  EXPECT_EQ(5, all.front().first);
+  EXPECT_EQ(0, all.back().first);
+  EXPECT_EQ(0, all.back().second.blob_offset());
+
+  IndexPage::multi_value_type some = page->multi_get(2, 4, 1, MAX_TRANSACTION - 1);
+  ASSERT_EQ(2, some.size());
+  EXPECT_EQ(1, some.back().first);
+
+  some = page->multi_get(2, 4, 2, MAX_TRANSACTION);
+  ASSERT_EQ(1, some.size());
+  EXPECT_EQ(5, some.front().first);
+}
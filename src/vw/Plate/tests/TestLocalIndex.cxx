@@ -370,4 +370,44 @@ TEST_F(LocalIndexTiles, ValidTiles) {
 
   tiles = index->search_by_region(1, BBox2i(0,0,2,2), tid.minimum(), tid.maximum());
   EXPECT_EQ(4, tiles.size());
+
+  // Nothing was written after tid.maximum(), until now
+  const uint32 later = uint32(tid.maximum() + 1);
+  std::vector<TileHeader> found;
+  index->search_by_region(found, 1, BBox2i(0,0,2,2), later, later);
+  EXPECT_EQ(0, found.size());
+
+  TileHeader hdr = hdrs[4];
+  hdr.set_transaction_id(later);
+  index_write(hdr, rec);
+  index->search_by_region(found, 1, BBox2i(0,0,2,2), later, later);
+  ASSERT_EQ(1, found.size());
+  EXPECT_EQ(later, found[0].transaction_id());
+}
+
+TEST_F(LocalIndexTiles, StaleSummaries) {
+  IndexRecord rec;
+  const uint32 later = hdrs[4].transaction_id() + 1;
+
+  // A second writer that opens level 1 before any summaries are saved
+  index_write(hdrs[1], rec);
+  boost::shared_ptr<LocalIndex> other(new LocalIndex(plate_path));
+
+  // This saves summaries saying level 1 has nothing after hdrs[1]...
+  index->sync();
+
+  // ... which the other writer then makes stale, without saving its own.
+  TileHeader hdr = hdrs[4];
+  hdr.set_transaction_id(later);
+  rec.set_blob_id( other->write_request() );
+  rec.set_blob_offset(blob->write(hdr, test_data, test_size));
+  other->write_update(hdr, rec);
+  other->write_complete(rec.blob_id());
+  other.reset();
+
+  std::vector<TileHeader> found;
+  LocalIndex reader(plate_path);
+  reader.search_by_region(found, 1, BBox2i(0,0,2,2), later, later);
+  ASSERT_EQ(1, found.size());
+  EXPECT_EQ(later, found[0].transaction_id());
 }
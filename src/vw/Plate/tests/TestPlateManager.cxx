@@ -20,6 +20,7 @@
 #include <test/Helpers.h>
 #include <vw/Plate/PlateManager.h>
 #include <vw/Plate/PlateCarreePlateManager.h>
+#include <vw/Plate/TileWriter.h>
 #include <vw/Cartography/GeoReference.h>
 
 using namespace std;
@@ -48,6 +49,22 @@ public:
   }
 };
 
+// A tile generator that fails on one tile, as a mipmap or insert
+// generator would on a bad input.
+template <class PixelT>
+struct FailingTile {
+  int m_col, m_fail_col;
+  FailingTile(int col, int fail_col) : m_col(col), m_fail_col(fail_col) {}
+
+  bool operator()(ImageView<PixelT>& dest) const {
+    if (m_col == m_fail_col)
+      vw_throw( ArgumentErr() << "bad tile " << m_col );
+    dest.set_size(256, 256);
+    fill(dest, PixelT(m_col, 255));
+    return true;
+  }
+};
+
 class PlateCarreeExposedTest : public ::testing::Test {
 protected:
   typedef PixelGrayA<uint8> PixelT;
@@ -200,3 +217,27 @@ TEST_F( PlateCarreeExposedTest, SlowMipmap ) {
 
   vw_settings().set_system_cache_size(cache_size_before);
 }
+
+TEST_F( PlateCarreeExposedTest, TileWriterError ) {
+  platefile->transaction_begin("", 1);
+  platefile->write_request();
+
+  {
+    ThreadedTileWriter writer( platefile );
+    for (int col = 0; col < 8; ++col)
+      writer.add_tile<PixelT>( FailingTile<PixelT>(col, 3), col, 0, 3 );
+    // Every tile still reaches the commit stage, so this returns
+    // (rather than hanging) with the generator's own error.
+    EXPECT_THROW( writer.process_tiles(), ArgumentErr );
+
+    // The error is reported once; the writer is usable afterwards.
+    writer.add_tile<PixelT>( FailingTile<PixelT>(0, -1), 0, 1, 3 );
+    EXPECT_NO_THROW( writer.process_tiles() );
+  }
+
+  platefile->write_complete();
+  platefile->transaction_end(true);
+
+  EXPECT_EQ( 1, platefile->search_by_region( 3, BBox2i(0,1,8,1),
+                                             TransactionRange(1,1) ).size() );
+}
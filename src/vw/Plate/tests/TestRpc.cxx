@@ -147,6 +147,86 @@ TEST_P(RpcTest, Err) {
   EXPECT_EQ(1, server->stats().get("server_error"));
 }
 
+TEST_P(RpcTest, Pipelined) {
+  ASSERT_NO_FATAL_FAILURE(make_things(1));
+  TestClient& c = *clients[0];
+
+  static const uint32 COUNT = 1000, WINDOW = 16;
+  DoubleMessage q, a;
+  uint32 next_reply = 0;
+  for (uint32 i = 0; i < COUNT; ++i) {
+    if (c.in_flight() >= WINDOW) {
+      ASSERT_NO_THROW(c.recv_reply(&a));
+      EXPECT_EQ(2 * next_reply++, a.num());
+    }
+    q.set_num(i);
+    ASSERT_NO_THROW(c.send_request("DoubleRequest", &q));
+  }
+
+  // An ordinary call waits for the pipelined ones to finish first
+  q.set_num(COUNT);
+  ASSERT_NO_THROW(c.DoubleRequest(&c, &q, &a, null_callback()));
+  EXPECT_EQ(2 * COUNT, a.num());
+  EXPECT_EQ(0u, c.in_flight());
+  EXPECT_EQ(COUNT + 1, server->stats().get("msgs"));
+
+  // Errors come back from the matching recv_reply
+  q.set_num(TestServiceImpl::CLIENT_ERROR);
+  c.send_request("DoubleRequest", &q);
+  q.set_num(7);
+  c.send_request("DoubleRequest", &q);
+  EXPECT_THROW(c.recv_reply(&a), PlatefileErr);
+  ASSERT_NO_THROW(c.recv_reply(&a));
+  EXPECT_EQ(14, a.num());
+
+  EXPECT_THROW(c.send_request("NoSuchRequest", &q), ArgumentErr);
+}
+
+// Collects a client's pipelined replies itself, the way RemoteWriteQueue
+// does, keeping errors out of unrelated calls.
+struct CollectReplies {
+  TestClient* client;
+  int* calls;
+  int* errors;
+  void operator()() const {
+    ++*calls;
+    while (client->in_flight() > 0) {
+      try {
+        client->recv_reply(0);
+      } catch (const PlatefileErr&) {
+        ++*errors;
+      }
+    }
+  }
+};
+
+TEST_P(RpcTest, BeforeCall) {
+  ASSERT_NO_FATAL_FAILURE(make_things(1));
+  TestClient& c = *clients[0];
+
+  int calls = 0, errors = 0;
+  CollectReplies hook = {&c, &calls, &errors};
+  c.set_before_call(hook);
+
+  DoubleMessage q, a;
+  q.set_num(TestServiceImpl::CLIENT_ERROR);
+  c.send_request("DoubleRequest", &q);
+  q.set_num(3);
+  c.send_request("DoubleRequest", &q);
+
+  // The failed pipelined call is the hook's business, not this call's
+  q.set_num(5);
+  ASSERT_NO_THROW(c.DoubleRequest(&c, &q, &a, null_callback()));
+  EXPECT_EQ(10, a.num());
+  EXPECT_EQ(1, calls);
+  EXPECT_EQ(1, errors);
+  EXPECT_EQ(0u, c.in_flight());
+
+  c.set_before_call(boost::function<void ()>());
+  ASSERT_NO_THROW(c.DoubleRequest(&c, &q, &a, null_callback()));
+  EXPECT_EQ(1, calls);
+}
+
 TEST(TestRpc, HAS_ZEROMQ(KillServerDeathTest)) {
   Url u("zmq+ipc://" TEST_OBJDIR "/unittest2");
   Server server;
@@ -249,6 +329,9 @@ std::vector<Url> test_urls() {
     v.push_back(Url("zmq+ipc://" TEST_OBJDIR "/unittest"));
     v.push_back(Url("zmq+tcp://127.0.0.1:54321"));
     v.push_back(Url("zmq+inproc://unittest"));
+#endif
+#if defined(VW_HAVE_PKG_RT) && VW_HAVE_PKG_RT==1
+    v.push_back(Url("shm://unittest/rpc"));
 #endif
     return v;
 }
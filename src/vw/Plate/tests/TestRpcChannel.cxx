@@ -21,6 +21,9 @@
 #include <vw/Plate/RpcChannel.h>
 #include <vw/Plate/HTTPUtils.h>
 #include <vw/Plate/Exception.h>
+#if defined(VW_HAVE_PKG_RT) && VW_HAVE_PKG_RT==1
+#include <vw/Plate/detail/ShmChannel.h>
+#endif
 #include <boost/foreach.hpp>
 #include <boost/lexical_cast.hpp>
 #include <cstdlib>
@@ -234,6 +237,9 @@ std::vector<Url> test_urls() {
     v.push_back(Url("zmq+ipc://" TEST_OBJDIR "/unittest"));
     v.push_back(Url("zmq+tcp://127.0.0.1:54321"));
     v.push_back(Url("zmq+inproc://unittest"));
+#endif
+#if defined(VW_HAVE_PKG_RT) && VW_HAVE_PKG_RT==1
+    v.push_back(Url("shm://unittest/channel"));
 #endif
     return v;
 }
@@ -265,3 +271,64 @@ TEST_F(TestUrls, Illegal) {
   EXPECT_THROW(client("zmq+ipc:///"), ArgumentErr);
 #endif
 }
+
+TEST_F(TestUrls, Shm) {
+#if defined(VW_HAVE_PKG_RT) && VW_HAVE_PKG_RT==1
+  // shm needs a name
+  EXPECT_THROW(server("shm:///"), ArgumentErr);
+  EXPECT_THROW(client("shm://"), ArgumentErr);
+  // and someone to talk to
+  EXPECT_THROW(client("shm://unittest/nobody"), ShmErr);
+#endif
+}
+
+#if defined(VW_HAVE_PKG_RT) && VW_HAVE_PKG_RT==1
+TEST_F(TestUrls, ShmDroppedSlot) {
+  const Url u("shm://unittest/dropped");
+  Chan srv = server(u);
+  srv->set_timeout(100);
+
+  // Count the slots a fresh server has
+  vector<Chan> all;
+  while (true) {
+    try { all.push_back(client(u)); } catch (const ShmErr&) { break; }
+  }
+  ASSERT_LT(1u, all.size());
+  const size_t slots = all.size();
+  all.clear();
+
+  Chan first = client(u);
+  std::vector<uint8> msg(1, 'q'), in;
+  first->send_bytes(&msg[0], msg.size());
+  ASSERT_TRUE(srv->recv_bytes(&in));
+
+  // A reply bigger than the ring, which first never reads, makes the
+  // server give up on it
+  std::vector<uint8> big(1 << 20, 'r');
+  srv->send_bytes(&big[0], big.size());
+
+  // first is still alive, so its slot must not be handed out again
+  for (size_t i = 0; i < slots - 1; ++i)
+    ASSERT_NO_THROW(all.push_back(client(u)));
+  EXPECT_THROW(client(u), ShmErr);
+
+  // and first finds out it was dropped rather than sharing a slot
+  EXPECT_THROW(first->send_bytes(&msg[0], msg.size()), ShmErr);
+
+  // Once first goes away, its slot is free again
+  first.reset();
+  EXPECT_NO_THROW(client(u));
+}
+
+TEST_F(TestUrls, ShmBindTwice) {
+  const Url u("shm://unittest/twice");
+  Chan srv = server(u);
+  // A live server's segment can't be taken over
+  EXPECT_THROW(server(u), ShmErr);
+  EXPECT_NO_THROW(client(u));
+
+  // but it's free again once that server is gone
+  srv.reset();
+  EXPECT_NO_THROW(server(u));
+}
+#endif
@@ -0,0 +1,134 @@
+// __BEGIN_LICENSE__
+//  Copyright (c) 2006-2013, United States Government as represented by the
+//  Administrator of the National Aeronautics and Space Administration. All
+//  rights reserved.
+//
+//  The NASA Vision Workbench is licensed under the Apache License,
+//  Version 2.0 (the "License"); you may not use this file except in
+//  compliance with the License. You may obtain a copy of the License at
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+// __END_LICENSE__
+
+
+#include <gtest/gtest_VW.h>
+#include <vw/Plate/TileLocationCache.h>
+
+using namespace vw;
+using namespace vw::platefile;
+
+typedef TileLocationCache::Key Key;
+
+static Key key(int32 id, uint32 col, uint32 transaction_id = 1) {
+  Key k = {id, 2, col, 0, transaction_id, false};
+  return k;
+}
+
+static TileLocation location(int32 id, uint32 blob_offset) {
+  TileLocation loc;
+  loc.platefile_id = id;
+  loc.blob_id      = 3;
+  loc.blob_offset  = blob_offset;
+  return loc;
+}
+
+TEST(TileLocationCache, Hit) {
+  TileLocationCache cache(4);
+  TileLocation loc;
+
+  EXPECT_FALSE(cache.get(key(1, 0), loc));
+  cache.insert(key(1, 0), location(1, 100));
+  ASSERT_TRUE(cache.get(key(1, 0), loc));
+  EXPECT_EQ(100u, loc.blob_offset);
+
+  // Every part of the key counts
+  EXPECT_FALSE(cache.get(key(1, 0, 2), loc));
+  EXPECT_FALSE(cache.get(key(2, 0), loc));
+  Key exact = key(1, 0);
+  exact.exact = true;
+  EXPECT_FALSE(cache.get(exact, loc));
+
+  EXPECT_EQ(1u, cache.hits());
+  EXPECT_EQ(4u, cache.misses());
+
+  // Inserting an existing key replaces it
+  cache.insert(key(1, 0), location(1, 200));
+  ASSERT_TRUE(cache.get(key(1, 0), loc));
+  EXPECT_EQ(200u, loc.blob_offset);
+  EXPECT_EQ(1u, cache.size());
+}
+
+TEST(TileLocationCache, Eviction) {
+  TileLocationCache cache(3);
+  TileLocation loc;
+
+  for (uint32 i = 0; i < 3; ++i)
+    cache.insert(key(1, i), location(1, i));
+
+  // Touch 0, so 1 is now the least recently used
+  ASSERT_TRUE(cache.get(key(1, 0), loc));
+  cache.insert(key(1, 3), location(1, 3));
+
+  EXPECT_EQ(3u, cache.size());
+  EXPECT_EQ(1u, cache.evictions());
+  EXPECT_FALSE(cache.get(key(1, 1), loc));
+  EXPECT_TRUE(cache.get(key(1, 0), loc));
+  EXPECT_TRUE(cache.get(key(1, 2), loc));
+  EXPECT_TRUE(cache.get(key(1, 3), loc));
+
+  // A zero-sized cache holds nothing
+  TileLocationCache off(0);
+  off.insert(key(1, 0), location(1, 0));
+  EXPECT_EQ(0u, off.size());
+  EXPECT_FALSE(off.get(key(1, 0), loc));
+}
+
+TEST(TileLocationCache, InvalidateOnCursorChange) {
+  TileLocationCache cache(10);
+  TileLocation loc;
+
+  // Platefile ids on either side, including negative ones, must survive
+  const int32 ids[] = {-1, 1, 2, 3};
+  for (uint32 i = 0; i < 4; ++i) {
+    cache.insert(key(ids[i], 0, 1), location(ids[i], 0));
+    cache.insert(key(ids[i], 1, 1), location(ids[i], 1));
+  }
+  ASSERT_EQ(8u, cache.size());
+
+  // Platefile 2's read cursor moved
+  cache.invalidate(2);
+  EXPECT_EQ(6u, cache.size());
+  EXPECT_FALSE(cache.get(key(2, 0), loc));
+  EXPECT_FALSE(cache.get(key(2, 1), loc));
+  EXPECT_TRUE(cache.get(key(-1, 0), loc));
+  EXPECT_TRUE(cache.get(key(1, 1), loc));
+  EXPECT_TRUE(cache.get(key(3, 0), loc));
+
+  // and it fills again at the new cursor
+  cache.insert(key(2, 0, 2), location(2, 5));
+  ASSERT_TRUE(cache.get(key(2, 0, 2), loc));
+  EXPECT_EQ(5u, loc.blob_offset);
+}
+
+TEST(TileLocationCache, ETag) {
+  const std::string tag = location(1, 0x10).etag();
+  EXPECT_EQ("\"1-3-10\"", tag);
+  EXPECT_NE(tag, location(1, 0x11).etag());
+  EXPECT_NE(tag, location(2, 0x10).etag());
+
+  EXPECT_TRUE(etag_matches(tag, tag));
+  EXPECT_TRUE(etag_matches("*", tag));
+  EXPECT_TRUE(etag_matches("W/" + tag, tag));
+  EXPECT_TRUE(etag_matches("\"a\", " + tag + " ,\"b\"", tag));
+  EXPECT_TRUE(etag_matches("\"a\",W/" + tag, tag));
+
+  EXPECT_FALSE(etag_matches("", tag));
+  EXPECT_FALSE(etag_matches("\"1-3-11\"", tag));
+  EXPECT_FALSE(etag_matches("1-3-10", tag));
+  EXPECT_FALSE(etag_matches("\"a\", \"b\"", tag));
+}
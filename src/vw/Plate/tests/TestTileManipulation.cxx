@@ -19,6 +19,8 @@
 #include <gtest/gtest_VW.h>
 #include <test/Helpers.h>
 #include <vw/Plate/TileManipulation.h>
+#include <vw/Image/Convolution.h>
+#include <vw/Image/PixelTypes.h>
 #include <boost/foreach.hpp>
 
 using namespace std;
@@ -76,3 +78,45 @@ TEST_F(BlobManagerTest, Tiles) {
 TEST_F(BlobManagerTest, Weird) {
   bbox_does_tile_area(BBox2i(7,17,31,13), 7, 5, 15);
 }
+
+// The fused 2x2 reduction must match the separable box filter plus
+// subsample it replaced, including the per-pass truncation.
+template <class PixelT>
+void check_mipmap_one_tile(bool blur) {
+  const uint32 tile_size = 8;
+  typedef typename CompoundChannelType<PixelT>::type channel_type;
+  ImageView<PixelT> children[4];
+  for (int k = 0; k < 3; ++k) {
+    children[k].set_size(tile_size, tile_size);
+    for (uint32 j = 0; j < tile_size; ++j)
+      for (uint32 i = 0; i < tile_size; ++i)
+        for (uint32 c = 0; c < CompoundNumChannels<PixelT>::value; ++c)
+          compound_select_channel<channel_type&>(children[k](i,j), c) =
+            channel_type((37*i + 91*j + 53*c + 17*k) % 251);
+  }
+
+  ImageView<PixelT> super(2*tile_size, 2*tile_size);
+  for (int k = 0; k < 3; ++k)
+    crop(super, (k%2)*tile_size, (k/2)*tile_size, tile_size, tile_size) = children[k];
+  std::vector<float> kernel(2, 0.5);
+  ImageView<PixelT> expected;
+  if (blur)
+    expected = subsample( separable_convolution_filter( super, kernel, kernel, 1, 1, ConstantEdgeExtension() ), 2);
+  else
+    expected = subsample( super, 2 );
+
+  ImageView<PixelT> result;
+  mipmap_one_tile(result, tile_size, children[0], children[1], children[2], children[3], blur);
+  EXPECT_SEQ_EQ(expected, result);
+
+  // The missing lower right child leaves its quadrant transparent.
+  EXPECT_PIXEL_EQ(PixelT(), result(tile_size-1, tile_size-1));
+}
+
+TEST(TileManipulation, MipmapOneTile) {
+  check_mipmap_one_tile<PixelGrayA<uint8> >(true);
+  check_mipmap_one_tile<PixelGrayA<uint8> >(false);
+  check_mipmap_one_tile<PixelGrayA<int16> >(true);
+  check_mipmap_one_tile<PixelGrayA<float32> >(true);
+  check_mipmap_one_tile<PixelRGBA<uint8> >(true);
+}
@@ -105,12 +105,12 @@ int main( int argc, char *argv[]) {
 
     BBox2i region(opt.minx, opt.miny, opt.width, opt.height);
     TransactionOrNeg id(-1);
-    std::list<TileHeader> tile_records;
-    tile_records = plate->search_by_region(opt.level,region,TransactionRange(id));
+    std::vector<TileHeader> tile_records;
+    plate->search_by_region(tile_records,opt.level,region,TransactionRange(id));
 
     printf("{ \"ok\": true,\n");
     printf("\"result\": [\n");
-    std::list<TileHeader>::iterator i;
+    std::vector<TileHeader>::const_iterator i;
     for (i=tile_records.begin(); i != tile_records.end(); i++) {
       if (i != tile_records.begin()) { std::cout << ",\n"; }
 
@@ -18,9 +18,286 @@
 
 #include <vw/Stereo/Correlation.h>
 
+#include <boost/foreach.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+  using namespace vw;
+
+  // Row primitives for sliding_best_of_search. The generic loops are
+  // written so that the compiler can vectorize them; the SSE2
+  // versions do so explicitly.
+
+  template <class T>
+  inline void absolute_cost_row( T* cost, const T* left, const T* right, int32 n ) {
+    for ( int32 i = 0; i < n; ++i )
+      cost[i] = left[i] < right[i] ? right[i] - left[i] : left[i] - right[i];
+  }
+
+  template <class T>
+  inline void squared_cost_row( T* cost, const T* left, const T* right, int32 n ) {
+    for ( int32 i = 0; i < n; ++i )
+      cost[i] = (left[i] - right[i]) * (left[i] - right[i]);
+  }
+
+  // col += fresh - stale
+  template <class T>
+  inline void update_column_sums( T* col, const T* fresh, const T* stale, int32 n ) {
+    for ( int32 i = 0; i < n; ++i )
+      col[i] += fresh[i] - stale[i];
+  }
+
+  // Compare one row of box sums against the best and worst so far,
+  // recording the disparity index of a new best. A sum that beats
+  // the best can't also beat the worst, so the worst is a plain max.
+  template <class T>
+  inline void update_quality_row( T* best, T* worst, int32* index,
+                                  const T* cost, int32 n, int32 disparity ) {
+    for ( int32 i = 0; i < n; ++i ) {
+      if ( cost[i] < best[i] ) {
+        best[i] = cost[i];
+        index[i] = disparity;
+      }
+      if ( worst[i] < cost[i] )
+        worst[i] = cost[i];
+    }
+  }
+
+#if defined(__SSE2__)
+  inline void absolute_cost_row( float* cost, const float* left, const float* right, int32 n ) {
+    const __m128 sign = _mm_set1_ps( -0.0f );
+    int32 i = 0;
+    for ( ; i + 4 <= n; i += 4 )
+      _mm_storeu_ps( cost + i, _mm_andnot_ps( sign, _mm_sub_ps( _mm_loadu_ps( left + i ),
+                                                                 _mm_loadu_ps( right + i ) ) ) );
+    for ( ; i < n; ++i )
+      cost[i] = std::fabs( left[i] - right[i] );
+  }
+
+  inline void squared_cost_row( float* cost, const float* left, const float* right, int32 n ) {
+    int32 i = 0;
+    for ( ; i + 4 <= n; i += 4 ) {
+      __m128 d = _mm_sub_ps( _mm_loadu_ps( left + i ), _mm_loadu_ps( right + i ) );
+      _mm_storeu_ps( cost + i, _mm_mul_ps( d, d ) );
+    }
+    for ( ; i < n; ++i )
+      cost[i] = (left[i] - right[i]) * (left[i] - right[i]);
+  }
+
+  inline void absolute_cost_row( int32* cost, const int32* left, const int32* right, int32 n ) {
+    int32 i = 0;
+    for ( ; i + 4 <= n; i += 4 ) {
+      __m128i d = _mm_sub_epi32( _mm_loadu_si128( (const __m128i*)(left + i) ),
+                                 _mm_loadu_si128( (const __m128i*)(right + i) ) );
+      __m128i s = _mm_srai_epi32( d, 31 );
+      _mm_storeu_si128( (__m128i*)(cost + i), _mm_sub_epi32( _mm_xor_si128( d, s ), s ) );
+    }
+    for ( ; i < n; ++i )
+      cost[i] = left[i] < right[i] ? right[i] - left[i] : left[i] - right[i];
+  }
+
+  inline void update_column_sums( float* col, const float* fresh, const float* stale, int32 n ) {
+    int32 i = 0;
+    for ( ; i + 4 <= n; i += 4 )
+      _mm_storeu_ps( col + i, _mm_add_ps( _mm_loadu_ps( col + i ),
+                                          _mm_sub_ps( _mm_loadu_ps( fresh + i ), _mm_loadu_ps( stale + i ) ) ) );
+    for ( ; i < n; ++i )
+      col[i] += fresh[i] - stale[i];
+  }
+
+  inline void update_column_sums( int32* col, const int32* fresh, const int32* stale, int32 n ) {
+    int32 i = 0;
+    for ( ; i + 4 <= n; i += 4 )
+      _mm_storeu_si128( (__m128i*)(col + i),
+                        _mm_add_epi32( _mm_loadu_si128( (const __m128i*)(col + i) ),
+                                       _mm_sub_epi32( _mm_loadu_si128( (const __m128i*)(fresh + i) ),
+                                                      _mm_loadu_si128( (const __m128i*)(stale + i) ) ) ) );
+    for ( ; i < n; ++i )
+      col[i] += fresh[i] - stale[i];
+  }
+
+  inline __m128i select_si128( __m128i mask, __m128i a, __m128i b ) {
+    return _mm_or_si128( _mm_and_si128( mask, a ), _mm_andnot_si128( mask, b ) );
+  }
+
+  inline void update_quality_row( float* best, float* worst, int32* index,
+                                  const float* cost, int32 n, int32 disparity ) {
+    const __m128i d = _mm_set1_epi32( disparity );
+    int32 i = 0;
+    for ( ; i + 4 <= n; i += 4 ) {
+      __m128 c = _mm_loadu_ps( cost + i ), b = _mm_loadu_ps( best + i );
+      __m128i better = _mm_castps_si128( _mm_cmplt_ps( c, b ) );
+      _mm_storeu_ps( best + i, _mm_min_ps( b, c ) );
+      _mm_storeu_ps( worst + i, _mm_max_ps( _mm_loadu_ps( worst + i ), c ) );
+      _mm_storeu_si128( (__m128i*)(index + i),
+                        select_si128( better, d, _mm_loadu_si128( (const __m128i*)(index + i) ) ) );
+    }
+    for ( ; i < n; ++i ) {
+      if ( cost[i] < best[i] ) {
+        best[i] = cost[i];
+        index[i] = disparity;
+      }
+      if ( worst[i] < cost[i] )
+        worst[i] = cost[i];
+    }
+  }
+
+  inline void update_quality_row( int32* best, int32* worst, int32* index,
+                                  const int32* cost, int32 n, int32 disparity ) {
+    const __m128i d = _mm_set1_epi32( disparity );
+    int32 i = 0;
+    for ( ; i + 4 <= n; i += 4 ) {
+      __m128i c = _mm_loadu_si128( (const __m128i*)(cost + i) );
+      __m128i b = _mm_loadu_si128( (const __m128i*)(best + i) );
+      __m128i w = _mm_loadu_si128( (const __m128i*)(worst + i) );
+      __m128i better = _mm_cmplt_epi32( c, b );
+      _mm_storeu_si128( (__m128i*)(best + i), select_si128( better, c, b ) );
+      _mm_storeu_si128( (__m128i*)(worst + i), select_si128( _mm_cmpgt_epi32( c, w ), c, w ) );
+      _mm_storeu_si128( (__m128i*)(index + i),
+                        select_si128( better, d, _mm_loadu_si128( (const __m128i*)(index + i) ) ) );
+    }
+    for ( ; i < n; ++i ) {
+      if ( cost[i] < best[i] ) {
+        best[i] = cost[i];
+        index[i] = disparity;
+      }
+      if ( worst[i] < cost[i] )
+        worst[i] = cost[i];
+    }
+  }
+#endif
+
+  template <class T>
+  inline void cost_row( T* cost, const T* left, const T* right, int32 n,
+                        stereo::CostFunctionType cost_type ) {
+    if ( cost_type == stereo::SQUARED_DIFFERENCE )
+      squared_cost_row( cost, left, right, n );
+    else
+      absolute_cost_row( cost, left, right, n );
+  }
+
+  template <class T>
+  ImageView<PixelMask<Vector2i> >
+  sliding_search( ImageView<T> const& left, ImageView<T> const& right,
+                  Vector2i const& search_volume, Vector2i const& kernel_size,
+                  stereo::CostFunctionType cost_type ) {
+    VW_ASSERT( kernel_size[0] % 2 == 1 && kernel_size[1] % 2 == 1,
+               ArgumentErr() << "sliding_best_of_search: Kernel input not sized with odd values." );
+    VW_ASSERT( search_volume[0] > 0 && search_volume[1] > 0,
+               ArgumentErr() << "sliding_best_of_search: Search volume must be greater than 0." );
+    VW_ASSERT( left.cols() >= kernel_size[0] && left.rows() >= kernel_size[1],
+               ArgumentErr() << "sliding_best_of_search: Kernel size too large of active region." );
+    VW_ASSERT( right.cols() == left.cols() + search_volume[0] - 1 &&
+               right.rows() == left.rows() + search_volume[1] - 1,
+               ArgumentErr() << "sliding_best_of_search: Right image does not cover the search volume." );
+
+    const int32 in_cols = left.cols();
+    const int32 kx = kernel_size[0], ky = kernel_size[1];
+    const int32 cols = in_cols - kx + 1, rows = left.rows() - ky + 1;
+    const ptrdiff_t lstride = left.cols(), rstride = right.cols();
+
+    // The ring holds the per-pixel costs of the ky rows under the
+    // window, plus one row for the incoming costs.
+    std::vector<T> ring_buffer( (ky + 1) * in_cols );
+    std::vector<T*> ring( ky + 1 );
+    for ( int32 i = 0; i <= ky; ++i )
+      ring[i] = &ring_buffer[i * in_cols];
+    std::vector<T> col_sum( in_cols ), box_sum( cols );
+    std::vector<T> best( cols * rows ), worst( cols * rows );
+    std::vector<int32> index( cols * rows, 0 );
+
+    int32 disparity = 0;
+    for ( int32 dy = 0; dy < search_volume[1]; ++dy ) {
+      for ( int32 dx = 0; dx < search_volume[0]; ++dx, ++disparity ) {
+        const T* lrow = left.data();
+        const T* rrow = right.data() + dy * rstride + dx;
+
+        // Seed the column sums with the first ky rows
+        std::fill( col_sum.begin(), col_sum.end(), T(0) );
+        for ( int32 r = 0; r < ky; ++r ) {
+          cost_row( ring[r], lrow + r * lstride, rrow + r * rstride, in_cols, cost_type );
+          for ( int32 i = 0; i < in_cols; ++i )
+            col_sum[i] += ring[r][i];
+        }
+
+        for ( int32 y = 0; y < rows; ++y ) {
+          // Box sums along the row
+          const T* col = &col_sum[0];
+          T sum = std::accumulate( col, col + kx, T(0) );
+          box_sum[0] = sum;
+          for ( int32 x = 1; x < cols; ++x ) {
+            sum += col[x + kx - 1] - col[x - 1];
+            box_sum[x] = sum;
+          }
+
+          T* best_row = &best[y * cols];
+          T* worst_row = &worst[y * cols];
+          if ( disparity == 0 ) {
+            std::copy( box_sum.begin(), box_sum.end(), best_row );
+            std::copy( box_sum.begin(), box_sum.end(), worst_row );
+          } else {
+            update_quality_row( best_row, worst_row, &index[y * cols],
+                                &box_sum[0], cols, disparity );
+          }
+
+          // Slide the window down a row
+          if ( y + 1 < rows ) {
+            T*& fresh = ring[ky];
+            T*& stale = ring[y % ky];
+            cost_row( fresh, lrow + (y + ky) * lstride, rrow + (y + ky) * rstride,
+                      in_cols, cost_type );
+            update_column_sums( &col_sum[0], fresh, stale, in_cols );
+            std::swap( fresh, stale );
+          }
+        }
+      }
+    }
+
+    // Best equal to worst means the costs were flat, so there is no
+    // match to speak of.
+    ImageView<PixelMask<Vector2i> > disparity_map( cols, rows );
+    PixelMask<Vector2i>* disp_ptr = disparity_map.data();
+    for ( int32 i = 0; i < cols * rows; ++i, ++disp_ptr ) {
+      *disp_ptr = PixelMask<Vector2i>( Vector2i( index[i] % search_volume[0],
+                                                 index[i] / search_volume[0] ) );
+      if ( best[i] == worst[i] )
+        invalidate( *disp_ptr );
+    }
+    return disparity_map;
+  }
+
+} // end anonymous namespace
+
 namespace vw {
 namespace stereo {
 
+  ImageView<PixelMask<Vector2i> >
+  sliding_best_of_search( ImageView<float> const& left,
+                          ImageView<float> const& right,
+                          Vector2i const& search_volume,
+                          Vector2i const& kernel_size,
+                          CostFunctionType cost_type ) {
+    return sliding_search( left, right, search_volume, kernel_size, cost_type );
+  }
+
+  ImageView<PixelMask<Vector2i> >
+  sliding_best_of_search( ImageView<int32> const& left,
+                          ImageView<int32> const& right,
+                          Vector2i const& search_volume,
+                          Vector2i const& kernel_size,
+                          CostFunctionType cost_type ) {
+    return sliding_search( left, right, search_volume, kernel_size, cost_type );
+  }
+
   inline int32 area( BBox2i const& a ) {
     int32 width = a.width();
     int32 heigh = a.height();
@@ -42,6 +319,72 @@ namespace stereo {
     a.max().y() = std::max(a.max().y(),b.max().y());
   }
 
+  SearchRangeIndex::SearchRangeIndex( int32 cell_size ) :
+    m_cell_size( cell_size ), m_size( 0 ) {
+    VW_ASSERT( cell_size > 0, ArgumentErr() << "SearchRangeIndex: cell size must be positive." );
+  }
+
+  // The range of cells covered by a region, rounding toward negative
+  // infinity so that negative coordinates bucket correctly.
+  BBox2i SearchRangeIndex::cells( BBox2i const& region ) const {
+    Vector2i lo, hi;
+    for ( int32 i = 0; i < 2; ++i ) {
+      lo[i] = region.min()[i] >= 0 ? region.min()[i] / m_cell_size
+                                   : -( ( -region.min()[i] + m_cell_size - 1 ) / m_cell_size );
+      int32 last = region.max()[i] - 1;
+      hi[i] = last >= 0 ? last / m_cell_size
+                        : -( ( -last + m_cell_size - 1 ) / m_cell_size );
+    }
+    return BBox2i( lo, hi + Vector2i(1,1) );
+  }
+
+  void SearchRangeIndex::insert( BBox2i const& region, BBox2i const& search ) {
+    if ( region.empty() ) return;
+    BBox2i span = cells( region );
+    Mutex::Lock lock( m_mutex );
+    for ( int32 y = span.min().y(); y < span.max().y(); ++y )
+      for ( int32 x = span.min().x(); x < span.max().x(); ++x )
+        m_cells[std::make_pair(x,y)].push_back( SearchParam( region, search ) );
+    ++m_size;
+  }
+
+  int32 SearchRangeIndex::query( BBox2i const& region, int32 distance,
+                                 BBox2i& search ) const {
+    // Touching regions share an edge, which BBox2i::intersects
+    // doesn't count, so grow by one more pixel than asked.
+    BBox2i touch = region;
+    touch.expand( distance + 1 );
+    BBox2i span = cells( touch );
+
+    std::vector<BBox2i> seen;
+    search = BBox2i();
+    Mutex::Lock lock( m_mutex );
+    for ( int32 y = span.min().y(); y < span.max().y(); ++y )
+      for ( int32 x = span.min().x(); x < span.max().x(); ++x ) {
+        cell_map::const_iterator cell = m_cells.find( std::make_pair(x,y) );
+        if ( cell == m_cells.end() ) continue;
+        BOOST_FOREACH( SearchParam const& entry, cell->second ) {
+          if ( !touch.intersects( entry.first ) ||
+               std::find( seen.begin(), seen.end(), entry.first ) != seen.end() )
+            continue;
+          seen.push_back( entry.first );
+          expand_bbox( search, entry.second );
+        }
+      }
+    return seen.size();
+  }
+
+  size_t SearchRangeIndex::size() const {
+    Mutex::Lock lock( m_mutex );
+    return m_size;
+  }
+
+  void SearchRangeIndex::clear() {
+    Mutex::Lock lock( m_mutex );
+    m_cells.clear();
+    m_size = 0;
+  }
+
   bool subdivide_regions( ImageView<PixelMask<Vector2i> > const& disparity,
                           BBox2i const& current_bbox,
                           std::vector<SearchParam>& list,
@@ -24,47 +24,109 @@
 #include <vw/Stereo/Correlate.h>
 #include <vw/Stereo/Algorithms.h>
 #include <vw/Stereo/CostFunctions.h>
+#include <vw/Stereo/SemiGlobalMatching.h>
 #include <vw/Core/Stopwatch.h>
+#include <vw/Core/Thread.h>
+
+#include <boost/mpl/if.hpp>
+#include <boost/type_traits/integral_constant.hpp>
+
+#include <map>
+#include <vector>
 
 namespace vw {
 namespace stereo {
 
-  // This actually RASTERIZES/COPY the input images. It then makes an
-  // allocation to store current costs.
-  //
-  // Users pass us the active region of the left image. Hopefully this
-  // allows them to consider if they need edge extension.
-  //
-  // The return size of this function will be:
-  //     return size = left_region_size - kernel_size + 1.
-  //
-  // This means the user must take in account the kernel size for
-  // deciding the region size.
-  //
-  // The size of the area we're going to access in the right is
-  // calculated as follows:
-  //     right_region = left_region + search_volume - 1.
-  //
+  /// Fused winner-take-all search for the absolute and squared
+  /// difference costs.  For each disparity the per-pixel costs of a
+  /// new row are computed into a ring of kernel_size[1] rows, the
+  /// running column sums are updated with the difference between the
+  /// new and the departing row, and the box sums along the row are
+  /// compared against the best and worst costs as they are produced.
+  /// No memory is allocated inside the search loop.  The arguments
+  /// and result follow best_of_search_convolution, with both images
+  /// already rasterized; cost_type is ABSOLUTE_DIFFERENCE or
+  /// SQUARED_DIFFERENCE.
+  ImageView<PixelMask<Vector2i> >
+  sliding_best_of_search( ImageView<float> const& left,
+                          ImageView<float> const& right,
+                          Vector2i const& search_volume,
+                          Vector2i const& kernel_size,
+                          CostFunctionType cost_type );
+
+  /// Integer version of sliding_best_of_search(), for images whose
+  /// pixels were 8 or 16 bit integers.  Sums are exact.
+  ImageView<PixelMask<Vector2i> >
+  sliding_best_of_search( ImageView<int32> const& left,
+                          ImageView<int32> const& right,
+                          Vector2i const& search_volume,
+                          Vector2i const& kernel_size,
+                          CostFunctionType cost_type );
+
+  /// \cond INTERNAL
+  namespace correlation {
+
+    /// Whether best_of_search_convolution can hand a cost function
+    /// to sliding_best_of_search(), and which buffer type it then
+    /// rasterizes to.  This holds for the absolute and squared
+    /// difference costs on unmasked single channel images of the same
+    /// pixel type.  Squared differences of 16 bit pixels could
+    /// overflow an int32 and use the generic path.
+    template <template<class,bool> class CostFuncT, class PixelT1, class PixelT2>
+    struct SlidingSearch {
+      typedef typename CompoundChannelType<PixelT1>::type channel_type;
+      static const bool single_channel =
+        boost::is_same<PixelT1, PixelT2>::value && !IsMasked<PixelT1>::value &&
+        CompoundNumChannels<PixelT1>::value == 1;
+      static const bool is_float = boost::is_same<channel_type, float>::value;
+      static const bool is_small_int =
+        boost::is_same<channel_type, uint8>::value || boost::is_same<channel_type, int8>::value;
+      static const bool is_int =
+        is_small_int || boost::is_same<channel_type, uint16>::value || boost::is_same<channel_type, int16>::value;
+      static const bool is_absolute = boost::is_same<AbsoluteCost<ImageView<PixelT1>,false>,
+                                                     CostFuncT<ImageView<PixelT1>,false> >::value;
+      static const bool is_squared = boost::is_same<SquaredCost<ImageView<PixelT1>,false>,
+                                                    CostFuncT<ImageView<PixelT1>,false> >::value;
+      static const bool value = single_channel &&
+        ( ( is_absolute && ( is_float || is_int ) ) || ( is_squared && ( is_float || is_small_int ) ) );
+      static const CostFunctionType cost_type = is_squared ? SQUARED_DIFFERENCE : ABSOLUTE_DIFFERENCE;
+      typedef typename boost::mpl::if_c<is_float, float, int32>::type buffer_type;
+      typedef boost::integral_constant<bool, value> type;
+    };
+
+  } // namespace correlation
+  /// \endcond
+
   template <template<class,bool> class CostFuncT, class ImageT1, class ImageT2>
   ImageView<PixelMask<Vector2i> >
   best_of_search_convolution( ImageViewBase<ImageT1> const& left,
                               ImageViewBase<ImageT2> const& right,
                               BBox2i const& left_region,
                               Vector2i const& search_volume,
-                              Vector2i const& kernel_size ) {
-    // Sanity check the input:
-    VW_DEBUG_ASSERT( kernel_size[0] % 2 == 1 && kernel_size[1] % 2 == 1,
-                     ArgumentErr() << "best_of_search_convolution: Kernel input not sized with odd values." );
-    VW_DEBUG_ASSERT( kernel_size[0] <= left_region.width() &&
-                     kernel_size[1] <= left_region.height(),
-                     ArgumentErr() << "best_of_search_convolution: Kernel size too large of active region." );
-    VW_DEBUG_ASSERT( search_volume[0] > 0 && search_volume[1] > 0,
-                     ArgumentErr() << "best_of_search_convolution: Search volume must be greater than 0." );
-    VW_DEBUG_ASSERT( left_region.min().x() >= 0 &&  left_region.min().y() >= 0 &&
-                     left_region.max().x() <= left.impl().cols() &&
-                     left_region.max().y() <= left.impl().rows(),
-                     ArgumentErr() << "best_of_search_convolution: Region not inside left image." );
+                              Vector2i const& kernel_size,
+                              boost::true_type /*sliding*/ ) {
+    typedef correlation::SlidingSearch<CostFuncT, typename ImageT1::pixel_type,
+                                       typename ImageT2::pixel_type> sliding;
+    typedef typename sliding::buffer_type BufferT;
 
+    BBox2i right_region = left_region;
+    right_region.max() += search_volume - Vector2i(1,1);
+    ImageView<BufferT> left_raster =
+      channel_cast<BufferT>( select_channel( crop(left.impl(), left_region), 0 ) );
+    ImageView<BufferT> right_raster =
+      channel_cast<BufferT>( select_channel( crop(right.impl(), right_region), 0 ) );
+    return sliding_best_of_search( left_raster, right_raster, search_volume,
+                                   kernel_size, sliding::cost_type );
+  }
+
+  template <template<class,bool> class CostFuncT, class ImageT1, class ImageT2>
+  ImageView<PixelMask<Vector2i> >
+  best_of_search_convolution( ImageViewBase<ImageT1> const& left,
+                              ImageViewBase<ImageT2> const& right,
+                              BBox2i const& left_region,
+                              Vector2i const& search_volume,
+                              Vector2i const& kernel_size,
+                              boost::false_type /*sliding*/ ) {
     typedef typename ImageT1::pixel_type PixelT1;
     typedef typename ImageT2::pixel_type PixelT2;
     typedef typename CostFuncT<ImageT1,boost::is_integral<typename PixelChannelType<PixelT1>::type>::value>::accumulator_type AccumChannelT;
@@ -156,6 +218,51 @@ namespace stereo {
     return disparity_map;
   }
 
+  // This actually RASTERIZES/COPY the input images. It then makes an
+  // allocation to store current costs.
+  //
+  // Users pass us the active region of the left image. Hopefully this
+  // allows them to consider if they need edge extension.
+  //
+  // The return size of this function will be:
+  //     return size = left_region_size - kernel_size + 1.
+  //
+  // This means the user must take in account the kernel size for
+  // deciding the region size.
+  //
+  // The size of the area we're going to access in the right is
+  // calculated as follows:
+  //     right_region = left_region + search_volume - 1.
+  //
+  template <template<class,bool> class CostFuncT, class ImageT1, class ImageT2>
+  ImageView<PixelMask<Vector2i> >
+  best_of_search_convolution( ImageViewBase<ImageT1> const& left,
+                              ImageViewBase<ImageT2> const& right,
+                              BBox2i const& left_region,
+                              Vector2i const& search_volume,
+                              Vector2i const& kernel_size ) {
+    // Sanity check the input:
+    VW_DEBUG_ASSERT( kernel_size[0] % 2 == 1 && kernel_size[1] % 2 == 1,
+                     ArgumentErr() << "best_of_search_convolution: Kernel input not sized with odd values." );
+    VW_DEBUG_ASSERT( kernel_size[0] <= left_region.width() &&
+                     kernel_size[1] <= left_region.height(),
+                     ArgumentErr() << "best_of_search_convolution: Kernel size too large of active region." );
+    VW_DEBUG_ASSERT( search_volume[0] > 0 && search_volume[1] > 0,
+                     ArgumentErr() << "best_of_search_convolution: Search volume must be greater than 0." );
+    VW_DEBUG_ASSERT( left_region.min().x() >= 0 &&  left_region.min().y() >= 0 &&
+                     left_region.max().x() <= left.impl().cols() &&
+                     left_region.max().y() <= left.impl().rows(),
+                     ArgumentErr() << "best_of_search_convolution: Region not inside left image." );
+
+    // Absolute and squared differences of plain images go through
+    // the fused sliding window search. Everything else builds a cost
+    // image per disparity and box sums it.
+    typedef typename correlation::SlidingSearch<CostFuncT, typename ImageT1::pixel_type,
+                                                typename ImageT2::pixel_type>::type sliding;
+    return best_of_search_convolution<CostFuncT>( left, right, left_region, search_volume,
+                                                  kernel_size, sliding() );
+  }
+
   template <class ImageT1, class ImageT2>
   ImageView<PixelMask<Vector2i> >
   calc_disparity(CostFunctionType cost_type,
@@ -163,13 +270,21 @@ namespace stereo {
                  ImageViewBase<ImageT2> const& right,
                  BBox2i const& left_region,
                  Vector2i const& search_volume,
-                 Vector2i const& kernel_size){
+                 Vector2i const& kernel_size,
+                 SemiGlobalOptions const& sgm_options = SemiGlobalOptions()){
 
-    // A wrapper around the best_of_search_convolution function.
+    // A wrapper around the best_of_search_convolution and
+    // semi_global_matching functions.
 
     ImageView<PixelMask<Vector2i> > disparity;
 
     switch ( cost_type ) {
+    case SEMI_GLOBAL_CENSUS:
+    case SEMI_GLOBAL_ABSOLUTE_DIFFERENCE:
+      disparity =
+        semi_global_matching(left, right, left_region, search_volume,
+                             kernel_size, cost_type, sgm_options);
+      break;
     case CROSS_CORRELATION:
       disparity =
         best_of_search_convolution<NCCCost>(left, right, left_region,
@@ -208,39 +323,41 @@ namespace stereo {
                              Vector2i const& kernel_size
                              ){
 
-    // Create fake left and right images and search volume.  Do a fake
-    // disparity calculation. Divide the run-time of this calculation
+    // Create fake left and right images and search volume.  Do fake
+    // disparity calculations. Divide the run-time of these calculations
     // by left region size times search box size. This will enable us
     // to estimate how long disparity calculation takes for given cost
     // function and kernel size.
-
-    double elapsed = -1.0;
-    double seconds_per_op = -1.0;
-
-    // We don't know what sizes to use to get a reliable time estimate.
-    // So increase the size until the time estimate is a second.
-    int lsize = 100;
-    while (elapsed < 1.0){
-
-      lsize = (int)ceil(lsize*1.2);
-
-      ImageView<typename ImageT1::pixel_type> fake_left(lsize, lsize);
-      for (int col = 0; col < fake_left.cols(); col++){
-        for (int row = 0; row < fake_left.rows(); row++){
-          fake_left(col, row) = col%2 + 2*(row%5); // some values
-        }
+    //
+    // The sliding window search costs about the same per pixel per
+    // disparity whatever the size of the problem, so rather than
+    // growing one problem until it takes a second, we repeat one shaped
+    // like the zones PyramidCorrelationView searches: a region of
+    // 64x64 results with its kernel border and a 2D search of 16x8.
+    Vector2i lsize = Vector2i(64, 64) + kernel_size - Vector2i(1,1);
+    Vector2i search_size(16, 8);
+
+    ImageView<typename ImageT1::pixel_type> fake_left(lsize[0], lsize[1]);
+    for (int col = 0; col < fake_left.cols(); col++){
+      for (int row = 0; row < fake_left.rows(); row++){
+        fake_left(col, row) = col%2 + 2*(row%5); // some values
       }
+    }
 
-      ImageView<typename ImageT2::pixel_type> fake_right(4*lsize, 4*lsize);
-      for (int col = 0; col < fake_right.cols(); col++){
-        for (int row = 0; row < fake_right.rows(); row++){
-          fake_right(col, row) = 3*(col%7) + row%3; // some values
-        }
+    ImageView<typename ImageT2::pixel_type> fake_right(lsize[0] + search_size[0],
+                                                       lsize[1] + search_size[1]);
+    for (int col = 0; col < fake_right.cols(); col++){
+      for (int row = 0; row < fake_right.rows(); row++){
+        fake_right(col, row) = 3*(col%7) + row%3; // some values
       }
+    }
 
-      BBox2i search_region(0, 0, lsize/5, lsize/5);
-      BBox2i left_region = bounding_box(fake_left);
+    BBox2i search_region(Vector2i(), search_size);
+    BBox2i left_region = bounding_box(fake_left);
 
+    // Repeat until the total is long enough to measure reliably.
+    double elapsed = 0.0, ops = 0.0, checksum = 0.0;
+    while (elapsed < 0.25){
       Stopwatch watch;
       watch.start();
       ImageView<PixelMask<Vector2i> > disparity =
@@ -248,14 +365,14 @@ namespace stereo {
                        left_region, search_region.size(), kernel_size);
       watch.stop();
 
-      // Note: We add an infinitesimal contribution of disparity, lest
-      // the compiler tries to optimize away the above calculation due
-      // to its result being unused.
-      elapsed = watch.elapsed_seconds()
-        + 1e-40*disparity(0, 0).child().x();
-      seconds_per_op
-        = elapsed/search_volume(SearchParam(left_region, search_region));
+      // Note: We keep a checksum of the disparity, lest the compiler
+      // tries to optimize away the above calculation due to its
+      // result being unused.
+      elapsed  += watch.elapsed_seconds();
+      checksum += disparity(0, 0).child().x();
+      ops      += search_volume(SearchParam(left_region, search_region));
     }
+    double seconds_per_op = elapsed/ops + 1e-40*checksum;
 
     return seconds_per_op;
   }
@@ -269,6 +386,34 @@ namespace stereo {
     }
   };
 
+  /// A spatial index of the disparity ranges found for regions of an
+  /// image, so that a region can start its search from the ranges of
+  /// neighbours that have already been solved instead of the full
+  /// search region. Regions are bucketed into a grid of square cells.
+  /// All methods are thread safe.
+  class SearchRangeIndex {
+    typedef std::map<std::pair<int32,int32>, std::vector<SearchParam> > cell_map;
+    int32 m_cell_size;
+    cell_map m_cells;
+    size_t m_size;
+    mutable Mutex m_mutex;
+
+    BBox2i cells( BBox2i const& region ) const;
+  public:
+    SearchRangeIndex( int32 cell_size = 256 );
+
+    /// Record that disparities within search were found in region.
+    void insert( BBox2i const& region, BBox2i const& search );
+
+    /// Sets search to the union of the ranges recorded for regions
+    /// that overlap or touch region grown by distance pixels, and
+    /// returns the number of such regions.
+    int32 query( BBox2i const& region, int32 distance, BBox2i& search ) const;
+
+    size_t size() const;
+    void clear();
+  };
+
   // Developer tools for modifying bboxes.
   inline int32 area( BBox2i const& a );
   inline void expand_bbox( BBox2i& a, BBox2i const& b );
@@ -23,6 +23,8 @@
 #include <vw/Core/Stopwatch.h>
 #include <vw/Core/Thread.h>
 #include <vw/Image/Algorithms.h>
+#include <vw/Image/BlockRasterize.h>
+#include <vw/Image/ImageViewRef.h>
 #include <vw/FileIO.h>
 #include <vw/Stereo/PreFilter.h>
 #include <vw/Stereo/Correlation.h>
@@ -43,6 +45,7 @@ namespace stereo {
     Vector2i m_kernel_size;
     CostFunctionType m_cost_type;
     float m_consistency_threshold; // 0 = means don't do a consistency check
+    SemiGlobalOptions m_sgm_options;
 
   public:
     typedef PixelMask<Vector2i> pixel_type;
@@ -54,10 +57,12 @@ namespace stereo {
                      PreFilterBase<PreFilterT> const& prefilter,
                      BBox2i const& search_region, Vector2i const& kernel_size,
                      CostFunctionType cost_type = ABSOLUTE_DIFFERENCE,
-                     float consistency_threshold = -1 ) :
+                     float consistency_threshold = -1,
+                     SemiGlobalOptions const& sgm_options = SemiGlobalOptions() ) :
       m_left_image(left.impl()), m_right_image(right.impl()),
       m_prefilter(prefilter.impl()), m_search_region(search_region), m_kernel_size(kernel_size),
-      m_cost_type(cost_type), m_consistency_threshold(consistency_threshold) {}
+      m_cost_type(cost_type), m_consistency_threshold(consistency_threshold),
+      m_sgm_options(sgm_options) {}
 
     // Standard required ImageView interfaces
     inline int32 cols() const { return m_left_image.cols(); }
@@ -96,7 +101,7 @@ namespace stereo {
                          crop(m_prefilter.filter(m_right_image),right_region),
                          left_region - left_region.min(),
                          m_search_region.size() + Vector2i(1,1),
-                         m_kernel_size);
+                         m_kernel_size, m_sgm_options);
 
       // 4.0 ) Consistency check
       if ( m_consistency_threshold >= 0 ) {
@@ -111,7 +116,7 @@ namespace stereo {
                                 -(m_search_region.size()+Vector2i(1,1))),
                            right_region - right_region.min(),
                            m_search_region.size() + Vector2i(1,1),
-                           m_kernel_size) -
+                           m_kernel_size, m_sgm_options) -
           pixel_type(m_search_region.size()+Vector2i(1,1));
 
         stereo::cross_corr_consistency_check( result, rl_result,
@@ -144,10 +149,11 @@ namespace stereo {
              PreFilterBase<PreFilterT> const& filter,
              BBox2i const& search_region, Vector2i const& kernel_size,
              CostFunctionType cost_type = ABSOLUTE_DIFFERENCE,
-             float consistency_threshold = -1 ) {
+             float consistency_threshold = -1,
+             SemiGlobalOptions const& sgm_options = SemiGlobalOptions() ) {
     typedef CorrelationView<Image1T,Image2T,PreFilterT> result_type;
     return result_type( left.impl(), right.impl(), filter.impl(), search_region,
-                        kernel_size, cost_type, consistency_threshold );
+                        kernel_size, cost_type, consistency_threshold, sgm_options );
   }
 
   /// An image view for performing pyramid image correlation (Faster
@@ -168,6 +174,30 @@ namespace stereo {
     double m_seconds_per_op;
     float m_consistency_threshold; // < 0 = means don't do a consistency check
     int32 m_max_level_by_search;
+    SemiGlobalOptions m_sgm_options;
+
+    typedef typename Image1T::pixel_type left_pixel_type;
+    typedef typename Image2T::pixel_type right_pixel_type;
+    typedef typename Mask1T::pixel_type left_mask_type;
+    typedef typename Mask2T::pixel_type right_mask_type;
+
+    // Image and mask pyramids of the whole input, shared by every
+    // tile and every copy of this view. They are set up on first use;
+    // level i+1 is level i blurred and subsampled, and is computed a
+    // block at a time through the system cache as tiles ask for it.
+    // The right pyramid starts at the corner of the search region so
+    // that its pixels line up with the left pyramid's at every level.
+    struct SharedPyramid {
+      Mutex mutex;
+      bool built, usable;
+      std::vector<ImageViewRef<left_pixel_type> > left;
+      std::vector<ImageViewRef<right_pixel_type> > right;
+      std::vector<ImageViewRef<left_mask_type> > left_mask;
+      std::vector<ImageViewRef<right_mask_type> > right_mask;
+      SharedPyramid() : built(false), usable(false) {}
+    };
+    boost::shared_ptr<SharedPyramid> m_pyramid;
+    boost::shared_ptr<SearchRangeIndex> m_seeds; // Null unless seeding is enabled
 
     struct SubsampleMaskByTwoFunc : public ReturnFixedType<uint8> {
       BBox2i work_area() const { return BBox2i(0,0,2,2); }
@@ -198,6 +228,205 @@ namespace stereo {
       return subsample(per_pixel_accessor_filter(input.impl(), SubsampleMaskByTwoFunc()),2);
     }
 
+    // Szeliski's book recommended this simple kernel.
+    static std::vector<typename DefaultKernelT<left_pixel_type>::type> pyramid_kernel() {
+      std::vector<typename DefaultKernelT<left_pixel_type>::type> kernel(5);
+      kernel[0] = kernel[4] = 1.0/16.0;
+      kernel[1] = kernel[3] = 4.0/16.0;
+      kernel[2] = 6.0/16.0;
+      return kernel;
+    }
+
+    // Mean of the valid pixels of an image. It's only used to fill in
+    // nodata, so it is estimated from a grid of small windows rather
+    // than reading every block of a large image. Throws ArgumentErr
+    // if no sampled pixel is valid.
+    template <class ViewT, class MaskT>
+    static typename ViewT::pixel_type
+    sampled_mean( ViewT const& image, MaskT const& mask ) {
+      typedef typename ViewT::pixel_type PixelT;
+      typedef typename CompoundChannelCast<PixelT,double>::type SumT;
+      const int32 grid = 16, window = 32;
+      SumT sum = SumT();
+      int64 count = 0;
+      for ( int32 gy = 0; gy < grid; ++gy )
+        for ( int32 gx = 0; gx < grid; ++gx ) {
+          BBox2i sample( Vector2i( gx * image.cols() / grid, gy * image.rows() / grid ),
+                         Vector2i( (gx + 1) * image.cols() / grid, (gy + 1) * image.rows() / grid ) );
+          if ( sample.width() > window ) sample.max().x() = sample.min().x() + window;
+          if ( sample.height() > window ) sample.max().y() = sample.min().y() + window;
+          if ( sample.empty() ) continue;
+          ImageView<PixelMask<PixelT> > pixels = crop( copy_mask( image, create_mask( mask, 0 ) ), sample );
+          for ( int32 j = 0; j < pixels.rows(); ++j )
+            for ( int32 i = 0; i < pixels.cols(); ++i )
+              if ( is_valid( pixels(i,j) ) ) {
+                sum += channel_cast<double>( pixels(i,j).child() );
+                ++count;
+              }
+        }
+      if ( count == 0 )
+        vw_throw( ArgumentErr() << "PyramidCorrelationView: image has no valid pixels." );
+      return channel_cast<typename CompoundChannelType<PixelT>::type>( sum / double(count) );
+    }
+
+    SharedPyramid const& shared_pyramid() const {
+      SharedPyramid& pyramid = *m_pyramid;
+      Mutex::Lock lock( pyramid.mutex );
+      if ( pyramid.built )
+        return pyramid;
+      pyramid.built = true;
+
+      Vector2i right_size = Vector2i( m_right_image.cols(), m_right_image.rows() ) - m_search_region.min();
+      if ( right_size.x() <= 0 || right_size.y() <= 0 )
+        return pyramid;
+
+      // Fill in the nodata of the left and right images with a mean
+      // pixel value. This helps with the edge quality of a DEM.
+      left_pixel_type left_mean;
+      right_pixel_type right_mean;
+      try {
+        left_mean = sampled_mean( m_left_image, m_left_mask );
+        right_mean = sampled_mean( m_right_image, m_right_mask );
+      } catch ( const ArgumentErr& ) {
+        // Let each tile find out for itself whether it has data.
+        return pyramid;
+      }
+
+      BBox2i right_frame( m_search_region.min(), m_search_region.min() + right_size );
+      pyramid.left.push_back( apply_mask( copy_mask( m_left_image, create_mask( m_left_mask, 0 ) ), left_mean ) );
+      pyramid.right.push_back( crop( edge_extend( apply_mask( copy_mask( m_right_image, create_mask( m_right_mask, 0 ) ),
+                                                              right_mean ) ), right_frame ) );
+      pyramid.left_mask.push_back( m_left_mask );
+      pyramid.right_mask.push_back( crop( edge_extend( m_right_mask, ConstantEdgeExtension() ), right_frame ) );
+
+      std::vector<typename DefaultKernelT<left_pixel_type>::type> kernel = pyramid_kernel();
+      Vector2i block( vw_settings().default_tile_size(), vw_settings().default_tile_size() );
+      for ( int32 i = 0; i < m_max_level_by_search; ++i ) {
+        pyramid.left.push_back( block_cache( pixel_cast<left_pixel_type>( subsample( separable_convolution_filter( pyramid.left[i], kernel, kernel ), 2 ) ), block, 1 ) );
+        pyramid.right.push_back( block_cache( pixel_cast<right_pixel_type>( subsample( separable_convolution_filter( pyramid.right[i], kernel, kernel ), 2 ) ), block, 1 ) );
+        pyramid.left_mask.push_back( block_cache( pixel_cast<left_mask_type>( subsample_mask_by_two( pyramid.left_mask[i] ) ), block, 1 ) );
+        pyramid.right_mask.push_back( block_cache( pixel_cast<right_mask_type>( subsample_mask_by_two( pyramid.right_mask[i] ) ), block, 1 ) );
+      }
+      pyramid.usable = true;
+      return pyramid;
+    }
+
+    template <class MaskT>
+    static bool has_valid_pixel( ImageViewBase<MaskT> const& mask ) {
+      ImageView<typename MaskT::pixel_type> pixels = mask.impl();
+      for ( int32 j = 0; j < pixels.rows(); ++j )
+        for ( int32 i = 0; i < pixels.cols(); ++i )
+          if ( is_valid( create_mask( pixels, 0 )(i,j) ) )
+            return true;
+      return false;
+    }
+
+    // Crop the levels of one tile out of the shared pyramid. The tile's
+    // corner must lie on the grid of the coarsest level used.
+    bool crop_shared_pyramid( BBox2i const& bbox, int32 max_pyramid_levels,
+                              BBox2i const& left_global_region,
+                              BBox2i const& right_global_region,
+                              std::vector<ImageView<left_pixel_type> >& left_pyramid,
+                              std::vector<ImageView<right_pixel_type> >& right_pyramid,
+                              std::vector<ImageView<left_mask_type> >& left_mask_pyramid,
+                              std::vector<ImageView<right_mask_type> >& right_mask_pyramid ) const {
+      SharedPyramid const& pyramid = shared_pyramid();
+      if ( !has_valid_pixel( crop( edge_extend( m_left_mask, ConstantEdgeExtension() ), left_global_region ) ) ||
+           !has_valid_pixel( crop( edge_extend( m_right_mask, ConstantEdgeExtension() ), right_global_region ) ) )
+        return false;
+
+      // Levels are cropped to the sizes that subsampling the level
+      // below would give, as build_tile_pyramid() does.
+      BBox2i right_region = right_global_region - m_search_region.min();
+      Vector2i left_size = left_global_region.size(), right_size = right_region.size();
+      Vector2i left_mask_size = bbox.size(), right_mask_size = bbox.size() + m_search_region.size();
+      for ( int32 i = 0; i <= max_pyramid_levels; ++i ) {
+        int32 scaling = 1 << i;
+        Vector2i left_corner = left_global_region.min() / scaling;
+        Vector2i right_corner = right_region.min() / scaling;
+        Vector2i mask_corner = bbox.min() / scaling;
+        left_pyramid[i] = m_prefilter.filter( crop( edge_extend( pyramid.left[i] ),
+                                                    BBox2i( left_corner, left_corner + left_size ) ) );
+        right_pyramid[i] = m_prefilter.filter( crop( edge_extend( pyramid.right[i] ),
+                                                     BBox2i( right_corner, right_corner + right_size ) ) );
+        left_mask_pyramid[i] = crop( edge_extend( pyramid.left_mask[i], ConstantEdgeExtension() ),
+                                     BBox2i( mask_corner, mask_corner + left_mask_size ) );
+        right_mask_pyramid[i] = crop( edge_extend( pyramid.right_mask[i], ConstantEdgeExtension() ),
+                                      BBox2i( mask_corner, mask_corner + right_mask_size ) );
+        left_size = ( left_size + Vector2i(1,1) ) / 2;
+        right_size = ( right_size + Vector2i(1,1) ) / 2;
+        left_mask_size = ( left_mask_size + Vector2i(1,1) ) / 2;
+        right_mask_size = ( right_mask_size + Vector2i(1,1) ) / 2;
+      }
+      return true;
+    }
+
+    // Build the levels of one tile from scratch.
+    bool build_tile_pyramid( BBox2i const& bbox, int32 max_pyramid_levels,
+                             BBox2i const& left_global_region,
+                             BBox2i const& right_global_region,
+                             std::vector<ImageView<left_pixel_type> >& left_pyramid,
+                             std::vector<ImageView<right_pixel_type> >& right_pyramid,
+                             std::vector<ImageView<left_mask_type> >& left_mask_pyramid,
+                             std::vector<ImageView<right_mask_type> >& right_mask_pyramid ) const {
+      left_pyramid[0] = crop(edge_extend(m_left_image),left_global_region);
+      right_pyramid[0] = crop(edge_extend(m_right_image),right_global_region);
+      left_mask_pyramid[0] =
+        crop(edge_extend(m_left_mask,ConstantEdgeExtension()),
+             left_global_region);
+      right_mask_pyramid[0] =
+        crop(edge_extend(m_right_mask,ConstantEdgeExtension()),
+             right_global_region);
+
+      // Fill in the nodata of the left and right images with a mean
+      // pixel value. This helps with the edge quality of a DEM.
+      left_pixel_type left_mean;
+      right_pixel_type right_mean;
+      try {
+        left_mean =
+          mean_pixel_value(subsample(copy_mask(left_pyramid[0],
+                                               create_mask(left_mask_pyramid[0],0)),2));
+        right_mean =
+          mean_pixel_value(subsample(copy_mask(right_pyramid[0],
+                                               create_mask(right_mask_pyramid[0],0)),2));
+      } catch ( const ArgumentErr& err ) {
+        // Mean pixel value will throw an argument error if there
+        // are no valid pixels. If that happens, it means either the
+        // left or the right image is full masked.
+        return false;
+      }
+      left_pyramid[0] = apply_mask(copy_mask(left_pyramid[0],create_mask(left_mask_pyramid[0],0)), left_mean );
+      right_pyramid[0] = apply_mask(copy_mask(right_pyramid[0],create_mask(right_mask_pyramid[0],0)), right_mean );
+
+      // Don't actually need the whole over cropped disparity
+      // mask. We only need the active region. I over cropped before
+      // just to calculate the mean color value options.
+      BBox2i right_mask = bbox + m_search_region.min();
+      right_mask.max() += m_search_region.size();
+      left_mask_pyramid[0] =
+        crop(left_mask_pyramid[0],bbox - left_global_region.min());
+      right_mask_pyramid[0] =
+        crop(right_mask_pyramid[0],right_mask - right_global_region.min());
+
+      // This operation is quickly becoming a time sink, we might
+      // possibly want to write an integer optimized version.
+      std::vector<typename DefaultKernelT<left_pixel_type>::type > kernel = pyramid_kernel();
+
+      // Build the pyramid first and then apply the filter to each
+      // level.
+      for ( int32 i = 0; i < max_pyramid_levels; ++i ) {
+        left_pyramid[i+1] = subsample(separable_convolution_filter(left_pyramid[i],kernel,kernel),2);
+        right_pyramid[i+1] = subsample(separable_convolution_filter(right_pyramid[i],kernel,kernel),2);
+        left_pyramid[i] = m_prefilter.filter(left_pyramid[i]);
+        right_pyramid[i] = m_prefilter.filter(right_pyramid[i]);
+        left_mask_pyramid[i+1] = subsample_mask_by_two(left_mask_pyramid[i]);
+        right_mask_pyramid[i+1] = subsample_mask_by_two(right_mask_pyramid[i]);
+      }
+      left_pyramid[max_pyramid_levels] = m_prefilter.filter(left_pyramid[max_pyramid_levels]);
+      right_pyramid[max_pyramid_levels] = m_prefilter.filter(right_pyramid[max_pyramid_levels]);
+      return true;
+    }
+
   public:
     typedef PixelMask<Vector2i> pixel_type;
     typedef PixelMask<Vector2i> result_type;
@@ -212,13 +441,15 @@ namespace stereo {
                             CostFunctionType cost_type,
                             int corr_timeout, double seconds_per_op,
                             float consistency_threshold,
-                            int32 max_pyramid_levels) :
+                            int32 max_pyramid_levels,
+                            SemiGlobalOptions const& sgm_options = SemiGlobalOptions()) :
       m_left_image(left.impl()), m_right_image(right.impl()),
       m_left_mask(left_mask.impl()), m_right_mask(right_mask.impl()),
       m_prefilter(prefilter.impl()), m_search_region(search_region), m_kernel_size(kernel_size),
       m_cost_type(cost_type),
       m_corr_timeout(corr_timeout), m_seconds_per_op(seconds_per_op),
-      m_consistency_threshold(consistency_threshold){
+      m_consistency_threshold(consistency_threshold), m_sgm_options(sgm_options),
+      m_pyramid(new SharedPyramid()){
       // Calculating max pyramid levels according to the supplied
       // search region.
       int32 largest_search = max( search_region.size() );
@@ -229,6 +460,18 @@ namespace stereo {
         m_max_level_by_search = 0;
     }
 
+    /// Let each tile start its search from the disparity ranges that
+    /// neighbouring tiles have already found, plus some slack, instead
+    /// of the whole search region. This saves time on large search
+    /// regions, but results then depend on the order tiles are
+    /// processed in, so it is off by default.
+    void set_search_seeding( bool enable ) {
+      if ( !enable )
+        m_seeds.reset();
+      else if ( !m_seeds )
+        m_seeds.reset( new SearchRangeIndex() );
+    }
+
     // Standard required ImageView interfaces
     inline int32 cols() const { return m_left_image.cols(); }
     inline int32 rows() const { return m_left_image.rows(); }
@@ -268,102 +511,87 @@ namespace stereo {
       Vector2i half_kernel = m_kernel_size/2;
 
       // 2.0) Build the pyramid
-      std::vector<ImageView<typename Image1T::pixel_type> > left_pyramid(max_pyramid_levels + 1 );
-      std::vector<ImageView<typename Image2T::pixel_type> > right_pyramid(max_pyramid_levels + 1 );
-      std::vector<ImageView<typename Mask1T::pixel_type> > left_mask_pyramid(max_pyramid_levels + 1 );
-      std::vector<ImageView<typename Mask2T::pixel_type> > right_mask_pyramid(max_pyramid_levels + 1 );
+      std::vector<ImageView<left_pixel_type> > left_pyramid(max_pyramid_levels + 1 );
+      std::vector<ImageView<right_pixel_type> > right_pyramid(max_pyramid_levels + 1 );
+      std::vector<ImageView<left_mask_type> > left_mask_pyramid(max_pyramid_levels + 1 );
+      std::vector<ImageView<right_mask_type> > right_mask_pyramid(max_pyramid_levels + 1 );
       int32 max_upscaling = 1 << max_pyramid_levels;
       BBox2i left_global_region, right_global_region;
-      {
-        left_global_region = bbox;
-        left_global_region.min() -= half_kernel * max_upscaling;
-        left_global_region.max() += half_kernel * max_upscaling;
-        right_global_region = left_global_region + m_search_region.min();
-        right_global_region.max() += m_search_region.size() + Vector2i(max_upscaling,max_upscaling);
-        left_pyramid[0] = crop(edge_extend(m_left_image),left_global_region);
-        right_pyramid[0] = crop(edge_extend(m_right_image),right_global_region);
-        left_mask_pyramid[0] =
-          crop(edge_extend(m_left_mask,ConstantEdgeExtension()),
-               left_global_region);
-        right_mask_pyramid[0] =
-          crop(edge_extend(m_right_mask,ConstantEdgeExtension()),
-               right_global_region);
+      left_global_region = bbox;
+      left_global_region.min() -= half_kernel * max_upscaling;
+      left_global_region.max() += half_kernel * max_upscaling;
+      right_global_region = left_global_region + m_search_region.min();
+      right_global_region.max() += m_search_region.size() + Vector2i(max_upscaling,max_upscaling);
 
 #if VW_DEBUG_LEVEL > 0
-        VW_OUT(DebugMessage,"stereo") << " > Left ROI: " << left_global_region
-                                      << "\n > Right ROI: " << right_global_region << "\n";
+      VW_OUT(DebugMessage,"stereo") << " > Left ROI: " << left_global_region
+                                    << "\n > Right ROI: " << right_global_region << "\n";
+      Stopwatch pyramid_watch;
+      pyramid_watch.start();
 #endif
 
-        // Fill in the nodata of the left and right images with a mean
-        // pixel value. This helps with the edge quality of a DEM.
-        typename Image1T::pixel_type left_mean;
-        typename Image2T::pixel_type right_mean;
-        try {
-          left_mean =
-            mean_pixel_value(subsample(copy_mask(left_pyramid[0],
-                                                 create_mask(left_mask_pyramid[0],0)),2));
-          right_mean =
-            mean_pixel_value(subsample(copy_mask(right_pyramid[0],
-                                                 create_mask(right_mask_pyramid[0],0)),2));
-        } catch ( const ArgumentErr& err ) {
-          // Mean pixel value will throw an argument error if there
-          // are no valid pixels. If that happens, it means either the
-          // left or the right image is full masked.
+      // Tiles whose corner falls on the coarsest pixel grid can crop
+      // their levels out of the shared pyramid. Others, and a tile that
+      // is the whole image and so has nothing to share, build their own.
+      bool shared = bbox.min().x() % max_upscaling == 0 &&
+        bbox.min().y() % max_upscaling == 0 &&
+        bbox != bounding_box(*this) && shared_pyramid().usable;
+      bool has_data = shared ?
+        crop_shared_pyramid( bbox, max_pyramid_levels,
+                             left_global_region, right_global_region,
+                             left_pyramid, right_pyramid,
+                             left_mask_pyramid, right_mask_pyramid ) :
+        build_tile_pyramid( bbox, max_pyramid_levels,
+                            left_global_region, right_global_region,
+                            left_pyramid, right_pyramid,
+                            left_mask_pyramid, right_mask_pyramid );
+
 #if VW_DEBUG_LEVEL > 0
-          watch.stop();
-          double elapsed = watch.elapsed_seconds();
-          vw_out(DebugMessage,"stereo")
-            << "Tile " << bbox << " has no data. Processed in "
-            << elapsed << " s\n";
+      pyramid_watch.stop();
 #endif
-          return prerasterize_type(ImageView<pixel_type>(bbox.width(),
-                                                         bbox.height()),
-                                   -bbox.min().x(), -bbox.min().y(),
-                                   cols(), rows() );
-        }
-        left_pyramid[0] = apply_mask(copy_mask(left_pyramid[0],create_mask(left_mask_pyramid[0],0)), left_mean );
-        right_pyramid[0] = apply_mask(copy_mask(right_pyramid[0],create_mask(right_mask_pyramid[0],0)), right_mean );
-
-        // Don't actually need the whole over cropped disparity
-        // mask. We only need the active region. I over cropped before
-        // just to calculate the mean color value options.
-        BBox2i right_mask = bbox + m_search_region.min();
-        right_mask.max() += m_search_region.size();
-        left_mask_pyramid[0] =
-          crop(left_mask_pyramid[0],bbox - left_global_region.min());
-        right_mask_pyramid[0] =
-          crop(right_mask_pyramid[0],right_mask - right_global_region.min());
-
-        // Szeliski's book recommended this simple kernel. This
-        // operation is quickly becoming a time sink, we might
-        // possibly want to write an integer optimized version.
-        std::vector<typename DefaultKernelT<typename Image1T::pixel_type>::type > kernel(5);
-        kernel[0] = kernel[4] = 1.0/16.0;
-        kernel[1] = kernel[3] = 4.0/16.0;
-        kernel[2] = 6.0/16.0;
-        std::vector<uint8> mask_kern(max(m_kernel_size));
-        std::fill(mask_kern.begin(), mask_kern.end(), 1 );
-
-        // Build the pyramid first and then apply the filter to each
-        // level.
-        for ( int32 i = 0; i < max_pyramid_levels; ++i ) {
-          left_pyramid[i+1] = subsample(separable_convolution_filter(left_pyramid[i],kernel,kernel),2);
-          right_pyramid[i+1] = subsample(separable_convolution_filter(right_pyramid[i],kernel,kernel),2);
-          left_pyramid[i] = m_prefilter.filter(left_pyramid[i]);
-          right_pyramid[i] = m_prefilter.filter(right_pyramid[i]);
-          left_mask_pyramid[i+1] = subsample_mask_by_two(left_mask_pyramid[i]);
-          right_mask_pyramid[i+1] = subsample_mask_by_two(right_mask_pyramid[i]);
-        }
-        left_pyramid[max_pyramid_levels] = m_prefilter.filter(left_pyramid[max_pyramid_levels]);
-        right_pyramid[max_pyramid_levels] = m_prefilter.filter(right_pyramid[max_pyramid_levels]);
+
+      if ( !has_data ) {
+        // Either the left or the right image is fully masked here.
+#if VW_DEBUG_LEVEL > 0
+        watch.stop();
+        double elapsed = watch.elapsed_seconds();
+        vw_out(DebugMessage,"stereo")
+          << "Tile " << bbox << " has no data. Processed in "
+          << elapsed << " s\n";
+#endif
+        return prerasterize_type(ImageView<pixel_type>(bbox.width(),
+                                                       bbox.height()),
+                                 -bbox.min().x(), -bbox.min().y(),
+                                 cols(), rows() );
       }
 
       // 3.0) Actually perform correlation now
       ImageView<pixel_type > disparity;
       std::vector<SearchParam> zones;
+      BBox2i top_search(0,0,m_search_region.width()/max_upscaling+1,
+                        m_search_region.height()/max_upscaling+1);
+      double full_top_volume =
+        search_volume(SearchParam(bounding_box(left_mask_pyramid[max_pyramid_levels]), top_search));
+      int32 seed_count = 0;
+      if ( m_seeds ) {
+        // Start from the disparities found by the neighbouring tiles,
+        // with some slack, rather than the whole search region.
+        BBox2i seed;
+        seed_count = m_seeds->query( bbox, 0, seed );
+        if ( seed_count > 0 ) {
+          seed.expand( std::max( 2*max_upscaling, int32(0.1*max(seed.size())) ) );
+          BBox2i top_seed( Vector2i(seed.min() / max_upscaling),
+                           Vector2i((seed.max() + Vector2i(max_upscaling-1,max_upscaling-1))
+                                    / max_upscaling + Vector2i(1,1)) );
+          top_seed.crop( top_search );
+          // Our correlation will fail if the search has only one
+          // solution.
+          if ( top_seed.width() > 1 && top_seed.height() > 1 )
+            top_search = top_seed;
+        }
+      }
       zones.push_back( SearchParam(bounding_box(left_mask_pyramid[max_pyramid_levels]),
-                                   BBox2i(0,0,m_search_region.width()/max_upscaling+1,
-                                          m_search_region.height()/max_upscaling+1)) );
+                                   top_search) );
 
       // Perform correlation. Keep track of how much time elapsed
       // since we started and stop if we estimate that doing one more
@@ -420,7 +648,7 @@ namespace stereo {
                              crop(left_pyramid[level], left_region),
                              crop(right_pyramid[level], right_region),
                              left_region - left_region.min(),
-                             zone.second.size(), m_kernel_size);
+                             zone.second.size(), m_kernel_size, m_sgm_options);
 
           if ( m_consistency_threshold >= 0 && level == 0 ) {
 
@@ -440,7 +668,7 @@ namespace stereo {
                                crop(edge_extend(left_pyramid[level]),
                                     left_region - zone.second.size()),
                                right_region - right_region.min(),
-                               zone.second.size(), m_kernel_size)
+                               zone.second.size(), m_kernel_size, m_sgm_options)
               - pixel_type(zone.second.size());
 
             stereo::cross_corr_consistency_check(crop(disparity,zone.first),
@@ -528,11 +756,30 @@ namespace stereo {
       VW_ASSERT( bbox.size() == bounding_box(disparity).size(),
                  MathErr() << "PyramidCorrelation: Solved disparity doesn't match requested bbox size." );
 
+      // 4.0) Record what this tile found for its neighbours
+      if ( m_seeds ) {
+        PixelAccumulator<EWMinMaxAccumulator<Vector2i> > accumulator;
+        for_each_pixel( disparity, accumulator );
+        if ( accumulator.is_valid() )
+          m_seeds->insert( bbox, BBox2i(accumulator.minimum(),
+                                        accumulator.maximum() + Vector2i(1,1)) );
+      }
+
 #if VW_DEBUG_LEVEL > 0
       watch.stop();
       double elapsed = watch.elapsed_seconds();
       vw_out(DebugMessage,"stereo") << "Tile " << bbox << " processed in "
-                                    << elapsed << " s\n";
+                                    << elapsed << " s, "
+                                    << pyramid_watch.elapsed_seconds() << " s of it on the "
+                                    << ( shared ? "shared" : "tile" ) << " pyramid\n";
+      if ( seed_count > 0 ) {
+        double top_volume =
+          search_volume(SearchParam(bounding_box(left_mask_pyramid[max_pyramid_levels]), top_search));
+        vw_out(DebugMessage,"stereo")
+          << "Tile " << bbox << " seeded by " << seed_count << " neighbours: top level search "
+          << top_search << ", saved about " << m_seconds_per_op * (full_top_volume - top_volume)
+          << " s\n";
+      }
       if (m_corr_timeout > 0.0){
         vw_out(DebugMessage,"stereo")
           << "Elapsed (actual/estimated/ratio): " << elapsed << ' '
@@ -565,13 +812,14 @@ namespace stereo {
                      CostFunctionType cost_type,
                      int corr_timeout, double seconds_per_op,
                      float consistency_threshold,
-                     int32 max_pyramid_levels) {
+                     int32 max_pyramid_levels,
+                     SemiGlobalOptions const& sgm_options = SemiGlobalOptions()) {
     typedef PyramidCorrelationView<Image1T,Image2T,Mask1T,Mask2T,PreFilterT> result_type;
     return result_type( left.impl(), right.impl(), left_mask.impl(),
                         right_mask.impl(), filter.impl(), search_region,
                         kernel_size, cost_type,
                         corr_timeout, seconds_per_op,
-                        consistency_threshold, max_pyramid_levels );
+                        consistency_threshold, max_pyramid_levels, sgm_options );
   }
 
 }} // namespace vw::stereo
@@ -181,7 +181,11 @@ namespace stereo {
   enum CostFunctionType {
     ABSOLUTE_DIFFERENCE,
     SQUARED_DIFFERENCE,
-    CROSS_CORRELATION
+    CROSS_CORRELATION,
+    // Semi-global matching (see SemiGlobalMatching.h) rather than
+    // winner-take-all block matching.
+    SEMI_GLOBAL_CENSUS,
+    SEMI_GLOBAL_ABSOLUTE_DIFFERENCE
   };
 
   template <class ImageT, bool IsInteger>
@@ -0,0 +1,352 @@
+// __BEGIN_LICENSE__
+//  Copyright (c) 2006-2013, United States Government as represented by the
+//  Administrator of the National Aeronautics and Space Administration. All
+//  rights reserved.
+//
+//  The NASA Vision Workbench is licensed under the Apache License,
+//  Version 2.0 (the "License"); you may not use this file except in
+//  compliance with the License. You may obtain a copy of the License at
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+// __END_LICENSE__
+
+
+#include <vw/Stereo/SemiGlobalMatching.h>
+#include <vw/Core/Exception.h>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+using namespace vw;
+
+namespace {
+
+  // The disparities of the search volume are laid out as lanes of a
+  // vector per pixel, one row of the search volume after another.
+  // Each row has one extra sentinel lane, so that stepping one lane
+  // left or right from a real disparity never lands on a disparity of
+  // the next row; stepping a whole row (for 2D searches) from the
+  // first or last row lands in guard lanes around the vector.  The
+  // sentinel and guard lanes always hold the largest cost.
+  struct LaneLayout {
+    int32 sx, sy;   // search volume
+    int32 row;      // lanes per search row, sx + 1
+    int32 lanes;    // row * sy
+    int32 stride;   // lanes, rounded up to a multiple of 8
+    int32 guard;    // guard lanes on each side of an aggregation vector
+    bool two_d;
+
+    LaneLayout( Vector2i const& search ) : sx(search[0]), sy(search[1]) {
+      row = sx + 1;
+      lanes = row * sy;
+      stride = (lanes + 7) & ~7;
+      two_d = sy > 1;
+      guard = ( ( two_d ? row : 1 ) + 7 ) & ~7;
+    }
+  };
+
+  const uint16 MaxCost = 0xFFFF;
+
+  inline int32 popcount64( uint64 x ) {
+#if defined(__GNUC__)
+    return __builtin_popcountll( x );
+#else
+    int32 count = 0;
+    for ( ; x; x &= x - 1 ) ++count;
+    return count;
+#endif
+  }
+
+  // Census transform over kernel-sized windows, sampled every step
+  // pixels so that the comparisons fit in 64 bits.
+  ImageView<uint64> census_transform( ImageView<float> const& image, Vector2i const& kernel,
+                                      int32 cols, int32 rows ) {
+    int32 step = 1;
+    while ( ((kernel[0]+step-1)/step) * ((kernel[1]+step-1)/step) > 64 )
+      ++step;
+    ImageView<uint64> result( cols, rows );
+    for ( int32 y = 0; y < rows; ++y )
+      for ( int32 x = 0; x < cols; ++x ) {
+        const float center = image( x + kernel[0]/2, y + kernel[1]/2 );
+        uint64 bits = 0;
+        for ( int32 j = 0; j < kernel[1]; j += step )
+          for ( int32 i = 0; i < kernel[0]; i += step )
+            bits = ( bits << 1 ) | ( image( x+i, y+j ) < center ? 1 : 0 );
+        result( x, y ) = bits;
+      }
+    return result;
+  }
+
+  void census_costs( ImageView<float> const& left, ImageView<float> const& right,
+                     Vector2i const& kernel, LaneLayout const& layout,
+                     int32 cols, int32 rows, std::vector<uint8>& costs ) {
+    ImageView<uint64> left_census = census_transform( left, kernel, cols, rows );
+    ImageView<uint64> right_census = census_transform( right, kernel, cols + layout.sx - 1, rows + layout.sy - 1 );
+    for ( int32 y = 0; y < rows; ++y )
+      for ( int32 x = 0; x < cols; ++x ) {
+        uint8* c = &costs[ (size_t(y)*cols + x) * layout.stride ];
+        const uint64 l = left_census( x, y );
+        for ( int32 dy = 0; dy < layout.sy; ++dy )
+          for ( int32 dx = 0; dx < layout.sx; ++dx )
+            c[ dy*layout.row + dx ] = uint8( popcount64( l ^ right_census( x+dx, y+dy ) ) );
+      }
+  }
+
+  // Mean absolute difference over the kernel window, kept as running
+  // sums of column sums.
+  void absolute_difference_costs( ImageView<float> const& left, ImageView<float> const& right,
+                                  Vector2i const& kernel, LaneLayout const& layout,
+                                  int32 cols, int32 rows, double intensity_range,
+                                  std::vector<uint8>& costs ) {
+    const double scale = 255.0 / ( 0.25 * intensity_range * prod(kernel) );
+
+    const int32 lcols = left.cols(), lrows = left.rows();
+    std::vector<float> diff( size_t(lcols) * lrows );
+    std::vector<double> col_sum( lcols );
+    for ( int32 dy = 0; dy < layout.sy; ++dy )
+      for ( int32 dx = 0; dx < layout.sx; ++dx ) {
+        for ( int32 y = 0; y < lrows; ++y )
+          for ( int32 x = 0; x < lcols; ++x )
+            diff[ size_t(y)*lcols + x ] = std::fabs( left(x,y) - right(x+dx,y+dy) );
+        std::fill( col_sum.begin(), col_sum.end(), 0.0 );
+        for ( int32 j = 0; j < kernel[1]; ++j )
+          for ( int32 x = 0; x < lcols; ++x )
+            col_sum[x] += diff[ size_t(j)*lcols + x ];
+        const int32 lane = dy*layout.row + dx;
+        for ( int32 y = 0; y < rows; ++y ) {
+          double sum = 0;
+          for ( int32 i = 0; i < kernel[0]; ++i )
+            sum += col_sum[i];
+          for ( int32 x = 0; x < cols; ++x ) {
+            costs[ (size_t(y)*cols + x) * layout.stride + lane ] = uint8( std::min( 255.0, sum * scale + 0.5 ) );
+            if ( x + 1 < cols )
+              sum += col_sum[x + kernel[0]] - col_sum[x];
+          }
+          if ( y + 1 < rows )
+            for ( int32 x = 0; x < lcols; ++x )
+              col_sum[x] += diff[ size_t(y + kernel[1])*lcols + x ] - diff[ size_t(y)*lcols + x ];
+        }
+      }
+  }
+
+  // One step along an aggregation path:
+  //
+  //   L(p,d) = C(p,d) + min( L(q,d), L(q,d+-1) + P1, min_k L(q,k) + P2 ) - min_k L(q,k)
+  //
+  // where q is the previous pixel on the path; with no previous pixel
+  // L(p,d) = C(p,d).  The result is also added into the sum over
+  // paths.  All arithmetic saturates at MaxCost, so sentinel lanes
+  // stay at MaxCost.  Returns min_d L(p,d).
+#if defined(__SSE2__)
+  inline __m128i min_epu16( __m128i a, __m128i b ) {
+    return _mm_sub_epi16( a, _mm_subs_epu16( a, b ) );
+  }
+
+  uint16 aggregate_step( const uint8* cost, const uint16* prev, uint16 prev_min,
+                         uint16* out, uint16* sum, const uint16* pad,
+                         LaneLayout const& layout, uint16 p1, uint16 p2 ) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i vp1 = _mm_set1_epi16( short(p1) );
+    const __m128i vjump = _mm_set1_epi16( short(std::min( int32(prev_min) + p2, int32(MaxCost) )) );
+    const __m128i vmin = _mm_set1_epi16( short(prev_min) );
+    __m128i run_min = _mm_set1_epi16( short(MaxCost) );
+    for ( int32 i = 0; i < layout.stride; i += 8 ) {
+      __m128i l = _mm_unpacklo_epi8( _mm_loadl_epi64( (const __m128i*)(cost + i) ), zero );
+      if ( prev ) {
+        __m128i near = min_epu16( _mm_loadu_si128( (const __m128i*)(prev + i - 1) ),
+                                  _mm_loadu_si128( (const __m128i*)(prev + i + 1) ) );
+        if ( layout.two_d )
+          near = min_epu16( near, min_epu16( _mm_loadu_si128( (const __m128i*)(prev + i - layout.row) ),
+                                             _mm_loadu_si128( (const __m128i*)(prev + i + layout.row) ) ) );
+        __m128i best = min_epu16( _mm_loadu_si128( (const __m128i*)(prev + i) ), _mm_adds_epu16( near, vp1 ) );
+        best = min_epu16( best, vjump );
+        l = _mm_adds_epu16( l, _mm_subs_epu16( best, vmin ) );
+      }
+      l = _mm_or_si128( l, _mm_loadu_si128( (const __m128i*)(pad + i) ) );
+      _mm_storeu_si128( (__m128i*)(out + i), l );
+      _mm_storeu_si128( (__m128i*)(sum + i), _mm_adds_epu16( _mm_loadu_si128( (const __m128i*)(sum + i) ), l ) );
+      run_min = min_epu16( run_min, l );
+    }
+    uint16 lanes[8];
+    _mm_storeu_si128( (__m128i*)lanes, run_min );
+    return *std::min_element( lanes, lanes + 8 );
+  }
+#else
+  inline uint16 adds( uint32 a, uint32 b ) { return uint16( std::min( a + b, uint32(MaxCost) ) ); }
+
+  uint16 aggregate_step( const uint8* cost, const uint16* prev, uint16 prev_min,
+                         uint16* out, uint16* sum, const uint16* pad,
+                         LaneLayout const& layout, uint16 p1, uint16 p2 ) {
+    const uint16 jump = adds( prev_min, p2 );
+    uint16 run_min = MaxCost;
+    for ( int32 i = 0; i < layout.stride; ++i ) {
+      uint16 l = cost[i];
+      if ( prev ) {
+        uint16 near = std::min( prev[i-1], prev[i+1] );
+        if ( layout.two_d )
+          near = std::min( near, std::min( prev[i-layout.row], prev[i+layout.row] ) );
+        uint16 best = std::min( std::min( prev[i], adds( near, p1 ) ), jump );
+        l = adds( l, best - prev_min );
+      }
+      l |= pad[i];
+      out[i] = l;
+      sum[i] = adds( sum[i], l );
+      run_min = std::min( run_min, l );
+    }
+    return run_min;
+  }
+#endif
+
+  // The aggregation state of one path: the last few rows of L, each
+  // pixel's vector surrounded by guard lanes, and the minimum of
+  // each vector.
+  struct PathState {
+    Vector2i dir;
+    int32 ring;
+    std::vector<uint16> lr;
+    std::vector<uint16> lr_min;
+
+    PathState( Vector2i const& dir, int32 cols, LaneLayout const& layout ) :
+      dir(dir), ring( std::abs(dir[1]) + 1 ),
+      lr( size_t(ring) * cols * ( layout.stride + 2*layout.guard ), MaxCost ),
+      lr_min( size_t(ring) * cols, MaxCost ) {}
+  };
+
+  void aggregate( std::vector<uint8> const& costs, std::vector<uint16>& sums,
+                  int32 cols, int32 rows, LaneLayout const& layout,
+                  stereo::SemiGlobalOptions const& options ) {
+    static const int32 dirs[16][2] = { {1,0}, {-1,0}, {0,1}, {0,-1}, {1,1}, {-1,-1}, {-1,1}, {1,-1},
+                                       {2,1}, {-2,-1}, {1,2}, {-1,-2}, {-1,2}, {1,-2}, {-2,1}, {2,-1} };
+    const int32 npaths = options.paths >= 16 ? 16 : 8;
+    const size_t vec = layout.stride + 2*layout.guard;
+
+    std::vector<uint16> pad( layout.stride, 0 );
+    for ( int32 i = 0; i < layout.stride; ++i )
+      if ( i >= layout.lanes || i % layout.row == layout.sx )
+        pad[i] = MaxCost;
+
+    // Paths running down the image (and rightwards along rows) are
+    // done on the way down; the rest on the way back up.
+    for ( int32 pass = 0; pass < 2; ++pass ) {
+      std::vector<PathState> paths;
+      for ( int32 i = 0; i < npaths; ++i ) {
+        Vector2i dir( dirs[i][0], dirs[i][1] );
+        bool down = dir[1] > 0 || ( dir[1] == 0 && dir[0] > 0 );
+        if ( down == ( pass == 0 ) )
+          paths.push_back( PathState( dir, cols, layout ) );
+      }
+
+      for ( int32 step = 0; step < rows; ++step ) {
+        const int32 y = pass == 0 ? step : rows - 1 - step;
+        for ( size_t k = 0; k < paths.size(); ++k ) {
+          PathState& path = paths[k];
+          const int32 py = y - path.dir[1];
+          const int32 slot = y % path.ring, pslot = ( ( py % path.ring ) + path.ring ) % path.ring;
+          const bool row_ok = py >= 0 && py < rows;
+          for ( int32 n = 0; n < cols; ++n ) {
+            const int32 x = path.dir[0] < 0 ? cols - 1 - n : n;
+            const int32 px = x - path.dir[0];
+            const bool has_prev = row_ok && px >= 0 && px < cols;
+            const size_t here = size_t(slot) * cols + x, there = size_t(pslot) * cols + px;
+            path.lr_min[here] =
+              aggregate_step( &costs[ (size_t(y)*cols + x) * layout.stride ],
+                              has_prev ? &path.lr[ there*vec + layout.guard ] : 0,
+                              has_prev ? path.lr_min[there] : 0,
+                              &path.lr[ here*vec + layout.guard ],
+                              &sums[ (size_t(y)*cols + x) * layout.stride ],
+                              &pad[0], layout, options.p1, options.p2 );
+          }
+        }
+      }
+    }
+  }
+
+  ImageView<PixelMask<Vector2i> >
+  match_region( ImageView<float> const& left, ImageView<float> const& right,
+                Vector2i const& search_volume, Vector2i const& kernel_size,
+                stereo::CostFunctionType cost_type, stereo::SemiGlobalOptions const& options ) {
+    const int32 cols = left.cols() - kernel_size[0] + 1, rows = left.rows() - kernel_size[1] + 1;
+    LaneLayout layout( search_volume );
+    std::vector<uint8> costs( size_t(cols) * rows * layout.stride, 0 );
+    if ( cost_type == stereo::SEMI_GLOBAL_ABSOLUTE_DIFFERENCE )
+      absolute_difference_costs( left, right, kernel_size, layout, cols, rows,
+                                 options.intensity_range, costs );
+    else
+      census_costs( left, right, kernel_size, layout, cols, rows, costs );
+
+    std::vector<uint16> sums( costs.size(), 0 );
+    aggregate( costs, sums, cols, rows, layout, options );
+
+    ImageView<PixelMask<Vector2i> > result( cols, rows );
+    for ( int32 y = 0; y < rows; ++y )
+      for ( int32 x = 0; x < cols; ++x ) {
+        const uint16* s = &sums[ (size_t(y)*cols + x) * layout.stride ];
+        int32 best = -1;
+        uint16 best_sum = MaxCost, worst_sum = 0;
+        for ( int32 d = 0; d < layout.lanes; ++d ) {
+          if ( d % layout.row == layout.sx ) continue;
+          if ( best < 0 || s[d] < best_sum ) {
+            best = d;
+            best_sum = s[d];
+          }
+          worst_sum = std::max( worst_sum, s[d] );
+        }
+        result(x,y) = PixelMask<Vector2i>( Vector2i( best % layout.row, best / layout.row ) );
+        if ( best_sum == worst_sum )
+          result(x,y).invalidate();
+      }
+    return result;
+  }
+
+} // namespace
+
+ImageView<PixelMask<Vector2i> >
+vw::stereo::semi_global_matching( ImageView<float> const& left,
+                                  ImageView<float> const& right,
+                                  Vector2i const& search_volume,
+                                  Vector2i const& kernel_size,
+                                  CostFunctionType cost_type,
+                                  SemiGlobalOptions const& options ) {
+  VW_ASSERT( search_volume[0] > 0 && search_volume[1] > 0,
+             ArgumentErr() << "semi_global_matching: Search volume must be greater than 0." );
+  VW_ASSERT( options.p2 <= 1024,
+             ArgumentErr() << "semi_global_matching: P2 must be at most 1024." );
+  VW_ASSERT( cost_type != SEMI_GLOBAL_ABSOLUTE_DIFFERENCE || options.intensity_range > 0,
+             ArgumentErr() << "semi_global_matching: Absolute difference costs need the intensity range of the images." );
+  VW_ASSERT( right.cols() >= left.cols() + search_volume[0] - 1 &&
+             right.rows() >= left.rows() + search_volume[1] - 1,
+             ArgumentErr() << "semi_global_matching: Right image does not cover the search volume." );
+  const int32 cols = left.cols() - kernel_size[0] + 1, rows = left.rows() - kernel_size[1] + 1;
+  if ( cols <= 0 || rows <= 0 )
+    return ImageView<PixelMask<Vector2i> >( std::max( cols, 0 ), std::max( rows, 0 ) );
+
+  // Split into strips of rows if the cost volume would be too big.
+  const size_t row_bytes = size_t(cols) * LaneLayout( search_volume ).stride * 3;
+  const int32 strip_rows = int32( std::max( options.max_memory / row_bytes, size_t(1) ) );
+  if ( strip_rows >= rows )
+    return match_region( left, right, search_volume, kernel_size, cost_type, options );
+
+  const int32 margin = std::min( 32, strip_rows / 4 );
+  const int32 inner = strip_rows - 2*margin;
+  ImageView<PixelMask<Vector2i> > result( cols, rows );
+  for ( int32 r0 = 0; r0 < rows; r0 += inner ) {
+    const int32 r1 = std::min( rows, r0 + inner );
+    const int32 a = std::max( 0, r0 - margin ), b = std::min( rows, r1 + margin );
+    ImageView<float> left_strip = crop( left, 0, a, left.cols(), b - a + kernel_size[1] - 1 );
+    ImageView<float> right_strip = crop( right, 0, a, right.cols(), b - a + kernel_size[1] + search_volume[1] - 2 );
+    ImageView<PixelMask<Vector2i> > strip =
+      match_region( left_strip, right_strip, search_volume, kernel_size, cost_type, options );
+    crop( result, 0, r0, cols, r1 - r0 ) = crop( strip, 0, r0 - a, cols, r1 - r0 );
+  }
+  return result;
+}
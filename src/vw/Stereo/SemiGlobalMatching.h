@@ -0,0 +1,117 @@
+// __BEGIN_LICENSE__
+//  Copyright (c) 2006-2013, United States Government as represented by the
+//  Administrator of the National Aeronautics and Space Administration. All
+//  rights reserved.
+//
+//  The NASA Vision Workbench is licensed under the Apache License,
+//  Version 2.0 (the "License"); you may not use this file except in
+//  compliance with the License. You may obtain a copy of the License at
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+// __END_LICENSE__
+
+
+/// \file SemiGlobalMatching.h
+///
+/// Semi-global matching (Hirschmuller 2008).  A matching cost is
+/// computed for every pixel and every disparity in the search volume,
+/// then smoothed along 8 or 16 straight paths through the image with
+/// a penalty P1 for disparity changes of one step and P2 for larger
+/// jumps.  The winning disparity minimizes the sum over all paths.
+///
+/// This is reached through calc_disparity() and so through
+/// CorrelationView and PyramidCorrelationView by choosing the
+/// SEMI_GLOBAL_CENSUS or SEMI_GLOBAL_ABSOLUTE_DIFFERENCE cost type.
+///
+#ifndef __VW_STEREO_SEMIGLOBALMATCHING_H__
+#define __VW_STEREO_SEMIGLOBALMATCHING_H__
+
+#include <vw/Image/ImageView.h>
+#include <vw/Image/PixelMask.h>
+#include <vw/Image/Manipulation.h>
+#include <vw/Image/PixelMath.h>
+#include <vw/Image/PixelTypeInfo.h>
+#include <vw/Math/Vector.h>
+#include <vw/Stereo/CostFunctions.h>
+
+#include <boost/type_traits/is_floating_point.hpp>
+
+namespace vw {
+namespace stereo {
+
+  /// Tuning for semi-global matching.  The penalties are in units of
+  /// the matching cost: census costs count differing bits (at most
+  /// 64), and absolute difference costs are scaled so that a mean
+  /// difference of a quarter of intensity_range costs 255.  The scale
+  /// is the same for every tile, so a pixel pair costs the same
+  /// wherever it is matched.  Floating point images (including the
+  /// output of a prefilter) have no natural range, so they need an
+  /// intensity_range for absolute difference costs.
+  struct SemiGlobalOptions {
+    int32  paths;           ///< 8 or 16 aggregation paths
+    uint16 p1;              ///< Penalty for a change of one disparity step
+    uint16 p2;              ///< Penalty for larger changes, at most 1024
+    size_t max_memory;      ///< Bytes of cost volume to hold at once
+    double intensity_range; ///< Range of the input intensities; 0 uses the range of an integer pixel type
+
+    SemiGlobalOptions( int32 paths = 8, uint16 p1 = 10, uint16 p2 = 120,
+                       size_t max_memory = size_t(512) << 20,
+                       double intensity_range = 0 ) :
+      paths(paths), p1(p1), p2(p2), max_memory(max_memory),
+      intensity_range(intensity_range) {}
+  };
+
+  /// Semi-global matching on single-channel float images.  The
+  /// arguments follow best_of_search_convolution: the result is
+  /// left.size() - kernel_size + 1 pixels, and right must be
+  /// search_volume - 1 larger than left.  cost_type is one of the
+  /// SEMI_GLOBAL cost types; kernel_size is the census window or the
+  /// window over which absolute differences are averaged.  Absolute
+  /// difference costs throw an ArgumentErr if the options give no
+  /// intensity range.
+  ///
+  /// The cost volume takes three bytes per pixel per disparity.  When
+  /// that exceeds options.max_memory the region is processed in strips
+  /// of rows, each with a margin of extra rows so that the vertical
+  /// paths have room to settle.
+  ImageView<PixelMask<Vector2i> >
+  semi_global_matching( ImageView<float> const& left,
+                        ImageView<float> const& right,
+                        Vector2i const& search_volume,
+                        Vector2i const& kernel_size,
+                        CostFunctionType cost_type,
+                        SemiGlobalOptions const& options = SemiGlobalOptions() );
+
+  /// Rasterizes the given regions of the first channel of two images
+  /// as floats and runs the non-template semi_global_matching() on
+  /// them.  Unless the options give an intensity range, the channel
+  /// range of the left image's pixel type is used; for floating point
+  /// pixels, absolute difference costs throw an ArgumentErr instead.
+  template <class ImageT1, class ImageT2>
+  ImageView<PixelMask<Vector2i> >
+  semi_global_matching( ImageViewBase<ImageT1> const& left,
+                        ImageViewBase<ImageT2> const& right,
+                        BBox2i const& left_region,
+                        Vector2i const& search_volume,
+                        Vector2i const& kernel_size,
+                        CostFunctionType cost_type,
+                        SemiGlobalOptions const& options = SemiGlobalOptions() ) {
+    BBox2i right_region = left_region;
+    right_region.max() += search_volume - Vector2i(1,1);
+    ImageView<float> left_raster = channel_cast<float>( select_channel( crop( left.impl(), left_region ), 0 ) );
+    ImageView<float> right_raster = channel_cast<float>( select_channel( crop( right.impl(), right_region ), 0 ) );
+    SemiGlobalOptions raster_options = options;
+    typedef typename CompoundChannelType<typename ImageT1::pixel_type>::type channel_type;
+    if ( raster_options.intensity_range <= 0 && !boost::is_floating_point<channel_type>::value )
+      raster_options.intensity_range = ChannelRange<typename ImageT1::pixel_type>::max();
+    return semi_global_matching( left_raster, right_raster, search_volume, kernel_size, cost_type, raster_options );
+  }
+
+}} // namespace vw::stereo
+
+#endif // __VW_STEREO_SEMIGLOBALMATCHING_H__
@@ -200,3 +200,152 @@ TEST_F( CorrelationU8, CrossCorrelation ) {
   ASSERT_TRUE( is_valid(disparity(10,10)) );
   CheckResult( disparity );
 }
+
+TEST_F( CorrelationGRAYU8, SemiGlobalCensus ) {
+  result_type disparity =
+    calc_disparity( SEMI_GLOBAL_CENSUS, input1, input2,
+                    bounding_box( input1 ), search_volume, kernel_size );
+  ASSERT_EQ( 19, disparity.cols() );
+  ASSERT_EQ( 21, disparity.rows() );
+  CheckResult( disparity );
+
+  // Sixteen paths, and a memory limit small enough to force the
+  // region to be split into strips.
+  disparity =
+    calc_disparity( SEMI_GLOBAL_CENSUS, input1, input2,
+                    bounding_box( input1 ), search_volume, kernel_size,
+                    SemiGlobalOptions( 16, 10, 120, 19*96*3*8 ) );
+  ASSERT_EQ( 19, disparity.cols() );
+  ASSERT_EQ( 21, disparity.rows() );
+  CheckResult( disparity );
+}
+
+TEST_F( CorrelationGRAYF32, SemiGlobalAbsDifference ) {
+  // Float pixels have no range of their own to scale the costs by
+  EXPECT_THROW( calc_disparity( SEMI_GLOBAL_ABSOLUTE_DIFFERENCE, input1, input2,
+                                bounding_box( input1 ), search_volume, kernel_size ),
+                ArgumentErr );
+
+  result_type disparity =
+    calc_disparity( SEMI_GLOBAL_ABSOLUTE_DIFFERENCE, input1, input2,
+                    bounding_box( input1 ), search_volume, kernel_size,
+                    SemiGlobalOptions( 8, 10, 120, size_t(512) << 20, 1.0 ) );
+  ASSERT_EQ( 19, disparity.cols() );
+  ASSERT_EQ( 21, disparity.rows() );
+  CheckResult( disparity );
+}
+
+TEST_F( CorrelationGRAYU8, SemiGlobalAbsDifference ) {
+  result_type disparity =
+    calc_disparity( SEMI_GLOBAL_ABSOLUTE_DIFFERENCE, input1, input2,
+                    bounding_box( input1 ), search_volume, kernel_size );
+  ASSERT_EQ( 19, disparity.cols() );
+  ASSERT_EQ( 21, disparity.rows() );
+  CheckResult( disparity );
+}
+
+// Along a row whose disparity steps from 2 to 5, the smoothness
+// penalty must not stop SGM from following the step.
+TEST( SemiGlobalMatching, Step ) {
+  boost::rand48 gen(3);
+  ImageView<float> left = uniform_noise_view( gen, 60, 20 );
+  ImageView<float> right( 60 + 7, 20 );
+  fill( right, 0.5 );
+  for ( int32 y = 0; y < 20; ++y )
+    for ( int32 x = 0; x < 60; ++x )
+      right( x + ( x < 30 ? 2 : 5 ), y ) = left( x, y );
+  ImageView<PixelMask<Vector2i> > disparity =
+    semi_global_matching( left, right, Vector2i(8,1), Vector2i(5,5), SEMI_GLOBAL_CENSUS );
+  ASSERT_EQ( 56, disparity.cols() );
+  ASSERT_EQ( 16, disparity.rows() );
+  int32 correct = 0;
+  for ( int32 y = 0; y < disparity.rows(); ++y )
+    for ( int32 x = 0; x < disparity.cols(); ++x ) {
+      // Windows that straddle the step have no right answer.
+      if ( x + 2 >= 26 && x + 2 <= 33 ) continue;
+      Vector2i expected( x + 2 < 30 ? 2 : 5, 0 );
+      if ( is_valid( disparity(x,y) ) && disparity(x,y).child() == expected )
+        ++correct;
+    }
+  EXPECT_GT( correct, 0.95 * 48 * 16 );
+}
+
+// Absolute difference costs are scaled by the given range, not by
+// whatever happens to be in the tile, so one bright pixel must not
+// wash out the costs of everything else.
+TEST( SemiGlobalMatching, AbsDifferenceScale ) {
+  boost::rand48 gen(5);
+  ImageView<float> left = uniform_noise_view( gen, 60, 40 );
+  ImageView<float> right( 60 + 7, 40 );
+  fill( right, 0.5 );
+  left( 0, 0 ) = 1000;
+  for ( int32 y = 0; y < 40; ++y )
+    for ( int32 x = 0; x < 60; ++x )
+      right( x + 3, y ) = left( x, y );
+  ImageView<PixelMask<Vector2i> > disparity =
+    semi_global_matching( left, right, Vector2i(8,1), Vector2i(5,5), SEMI_GLOBAL_ABSOLUTE_DIFFERENCE,
+                          SemiGlobalOptions( 8, 10, 120, size_t(512) << 20, 1.0 ) );
+  ASSERT_EQ( 56, disparity.cols() );
+  ASSERT_EQ( 36, disparity.rows() );
+  int32 correct = 0;
+  for ( int32 y = 10; y < disparity.rows(); ++y )
+    for ( int32 x = 0; x < disparity.cols(); ++x )
+      if ( is_valid( disparity(x,y) ) && disparity(x,y).child() == Vector2i(3,0) )
+        ++correct;
+  EXPECT_GT( correct, 0.95 * 56 * 26 );
+}
+
+// The sliding window search must pick the same disparities as
+// building and box summing a cost image per disparity. The pixel
+// values are small integers so that both sum exactly, and the right
+// image is unrelated noise so that there are plenty of near ties.
+template <template<class,bool> class CostFuncT, class PixelT>
+void check_sliding_search( Vector2i const& search_volume, Vector2i const& kernel_size ) {
+  boost::rand48 gen(5);
+  ImageView<PixelT> left = pixel_cast<PixelT>( floor( 64 * uniform_noise_view( gen, 31, 23 ) ) );
+  ImageView<PixelT> right = pixel_cast<PixelT>( floor( 64 * uniform_noise_view( gen, 31 + search_volume[0] - 1,
+                                                                                23 + search_volume[1] - 1 ) ) );
+  ImageView<PixelMask<Vector2i> > sliding =
+    best_of_search_convolution<CostFuncT>( left, right, bounding_box( left ),
+                                           search_volume, kernel_size, boost::true_type() );
+  ImageView<PixelMask<Vector2i> > generic =
+    best_of_search_convolution<CostFuncT>( left, right, bounding_box( left ),
+                                           search_volume, kernel_size, boost::false_type() );
+  ASSERT_EQ( generic.cols(), sliding.cols() );
+  ASSERT_EQ( generic.rows(), sliding.rows() );
+  for ( int32 j = 0; j < generic.rows(); ++j )
+    for ( int32 i = 0; i < generic.cols(); ++i ) {
+      EXPECT_EQ( is_valid( generic(i,j) ), is_valid( sliding(i,j) ) );
+      EXPECT_VW_EQ( generic(i,j).child(), sliding(i,j).child() );
+    }
+}
+
+TEST( Correlation, SlidingSearch ) {
+  check_sliding_search<AbsoluteCost, PixelGray<uint8> >( Vector2i(9,4), Vector2i(7,5) );
+  check_sliding_search<SquaredCost,  PixelGray<uint8> >( Vector2i(9,4), Vector2i(7,5) );
+  check_sliding_search<AbsoluteCost, PixelGray<float> >( Vector2i(5,1), Vector2i(3,9) );
+  check_sliding_search<SquaredCost,  float            >( Vector2i(1,6), Vector2i(9,1) );
+  check_sliding_search<AbsoluteCost, int16            >( Vector2i(3,3), Vector2i(1,1) );
+}
+
+TEST( SearchRangeIndex, Neighbours ) {
+  SearchRangeIndex index( 100 );
+  index.insert( BBox2i(0,0,64,64), BBox2i(0,0,5,5) );
+  index.insert( BBox2i(64,0,64,64), BBox2i(3,2,10,4) );
+  index.insert( BBox2i(512,512,64,64), BBox2i(20,20,4,4) );
+  EXPECT_EQ( 3u, index.size() );
+
+  // Touching the first two, far from the third
+  BBox2i search;
+  EXPECT_EQ( 2, index.query( BBox2i(0,64,64,64), 0, search ) );
+  EXPECT_EQ( BBox2i(0,0,13,6), search );
+
+  // Only the first touches this one unless we reach further
+  EXPECT_EQ( 0, index.query( BBox2i(-128,0,64,64), 0, search ) );
+  EXPECT_EQ( 1, index.query( BBox2i(-128,0,64,64), 64, search ) );
+  EXPECT_EQ( BBox2i(0,0,5,5), search );
+
+  index.clear();
+  EXPECT_EQ( 0, index.query( BBox2i(0,64,64,64), 0, search ) );
+  EXPECT_EQ( 0u, index.size() );
+}
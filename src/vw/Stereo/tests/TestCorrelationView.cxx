@@ -206,6 +206,26 @@ TEST_F( CorrelationViewU8, NullPreprocess ) {
   check_error( disparity_map, .966, .99, "Cross Correlation" );
 }
 
+TEST_F( CorrelationViewGRAYU8, SemiGlobal ) {
+  // Paths that start at the image border have little to go on, so
+  // the last row and column are sometimes wrong on an image this small.
+  ImageView<PixelMask<Vector2i> > disparity_map =
+    correlate( input1, input2, NullOperation(),
+               search_volume, kernel_size,
+               SEMI_GLOBAL_CENSUS, -1 );
+  ASSERT_EQ( input1.cols(), disparity_map.cols() );
+  ASSERT_EQ( input1.rows(), disparity_map.rows() );
+  check_error( disparity_map, .95, .99, "Semi-global Census" );
+
+  disparity_map =
+    correlate( input1, input2, NullOperation(),
+               search_volume, kernel_size,
+               SEMI_GLOBAL_ABSOLUTE_DIFFERENCE, -1 );
+  ASSERT_EQ( input1.cols(), disparity_map.cols() );
+  ASSERT_EQ( input1.rows(), disparity_map.rows() );
+  check_error( disparity_map, .95, .99, "Semi-global Absolute Difference" );
+}
+
 TEST_F( CorrelationViewGRAYU8, LaplacianOfGaussian) {
   // Percentage correct should never go below 77.4%
   ImageView<PixelMask<Vector2i> > disparity_map =
@@ -408,3 +408,28 @@ TEST_F( PyramidViewU8, NullPreprocess ) {
   ASSERT_EQ( input1.rows(), disparity_map.rows() );
   check_error( disparity_map, .90, .990, "Cross Correlation" );
 }
+
+// Tiles of 64 pixels lie on the coarsest pyramid grid, so they crop
+// their levels out of the shared pyramid.
+TEST_F( PyramidViewGRAYU8, Tiled ) {
+  ImageView<uint8> left_mask = constant_view(uint8(255), input1);
+  ImageView<uint8> right_mask = constant_view(uint8(255), input2);
+  typedef PyramidCorrelationView<image_type, image_type, ImageView<uint8>,
+                                 ImageView<uint8>, NullOperation> view_type;
+  view_type view =
+    pyramid_correlate( input1, input2, left_mask, right_mask,
+                       NullOperation(),
+                       search_volume, kernel_size,
+                       ABSOLUTE_DIFFERENCE,
+                       corr_timeout, seconds_per_op,
+                       -1, max_levels );
+  ImageView<PixelMask<Vector2i> > disparity_map =
+    block_rasterize( view, Vector2i(64,64), 1 );
+  check_error( disparity_map, .909, .998, "Shared pyramid" );
+
+  // Seeded tiles after the first search only what their neighbours
+  // found, so they should do about as well.
+  view.set_search_seeding( true );
+  disparity_map = block_rasterize( view, Vector2i(64,64), 1 );
+  check_error( disparity_map, .909, .998, "Seeded search" );
+}
@@ -0,0 +1,127 @@
+// __BEGIN_LICENSE__
+//  Copyright (c) 2006-2013, United States Government as represented by the
+//  Administrator of the National Aeronautics and Space Administration. All
+//  rights reserved.
+//
+//  The NASA Vision Workbench is licensed under the Apache License,
+//  Version 2.0 (the "License"); you may not use this file except in
+//  compliance with the License. You may obtain a copy of the License at
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+// __END_LICENSE__
+
+
+/// \file block_perftest.cc
+///
+/// Compares the BlockProcessor traversal orders on a deep view
+/// pipeline (cached source -> rotate -> gaussian blur -> crop).  The
+/// source blocks live in a cache that is deliberately too small to
+/// hold the whole image, so the order in which output tiles are
+/// produced decides how often source blocks get regenerated.
+///
+#include <vw/Core/Cache.h>
+#include <vw/Core/Stopwatch.h>
+#include <vw/Image/BlockProcessor.h>
+#include <vw/Image/BlockRasterize.h>
+#include <vw/Image/Filter.h>
+#include <vw/Image/ImageView.h>
+#include <vw/Image/ImageViewRef.h>
+#include <vw/Image/Transform.h>
+#include <vw/Image/UtilityViews.h>
+
+#include <iostream>
+#include <iomanip>
+
+#include <boost/program_options.hpp>
+namespace po = boost::program_options;
+
+using namespace vw;
+
+// A synthetic source image with a little work per pixel, standing in
+// for a file on disk.
+struct PatternFunctor {
+  typedef float32 result_type;
+  result_type operator()( double i, double j, int32 /*p*/ ) const {
+    return result_type( sin(0.05*i) * cos(0.07*j) );
+  }
+};
+
+// Rasterizes one output tile of the pipeline.
+struct TileFunctor {
+  ImageViewRef<float32> m_view;
+  TileFunctor( ImageViewRef<float32> const& view ) : m_view(view) {}
+  void operator()( BBox2i const& bbox ) const {
+    ImageView<float32> tile = crop( m_view, bbox );
+  }
+};
+
+int main( int argc, char** argv ) {
+  int32 size, tile_size, source_tile_size;
+  uint32 threads;
+  size_t cache_mb;
+
+  po::options_description general_options("BlockProcessor traversal benchmark");
+  general_options.add_options()
+    ("size", po::value(&size)->default_value(8192), "Width and height of the image.")
+    ("tile-size", po::value(&tile_size)->default_value(256), "Output tile size.")
+    ("source-tile-size", po::value(&source_tile_size)->default_value(512), "Cached source block size.")
+    ("cache", po::value(&cache_mb)->default_value(32), "Source cache size, in MB.")
+    ("threads", po::value(&threads)->default_value(0), "Number of threads (0 for the default).")
+    ("help,h", "Display this help message");
+
+  po::variables_map vm;
+  po::store( po::command_line_parser( argc, argv ).options(general_options).run(), vm );
+  po::notify( vm );
+
+  if( vm.count("help") ) {
+    std::cout << "Usage: " << argv[0] << "\n\n" << general_options << std::endl;
+    return 1;
+  }
+
+  if( threads == 0 )
+    threads = vw_settings().default_num_threads();
+
+  const char* names[] = { "row-major", "z-order", "hilbert", "striped" };
+  BlockTraversal orders[] = { RowMajorTraversal, ZOrderTraversal, HilbertTraversal, StripedTraversal };
+
+  int32 source_blocks = ( (size + source_tile_size - 1) / source_tile_size );
+  source_blocks *= source_blocks;
+
+  std::cout << size << "x" << size << " image, " << tile_size << " px tiles, "
+            << source_blocks << " source blocks of " << source_tile_size << " px, "
+            << cache_mb << " MB cache, " << threads << " threads\n\n";
+  std::cout << std::setw(10) << "order" << std::setw(12) << "seconds"
+            << std::setw(12) << "hits" << std::setw(12) << "misses"
+            << std::setw(10) << "hit rate" << std::setw(12) << "regenerated" << "\n";
+
+  for( int o = 0; o < 4; ++o ) {
+    // A fresh cache for each run, so every order starts cold.
+    Cache cache( cache_mb * 1024 * 1024, 4 );
+    PerPixelIndexView<PatternFunctor> pattern( PatternFunctor(), size, size, 1 );
+    BlockRasterizeView<PerPixelIndexView<PatternFunctor> > source =
+      block_cache( pattern, Vector2i(source_tile_size, source_tile_size), 1, cache );
+
+    ImageViewRef<float32> pipeline =
+      gaussian_filter( rotate( source, 0.3, Vector2(size/2, size/2), ConstantEdgeExtension() ), 2.0, 2.0 );
+
+    BlockProcessor<TileFunctor> process( TileFunctor(pipeline), Vector2i(tile_size, tile_size), threads, orders[o] );
+
+    uint64 t0 = Stopwatch::microtime();
+    process( BBox2i(0, 0, size, size) );
+    uint64 t1 = Stopwatch::microtime();
+
+    uint64 hits = cache.hits(), misses = cache.misses();
+    std::cout << std::setw(10) << names[o]
+              << std::setw(12) << std::fixed << std::setprecision(3) << (t1 - t0) / 1e6
+              << std::setw(12) << hits << std::setw(12) << misses
+              << std::setw(10) << std::setprecision(4) << ( hits + misses ? double(hits) / double(hits + misses) : 0.0 )
+              << std::setw(12) << int64(misses) - source_blocks << "\n";
+  }
+
+  return 0;
+}
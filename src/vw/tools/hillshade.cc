@@ -184,7 +184,7 @@ void do_hillshade(Options& opt) {
   if ( !std::isnan(opt.blur_sigma) ) {
     vw_out() << "\t--> Blurring pixel with gaussian kernal.  Sigma = "
              << opt.blur_sigma << "\n";
-    dem = gaussian_filter(dem, opt.blur_sigma);
+    dem = gaussian_filter(dem, opt.blur_sigma, AutoGaussian);
   }
 
   // The final result is the dot product of the light source with the normals
@@ -147,7 +147,7 @@ int main(int argc, char** argv) {
     ("no-orientation", po::bool_switch(&no_orientation), "Shutoff rotational invariance")
 
     // Descriptor generator options
-    ("descriptor-generator", po::value(&descriptor_generator)->default_value("sgrad"), "Choose a descriptor generator from [patch,pca,sgrad,sgrad2]");
+    ("descriptor-generator", po::value(&descriptor_generator)->default_value("sgrad"), "Choose a descriptor generator from [patch,pca,sgrad,sgrad2,brief]. Match brief descriptors with ipmatch --hamming.");
 
   po::options_description hidden_options("");
   hidden_options.add_options()
@@ -205,9 +205,10 @@ int main(int argc, char** argv) {
   if ( !( descriptor_generator == "patch" ||
           descriptor_generator == "pca"   ||
           descriptor_generator == "sgrad" ||
-          descriptor_generator == "sgrad2" ) ) {
+          descriptor_generator == "sgrad2" ||
+          descriptor_generator == "brief" ) ) {
     vw_out() << "Unkown descriptor generator: " << descriptor_generator
-             << ". Options are : [ Patch, PCA, SGrad, SGrad2 ]\n";
+             << ". Options are : [ Patch, PCA, SGrad, SGrad2, Brief ]\n";
     exit(0);
   }
 
@@ -240,6 +241,10 @@ int main(int argc, char** argv) {
     if ( max_points == 0 ) tile_max_points = 0; // No culling
     else if ( tile_max_points < 50 ) tile_max_points = 50;
 
+    // With no nodata mask to apply afterwards, the detector can keep
+    // just the max_points best points in the whole image as it goes.
+    size_t image_max_points = image_rsrc->has_nodata_read() ? 0 : max_points;
+
     // Detecting Interest Points
     InterestPointList ip;
     if ( interest_operator == "harris" ) {
@@ -248,11 +253,11 @@ int main(int argc, char** argv) {
       if (!vm.count("single-scale")) {
         ScaledInterestPointDetector<HarrisInterestOperator> detector(interest_operator,
                                                                      tile_max_points);
-        ip = detect_interest_points(image, detector);
+        detect_interest_points(image, detector, ip, image_max_points);
       } else {
         InterestPointDetector<HarrisInterestOperator> detector(interest_operator,
                                                                tile_max_points);
-        ip = detect_interest_points(image, detector);
+        detect_interest_points(image, detector, ip, image_max_points);
       }
     } else if ( interest_operator == "log") {
       // Use a scale-space Laplacian of Gaussian feature detector. The
@@ -262,18 +267,18 @@ int main(int argc, char** argv) {
       if (!vm.count("single-scale")) {
         ScaledInterestPointDetector<LogInterestOperator> detector(interest_operator,
                                                                   tile_max_points);
-        ip = detect_interest_points(image, detector);
+        detect_interest_points(image, detector, ip, image_max_points);
       } else {
         InterestPointDetector<LogInterestOperator> detector(interest_operator,
                                                             tile_max_points);
-        ip = detect_interest_points(image, detector);
+        detect_interest_points(image, detector, ip, image_max_points);
       }
     } else if ( interest_operator == "obalog") {
       // OBALoG threshold is inversely proportional to gain ..
       OBALoGInterestOperator interest_operator(IDEAL_OBALOG_THRESHOLD/ip_gain);
       IntegralInterestPointDetector<OBALoGInterestOperator> detector( interest_operator,
                                                                       tile_max_points );
-      ip = detect_interest_points(image, detector);
+      detect_interest_points(image, detector, ip, image_max_points);
     }
 
     // Removing Interest Points on nodata or within 1/px
@@ -341,6 +346,9 @@ int main(int argc, char** argv) {
     } else if (descriptor_generator == "sgrad2") {
       SGrad2DescriptorGenerator descriptor;
       describe_interest_points( image, descriptor, ip );
+    } else if (descriptor_generator == "brief") {
+      BriefDescriptorGenerator descriptor;
+      describe_interest_points( image, descriptor, ip );
     }
 
     // If ASCII output was requested, write it out.  Otherwise stick
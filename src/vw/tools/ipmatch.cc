@@ -116,6 +116,8 @@ int main(int argc, char** argv) {
     ("help,h", "Display this help message")
     ("matcher-threshold,t", po::value(&matcher_threshold)->default_value(0.6), "Threshold for the interest point matcher.")
     ("non-kdtree", "Use an implementation of the interest matcher that is not reliant on a KDTree algorithm")
+    ("mutual", "Only keep matches that are each other's nearest neighbour")
+    ("hamming", "Match binary descriptors (ipfind --descriptor-generator brief) by Hamming distance")
     ("ransac-constraint,r", po::value(&ransac_constraint)->default_value("similarity"), "RANSAC constraint type.  Choose one of: [similarity, homography, fundamental, or none].")
     ("inlier-threshold,i", po::value(&inlier_threshold)->default_value(10), "RANSAC inlier threshold.")
     ("ransac-iterations", po::value(&ransac_iterations)->default_value(100), "Number of RANSAC iterations.")
@@ -169,9 +171,16 @@ int main(int argc, char** argv) {
 
       std::vector<InterestPoint> matched_ip1, matched_ip2;
 
-      if ( !vm.count("non-kdtree") ) {
+      if ( vm.count("hamming") ) {
+        // Binary descriptors are matched by brute force
+        BinaryMatcher matcher(matcher_threshold, HammingMetric(), NullConstraint(),
+                              false, vm.count("mutual"));
+        matcher(ip1, ip2, matched_ip1, matched_ip2,
+                TerminalProgressCallback( "tools.ipmatch","Matching:"));
+      } else if ( !vm.count("non-kdtree") ) {
         // Run interest point matcher that uses KDTree algorithm.
-        DefaultMatcher matcher(matcher_threshold);
+        DefaultMatcher matcher(matcher_threshold, L2NormMetric(), NullConstraint(),
+                               false, vm.count("mutual"));
         matcher(ip1, ip2, matched_ip1, matched_ip2,
                 TerminalProgressCallback( "tools.ipmatch","Matching:"));
       } else {